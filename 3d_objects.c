@@ -11,6 +11,7 @@
 #include "elconfig.h"
 #include "errors.h"
 #include "events.h"
+#include "gl_init.h"
 #include "map.h"
 #include "particles.h"
 #include "platform.h"
@@ -101,6 +102,8 @@ void draw_3d_object_detail(object3d * object_id, Uint32 material_index, Uint32 u
 
 	// check for having to load the arrays
 	load_e3d_detail_if_needed(object_id->e3d_data);
+	// drawn meshes stay at the front of the LRU list, out of reach of the size limit
+	cache_use(object_id->e3d_data->cache_ptr);
 
 	CHECK_GL_ERRORS();
 	//also, update the last time this object was used
@@ -250,6 +253,8 @@ void draw_3d_objects(unsigned int object_type)
 	unsigned int    start, stop;
 	unsigned int    i, l;
 	int is_selflit, is_transparent, is_ground;
+	const e3d_draw_list* material;
+	float dx, dy, eye_distance, pixel_scale;
 #ifdef  SIMPLE_LOD
 	int x, y, dist;
 #endif
@@ -273,6 +278,10 @@ void draw_3d_objects(unsigned int object_type)
 		return;
 	}
 
+	// screen pixels per world unit at distance one
+	eye_distance = camera_distance * zoom_level;
+	pixel_scale = window_height / (2.0f * perspective);
+
 	// find the modes we need
 	is_selflit= is_self_lit_3d_object(object_type);
 	is_transparent= is_alpha_3d_object(object_type);
@@ -338,6 +347,16 @@ void draw_3d_objects(unsigned int object_type)
 		if(objects_list[l]->e3d_data->materials && (10000*objects_list[l]->e3d_data->materials[get_3dobject_material(j)].max_size)/(dist) < ((is_transparent)?15:10)) continue;
 #endif  //SIMPLE_LOD
 
+		// stream in the texture detail needed for the size on screen
+		if (objects_list[l]->e3d_data->materials)
+		{
+			material = &objects_list[l]->e3d_data->materials[get_3dobject_material(j)];
+			dx = objects_list[l]->x_pos + camera_x;
+			dy = objects_list[l]->y_pos + camera_y;
+			request_texture_screen_size(material->texture, material->max_size * pixel_scale /
+				sqrtf(dx * dx + dy * dy + eye_distance * eye_distance));
+		}
+
 		draw_3d_object_detail(objects_list[l], get_3dobject_material(j), 1, 1, 1);
 
 #ifdef MAP_EDITOR2
@@ -422,12 +441,13 @@ static e3d_object *load_e3d_cache(const char* file_name)
 		return NULL;
 	}
 
-	// Note, doing this after load_e3d_detail() means the cache size is not calculated correctly
-	// but doing it before load_e3d_detail() puts invalid objects into the cache if they fail to load.
-	// This needs fixing properly, but for now this works without other issues.
+	// Note, doing this before load_e3d_detail() puts invalid objects into the cache if they fail to load.
 	// see https://github.com/raduprv/Eternal-Lands/commit/1796c7944f4b11f67595e84ba42fa8e036621de5
+	// The item is not in the cache yet when load_e3d_detail() adjusts its size, so the
+	// vertices and materials are counted here, like load_e3d_detail() counts them.
 	e3d_id->cache_ptr = cache_add_item(cache_e3d, e3d_id->file_name,
-		e3d_id, sizeof(*e3d_id));
+		e3d_id, sizeof(*e3d_id) + e3d_id->vertex_no * e3d_id->vertex_layout->size +
+		e3d_id->material_no * sizeof(e3d_draw_list));
 
 	return e3d_id;
 }
@@ -0,0 +1,743 @@
+/*
+ * Headless benchmark of the actor pipeline.
+ *
+ * Loads the actor definitions from the data directory, spawns enhanced
+ * actors with random outfits through the same code that handles
+ * ADD_NEW_ENHANCED_ACTOR and feeds them move, emote and combat commands
+ * through add_command_to_actor() and add_emote_to_actor(). The simulated
+ * clock then drives the stages of the main loop for a fixed time:
+ *
+ *   commands	the synthetic server commands
+ *   next_command	next_command(), every 60 ms like the main loop
+ *   next_frame	move_to_next_frame(), every 60 ms like the main loop
+ *   animate	animate_actors(), every frame
+ *   skin	skin_actor() for the actors in view, the CPU half of drawing
+ *   textures	with -m, binds a moving half of the actor skins every frame
+ *   lookup	get_actor_ptr_from_id() for every actor and as many unused
+ *		ids, every frame, not part of the frame time
+ *   lookup_scan	the same with the linear scan of the actors_list the id
+ *		index replaced, whose results the lookups must match
+ *
+ * No window or GL context is created. The animation program and eye candy
+ * are off and the textures are CPU only, so none of the stages calls into
+ * GL. The actors within the view distance of the first actor count as
+ * drawn, for the animation level of detail.
+ *
+ * Each stage is timed, and with GNU ld the allocations made while it runs
+ * are counted, see actor_benchmark_alloc.cpp. The actor textures are still
+ * composed on their threads, their allocations are counted in the stage
+ * that runs at the time.
+ *
+ * Usage: el_actor_bench [-d data dir] [-n actors] [-t seconds] [-f fps]
+ *	[-s seed] [-v view distance] [-q pose quantum] [-m texture budget]
+ *	[-l] [-p] [-k]
+ *
+ *   -q	ms of animation time that share a pose, 0 turns the pose cache off
+ *   -m	MB of texture memory, adds the textures stage, which tests the
+ *	texture budget with the CPU only texture mode
+ *   -l	animate all actors in every frame (animation_lod off)
+ *   -p	update the skeletons on the main thread (parallel_animation off)
+ *   -k	skin with cal3d (use_fast_skinning off)
+ *
+ * Build with -DACTOR_BENCHMARK=1 for cmake or "make -f Makefile.linux
+ * el_actor_bench".
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <SDL.h>
+#include "actor_defs_cache.h"
+#include "actor_init.h"
+#include "actor_scripts.h"
+#include "actors.h"
+#include "asc.h"
+#include "cache.h"
+#include "client_serv.h"
+#include "elloggingwrapper.h"
+#include "eye_candy_wrapper.h"
+#include "hash.h"
+#include "init.h"
+#include "main.h"
+#include "missiles.h"
+#include "new_actors.h"
+#include "pose_cache.h"
+#include "textures.h"
+#include "worker_pool.h"
+#include "io/elfilewrapper.h"
+#include "io/fileutil.h"
+#include "io/xmlcallbacks.h"
+
+#define FIRST_ACTOR_ID		1000
+#define COMMAND_INTERVAL	60	/* ms between next_command() calls, as in the main loop */
+#define MAX_EMOTE_IDS		256
+#define SPAWN_RADIUS		40	/* tiles around the center */
+#define CENTER			256
+
+typedef enum
+{
+	STAGE_SPAWN,
+	STAGE_COMMANDS,
+	STAGE_NEXT_COMMAND,
+	STAGE_NEXT_FRAME,
+	STAGE_ANIMATE,
+	STAGE_SKIN,
+	STAGE_TEXTURES,
+	STAGE_LOOKUP,
+	STAGE_LOOKUP_SCAN,
+	STAGE_COUNT
+} stage_t;
+
+typedef struct
+{
+	Uint32 calls;
+	Uint64 total_time;
+	Uint64 max_time;
+	Uint64 allocations;
+	Uint64 allocated_bytes;
+} stage_stats_t;
+
+static const char *stage_names[STAGE_COUNT] =
+{
+	"spawn", "commands", "next_command", "next_frame", "animate", "skin",
+	"textures", "lookup", "lookup_scan"
+};
+
+/* the playable races, the others have no enhanced actor definitions */
+static const int player_types[] =
+{
+	human_female, human_male, elf_female, elf_male, dwarf_female,
+	dwarf_male, gnome_female, gnome_male, orchan_female, orchan_male,
+	draegoni_female, draegoni_male
+};
+
+static stage_stats_t stage_stats[STAGE_COUNT];
+static Uint64 stage_start_time;
+static Uint64 stage_start_allocations;
+static Uint64 stage_start_bytes;
+
+static int emote_ids[MAX_EMOTE_IDS];
+static int emote_id_count = 0;
+
+static int actor_count = 200;
+static float simulated_seconds = 60.0f;
+static int frames_per_second = 60;
+static float view_distance = 12.0f;
+
+static Uint32 random_state = 1;
+
+static actor *lookup_results[2 * MAX_ACTORS];
+static Uint32 lookup_mismatches = 0;
+
+static int texture_budget = -1;
+static Uint32 skin_textures[MAX_ACTOR_DEFS];
+static Uint32 skin_texture_count = 0;
+
+#ifdef	COUNT_ALLOCATIONS
+/*
+ * Counts the allocations. The build links with -Wl,--wrap=malloc and so on,
+ * which sends the calls of the client objects here. The operator new of
+ * actor_benchmark_alloc.cpp replaces the one of the whole process and
+ * allocates through here too, so the C++ allocations of cal3d and the C++
+ * runtime are counted as well. Only their direct malloc calls are not seen.
+ */
+extern void *__real_malloc(size_t size);
+extern void *__real_calloc(size_t count, size_t size);
+extern void *__real_realloc(void *pointer, size_t size);
+extern void __real_free(void *pointer);
+
+static volatile Uint64 allocations = 0;
+static volatile Uint64 allocated_bytes = 0;
+
+void *__wrap_malloc(size_t size)
+{
+	__sync_fetch_and_add(&allocations, 1);
+	__sync_fetch_and_add(&allocated_bytes, size);
+	return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+	__sync_fetch_and_add(&allocations, 1);
+	__sync_fetch_and_add(&allocated_bytes, count * size);
+	return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *pointer, size_t size)
+{
+	__sync_fetch_and_add(&allocations, 1);
+	__sync_fetch_and_add(&allocated_bytes, size);
+	return __real_realloc(pointer, size);
+}
+
+void __wrap_free(void *pointer)
+{
+	__real_free(pointer);
+}
+#else	/* COUNT_ALLOCATIONS */
+static const Uint64 allocations = 0;
+static const Uint64 allocated_bytes = 0;
+#endif	/* COUNT_ALLOCATIONS */
+
+static Uint32 get_random(Uint32 range)
+{
+	/* xorshift, so a seed always gives the same crowd */
+	random_state ^= random_state << 13;
+	random_state ^= random_state >> 17;
+	random_state ^= random_state << 5;
+
+	return range > 0 ? random_state % range : 0;
+}
+
+static void put_16(char *buffer, Uint16 value)
+{
+	buffer[0] = value & 0xFF;
+	buffer[1] = value >> 8;
+}
+
+static void start_stage(void)
+{
+	stage_start_allocations = allocations;
+	stage_start_bytes = allocated_bytes;
+	stage_start_time = SDL_GetPerformanceCounter();
+}
+
+static void end_stage(stage_t stage)
+{
+	stage_stats_t *stats = &stage_stats[stage];
+	Uint64 time;
+
+	time = SDL_GetPerformanceCounter() - stage_start_time;
+
+	stats->calls++;
+	stats->total_time += time;
+	if (time > stats->max_time)
+	{
+		stats->max_time = time;
+	}
+	stats->allocations += allocations - stage_start_allocations;
+	stats->allocated_bytes += allocated_bytes - stage_start_bytes;
+}
+
+static void spawn_actor(int index)
+{
+	static const int shields[] = { SHIELD_WOOD, SHIELD_IRON, SHIELD_STEEL, SHIELD_NONE };
+	static const int helmets[] = { HELMET_IRON, HELMET_FUR, HELMET_LEATHER, HELMET_NONE };
+	char data[128];
+	int length;
+
+	memset(data, 0, sizeof(data));
+	put_16(data, FIRST_ACTOR_ID + index);
+	put_16(data + 2, (CENTER + get_random(2 * SPAWN_RADIUS + 1) - SPAWN_RADIUS) & 0x7FF);
+	put_16(data + 4, (CENTER + get_random(2 * SPAWN_RADIUS + 1) - SPAWN_RADIUS) & 0x7FF);
+	put_16(data + 8, get_random(8) * 45);
+	data[10] = player_types[get_random(sizeof(player_types) / sizeof(player_types[0]))];
+	data[12] = SKIN_BROWN + get_random(4);
+	data[13] = HAIR_BLACK + get_random(6);
+	data[14] = SHIRT_BLACK + get_random(SHIRT_BRONZE_PLATE_ARMOR + 1);
+	data[15] = PANTS_BLACK + get_random(PANTS_AUGMENTED_LEATHER_CUISSES + 1);
+	data[16] = BOOTS_BLACK + get_random(BOOTS_AUGMENTED_LEATHER_GREAVE + 1);
+	data[17] = HEAD_1 + get_random(5);
+	data[18] = shields[get_random(sizeof(shields) / sizeof(shields[0]))];
+	/* only the weapons without effects, eye candy is off */
+	data[19] = WEAPON_NONE + get_random(PICKAX + 1);
+	data[20] = get_random(2) ? CAPE_BLACK + get_random(CAPE_ORANGE + 1) : CAPE_NONE;
+	data[21] = helmets[get_random(sizeof(helmets) / sizeof(helmets[0]))];
+	data[22] = frame_idle;
+	put_16(data + 23, 100);
+	put_16(data + 25, 100);
+	data[27] = HUMAN;
+	length = 28 + snprintf(data + 28, 32, "Bench%d", index) + 1;
+	put_16(data + length, ACTOR_SCALE_BASE);
+	data[length + 2] = (char)255;	/* no attachment */
+	data[length + 3] = 0;		/* eyes */
+	data[length + 4] = NECK_NONE;
+
+	add_enhanced_actor_from_server(data, length + 5);
+}
+
+static void find_emotes(void)
+{
+	hash_entry *he;
+
+	if (emotes == NULL)
+	{
+		return;
+	}
+
+	hash_start_iterator(emotes);
+	while (((he = hash_get_next(emotes)) != NULL) && (emote_id_count < MAX_EMOTE_IDS))
+	{
+		emote_ids[emote_id_count++] = (int)(uintptr_t)he->key;
+	}
+}
+
+/* what the server sends for a crowd: mostly walking, some emotes and fights */
+static void add_random_commands(int id)
+{
+	Uint32 i, steps, dir;
+
+	switch (get_random(10))
+	{
+		case 0:
+		case 1:
+		case 2:
+		case 3:
+		case 4:
+			dir = get_random(8);
+			steps = 1 + get_random(4);
+			for (i = 0; i < steps; i++)
+			{
+				add_command_to_actor(id, move_n + dir);
+			}
+			break;
+		case 5:
+			if (emote_id_count > 0)
+			{
+				add_emote_to_actor(id, emote_ids[get_random(emote_id_count)]);
+			}
+			break;
+		case 6:
+		case 7:
+			add_command_to_actor(id, enter_combat);
+			add_command_to_actor(id, attack_up_1 + get_random(4));
+			add_command_to_actor(id, pain1);
+			add_command_to_actor(id, leave_combat);
+			break;
+		case 8:
+			add_command_to_actor(id, get_random(2) ? turn_left : turn_right);
+			break;
+		default:
+			break;
+	}
+}
+
+static void update_commands(void)
+{
+	actor *a;
+	int i, due;
+
+	/* an actor gets new commands about once a second, when it has nothing to do */
+	for (i = 0; i < actor_count; i++)
+	{
+		LOCK_ACTORS_LISTS();
+		a = get_actor_ptr_from_id(FIRST_ACTOR_ID + i);
+		due = (a != NULL) && (a->que_length == 0) && !a->moving &&
+			(get_random(1000) < COMMAND_INTERVAL);
+		UNLOCK_ACTORS_LISTS();
+
+		if (due)
+		{
+			add_random_commands(FIRST_ACTOR_ID + i);
+		}
+	}
+}
+
+/* there is no frustum, the actors near the first one count as drawn */
+static void update_visible_actors(void)
+{
+	actor *me, *a;
+	float dx, dy;
+	int i;
+
+	me = get_our_actor();
+
+	for (i = 0; i < max_actors; i++)
+	{
+		a = actors_list[i];
+		if ((a == NULL) || (me == NULL))
+		{
+			continue;
+		}
+
+		dx = a->x_pos - me->x_pos;
+		dy = a->y_pos - me->y_pos;
+		if ((dx * dx + dy * dy) <= (view_distance * view_distance))
+		{
+			a->last_visible_time = cur_time;
+		}
+	}
+}
+
+static void skin_visible_actors(void)
+{
+	int i;
+
+	for (i = 0; i < max_actors; i++)
+	{
+		if ((actors_list[i] != NULL) && (actors_list[i]->calmodel != NULL) &&
+			(actors_list[i]->last_visible_time == cur_time))
+		{
+			skin_actor(actors_list[i], 1);
+		}
+	}
+}
+
+static void load_skin_textures(void)
+{
+	int i;
+
+	for (i = 0; i < MAX_ACTOR_DEFS; i++)
+	{
+		if (actors_defs[i].skin_name[0] != '\0')
+		{
+			skin_textures[skin_texture_count++] =
+				load_texture_cached(actors_defs[i].skin_name, tt_mesh);
+		}
+	}
+}
+
+/* what the main loop does with the textures, the bound half moves on by
+ * one skin a second, so old textures fall out of the budget */
+static void bind_skin_textures(Uint32 frame)
+{
+	Uint32 i, first;
+
+	check_texture_memory_budget();
+	upload_decoded_textures();
+
+	if (skin_texture_count == 0)
+	{
+		return;
+	}
+
+	first = frame / frames_per_second;
+
+	for (i = 0; i < (skin_texture_count + 1) / 2; i++)
+	{
+		bind_texture(skin_textures[(first + i) % skin_texture_count]);
+	}
+}
+
+/* the ids of all actors and as many unused ones */
+static Uint32 get_lookup_count(void)
+{
+	if (actor_count > MAX_ACTORS)
+	{
+		return 2 * MAX_ACTORS;
+	}
+
+	return 2 * actor_count;
+}
+
+static void lookup_actors(void)
+{
+	Uint32 i, count;
+
+	count = get_lookup_count();
+
+	for (i = 0; i < count; i++)
+	{
+		lookup_results[i] = get_actor_ptr_from_id(FIRST_ACTOR_ID + i);
+	}
+}
+
+/* how get_actor_ptr_from_id() found the actors before the id index */
+static void scan_actors(void)
+{
+	actor *found;
+	Uint32 i, count;
+	int j;
+
+	count = get_lookup_count();
+
+	for (i = 0; i < count; i++)
+	{
+		found = NULL;
+
+		for (j = 0; j < max_actors; j++)
+		{
+			if (actors_list[j] && (actors_list[j]->actor_id == FIRST_ACTOR_ID + i))
+			{
+				found = actors_list[j];
+				break;
+			}
+		}
+
+		if (found != lookup_results[i])
+		{
+			lookup_mismatches++;
+		}
+	}
+}
+
+static void print_stats(Uint32 frames)
+{
+#ifndef	DYNAMIC_ANIMATIONS
+	Uint32 counts[ANIMATION_LOD_COUNT], updates;
+	Uint32 hits, misses, skipped, entries;
+#endif	//DYNAMIC_ANIMATIONS
+	texture_residency_stats_t residency;
+	const stage_stats_t *stats;
+	double frequency, frame_time = 0.0;
+	int i;
+
+	frequency = SDL_GetPerformanceFrequency();
+
+	printf("%d actors, %.1f s simulated at %d fps (%u frames), %u worker threads\n",
+		max_actors, simulated_seconds, frames_per_second, frames,
+		get_worker_pool_size());
+#ifndef	COUNT_ALLOCATIONS
+	printf("allocations are only counted with GNU ld\n");
+#endif	/* COUNT_ALLOCATIONS */
+	printf("%-14s %8s %11s %10s %10s %12s %12s\n", "stage", "calls",
+		"total ms", "avg us", "max us", "allocs", "alloc kB");
+
+	for (i = 0; i < STAGE_COUNT; i++)
+	{
+		stats = &stage_stats[i];
+		if (stats->calls == 0)
+		{
+			continue;
+		}
+
+		printf("%-14s %8u %11.2f %10.2f %10.2f %12llu %12.1f\n",
+			stage_names[i], stats->calls,
+			1000.0 * stats->total_time / frequency,
+			1000000.0 * stats->total_time / stats->calls / frequency,
+			1000000.0 * stats->max_time / frequency,
+			(unsigned long long)stats->allocations,
+			stats->allocated_bytes / 1024.0);
+
+		if ((i != STAGE_SPAWN) && (i != STAGE_LOOKUP) &&
+			(i != STAGE_LOOKUP_SCAN))
+		{
+			frame_time += stats->total_time;
+		}
+	}
+
+	if (frames > 0)
+	{
+		printf("%.2f us per frame, %.2f us per actor and frame\n",
+			1000000.0 * frame_time / frames / frequency,
+			max_actors > 0 ? 1000000.0 * frame_time / frames / max_actors / frequency : 0.0);
+	}
+
+	printf("%u id lookups per frame, %u differ from the scan\n",
+		get_lookup_count(), lookup_mismatches);
+
+#ifndef	DYNAMIC_ANIMATIONS
+	get_animation_lod_stats(counts, &updates);
+	printf("animation level of detail %s: %u full, %u reduced, %u low, %u frozen, "
+		"%u skeletons updated in the last frame\n", animation_lod ? "on" : "off",
+		counts[ANIMATION_LOD_FULL], counts[ANIMATION_LOD_REDUCED],
+		counts[ANIMATION_LOD_LOW], counts[ANIMATION_LOD_FROZEN], updates);
+
+	get_pose_cache_stats(&hits, &misses, &skipped, &entries);
+	printf("shared poses (%d ms): %u hits, %u misses (%.1f%% hit rate), "
+		"%u not shareable, %u poses cached\n", pose_cache_quantum, hits,
+		misses, hits + misses > 0 ? 100.0 * hits / (hits + misses) : 0.0,
+		skipped, entries);
+#endif	//DYNAMIC_ANIMATIONS
+
+	if (texture_budget >= 0)
+	{
+		get_texture_residency_stats(&residency);
+		printf("textures (%d MB budget, %u skins): %u resident, %llu kB "
+			"(peak %llu kB), %llu binds, %.1f%% hit rate, %llu "
+			"evictions (%llu kB)\n", texture_budget, skin_texture_count,
+			residency.resident,
+			(unsigned long long)(residency.resident_bytes / 1024),
+			(unsigned long long)(residency.peak_resident_bytes / 1024),
+			(unsigned long long)residency.binds,
+			residency.binds > 0 ? 100.0 * residency.hits / residency.binds : 0.0,
+			(unsigned long long)residency.evictions,
+			(unsigned long long)(residency.evicted_bytes / 1024));
+	}
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [-d data dir] [-n actors] [-t seconds] [-f fps] "
+		"[-s seed] [-v view distance] [-q pose quantum] [-m texture budget] "
+		"[-l] [-p] [-k]\n", name);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	Uint32 frames, frame, frame_time, last_command_time;
+	int i;
+
+	for (i = 1; i < argc; i++)
+	{
+		if ((strcmp(argv[i], "-d") == 0) && (i + 1 < argc))
+		{
+			safe_strncpy(datadir, argv[++i], sizeof(datadir));
+		}
+		else if ((strcmp(argv[i], "-n") == 0) && (i + 1 < argc))
+		{
+			actor_count = atoi(argv[++i]);
+		}
+		else if ((strcmp(argv[i], "-t") == 0) && (i + 1 < argc))
+		{
+			simulated_seconds = atof(argv[++i]);
+		}
+		else if ((strcmp(argv[i], "-f") == 0) && (i + 1 < argc))
+		{
+			frames_per_second = atoi(argv[++i]);
+		}
+		else if ((strcmp(argv[i], "-s") == 0) && (i + 1 < argc))
+		{
+			random_state = strtoul(argv[++i], NULL, 0);
+		}
+		else if ((strcmp(argv[i], "-v") == 0) && (i + 1 < argc))
+		{
+			view_distance = atof(argv[++i]);
+		}
+#ifndef	DYNAMIC_ANIMATIONS
+		else if ((strcmp(argv[i], "-q") == 0) && (i + 1 < argc))
+		{
+			pose_cache_quantum = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-l") == 0)
+		{
+			animation_lod = 0;
+		}
+		else if (strcmp(argv[i], "-p") == 0)
+		{
+			parallel_animation = 0;
+		}
+#endif	//DYNAMIC_ANIMATIONS
+		else if ((strcmp(argv[i], "-m") == 0) && (i + 1 < argc))
+		{
+			texture_budget = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-k") == 0)
+		{
+			use_fast_skinning = 0;
+		}
+		else
+		{
+			usage(argv[0]);
+		}
+	}
+
+	if ((actor_count < 1) || (actor_count >= MAX_ACTORS) ||
+		(frames_per_second < 1) || (frames_per_second > 1000) ||
+		(simulated_seconds <= 0.0f) || (random_state == 0))
+	{
+		usage(argv[0]);
+	}
+
+	if (chdir(datadir) != 0)
+	{
+		fprintf(stderr, "Can't change to the data directory %s\n", datadir);
+		return 1;
+	}
+
+	if (SDL_Init(0) != 0)
+	{
+		fprintf(stderr, "Can't initialise SDL: %s\n", SDL_GetError());
+		return 1;
+	}
+
+	init_logging("log");
+
+	/* nothing may touch GL */
+	use_animation_program = 0;
+	use_eye_candy = 0;
+	texture_cpu_only = 1;
+	texture_memory_budget = texture_budget;
+
+	init_crc_tables();
+	init_zip_archives();
+	xml_register_el_input_callbacks();
+	cache_system_init(MAX_CACHE_SYSTEM);
+	init_texture_cache();
+	build_glow_color_table();
+	init_actors_lists();
+	init_worker_pool();
+	load_actor_defs();
+	missiles_init_defs();
+	find_emotes();
+
+	if (texture_budget >= 0)
+	{
+		load_skin_textures();
+	}
+
+	/* the first actor is you, the view and the level of detail follow it */
+	yourself = FIRST_ACTOR_ID;
+
+	start_stage();
+	for (i = 0; i < actor_count; i++)
+	{
+		spawn_actor(i);
+	}
+	end_stage(STAGE_SPAWN);
+
+	if (max_actors == 0)
+	{
+		fprintf(stderr, "No actors were created, is %s the data directory?\n", datadir);
+		return 1;
+	}
+
+	frame_time = 1000 / frames_per_second;
+	frames = simulated_seconds * 1000.0f / frame_time;
+	cur_time = 1000;
+	last_command_time = cur_time;
+
+	for (frame = 0; frame < frames; frame++)
+	{
+		cur_time += frame_time;
+
+		if (cur_time > last_command_time + COMMAND_INTERVAL)
+		{
+			start_stage();
+			update_commands();
+			end_stage(STAGE_COMMANDS);
+
+			start_stage();
+			LOCK_ACTORS_LISTS();
+			next_command();
+			UNLOCK_ACTORS_LISTS();
+			end_stage(STAGE_NEXT_COMMAND);
+
+			start_stage();
+			move_to_next_frame();
+			end_stage(STAGE_NEXT_FRAME);
+
+			last_command_time = cur_time;
+		}
+
+		start_stage();
+		animate_actors();
+		end_stage(STAGE_ANIMATE);
+
+		start_stage();
+		LOCK_ACTORS_LISTS();
+		update_visible_actors();
+		skin_visible_actors();
+		UNLOCK_ACTORS_LISTS();
+		end_stage(STAGE_SKIN);
+
+		if (texture_budget >= 0)
+		{
+			start_stage();
+			bind_skin_textures(frame);
+			end_stage(STAGE_TEXTURES);
+		}
+
+		LOCK_ACTORS_LISTS();
+		start_stage();
+		lookup_actors();
+		end_stage(STAGE_LOOKUP);
+
+		start_stage();
+		scan_actors();
+		end_stage(STAGE_LOOKUP_SCAN);
+		UNLOCK_ACTORS_LISTS();
+	}
+
+	print_stats(frames);
+
+	destroy_all_actors();
+	end_actors_lists();
+	free_worker_pool();
+	free_texture_cache();
+	SDL_Quit();
+
+	return lookup_mismatches != 0;
+}
@@ -0,0 +1,74 @@
+/*
+ * The global operator new and delete of the headless actor benchmark, see
+ * actor_benchmark.c.
+ *
+ * They replace the ones of the C++ runtime in the whole process, cal3d and
+ * libstdc++ included, and allocate with malloc. As the benchmark is linked
+ * with -Wl,--wrap=malloc, the calls made here are counted by __wrap_malloc,
+ * so the C++ allocations of the shared libraries are counted as well.
+ */
+#ifdef	COUNT_ALLOCATIONS
+#include <cstdlib>
+#include <new>
+
+void* operator new(std::size_t size)
+{
+	void* pointer;
+
+	pointer = std::malloc(size > 0 ? size : 1);
+
+	if (pointer == 0)
+	{
+		throw std::bad_alloc();
+	}
+
+	return pointer;
+}
+
+void* operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) throw()
+{
+	return std::malloc(size > 0 ? size : 1);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) throw()
+{
+	return std::malloc(size > 0 ? size : 1);
+}
+
+void operator delete(void* pointer) throw()
+{
+	std::free(pointer);
+}
+
+void operator delete[](void* pointer) throw()
+{
+	std::free(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) throw()
+{
+	std::free(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) throw()
+{
+	std::free(pointer);
+}
+
+#ifdef	__cpp_sized_deallocation
+void operator delete(void* pointer, std::size_t) throw()
+{
+	std::free(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) throw()
+{
+	std::free(pointer);
+}
+#endif	/* __cpp_sized_deallocation */
+#endif	/* COUNT_ALLOCATIONS */
@@ -0,0 +1,1160 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL.h>
+#include "actor_defs_cache.h"
+#include "actor_init.h"
+#include "actor_scripts.h"
+#include "asc.h"
+#include "cal3d_wrapper.h"
+#include "errors.h"
+#include "hash.h"
+#include "skeletons.h"
+#include "worker_pool.h"
+#ifdef NEW_SOUND
+#include "sound.h"
+#endif // NEW_SOUND
+#include "io/cal3d_io_wrapper.h"
+#include "io/elfilewrapper.h"
+#include "io/elpathwrapper.h"
+#ifndef FASTER_MAP_LOAD
+#include "xz/7zCrc.h"
+#endif // FASTER_MAP_LOAD
+
+#define ACTOR_DEFS_CACHE_FILE		"actor_defs.cache"
+#define ACTOR_DEFS_CACHE_MAGIC		0x43444145	/* "EADC" */
+#define ACTOR_DEFS_CACHE_VERSION	2
+#define ACTOR_DEFS_CACHE_MAX_FILES	65536
+#define ACTOR_DEFS_CACHE_MAX_LOADS	1000000
+#define ACTOR_DEFS_CACHE_SIZES		16
+
+#define MAX_EMOTE_LISTS	(EMOTE_ACTOR_TYPES * 4 * 2)
+
+typedef struct
+{
+	char name[MAX_FILE_PATH];
+	Uint32 crc;
+} source_file_t;
+
+typedef struct
+{
+	Sint32 type;
+	Sint32 actor_type;
+	Sint32 result;
+	float scale;
+	char name[MAX_FILE_PATH];
+} actor_def_load_t;
+
+typedef struct
+{
+	Uint32 magic;
+	Uint32 version;
+	Uint32 features;
+	Uint32 sizes[ACTOR_DEFS_CACHE_SIZES];	/* the cache is only valid for the same layout */
+	Uint32 file_count;
+	Uint32 load_count;
+} cache_header_t;
+
+/* the part arrays of an actor type, with the element size and count */
+typedef struct
+{
+	size_t offset;
+	size_t size;
+	int part;
+} part_array_t;
+
+static const part_array_t part_arrays[] =
+{
+	{ offsetof(actor_types, head), sizeof(body_part), ACTOR_HEAD_SIZE },
+	{ offsetof(actor_types, shield), sizeof(shield_part), ACTOR_SHIELD_SIZE },
+	{ offsetof(actor_types, cape), sizeof(body_part), ACTOR_CAPE_SIZE },
+	{ offsetof(actor_types, helmet), sizeof(body_part), ACTOR_HELMET_SIZE },
+	{ offsetof(actor_types, neck), sizeof(body_part), ACTOR_NECK_SIZE },
+	{ offsetof(actor_types, weapon), sizeof(weapon_part), ACTOR_WEAPON_SIZE },
+	{ offsetof(actor_types, shirt), sizeof(shirt_part), ACTOR_SHIRT_SIZE },
+	{ offsetof(actor_types, skin), sizeof(skin_part), ACTOR_SKIN_SIZE },
+	{ offsetof(actor_types, hair), sizeof(hair_part), ACTOR_HAIR_SIZE },
+	{ offsetof(actor_types, eyes), sizeof(eyes_part), ACTOR_EYES_SIZE },
+	{ offsetof(actor_types, boots), sizeof(boots_part), ACTOR_BOOTS_SIZE },
+	{ offsetof(actor_types, legs), sizeof(legs_part), ACTOR_LEGS_SIZE }
+};
+
+#define PART_ARRAY_COUNT	(sizeof(part_arrays) / sizeof(part_arrays[0]))
+
+static int recording = 0;
+static source_file_t *source_files = NULL;
+static Uint32 source_file_count = 0;
+static Uint32 source_file_size = 0;
+static hash_table *source_file_names = NULL;
+static actor_def_load_t *actor_def_loads = NULL;
+static Uint32 actor_def_load_count = 0;
+static Uint32 actor_def_load_size = 0;
+
+static void init_cache_header(cache_header_t *header)
+{
+	memset(header, 0, sizeof(cache_header_t));
+
+	header->magic = ACTOR_DEFS_CACHE_MAGIC;
+	header->version = ACTOR_DEFS_CACHE_VERSION;
+#ifdef NEW_SOUND
+	header->features |= 1;
+#endif // NEW_SOUND
+#ifdef EXT_ACTOR_DICT
+	header->features |= 2;
+#endif // EXT_ACTOR_DICT
+	header->sizes[0] = MAX_ACTOR_DEFS;
+	header->sizes[1] = sizeof(actor_types);
+	header->sizes[2] = sizeof(attachment_props);
+	header->sizes[3] = sizeof(struct cal_anim);
+	header->sizes[4] = sizeof(body_part);
+	header->sizes[5] = sizeof(shield_part);
+	header->sizes[6] = sizeof(weapon_part);
+	header->sizes[7] = sizeof(shirt_part);
+	header->sizes[8] = sizeof(skin_part);
+	header->sizes[9] = sizeof(hair_part);
+	header->sizes[10] = sizeof(eyes_part);
+	header->sizes[11] = sizeof(boots_part);
+	header->sizes[12] = sizeof(legs_part);
+	header->sizes[13] = sizeof(emote_data);
+	header->sizes[14] = sizeof(emote_frame);
+	header->sizes[15] = sizeof(void *);
+}
+
+static void **get_part_array(actor_types *act, const part_array_t *array)
+{
+	return (void **)((char *)act + array->offset);
+}
+
+void record_actor_def_file(const char *file_name)
+{
+	source_file_t *file;
+	char *name;
+
+	if (!recording)
+	{
+		return;
+	}
+
+	if (source_file_names == NULL)
+	{
+		source_file_names = create_hash_table(1024, hash_fn_str,
+			cmp_fn_str, free);
+	}
+
+	if (hash_get(source_file_names, (void *)file_name) != NULL)
+	{
+		return;
+	}
+
+	if (source_file_count >= ACTOR_DEFS_CACHE_MAX_FILES)
+	{
+		LOG_ERROR("Too many actor definition files, the cache is not written");
+		recording = 0;
+		return;
+	}
+
+	if (source_file_count >= source_file_size)
+	{
+		source_file_size = source_file_size > 0 ? source_file_size * 2 : 1024;
+		source_files = realloc(source_files,
+			source_file_size * sizeof(source_file_t));
+	}
+
+	file = &source_files[source_file_count];
+	memset(file, 0, sizeof(source_file_t));
+	safe_strncpy(file->name, file_name, sizeof(file->name));
+	source_file_count++;
+
+	name = strdup(file_name);
+	hash_add(source_file_names, name, name);
+}
+
+void record_actor_def_load(const actor_types *act, const actor_def_load_type type,
+	const char *name, const float scale, const int result)
+{
+	actor_def_load_t *load;
+
+	if (!recording)
+	{
+		return;
+	}
+
+	if ((act < actors_defs) || (act >= actors_defs + MAX_ACTOR_DEFS))
+	{
+		LOG_ERROR("Load into an unknown actor type, the cache is not written");
+		recording = 0;
+		return;
+	}
+
+	if (actor_def_load_count >= actor_def_load_size)
+	{
+		actor_def_load_size = actor_def_load_size > 0 ? actor_def_load_size * 2 : 1024;
+		actor_def_loads = realloc(actor_def_loads,
+			actor_def_load_size * sizeof(actor_def_load_t));
+	}
+
+	load = &actor_def_loads[actor_def_load_count];
+	memset(load, 0, sizeof(actor_def_load_t));
+
+	load->type = type;
+	load->actor_type = act - actors_defs;
+	load->result = result;
+	load->scale = scale;
+
+	if (name != NULL)
+	{
+		safe_strncpy(load->name, name, sizeof(load->name));
+	}
+
+	actor_def_load_count++;
+
+	// the skeletons, meshes and animations are checked like the XML files
+	if ((name != NULL) && (type != ACTOR_DEF_SCALE_SKELETON))
+	{
+		record_actor_def_file(name);
+	}
+}
+
+/* The entities of the index are the files of the actor types. */
+void record_actor_def_entities(const xmlDoc *doc)
+{
+	const xmlNode *node;
+	const xmlEntity *entity;
+
+	if (!recording || (doc == NULL) || (doc->intSubset == NULL))
+	{
+		return;
+	}
+
+	for (node = doc->intSubset->children; node; node = node->next)
+	{
+		if (node->type != XML_ENTITY_DECL)
+		{
+			continue;
+		}
+
+		entity = (const xmlEntity *)node;
+
+		if (entity->URI != NULL)
+		{
+			record_actor_def_file((const char *)entity->URI);
+		}
+		else if (entity->SystemID != NULL)
+		{
+			record_actor_def_file((const char *)entity->SystemID);
+		}
+	}
+}
+
+static void get_source_file_crc(void *data, Uint32 index)
+{
+	source_file_t *file = &((source_file_t *)data)[index];
+	el_file_ptr el_file;
+
+	// a missing file has the CRC zero, it may be added later
+	file->crc = 0;
+
+	el_file = el_open_anywhere(file->name);
+
+	if (el_file != NULL)
+	{
+#ifdef FASTER_MAP_LOAD
+		file->crc = el_crc32(el_file);
+#else // FASTER_MAP_LOAD
+		file->crc = CrcCalc(el_get_pointer(el_file), el_get_size(el_file));
+#endif // FASTER_MAP_LOAD
+		el_close(el_file);
+	}
+}
+
+static int write_data(FILE *file, const void *data, const size_t size)
+{
+	return (size == 0) || (fwrite(data, size, 1, file) == 1);
+}
+
+static int read_data(FILE *file, void *data, const size_t size)
+{
+	return (size == 0) || (fread(data, size, 1, file) == 1);
+}
+
+static int is_zero(const void *data, const size_t size)
+{
+	const Uint8 *bytes = data;
+	size_t i;
+
+	for (i = 0; i < size; i++)
+	{
+		if (bytes[i] != 0)
+		{
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+static int write_actor_types(FILE *file)
+{
+	actor_types *act;
+	hash_entry *entry;
+	void **array;
+	Sint32 index, key;
+	Uint32 i, j, count;
+	Uint8 present;
+	int ok;
+
+	ok = write_data(file, actor_part_sizes, sizeof(actor_part_sizes));
+#ifdef EXT_ACTOR_DICT
+	ok &= write_data(file, skin_color_dict, sizeof(skin_color_dict));
+	ok &= write_data(file, head_number_dict, sizeof(head_number_dict));
+	ok &= write_data(file, glow_mode_dict, sizeof(glow_mode_dict));
+	ok &= write_data(file, &num_skin_colors, sizeof(num_skin_colors));
+	ok &= write_data(file, &num_head_numbers, sizeof(num_head_numbers));
+	ok &= write_data(file, &num_glow_modes, sizeof(num_glow_modes));
+#endif // EXT_ACTOR_DICT
+
+	count = 0;
+
+	for (i = 0; i < MAX_ACTOR_DEFS; i++)
+	{
+		if (!is_zero(&actors_defs[i], sizeof(actor_types)))
+		{
+			count++;
+		}
+	}
+
+	ok &= write_data(file, &count, sizeof(count));
+
+	for (i = 0; i < MAX_ACTOR_DEFS; i++)
+	{
+		act = &actors_defs[i];
+
+		if (is_zero(act, sizeof(actor_types)))
+		{
+			continue;
+		}
+
+		index = i;
+		ok &= write_data(file, &index, sizeof(index));
+		ok &= write_data(file, act, sizeof(actor_types));
+
+		for (j = 0; j < PART_ARRAY_COUNT; j++)
+		{
+			array = get_part_array(act, &part_arrays[j]);
+			present = *array != NULL;
+
+			ok &= write_data(file, &present, sizeof(present));
+
+			if (present)
+			{
+				ok &= write_data(file, *array, part_arrays[j].size *
+					actor_part_sizes[part_arrays[j].part]);
+			}
+		}
+
+		count = act->emote_frames != NULL ? act->emote_frames->items : 0;
+		ok &= write_data(file, &count, sizeof(count));
+
+		if (count == 0)
+		{
+			continue;
+		}
+
+		hash_start_iterator(act->emote_frames);
+
+		for (j = 0; j < count; j++)
+		{
+			entry = hash_get_next(act->emote_frames);
+
+			if (entry == NULL)
+			{
+				return 0;
+			}
+
+			key = (uintptr_t)entry->key;
+			ok &= write_data(file, &key, sizeof(key));
+			ok &= write_data(file, entry->item, sizeof(struct cal_anim));
+		}
+	}
+
+	return ok;
+}
+
+static int read_actor_types(FILE *file)
+{
+	actor_types *act;
+	struct cal_anim *anim;
+	void **array;
+	Sint32 index, key;
+	Uint32 i, j, k, count, frame_count;
+	Uint8 present;
+
+	if (!read_data(file, actor_part_sizes, sizeof(actor_part_sizes)))
+	{
+		return 0;
+	}
+
+	for (i = 0; i < ACTOR_NUM_PARTS; i++)
+	{
+		if ((actor_part_sizes[i] < 0) || (actor_part_sizes[i] > 65536))
+		{
+			return 0;
+		}
+	}
+
+#ifdef EXT_ACTOR_DICT
+	if (!read_data(file, skin_color_dict, sizeof(skin_color_dict)) ||
+		!read_data(file, head_number_dict, sizeof(head_number_dict)) ||
+		!read_data(file, glow_mode_dict, sizeof(glow_mode_dict)) ||
+		!read_data(file, &num_skin_colors, sizeof(num_skin_colors)) ||
+		!read_data(file, &num_head_numbers, sizeof(num_head_numbers)) ||
+		!read_data(file, &num_glow_modes, sizeof(num_glow_modes)))
+	{
+		return 0;
+	}
+#endif // EXT_ACTOR_DICT
+
+	if (!read_data(file, &count, sizeof(count)) || (count > MAX_ACTOR_DEFS))
+	{
+		return 0;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		if (!read_data(file, &index, sizeof(index)) ||
+			(index < 0) || (index >= MAX_ACTOR_DEFS))
+		{
+			return 0;
+		}
+
+		act = &actors_defs[index];
+
+		if (!read_data(file, act, sizeof(actor_types)))
+		{
+			memset(act, 0, sizeof(actor_types));
+			return 0;
+		}
+
+		// the pointers and buffers are set up again below
+		act->coremodel = NULL;
+		act->hardware_model = NULL;
+		act->vertex_buffer = 0;
+		act->index_buffer = 0;
+		act->index_type = 0;
+		act->index_size = 0;
+		act->emote_frames = NULL;
+
+		for (j = 0; j < PART_ARRAY_COUNT; j++)
+		{
+			*get_part_array(act, &part_arrays[j]) = NULL;
+		}
+
+		for (j = 0; j < PART_ARRAY_COUNT; j++)
+		{
+			if (!read_data(file, &present, sizeof(present)))
+			{
+				return 0;
+			}
+
+			if (!present)
+			{
+				continue;
+			}
+
+			array = get_part_array(act, &part_arrays[j]);
+			*array = calloc(actor_part_sizes[part_arrays[j].part],
+				part_arrays[j].size);
+
+			if (!read_data(file, *array, part_arrays[j].size *
+				actor_part_sizes[part_arrays[j].part]))
+			{
+				return 0;
+			}
+		}
+
+		if (!read_data(file, &frame_count, sizeof(frame_count)))
+		{
+			return 0;
+		}
+
+		if (frame_count > 0)
+		{
+			act->emote_frames = create_hash_table(EMOTES_FRAMES,
+				hash_fn_int, cmp_fn_int, free);
+		}
+
+		for (k = 0; k < frame_count; k++)
+		{
+			anim = calloc(1, sizeof(struct cal_anim));
+
+			if (!read_data(file, &key, sizeof(key)) ||
+				!read_data(file, anim, sizeof(struct cal_anim)))
+			{
+				free(anim);
+				return 0;
+			}
+
+			hash_add(act->emote_frames, (void *)(uintptr_t)key, anim);
+		}
+	}
+
+	return 1;
+}
+
+/*
+ * Most attachments are either all zero or have the defaults set when their
+ * actor type was parsed, only the others are written.
+ */
+static void get_default_attachment(attachment_props *props)
+{
+	int i;
+
+	memset(props, 0, sizeof(attachment_props));
+
+	for (i = 0; i < NUM_ATTACHED_ACTOR_FRAMES; i++)
+	{
+		props->cal_frames[i].anim_index = -1;
+#ifdef NEW_SOUND
+		props->cal_frames[i].sound = -1;
+#endif // NEW_SOUND
+	}
+}
+
+static int write_attachments(FILE *file)
+{
+	attachment_props zero, defaults;
+	const attachment_props *base, *props;
+	Uint32 i, j, count, defaults_count;
+	Uint8 use_defaults;
+	Sint32 index;
+	int ok;
+
+	memset(&zero, 0, sizeof(zero));
+	get_default_attachment(&defaults);
+
+	ok = 1;
+
+	for (i = 0; i < MAX_ACTOR_DEFS; i++)
+	{
+		defaults_count = 0;
+
+		for (j = 0; j < MAX_ACTOR_DEFS; j++)
+		{
+			if (memcmp(&attached_actors_defs[i].actor_type[j], &defaults,
+				sizeof(defaults)) == 0)
+			{
+				defaults_count++;
+			}
+		}
+
+		use_defaults = defaults_count > MAX_ACTOR_DEFS / 2;
+		base = use_defaults ? &defaults : &zero;
+
+		count = 0;
+
+		for (j = 0; j < MAX_ACTOR_DEFS; j++)
+		{
+			if (memcmp(&attached_actors_defs[i].actor_type[j], base,
+				sizeof(attachment_props)) != 0)
+			{
+				count++;
+			}
+		}
+
+		ok &= write_data(file, &use_defaults, sizeof(use_defaults));
+		ok &= write_data(file, &count, sizeof(count));
+
+		for (j = 0; j < MAX_ACTOR_DEFS; j++)
+		{
+			props = &attached_actors_defs[i].actor_type[j];
+
+			if (memcmp(props, base, sizeof(attachment_props)) != 0)
+			{
+				index = j;
+				ok &= write_data(file, &index, sizeof(index));
+				ok &= write_data(file, props, sizeof(attachment_props));
+			}
+		}
+	}
+
+	return ok;
+}
+
+static int read_attachments(FILE *file)
+{
+	attachment_props defaults;
+	Uint32 i, j, count;
+	Uint8 use_defaults;
+	Sint32 index;
+
+	get_default_attachment(&defaults);
+
+	for (i = 0; i < MAX_ACTOR_DEFS; i++)
+	{
+		if (!read_data(file, &use_defaults, sizeof(use_defaults)) ||
+			!read_data(file, &count, sizeof(count)) ||
+			(count > MAX_ACTOR_DEFS))
+		{
+			return 0;
+		}
+
+		for (j = 0; j < MAX_ACTOR_DEFS; j++)
+		{
+			if (use_defaults)
+			{
+				attached_actors_defs[i].actor_type[j] = defaults;
+			}
+			else
+			{
+				memset(&attached_actors_defs[i].actor_type[j], 0,
+					sizeof(attachment_props));
+			}
+		}
+
+		for (j = 0; j < count; j++)
+		{
+			if (!read_data(file, &index, sizeof(index)) ||
+				(index < 0) || (index >= MAX_ACTOR_DEFS) ||
+				!read_data(file, &attached_actors_defs[i].actor_type[index],
+					sizeof(attachment_props)))
+			{
+				return 0;
+			}
+		}
+	}
+
+	return 1;
+}
+
+/*
+ * The frame lists of an emote are shared by several actor types and poses,
+ * each list is written once and the slots refer to it by its position.
+ */
+static int write_emote(FILE *file, const emote_data *emote)
+{
+	const emote_frame *lists[MAX_EMOTE_LISTS];
+	const emote_frame *frame;
+	Uint32 slots[EMOTE_ACTOR_TYPES][4][2];
+	Uint32 list_count, count, i, j, k, l;
+	int ok;
+
+	list_count = 0;
+
+	for (i = 0; i < EMOTE_ACTOR_TYPES; i++)
+	{
+		for (j = 0; j < 4; j++)
+		{
+			for (k = 0; k < 2; k++)
+			{
+				slots[i][j][k] = 0;
+
+				if (emote->anims[i][j][k] == NULL)
+				{
+					continue;
+				}
+
+				for (l = 0; l < list_count; l++)
+				{
+					if (lists[l] == emote->anims[i][j][k])
+					{
+						break;
+					}
+				}
+
+				if (l == list_count)
+				{
+					lists[list_count++] = emote->anims[i][j][k];
+				}
+
+				slots[i][j][k] = l + 1;
+			}
+		}
+	}
+
+	ok = write_data(file, emote, sizeof(emote_data));
+	ok &= write_data(file, slots, sizeof(slots));
+	ok &= write_data(file, &list_count, sizeof(list_count));
+
+	for (l = 0; l < list_count; l++)
+	{
+		count = 0;
+
+		for (frame = lists[l]; frame; frame = frame->next)
+		{
+			count++;
+		}
+
+		ok &= write_data(file, &count, sizeof(count));
+
+		for (frame = lists[l]; frame; frame = frame->next)
+		{
+			ok &= write_data(file, frame, sizeof(emote_frame));
+		}
+	}
+
+	return ok;
+}
+
+static void free_emote_frames(emote_frame **lists, const Uint32 count)
+{
+	emote_frame *frame, *next;
+	Uint32 i;
+
+	for (i = 0; i < count; i++)
+	{
+		for (frame = lists[i]; frame; frame = next)
+		{
+			next = frame->next;
+			free(frame);
+		}
+	}
+}
+
+static int read_emote(FILE *file)
+{
+	emote_data data, *emote;
+	emote_frame *lists[MAX_EMOTE_LISTS];
+	emote_frame *frame, *last;
+	Uint32 slots[EMOTE_ACTOR_TYPES][4][2];
+	Uint32 list_count, count, i, j, k, l;
+
+	if (!read_data(file, &data, sizeof(data)) ||
+		!read_data(file, slots, sizeof(slots)) ||
+		!read_data(file, &list_count, sizeof(list_count)) ||
+		(list_count > MAX_EMOTE_LISTS))
+	{
+		return 0;
+	}
+
+	emote = new_emote(data.id);
+	emote->barehanded = data.barehanded;
+	emote->pose = data.pose;
+	emote->timeout = data.timeout;
+	safe_strncpy(emote->name, data.name, sizeof(emote->name));
+	safe_strncpy(emote->desc, data.desc, sizeof(emote->desc));
+
+	for (l = 0; l < list_count; l++)
+	{
+		lists[l] = NULL;
+
+		if (!read_data(file, &count, sizeof(count)) || (count == 0))
+		{
+			free_emote_frames(lists, l);
+			return 0;
+		}
+
+		last = NULL;
+
+		for (i = 0; i < count; i++)
+		{
+			frame = calloc(1, sizeof(emote_frame));
+
+			if (last != NULL)
+			{
+				last->next = frame;
+			}
+			else
+			{
+				lists[l] = frame;
+			}
+
+			if (!read_data(file, frame, sizeof(emote_frame)))
+			{
+				frame->next = NULL;
+				free_emote_frames(lists, l + 1);
+				return 0;
+			}
+
+			frame->next = NULL;
+
+			last = frame;
+		}
+	}
+
+	for (i = 0; i < EMOTE_ACTOR_TYPES; i++)
+	{
+		for (j = 0; j < 4; j++)
+		{
+			for (k = 0; k < 2; k++)
+			{
+				if ((slots[i][j][k] > 0) && (slots[i][j][k] <= list_count))
+				{
+					emote->anims[i][j][k] = lists[slots[i][j][k] - 1];
+				}
+			}
+		}
+	}
+
+	return 1;
+}
+
+static int write_emotes(FILE *file)
+{
+	hash_entry *entry;
+	const emote_dict *command;
+	Sint32 id;
+	Uint32 i, count;
+	int ok;
+
+	count = emotes != NULL ? emotes->items : 0;
+	ok = write_data(file, &count, sizeof(count));
+
+	hash_start_iterator(emotes);
+
+	for (i = 0; i < count; i++)
+	{
+		entry = hash_get_next(emotes);
+
+		if (entry == NULL)
+		{
+			return 0;
+		}
+
+		ok &= write_emote(file, entry->item);
+	}
+
+	count = emote_cmds != NULL ? emote_cmds->items : 0;
+	ok &= write_data(file, &count, sizeof(count));
+
+	hash_start_iterator(emote_cmds);
+
+	for (i = 0; i < count; i++)
+	{
+		entry = hash_get_next(emote_cmds);
+
+		if (entry == NULL)
+		{
+			return 0;
+		}
+
+		command = entry->item;
+		id = command->emote != NULL ? command->emote->id : -1;
+		ok &= write_data(file, command->command, sizeof(command->command));
+		ok &= write_data(file, &id, sizeof(id));
+	}
+
+	return ok;
+}
+
+static int read_emotes(FILE *file)
+{
+	hash_entry *entry;
+	emote_dict *command;
+	Sint32 id;
+	Uint32 i, count;
+
+	if (!read_data(file, &count, sizeof(count)))
+	{
+		return 0;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		if (!read_emote(file))
+		{
+			return 0;
+		}
+	}
+
+	if (!read_data(file, &count, sizeof(count)))
+	{
+		return 0;
+	}
+
+	if ((count > 0) && (emote_cmds == NULL))
+	{
+		emote_cmds = create_hash_table(EMOTE_CMDS_HASH, hash_fn_str,
+			cmp_fn_str, free);
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		command = malloc(sizeof(emote_dict));
+
+		if (!read_data(file, command->command, sizeof(command->command)) ||
+			!read_data(file, &id, sizeof(id)))
+		{
+			free(command);
+			return 0;
+		}
+
+		command->command[sizeof(command->command) - 1] = '\0';
+		entry = hash_get(emotes, (void *)(uintptr_t)id);
+		command->emote = entry != NULL ? entry->item : NULL;
+		hash_add(emote_cmds, command->command, command);
+	}
+
+	return 1;
+}
+
+/*
+ * Loads the skeletons, meshes and animations in the recorded order, so
+ * every id saved in the definitions points to the same data again.
+ */
+static int replay_actor_def_loads(const actor_def_load_t *loads, const Uint32 count)
+{
+	const actor_def_load_t *load;
+	actor_types *act;
+	struct CalCoreMesh *mesh;
+	struct CalCoreSkeleton *skel;
+	Uint32 i;
+	int result;
+
+	for (i = 0; i < count; i++)
+	{
+		load = &loads[i];
+
+		if ((load->actor_type < 0) || (load->actor_type >= MAX_ACTOR_DEFS))
+		{
+			return 0;
+		}
+
+		act = &actors_defs[load->actor_type];
+
+		if ((load->type != ACTOR_DEF_LOAD_SKELETON) && (act->coremodel == NULL))
+		{
+			return 0;
+		}
+
+		switch (load->type)
+		{
+			case ACTOR_DEF_LOAD_SKELETON:
+				act->coremodel = CalCoreModel_New("Model");
+				if (CalCoreModel_ELLoadCoreSkeleton(act->coremodel, load->name))
+				{
+					result = get_skeleton(act->coremodel, load->name);
+				}
+				else
+				{
+					result = -1;
+				}
+				break;
+			case ACTOR_DEF_LOAD_MESH:
+				result = CalCoreModel_ELLoadCoreMesh(act->coremodel, load->name);
+				if ((result >= 0) && (load->scale != 1.0f))
+				{
+					mesh = CalCoreModel_GetCoreMesh(act->coremodel, result);
+					if (mesh)
+					{
+						CalCoreMesh_Scale(mesh, load->scale);
+					}
+				}
+				break;
+			case ACTOR_DEF_LOAD_ANIMATION:
+				result = CalCoreModel_ELLoadCoreAnimation(act->coremodel,
+					load->name, load->scale);
+				break;
+			case ACTOR_DEF_SCALE_SKELETON:
+				skel = CalCoreModel_GetCoreSkeleton(act->coremodel);
+				if (skel)
+				{
+					CalCoreSkeleton_Scale(skel, load->scale);
+				}
+				result = load->result;
+				break;
+			default:
+				return 0;
+		}
+
+		if (result != load->result)
+		{
+			LOG_ERROR("Loading %s for actor type %d gave %d instead of %d",
+				load->name, load->actor_type, result, load->result);
+			return 0;
+		}
+	}
+
+	if (use_animation_program)
+	{
+		for (i = 0; i < MAX_ACTOR_DEFS; i++)
+		{
+			if (actors_defs[i].coremodel != NULL)
+			{
+				build_buffers(&actors_defs[i]);
+			}
+		}
+	}
+
+	return 1;
+}
+
+static void write_actor_defs_cache(void)
+{
+	cache_header_t header;
+	FILE *file;
+	Uint32 magic;
+	int ok;
+
+	worker_pool_run(get_source_file_crc, source_files, source_file_count, 1);
+
+	file = open_file_config(ACTOR_DEFS_CACHE_FILE, "wb");
+
+	if (file == NULL)
+	{
+		LOG_ERROR("Can't write the actor definitions cache %s",
+			ACTOR_DEFS_CACHE_FILE);
+		return;
+	}
+
+	init_cache_header(&header);
+	header.file_count = source_file_count;
+	header.load_count = actor_def_load_count;
+	magic = ACTOR_DEFS_CACHE_MAGIC;
+
+	ok = write_data(file, &header, sizeof(header));
+	ok &= write_data(file, source_files, source_file_count * sizeof(source_file_t));
+	ok &= write_data(file, actor_def_loads, actor_def_load_count * sizeof(actor_def_load_t));
+	ok &= write_actor_types(file);
+	ok &= write_attachments(file);
+	ok &= write_emotes(file);
+	// the end marker tells a complete cache from a truncated one
+	ok &= write_data(file, &magic, sizeof(magic));
+
+	fclose(file);
+
+	if (!ok)
+	{
+		LOG_ERROR("Can't write the actor definitions cache %s",
+			ACTOR_DEFS_CACHE_FILE);
+	}
+}
+
+static int read_actor_defs_cache(void)
+{
+	cache_header_t header, expected;
+	source_file_t *files;
+	actor_def_load_t *loads;
+	Uint32 *crcs;
+	FILE *file;
+	Uint32 i, magic;
+	int ok;
+
+	file = open_file_config(ACTOR_DEFS_CACHE_FILE, "rb");
+
+	if (file == NULL)
+	{
+		return 0;
+	}
+
+	init_cache_header(&expected);
+
+	if (!read_data(file, &header, sizeof(header)) ||
+		(header.magic != expected.magic) ||
+		(header.version != expected.version) ||
+		(header.features != expected.features) ||
+		(memcmp(header.sizes, expected.sizes, sizeof(header.sizes)) != 0) ||
+		(header.file_count == 0) ||
+		(header.file_count > ACTOR_DEFS_CACHE_MAX_FILES) ||
+		(header.load_count > ACTOR_DEFS_CACHE_MAX_LOADS))
+	{
+		LOG_INFO("The actor definitions cache %s is outdated",
+			ACTOR_DEFS_CACHE_FILE);
+		fclose(file);
+		return 0;
+	}
+
+	files = calloc(header.file_count, sizeof(source_file_t));
+	crcs = calloc(header.file_count, sizeof(Uint32));
+	loads = calloc(header.load_count + 1, sizeof(actor_def_load_t));
+
+	ok = read_data(file, files, header.file_count * sizeof(source_file_t));
+
+	if (ok)
+	{
+		for (i = 0; i < header.file_count; i++)
+		{
+			files[i].name[sizeof(files[i].name) - 1] = '\0';
+			crcs[i] = files[i].crc;
+		}
+
+		// the source files are read and checked by all workers at once
+		worker_pool_run(get_source_file_crc, files, header.file_count, 1);
+
+		for (i = 0; i < header.file_count; i++)
+		{
+			if (crcs[i] != files[i].crc)
+			{
+				LOG_INFO("The actor definitions file %s was changed",
+					files[i].name);
+				ok = 0;
+				break;
+			}
+		}
+	}
+
+	ok = ok && read_data(file, loads, header.load_count * sizeof(actor_def_load_t));
+
+	for (i = 0; ok && (i < header.load_count); i++)
+	{
+		loads[i].name[sizeof(loads[i].name) - 1] = '\0';
+	}
+
+	ok = ok && read_actor_types(file);
+	ok = ok && read_attachments(file);
+	ok = ok && read_emotes(file);
+	ok = ok && read_data(file, &magic, sizeof(magic)) &&
+		(magic == ACTOR_DEFS_CACHE_MAGIC);
+	ok = ok && replay_actor_def_loads(loads, header.load_count);
+
+	free(files);
+	free(crcs);
+	free(loads);
+	fclose(file);
+
+	return ok;
+}
+
+void load_actor_defs(void)
+{
+	Uint32 start;
+
+	start = SDL_GetTicks();
+
+	memset(actors_defs, 0, sizeof(actors_defs));
+	memset(attached_actors_defs, 0, sizeof(attached_actors_defs));
+	set_invert_v_coord();
+
+	if (read_actor_defs_cache())
+	{
+		LOG_INFO("Read the actor definitions from %s in %d ms",
+			ACTOR_DEFS_CACHE_FILE, SDL_GetTicks() - start);
+		return;
+	}
+
+	// drop whatever was read before the cache turned out to be unusable
+	free_emotes();
+	free_actor_defs();
+	emotes = NULL;
+	emote_cmds = NULL;
+
+	recording = 1;
+
+#ifdef NEW_SOUND
+	// the sound indices of the animations depend on the sound config
+	record_actor_def_file(SOUND_CONFIG_PATH);
+#endif // NEW_SOUND
+
+	init_actor_defs();
+	read_emotes_defs("", "emotes.xml");
+
+	if (recording)
+	{
+		write_actor_defs_cache();
+	}
+
+	recording = 0;
+
+	free(source_files);
+	free(actor_def_loads);
+	destroy_hash_table(source_file_names);
+	source_files = NULL;
+	actor_def_loads = NULL;
+	source_file_names = NULL;
+	source_file_count = 0;
+	source_file_size = 0;
+	actor_def_load_count = 0;
+	actor_def_load_size = 0;
+
+	LOG_INFO("Parsed the actor definitions in %d ms", SDL_GetTicks() - start);
+}
@@ -0,0 +1,80 @@
+/*!
+ * \file
+ * \ingroup other
+ * \brief Binary cache of the parsed actor and emote definitions.
+ *
+ *      While the XML files are parsed, the skeletons, meshes and animations
+ *      loaded into the core models are recorded in order. The parsed actor
+ *      types, attachments and emotes are then written to the config
+ *      directory, together with the CRC of each source file. On the next
+ *      start the cache is used if all CRCs still match: the definitions are
+ *      read back and the recorded loads are replayed, so the core models
+ *      get the same mesh and animation ids without any XML parsing.
+ */
+#ifndef	ACTOR_DEFS_CACHE_H
+#define	ACTOR_DEFS_CACHE_H
+
+#include <libxml/tree.h>
+#include "actors.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+ * The kinds of loads into a core model that are recorded.
+ */
+typedef enum
+{
+	ACTOR_DEF_LOAD_SKELETON = 0,	/*!< a new core model with a skeleton, the result is the skeleton type */
+	ACTOR_DEF_LOAD_MESH,		/*!< a core mesh, scaled unless the scale is one */
+	ACTOR_DEF_LOAD_ANIMATION,	/*!< a core animation, loaded with the scale */
+	ACTOR_DEF_SCALE_SKELETON	/*!< the skeleton scaled after the actor was parsed */
+} actor_def_load_type;
+
+/*!
+ * \ingroup other
+ * \brief Loads the actor and emote definitions.
+ *
+ *      Uses the cache if it is valid, else parses the XML files and writes a
+ *      new cache.
+ *
+ * \callgraph
+ */
+void load_actor_defs(void);
+
+/*!
+ * \brief Records a source file of the definitions.
+ *
+ *      Does nothing unless the definitions are parsed for a new cache.
+ * \param file_name	the file name, as passed to el_open_anywhere()
+ */
+void record_actor_def_file(const char *file_name);
+
+/*!
+ * \brief Records the external entities of a document as source files.
+ *
+ *      Does nothing unless the definitions are parsed for a new cache.
+ * \param doc	the parsed document
+ */
+void record_actor_def_entities(const xmlDoc *doc);
+
+/*!
+ * \brief Records a load into the core model of an actor type.
+ *
+ *      Does nothing unless the definitions are parsed for a new cache. The
+ *      loaded file is recorded as a source file too.
+ * \param act		the actor type, an entry of actors_defs
+ * \param type		the kind of load
+ * \param name		the loaded file, unused for ACTOR_DEF_SCALE_SKELETON
+ * \param scale		the scale
+ * \param result	the id of the mesh or animation or the skeleton type
+ */
+void record_actor_def_load(const actor_types *act, const actor_def_load_type type,
+	const char *name, const float scale, const int result);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif	/* ACTOR_DEFS_CACHE_H */
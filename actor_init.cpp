@@ -1,9 +1,11 @@
 #include <limits>
 #include <algorithm>
+#include <cmath>
 #include "actor_init.h"
 #include "load_gl_extensions.h"
 #include <cal3d/cal3d.h>
 #include <map>
+#include <vector>
 #include "bbox_tree.h"
 #include "io/elfilewrapper.h"
 #include "gl_init.h"
@@ -12,8 +14,11 @@
 #include "optimizer.hpp"
 #include "md5.h"
 #include "errors.h"
+#include "skinning.h"
+#include "worker_pool.h"
 
 Uint32 use_animation_program = 1;
+Uint32 use_fast_skinning = 1;
 Uint32 max_bones_per_mesh = 27;
 
 class HardwareMeshData
@@ -79,6 +84,59 @@ struct ActorVertex
 
 typedef std::map<Sint32, HardwareMeshData> IntMap;
 
+class SkinnedSubmesh
+{
+	public:
+		CalSubmesh* m_submesh;
+		const skinning_data_t* m_data;
+		bool m_fast;
+		Uint32 m_vertex_count;
+		Uint32 m_face_count;
+		std::vector<float> m_vertices;
+		std::vector<float> m_normals;
+		std::vector<CalIndex> m_faces;
+
+		inline SkinnedSubmesh(): m_submesh(0), m_data(0), m_fast(false),
+			m_vertex_count(0), m_face_count(0)
+		{
+		}
+};
+
+/* The per actor data, stored as user data of the cal3d model. The hardware
+ * meshes are used by the animation program, the skinned submeshes when the
+ * actors are skinned on the CPU. */
+class ModelData
+{
+	public:
+		IntMap m_hardware_meshes;
+		std::vector<float> m_bones;
+		std::vector<SkinnedSubmesh> m_submeshes;
+		std::vector<Uint32> m_first_submesh;
+		bool m_normals;
+
+		inline ModelData(): m_normals(false)
+		{
+		}
+};
+
+class SkinningJob
+{
+	public:
+		SkinnedSubmesh* m_submesh;
+		CalModel* m_model;
+		const float* m_bones;
+		Uint32 m_start;
+		Uint32 m_end;
+		bool m_normals;
+};
+
+typedef std::map<const CalCoreSubmesh*, skinning_data_t*> SkinningDataMap;
+
+static SkinningDataMap skinning_data_cache;
+static std::vector<SkinningJob> skinning_jobs;
+
+#define SKINNING_JOB_SIZE	512	/* vertices skinned by one job, a multiple of eight */
+
 int last_actor_type = -1;
 bool use_normals;
 
@@ -465,7 +523,7 @@ extern "C" void cal_render_actor_shader(actor *act, Uint32 use_lightning, Uint32
 		last_actor_type = act->actor_type;
 	}
 
-	im = reinterpret_cast<IntMap*>(act->calmodel->getUserData());
+	im = &reinterpret_cast<ModelData*>(act->calmodel->getUserData())->m_hardware_meshes;
 
 	assert(im);
 
@@ -772,9 +830,9 @@ static inline void set_transformation_buffer(actor_types *a, actor *act, const U
 	Sint32 i, count;
 	const std::vector<CalBone *>& vectorBone = act->calmodel->getSkeleton()->getVectorBone();
 
-	a->hardware_model->selectHardwareMesh(index);
-
-	count = a->hardware_model->getBoneCount();
+	// the hardware model is shared by all actors of the type and this runs
+	// on the worker threads, so don't select the mesh in it
+	count = a->hardware_model->getVectorHardwareMesh()[index].m_vectorBonesIndices.size();
 
 	for (i = 0; i < count; i++)
 	{
@@ -802,7 +860,7 @@ extern "C" void set_transformation_buffers(actor* act)
 	IntMap::iterator it;
 	actor_types* a;
 
-	im = reinterpret_cast<IntMap*>(act->calmodel->getUserData());
+	im = &reinterpret_cast<ModelData*>(act->calmodel->getUserData())->m_hardware_meshes;
 
 	a = &actors_defs[act->actor_type];
 
@@ -840,7 +898,7 @@ extern "C" CalModel *model_new(CalCoreModel* pCoreModel)
 
 	tmp = new CalModel(pCoreModel);
 
-	tmp->setUserData(new IntMap());
+	tmp->setUserData(new ModelData());
 
 	return tmp;
 }
@@ -849,7 +907,7 @@ extern "C" void model_delete(CalModel *self)
 {
 	if (self)
 	{
-		delete reinterpret_cast<IntMap*>(self->getUserData());
+		delete reinterpret_cast<ModelData*>(self->getUserData());
 		self->setUserData(0);
 	}
 
@@ -868,7 +926,7 @@ extern "C" void model_attach_mesh(actor *act, int mesh_id)
 
 	act->calmodel->attachMesh(mesh_id);
 
-	im = reinterpret_cast<IntMap*>(act->calmodel->getUserData());
+	im = &reinterpret_cast<ModelData*>(act->calmodel->getUserData())->m_hardware_meshes;
 
 	assert(im);
 
@@ -904,7 +962,7 @@ extern "C" void model_detach_mesh(actor *act, int mesh_id)
 
 	act->calmodel->detachMesh(mesh_id);
 
-	im = reinterpret_cast<IntMap*>(act->calmodel->getUserData());
+	im = &reinterpret_cast<ModelData*>(act->calmodel->getUserData())->m_hardware_meshes;
 
 	assert(im);
 
@@ -924,3 +982,370 @@ extern "C" void model_detach_mesh(actor *act, int mesh_id)
 	}
 }
 
+
+static skinning_data_t* build_skinning_data(CalCoreSubmesh* core_submesh)
+{
+	skinning_data_t* data;
+	Uint32 i, j, count, influence_count;
+
+	const std::vector<CalCoreSubmesh::Vertex> &vertices =
+		core_submesh->getVectorVertex();
+
+	count = vertices.size();
+	influence_count = 1;
+
+	for (i = 0; i < count; i++)
+	{
+		influence_count = std::max(influence_count,
+			static_cast<Uint32>(vertices[i].vectorInfluence.size()));
+	}
+
+	data = skinning_data_new(count, influence_count);
+
+	if (data == 0)
+	{
+		LOG_ERROR("Can't allocate skinning data for %d vertices",
+			count);
+		return 0;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		const CalCoreSubmesh::Vertex &vertex = vertices[i];
+
+		data->positions[i] = vertex.position.x;
+		data->positions[count + i] = vertex.position.y;
+		data->positions[2 * count + i] = vertex.position.z;
+		data->normals[i] = vertex.normal.x;
+		data->normals[count + i] = vertex.normal.y;
+		data->normals[2 * count + i] = vertex.normal.z;
+
+		// cal3d keeps vertices without influences as they are, the
+		// first bone matrix is the identity for them
+		if (vertex.vectorInfluence.size() == 0)
+		{
+			data->weights[i] = 1.0f;
+			data->offsets[i] = 0;
+			continue;
+		}
+
+		for (j = 0; j < vertex.vectorInfluence.size(); j++)
+		{
+			const CalCoreSubmesh::Influence &influence =
+				vertex.vectorInfluence[j];
+
+			data->weights[j * count + i] = influence.weight;
+			data->offsets[j * count + i] = (influence.boneId + 1) *
+				SKINNING_MATRIX_SIZE;
+			data->bone_count = std::max(data->bone_count,
+				static_cast<Uint32>(influence.boneId + 1));
+		}
+	}
+
+	if (core_submesh->getVectorVectorTextureCoordinate().size() > 0)
+	{
+		const std::vector<CalCoreSubmesh::TextureCoordinate> &texture_coordinates =
+			core_submesh->getVectorVectorTextureCoordinate()[0];
+
+		count = std::min(count, static_cast<Uint32>(texture_coordinates.size()));
+
+		for (i = 0; i < count; i++)
+		{
+			data->texture_coordinates[i * 2 + 0] = texture_coordinates[i].u;
+			data->texture_coordinates[i * 2 + 1] = texture_coordinates[i].v;
+		}
+	}
+
+	return data;
+}
+
+static const skinning_data_t* get_skinning_data(CalCoreSubmesh* core_submesh)
+{
+	SkinningDataMap::iterator it;
+	skinning_data_t* data;
+
+	it = skinning_data_cache.find(core_submesh);
+
+	if (it != skinning_data_cache.end())
+	{
+		return it->second;
+	}
+
+	data = build_skinning_data(core_submesh);
+
+	skinning_data_cache[core_submesh] = data;
+
+	return data;
+}
+
+extern "C" void clear_skinning_data()
+{
+	SkinningDataMap::iterator it;
+
+	for (it = skinning_data_cache.begin(); it != skinning_data_cache.end(); it++)
+	{
+		skinning_data_free(it->second);
+	}
+
+	skinning_data_cache.clear();
+}
+
+static void run_skinning_job(void* data, Uint32 index)
+{
+	const SkinningJob &job = reinterpret_cast<SkinningJob*>(data)[index];
+	SkinnedSubmesh* submesh;
+	CalPhysique* physique;
+	Uint32 i;
+
+	submesh = job.m_submesh;
+
+	if (job.m_start == 0)
+	{
+		submesh->m_submesh->getFaces(&submesh->m_faces[0]);
+	}
+
+	if (submesh->m_fast)
+	{
+		skin_vertices(submesh->m_data, job.m_bones, job.m_start,
+			job.m_end, &submesh->m_vertices[0],
+			job.m_normals ? &submesh->m_normals[0] : 0);
+		return;
+	}
+
+	// morph targets and springs are left to cal3d, like CalRenderer does
+	if (submesh->m_submesh->hasInternalData())
+	{
+		const std::vector<CalVector> &vertices = submesh->m_submesh->getVectorVertex();
+		const std::vector<CalVector> &normals = submesh->m_submesh->getVectorNormal();
+
+		for (i = 0; i < submesh->m_vertex_count; i++)
+		{
+			submesh->m_vertices[i * 3 + 0] = vertices[i].x;
+			submesh->m_vertices[i * 3 + 1] = vertices[i].y;
+			submesh->m_vertices[i * 3 + 2] = vertices[i].z;
+
+			if (job.m_normals)
+			{
+				submesh->m_normals[i * 3 + 0] = normals[i].x;
+				submesh->m_normals[i * 3 + 1] = normals[i].y;
+				submesh->m_normals[i * 3 + 2] = normals[i].z;
+			}
+		}
+
+		return;
+	}
+
+	physique = job.m_model->getPhysique();
+
+	physique->calculateVertices(submesh->m_submesh, &submesh->m_vertices[0]);
+
+	if (job.m_normals)
+	{
+		physique->calculateNormals(submesh->m_submesh, &submesh->m_normals[0]);
+	}
+}
+
+static void skin_model(actor* act, ModelData* md, const bool normals,
+	const bool fast)
+{
+	SkinningJob job;
+	float* matrix;
+	Uint32 i, j, count, start;
+
+	std::vector<CalMesh*> &meshes = act->calmodel->getVectorMesh();
+	const std::vector<CalBone*> &bones = act->calmodel->getSkeleton()->getVectorBone();
+
+	// the bone matrices, after the identity for vertices without influences
+	md->m_bones.resize((bones.size() + 1) * SKINNING_MATRIX_SIZE);
+
+	std::fill(md->m_bones.begin(), md->m_bones.begin() + SKINNING_MATRIX_SIZE, 0.0f);
+	md->m_bones[0] = 1.0f;
+	md->m_bones[5] = 1.0f;
+	md->m_bones[10] = 1.0f;
+
+	for (i = 0; i < bones.size(); i++)
+	{
+		const CalMatrix &rotation = bones[i]->getTransformMatrix();
+		const CalVector &translation = bones[i]->getTranslationBoneSpace();
+
+		matrix = &md->m_bones[(i + 1) * SKINNING_MATRIX_SIZE];
+
+		matrix[0] = rotation.dxdx;
+		matrix[1] = rotation.dxdy;
+		matrix[2] = rotation.dxdz;
+		matrix[3] = translation.x;
+		matrix[4] = rotation.dydx;
+		matrix[5] = rotation.dydy;
+		matrix[6] = rotation.dydz;
+		matrix[7] = translation.y;
+		matrix[8] = rotation.dzdx;
+		matrix[9] = rotation.dzdy;
+		matrix[10] = rotation.dzdz;
+		matrix[11] = translation.z;
+	}
+
+	md->m_first_submesh.resize(meshes.size());
+
+	count = 0;
+
+	for (i = 0; i < meshes.size(); i++)
+	{
+		md->m_first_submesh[i] = count;
+		count += meshes[i]->getSubmeshCount();
+	}
+
+	md->m_submeshes.resize(count);
+	md->m_normals = normals;
+
+	skinning_jobs.clear();
+
+	job.m_model = act->calmodel;
+	job.m_bones = &md->m_bones[0];
+	job.m_normals = normals;
+
+	for (i = 0; i < meshes.size(); i++)
+	{
+		for (j = 0; j < static_cast<Uint32>(meshes[i]->getSubmeshCount()); j++)
+		{
+			SkinnedSubmesh &submesh = md->m_submeshes[md->m_first_submesh[i] + j];
+
+			submesh.m_submesh = meshes[i]->getSubmesh(j);
+			submesh.m_data = get_skinning_data(submesh.m_submesh->getCoreSubmesh());
+			submesh.m_vertex_count = submesh.m_submesh->getVertexCount();
+			submesh.m_face_count = submesh.m_submesh->getFaceCount();
+			submesh.m_fast = fast && (submesh.m_data != 0) &&
+				!submesh.m_submesh->hasInternalData() &&
+				(submesh.m_submesh->getMorphTargetWeightCount() == 0) &&
+				(submesh.m_data->bone_count <= bones.size()) &&
+				(submesh.m_vertex_count <= submesh.m_data->vertex_count);
+
+			// one more, so the buffers are never empty
+			submesh.m_vertices.resize(submesh.m_vertex_count * 3 + 1);
+			submesh.m_faces.resize(submesh.m_face_count * 3 + 1);
+
+			if (normals)
+			{
+				submesh.m_normals.resize(submesh.m_vertex_count * 3 + 1);
+			}
+
+			job.m_submesh = &submesh;
+
+			if (!submesh.m_fast)
+			{
+				job.m_start = 0;
+				job.m_end = submesh.m_vertex_count;
+				skinning_jobs.push_back(job);
+				continue;
+			}
+
+			start = 0;
+
+			do
+			{
+				job.m_start = start;
+				job.m_end = std::min(start + SKINNING_JOB_SIZE,
+					submesh.m_vertex_count);
+				skinning_jobs.push_back(job);
+				start += SKINNING_JOB_SIZE;
+			}
+			while (start < submesh.m_vertex_count);
+		}
+	}
+
+	if (skinning_jobs.size() > 0)
+	{
+		worker_pool_run(run_skinning_job, &skinning_jobs[0],
+			skinning_jobs.size(), 1);
+	}
+}
+
+extern "C" void skin_actor(actor* act, Uint32 normals)
+{
+	ModelData* md;
+
+	assert(act->calmodel);
+
+	md = reinterpret_cast<ModelData*>(act->calmodel->getUserData());
+
+	assert(md);
+
+	skin_model(act, md, normals != 0, use_fast_skinning != 0);
+}
+
+extern "C" int get_skinned_submesh(actor* act, int mesh_id, int submesh_id,
+	skinned_submesh_t* result)
+{
+	ModelData* md;
+	Uint32 index;
+
+	md = reinterpret_cast<ModelData*>(act->calmodel->getUserData());
+
+	if ((mesh_id < 0) || (mesh_id >= static_cast<int>(md->m_first_submesh.size())))
+	{
+		return 0;
+	}
+
+	index = md->m_first_submesh[mesh_id] + submesh_id;
+
+	if ((submesh_id < 0) || (index >= md->m_submeshes.size()))
+	{
+		return 0;
+	}
+
+	const SkinnedSubmesh &submesh = md->m_submeshes[index];
+
+	result->vertices = &submesh.m_vertices[0];
+	result->normals = md->m_normals ? &submesh.m_normals[0] : 0;
+	result->texture_coordinates = submesh.m_data != 0 ?
+		submesh.m_data->texture_coordinates : 0;
+	result->faces = &submesh.m_faces[0];
+	result->face_count = submesh.m_face_count;
+
+	return 1;
+}
+
+extern "C" Uint32 check_actor_skinning(actor* act, float* vertex_error,
+	float* normal_error)
+{
+	ModelData* md;
+	CalPhysique* physique;
+	std::vector<float> vertices, normals;
+	Uint32 i, j, count;
+
+	assert(act->calmodel);
+
+	md = reinterpret_cast<ModelData*>(act->calmodel->getUserData());
+	physique = act->calmodel->getPhysique();
+
+	skin_model(act, md, true, true);
+
+	count = 0;
+
+	for (i = 0; i < md->m_submeshes.size(); i++)
+	{
+		const SkinnedSubmesh &submesh = md->m_submeshes[i];
+
+		if (!submesh.m_fast)
+		{
+			continue;
+		}
+
+		vertices.resize(submesh.m_vertex_count * 3 + 1);
+		normals.resize(submesh.m_vertex_count * 3 + 1);
+
+		physique->calculateVertices(submesh.m_submesh, &vertices[0]);
+		physique->calculateNormals(submesh.m_submesh, &normals[0]);
+
+		for (j = 0; j < submesh.m_vertex_count * 3; j++)
+		{
+			*vertex_error = std::max(*vertex_error,
+				std::abs(vertices[j] - submesh.m_vertices[j]));
+			*normal_error = std::max(*normal_error,
+				std::abs(normals[j] - submesh.m_normals[j]));
+		}
+
+		count += submesh.m_vertex_count;
+	}
+
+	return count;
+}
@@ -12,6 +12,19 @@ extern "C"
 #endif
 
 extern Uint32 use_animation_program;
+extern Uint32 use_fast_skinning;
+
+/*!
+ * A submesh of an actor, skinned on the CPU by skin_actor().
+ */
+typedef struct
+{
+	const float *vertices;		/*!< x, y and z of each vertex */
+	const float *normals;		/*!< the normals like the vertices, NULL if they were not skinned */
+	const float *texture_coordinates;	/*!< u and v of each vertex, NULL if unknown */
+	const void *faces;		/*!< three CalIndex values per face */
+	Uint32 face_count;		/*!< number of faces */
+} skinned_submesh_t;
 
 int load_vertex_programs();
 void unload_vertex_programs();
@@ -20,6 +33,11 @@ void clear_buffers(actor_types* a);
 void build_actor_bounding_box(actor* a);
 void set_transformation_buffers(actor* act);
 
+void skin_actor(actor* act, Uint32 normals);
+int get_skinned_submesh(actor* act, int mesh_id, int submesh_id, skinned_submesh_t* result);
+Uint32 check_actor_skinning(actor* act, float* vertex_error, float* normal_error);
+void clear_skinning_data();
+
 struct CalModel *model_new(struct CalCoreModel* pCoreModel);
 void model_delete(struct CalModel *self);
 void model_attach_mesh(actor *act, int mesh_id);
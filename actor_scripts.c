@@ -37,6 +37,9 @@
 #include "io/cal3d_io_wrapper.h"
 #include "actor_init.h"
 #include "textures.h"
+#include "worker_pool.h"
+#include "pose_cache.h"
+#include "actor_defs_cache.h"
 
 #ifndef EXT_ACTOR_DICT
 const dict_elem skin_color_dict[] =
@@ -69,9 +72,6 @@ const dict_elem head_number_dict[] =
 	};
 int actor_part_sizes[ACTOR_NUM_PARTS] = {10, 40, 50, 100, 100, 100, 10, 20, 40, 60, 20, 20};		// Elements according to actor_parts_enum
 #else // EXT_ACTOR_DICT
-#define MAX_SKIN_COLORS 7
-#define MAX_GLOW_MODES 5
-#define MAX_HEAD_NUMBERS 5
 dict_elem skin_color_dict[MAX_SKIN_COLORS];
 dict_elem head_number_dict[MAX_GLOW_MODES];
 dict_elem glow_mode_dict[MAX_HEAD_NUMBERS];
@@ -91,6 +91,7 @@ int parse_actor_sounds(actor_types *act, const xmlNode *cfg);
 
 hash_table *emote_cmds = NULL;
 hash_table *emotes = NULL;
+Uint32 cmd_queue_resyncs = 0;
 int parse_actor_frames(actor_types *act, const xmlNode *cfg, const xmlNode *defaults);
 
 
@@ -101,7 +102,7 @@ static int thecount=0;
 
 void unfreeze_horse(int i){
 
-			if(HAS_HORSE(i)&&MY_HORSE(i)->que[0]==wait_cmd) {
+			if(HAS_HORSE(i)&&get_queued_command(MY_HORSE(i), 0)==wait_cmd) {
 				//printf("%i, horse out of wait\n",thecount);
 				unqueue_cmd(MY_HORSE_ID(i));
 				MY_HORSE(i)->busy=0;
@@ -118,6 +119,7 @@ void cal_actor_set_random_idle(int id)
 	int random_anim_index;
 
 	if (actors_list[id]->calmodel==NULL) return;
+	cal_flush_animation_lod(actors_list[id]);
 	//LOG_TO_CONSOLE(c_green2,"Randomizing");
 	//if (actors_list[id]->cur_anim.anim_index==anim.anim_index) return;
 	srand( (unsigned)time( NULL ) );
@@ -258,9 +260,9 @@ static Uint32 update_actor_animation_speed(actor* a, const float time_diff)
 
 	animations = 0;
 
-	for (i = 0; i < MAX_CMD_QUEUE; i++)
+	for (i = 0; i < a->que_length; i++)
 	{
-		if ((a->que[i] != nothing) && (a->que[i] != wait_cmd))
+		if (get_queued_command(a, i) != wait_cmd)
 		{
 			animations++;
 		}
@@ -297,8 +299,174 @@ static Uint32 update_actor_animation_speed(actor* a, const float time_diff)
 }
 #endif	/* ANIMATION_SCALING */
 
+#ifndef	DYNAMIC_ANIMATIONS
+#define ANIMATION_BATCH_SIZE	4	/*!< actors a thread updates at once */
+
+int parallel_animation = 1;
+
+/*!
+ * An actor whose skeleton is updated by \ref animate_actors.
+ */
+typedef struct
+{
+	int index;	/*!< position in the actors list */
+	float step;	/*!< seconds to advance the animations */
+	int wasbusy;	/*!< the busy flag before the bones were rotated */
+} animated_actor_t;
+
+static animated_actor_t animated_actors[MAX_ACTORS];
+
+/*!
+ * Updates the skeleton of one actor and everything derived from it. Runs on
+ * the worker threads, so it must only touch the actor itself.
+ */
+static void update_actor_skeleton(void *data, Uint32 index)
+{
+	animated_actor_t *aa = &((animated_actor_t *)data)[index];
+	actor *a = actors_list[aa->index];
+
+	update_actor_pose(a, aa->step);
+	build_actor_bounding_box(a);
+	aa->wasbusy = a->busy;
+	missiles_rotate_actor_bones(a);
+	if (use_animation_program)
+	{
+		set_transformation_buffers(a);
+	}
+}
+
+#define ANIMATION_LOD_VISIBLE_TIME	1000	/*!< ms an actor is still animated after it left the view */
+
+int animation_lod = 1;
+float animation_lod_near_distance = 10.0f;
+float animation_lod_far_distance = 20.0f;
+
+/* ms between two skeleton updates in each level, zero for every frame */
+static const Uint32 animation_lod_intervals[ANIMATION_LOD_COUNT] = { 0, 66, 200, 0 };
+static Uint32 animation_lod_counts[ANIMATION_LOD_COUNT];
+static Uint32 animation_lod_updates = 0;
+
+static int get_actor_animation_lod(const actor *a, const actor *me)
+{
+	float dx, dy, distance;
+
+	// aiming rotates the bones on top of the animations in every frame
+	if (!animation_lod || (me == NULL) || (a == me) ||
+		(a->cal_rotation_blend >= 0.0f))
+	{
+		return ANIMATION_LOD_FULL;
+	}
+
+	if (cur_time - a->last_visible_time > ANIMATION_LOD_VISIBLE_TIME)
+	{
+		return ANIMATION_LOD_FROZEN;
+	}
+
+	dx = a->x_pos - me->x_pos;
+	dy = a->y_pos - me->y_pos;
+	distance = dx * dx + dy * dy;
+
+	if (distance <= animation_lod_near_distance * animation_lod_near_distance)
+	{
+		return ANIMATION_LOD_FULL;
+	}
+
+	if (distance <= animation_lod_far_distance * animation_lod_far_distance)
+	{
+		return ANIMATION_LOD_REDUCED;
+	}
+
+	return ANIMATION_LOD_LOW;
+}
+
+static void update_animation_lods(void)
+{
+	actor *me, *att;
+	int i, lod;
+
+	me = get_our_actor();
+
+	for (i = 0; i < max_actors; i++)
+	{
+		if (actors_list[i] != NULL)
+		{
+			actors_list[i]->animation_lod = get_actor_animation_lod(actors_list[i], me);
+		}
+	}
+
+	// a horse and its rider are updated in the same frames, else the rider would shake
+	for (i = 0; i < max_actors; i++)
+	{
+		if ((actors_list[i] != NULL) && (actors_list[i]->attached_actor >= 0))
+		{
+			att = actors_list[actors_list[i]->attached_actor];
+			if (att != NULL)
+			{
+				lod = min2i(actors_list[i]->animation_lod, att->animation_lod);
+				actors_list[i]->animation_lod = lod;
+				att->animation_lod = lod;
+			}
+		}
+	}
+
+	memset(animation_lod_counts, 0, sizeof(animation_lod_counts));
+	for (i = 0; i < max_actors; i++)
+	{
+		if ((actors_list[i] != NULL) && (actors_list[i]->calmodel != NULL))
+		{
+			animation_lod_counts[actors_list[i]->animation_lod]++;
+		}
+	}
+}
+
+/*!
+ * Adds the animation time of this frame to an actor. If the skeleton is due
+ * for an update, the time saved up since the last update is returned in
+ * \a step, so the animations end up where they would be when updated in every
+ * frame.
+ */
+static int update_animation_lod(actor *a, float time, float *step)
+{
+	Uint32 interval;
+
+	a->animation_lod_step += time;
+
+	if (a->animation_lod == ANIMATION_LOD_FROZEN)
+	{
+		return 0;
+	}
+
+	// all actors in a level are updated in the same frames
+	interval = animation_lod_intervals[a->animation_lod];
+	if ((interval > 0) && (cur_time / interval == a->last_skeleton_update / interval))
+	{
+		return 0;
+	}
+
+	*step = a->animation_lod_step;
+	a->animation_lod_step = 0.0f;
+	a->last_skeleton_update = cur_time;
+
+	return 1;
+}
+
+void get_animation_lod_stats(Uint32 *counts, Uint32 *updates)
+{
+	memcpy(counts, animation_lod_counts, sizeof(animation_lod_counts));
+
+	if (updates != NULL)
+	{
+		*updates = animation_lod_updates;
+	}
+}
+#endif	//DYNAMIC_ANIMATIONS
+
 void animate_actors()
 {
+#ifndef	DYNAMIC_ANIMATIONS
+	int j, animated_count = 0;
+	float step;
+#endif	//DYNAMIC_ANIMATIONS
 #ifdef	ANIMATION_SCALING
 	static int last_update = 0;
 	int i, actors_time_diff, time_diff, tmp_time_diff;
@@ -313,6 +481,9 @@ void animate_actors()
 
 	// lock the actors_list so that nothing can interere with this look
 	LOCK_ACTORS_LISTS();	//lock it to avoid timing issues
+#ifndef	DYNAMIC_ANIMATIONS
+	update_animation_lods();
+#endif	//DYNAMIC_ANIMATIONS
 	for(i=0; i<max_actors; i++) {
 		if(actors_list[i]) {
 #ifdef	ANIMATION_SCALING
@@ -355,8 +526,8 @@ void animate_actors()
 						//if(actors_list[i]->actor_id==yourself) printf("%i, unbusy(moved)\n", thecount);
 						//if(actors_list[i]->actor_id<0) printf("%i, unbusy horse(moved)\n", thecount);
 
-						if (actors_list[i]->que[0] >= move_n &&
-							actors_list[i]->que[0] <= move_nw) {
+						if (get_queued_command(actors_list[i], 0) >= move_n &&
+							get_queued_command(actors_list[i], 0) <= move_nw) {
 							next_command();
 						}
 						else {
@@ -437,44 +608,83 @@ void animate_actors()
 					}
 				}
 #endif
+				// the skeleton is updated below, together with the other actors
 #ifdef	ANIMATION_SCALING
-				CalModel_Update(actors_list[i]->calmodel, (time_diff * actors_list[i]->cur_anim.duration_scale) / 1000.0f);
+				step = (time_diff * actors_list[i]->cur_anim.duration_scale) / 1000.0f;
 #else	/* ANIMATION_SCALING */
-				CalModel_Update(actors_list[i]->calmodel, (((cur_time-last_update)*actors_list[i]->cur_anim.duration_scale)/1000.0));
+				step = (((cur_time-last_update)*actors_list[i]->cur_anim.duration_scale)/1000.0);
 #endif	/* ANIMATION_SCALING */
-				build_actor_bounding_box(actors_list[i]);
-				{
-				int wasbusy = ACTOR(i)->busy;
-				missiles_rotate_actor_bones(actors_list[i]);
-				if (ACTOR(i)->busy!=wasbusy&&HAS_HORSE(i)) {
-					//if(actors_list[i]->actor_id==yourself) printf("%i, %s is no more busy due to missiles_rotate_actor_bones!! Setting the horse free...\n",thecount, ACTOR(i)->actor_name);
-					unfreeze_horse(i);
-				}
-
-				}
-				if (use_animation_program)
+				if (update_animation_lod(actors_list[i], step, &animated_actors[animated_count].step))
 				{
-					set_transformation_buffers(actors_list[i]);
+					animated_actors[animated_count].index = i;
+					animated_count++;
 				}
 			}
 #endif	//DYNAMIC_ANIMATIONS
 		}
 	}
+
+#ifndef	DYNAMIC_ANIMATIONS
+	animation_lod_updates = animated_count;
+
+	age_pose_cache(cur_time);
+
+	// the actors don't share any state here, so the order doesn't matter
+	if (parallel_animation)
+	{
+		worker_pool_run(update_actor_skeleton, animated_actors,
+			animated_count, ANIMATION_BATCH_SIZE);
+	}
+	else
+	{
+		for (i = 0; i < animated_count; i++)
+		{
+			update_actor_skeleton(animated_actors, i);
+		}
+	}
+
+	// the horse is another actor, so wake it up on this thread
+	for (i = 0; i < animated_count; i++)
+	{
+		j = animated_actors[i].index;
+		if (ACTOR(j)->busy!=animated_actors[i].wasbusy&&HAS_HORSE(j)) {
+			//if(actors_list[j]->actor_id==yourself) printf("%i, %s is no more busy due to missiles_rotate_actor_bones!! Setting the horse free...\n",thecount, ACTOR(j)->actor_name);
+			unfreeze_horse(j);
+		}
+	}
+#endif	//DYNAMIC_ANIMATIONS
+
 	// unlock the actors_list since we are done now
 	UNLOCK_ACTORS_LISTS();
 
 	last_update = cur_time;
 }
 
+static void set_queued_command(actor *act, int k, actor_commands command)
+{
+	act->que[(act->que_head + k) & MAX_CMD_QUEUE] = command;
+}
+
+/* Removes a command from the queue, the next one is removed in constant time */
+static void remove_queued_command(actor *act, int k)
+{
+	if (k < 0 || k >= act->que_length)
+		return;
+
+	if (k == 0)
+	{
+		act->que_head = (act->que_head + 1) & MAX_CMD_QUEUE;
+	}
+	else
+	{
+		for (; k < act->que_length - 1; k++)
+			set_queued_command(act, k, get_queued_command(act, k + 1));
+	}
+	act->que_length--;
+}
+
 void unqueue_cmd(int i){
-	int k;
-	int max_queue=0;
-	//move que down with one command
-	for(k=0;k<MAX_CMD_QUEUE-1;k++) {
-		if(k>max_queue && actors_list[i]->que[k]!=nothing)max_queue=k;
-			actors_list[i]->que[k]=actors_list[i]->que[k+1];
-		}
-	actors_list[i]->que[k]=nothing;
+	remove_queued_command(actors_list[i], 0);
 }
 
 
@@ -484,11 +694,12 @@ void print_queue(actor *act) {
 	printf("   Actor %s queue:",act->actor_name);
 	printf(" -->");
 	for(k=0; k<MAX_CMD_QUEUE; k++){
-			if(act->que[k]==enter_combat) printf("IC");
-			if(act->que[k]==leave_combat) printf("LC");
-			if(act->que[k]>=move_n&&act->que[k]<=move_nw) printf("M");
-			if(act->que[k]>=turn_n&&act->que[k]<=turn_nw) printf("R");
-			printf("%2i|",act->que[k]);
+			actor_commands command = get_queued_command(act, k);
+			if(command==enter_combat) printf("IC");
+			if(command==leave_combat) printf("LC");
+			if(command>=move_n&&command<=move_nw) printf("M");
+			if(command>=turn_n&&command<=turn_nw) printf("R");
+			printf("%2i|",command);
 	}
 	printf("\n");
 	/*for(k=0; k<MAX_RANGE_ACTION_QUEUE; k++){
@@ -501,11 +712,12 @@ void print_queue(actor *act) {
 		printf("   Horse %s queue:",act->actor_name);
 		printf(" -->");
 		for(k=0; k<MAX_CMD_QUEUE; k++){
-			if(actors_list[act->attached_actor]->que[k]==enter_combat) printf("IC");
-			if(actors_list[act->attached_actor]->que[k]==leave_combat) printf("LC");
-			if(actors_list[act->attached_actor]->que[k]>=move_n&&actors_list[act->attached_actor]->que[k]<=move_nw) printf("M");
-			if(actors_list[act->attached_actor]->que[k]>=turn_n&&actors_list[act->attached_actor]->que[k]<=turn_nw) printf("R");
-			printf("%2i|",actors_list[act->attached_actor]->que[k]);
+			actor_commands command = get_queued_command(actors_list[act->attached_actor], k);
+			if(command==enter_combat) printf("IC");
+			if(command==leave_combat) printf("LC");
+			if(command>=move_n&&command<=move_nw) printf("M");
+			if(command>=turn_n&&command<=turn_nw) printf("R");
+			printf("%2i|",command);
 		}
 		printf("\n");
 	}
@@ -513,12 +725,12 @@ void print_queue(actor *act) {
 }
 
 void attached_info(int i, int c){
-					if(actors_list[i]->actor_id==yourself&&actors_list[i]->que[0]!=nothing) {
-						printf("%i---------> DOING: %i -----------\n",c,actors_list[i]->que[0]);
+					if(actors_list[i]->actor_id==yourself&&get_queued_command(actors_list[i], 0)!=nothing) {
+						printf("%i---------> DOING: %i -----------\n",c,get_queued_command(actors_list[i], 0));
 						print_queue(actors_list[i]);
 					}
-					if(actors_list[i]->actor_id<0&&MY_HORSE(i)->actor_id==yourself&&actors_list[i]->que[0]!=wait_cmd&&actors_list[i]->que[0]!=nothing){
-						printf("%i---------> DOING (horse): %i ---\n",c,actors_list[i]->que[0]);
+					if(actors_list[i]->actor_id<0&&MY_HORSE(i)->actor_id==yourself&&get_queued_command(actors_list[i], 0)!=wait_cmd&&get_queued_command(actors_list[i], 0)!=nothing){
+						printf("%i---------> DOING (horse): %i ---\n",c,get_queued_command(actors_list[i], 0));
 						print_queue(actors_list[actors_list[i]->attached_actor]);
 					}
 
@@ -974,7 +1186,6 @@ void rotate_actor_and_horse_range(int id, int mul){
 void next_command()
 {
 	int i, index;
-	int max_queue=0;
 
 
 #ifdef MORE_ATTACHED_ACTORS_DEBUG
@@ -983,30 +1194,24 @@ void next_command()
 
 	for(i=0;i<max_actors;i++){
 		if(!actors_list[i])continue;//actor exists?
-		if(actors_list[i]->que[0]>=emote_cmd
-		&&actors_list[i]->que[0]<wait_cmd
+		if(get_queued_command(actors_list[i], 0)>=emote_cmd
+		&&get_queued_command(actors_list[i], 0)<wait_cmd
 		){
-			int k;
-			add_emote_to_actor(actors_list[i]->actor_id,actors_list[i]->que[0]);
+			add_emote_to_actor(actors_list[i]->actor_id,get_queued_command(actors_list[i], 0));
 			//actors_list[i]->stop_animation=1;
-			//move que down with one command
-			for(k=0;k<MAX_CMD_QUEUE-1;k++) {
-				if(k>max_queue && actors_list[i]->que[k]!=nothing)max_queue=k;
-				actors_list[i]->que[k]=actors_list[i]->que[k+1];
-			}
-			actors_list[i]->que[max_queue]=nothing;
+			unqueue_cmd(i);
 		}
 		if(!actors_list[i]->busy){//Are we busy?
 			//are we playing an emote?
 			if(actors_list[i]->cur_emote.active
-			&&!(actors_list[i]->que[0]>=move_n&&actors_list[i]->que[0]<=move_nw&&actors_list[i]->last_command>=move_n&&actors_list[i]->last_command<=move_nw)
+			&&!(get_queued_command(actors_list[i], 0)>=move_n&&get_queued_command(actors_list[i], 0)<=move_nw&&actors_list[i]->last_command>=move_n&&actors_list[i]->last_command<=move_nw)
 			&&!HAS_HORSE(i)
 			) { continue;}
 			
 			// If the que is empty, check for an emote to display
 			while (actors_list[i]->emote_que[0].origin != NO_EMOTE)
 				if(!handle_emote_command(i, &actors_list[i]->emote_que[0])) break;
-			if(actors_list[i]->que[0]==nothing){//Is the queue empty?
+			if(get_queued_command(actors_list[i], 0)==nothing){//Is the queue empty?
 				//if que is empty, set on idle
 				set_on_idle(i);
 				//synch_attachment(i);
@@ -1023,12 +1228,12 @@ void next_command()
 
 #ifndef DISABLE_RANGE_MODE_EXIT_BUGFIX
 				if (actors_list[i]->is_enhanced_model && actors_list[i]->in_aim_mode == 1 &&
-					(actors_list[i]->que[0] < enter_aim_mode || actors_list[i]->que[0] > missile_critical) &&
-					(actors_list[i]->que[0] < turn_n || actors_list[i]->que[0] > turn_nw))
+					(get_queued_command(actors_list[i], 0) < enter_aim_mode || get_queued_command(actors_list[i], 0) > missile_critical) &&
+					(get_queued_command(actors_list[i], 0) < turn_n || get_queued_command(actors_list[i], 0) > turn_nw))
 				{
 					actor *a = actors_list[i];
 
-					LOG_ERROR("%s: %d: command incompatible with range mode detected: %d", __FUNCTION__, __LINE__, actors_list[i]->que[0]);
+					LOG_ERROR("%s: %d: command incompatible with range mode detected: %d", __FUNCTION__, __LINE__, get_queued_command(actors_list[i], 0));
 					missiles_log_message("%s (%d): forcing aim mode exit", a->actor_name, a->actor_id);
 					a->cal_h_rot_start = 0.0;
 					a->cal_v_rot_start = 0.0;
@@ -1048,7 +1253,7 @@ void next_command()
 				//just for debugging
 				attached_info(i,thecount);
 #endif
-				switch(actors_list[i]->que[0]) {
+				switch(get_queued_command(actors_list[i], 0)) {
 					case kill_me:
 /*						if(actors_list[i]->remapped_colors)
 						glDeleteTextures(1,&actors_list[i]->texture_id);
@@ -1068,7 +1273,7 @@ void next_command()
 						break;
 					case pain1:
 					case pain2: {
-						int painframe = (actors_list[i]->que[0]==pain1) ? (cal_actor_pain1_frame):(cal_actor_pain2_frame);
+						int painframe = (get_queued_command(actors_list[i], 0)==pain1) ? (cal_actor_pain1_frame):(cal_actor_pain2_frame);
 						attachment_props *att_props = get_attachment_props_if_held(actors_list[i]);
 						if (att_props) {
 							if(HAS_HORSE(i)&&!ACTOR_WEAPON(i)->unarmed) {
@@ -1129,7 +1334,7 @@ void next_command()
 					case enter_combat:
 					case leave_combat:
 						{
-						int fight_k = (actors_list[i]->que[0]==enter_combat) ? (1):(0);
+						int fight_k = (get_queued_command(actors_list[i], 0)==enter_combat) ? (1):(0);
 						int combat_frame = (fight_k) ? (cal_actor_in_combat_frame):(cal_actor_out_combat_frame);
 						int combat_held_frame = (fight_k) ? (cal_actor_in_combat_held_frame):(cal_actor_out_combat_held_frame);
 						int combat_held_unarmed_frame = (fight_k) ? (cal_actor_in_combat_held_unarmed_frame):(cal_actor_out_combat_held_unarmed_frame);
@@ -1192,7 +1397,7 @@ void next_command()
 					case attack_down_9:
 					case attack_down_10:
 						index = -1;
-						switch (actors_list[i]->que[0])
+						switch (get_queued_command(actors_list[i], 0))
 						{
 							case attack_down_10:
 								index++;
@@ -1281,8 +1486,8 @@ void next_command()
 					case turn_left:
 					case turn_right: 
 					{
-						int mul= (actors_list[i]->que[0]==turn_left) ? (1):(-1);
-						int turnframe=(actors_list[i]->que[0]==turn_left) ? (cal_actor_turn_left_frame):(cal_actor_turn_right_frame);
+						int mul= (get_queued_command(actors_list[i], 0)==turn_left) ? (1):(-1);
+						int turnframe=(get_queued_command(actors_list[i], 0)==turn_left) ? (cal_actor_turn_left_frame):(cal_actor_turn_right_frame);
 
 						//LOG_TO_CONSOLE(c_green2,"turn left");
 						actors_list[i]->rotate_z_speed=mul*45.0/540.0;
@@ -1577,7 +1782,7 @@ void next_command()
 
 					//ok, now the movement, this is the tricky part
 					default:
-						if(actors_list[i]->que[0]>=move_n && actors_list[i]->que[0]<=move_nw) {
+						if(get_queued_command(actors_list[i], 0)>=move_n && get_queued_command(actors_list[i], 0)<=move_nw) {
 							float rotation_angle;
 							int dx, dy;
 							int step_duration = actors_list[i]->step_duration;
@@ -1598,26 +1803,26 @@ void next_command()
 								actors_list[i]->stop_animation=0;
 							}
 
-							if(last_command!=actors_list[i]->que[0]){ //Calculate the rotation
-								targeted_z_rot=(actors_list[i]->que[0]-move_n)*45.0f;
+							if(last_command!=get_queued_command(actors_list[i], 0)){ //Calculate the rotation
+								targeted_z_rot=(get_queued_command(actors_list[i], 0)-move_n)*45.0f;
 								rotation_angle=get_rotation_vector(z_rot,targeted_z_rot);
 								actors_list[i]->rotate_z_speed=rotation_angle/360.0;
 
 								actors_list[i]->rotate_time_left=360;
 								actors_list[i]->rotating=1;
 							}
-                            get_motion_vector(actors_list[i]->que[0], &dx, &dy);
+                            get_motion_vector(get_queued_command(actors_list[i], 0), &dx, &dy);
 
 							/* if other move commands are waiting in the queue,
 							 * we walk at a speed that is close to the server speed
 							 * else we walk at a slightly slower speed to wait next
 							 * incoming walking commands */
-                            if (actors_list[i]->que[1] >= move_n &&
-                                actors_list[i]->que[1] <= move_nw) {
-                                if (actors_list[i]->que[2] >= move_n &&
-                                    actors_list[i]->que[2] <= move_nw) {
-									if (actors_list[i]->que[3] >= move_n &&
-										actors_list[i]->que[3] <= move_nw)
+                            if (get_queued_command(actors_list[i], 1) >= move_n &&
+                                get_queued_command(actors_list[i], 1) <= move_nw) {
+                                if (get_queued_command(actors_list[i], 2) >= move_n &&
+                                    get_queued_command(actors_list[i], 2) <= move_nw) {
+									if (get_queued_command(actors_list[i], 3) >= move_n &&
+										get_queued_command(actors_list[i], 3) <= move_nw)
 										actors_list[i]->movement_time_left = (int)(step_duration*0.9); // 3 moves
 									else
 										actors_list[i]->movement_time_left = step_duration; // 2 moves
@@ -1650,7 +1855,7 @@ void next_command()
 								actors_list[i]->cur_anim.duration_scale /= actors_defs[actor_type].scale;
 							if (dx != 0 && dy != 0)
 								actors_list[i]->cur_anim.duration_scale *= 1.4142315;
-						} else if(actors_list[i]->que[0]>=turn_n && actors_list[i]->que[0]<=turn_nw) {
+						} else if(get_queued_command(actors_list[i], 0)>=turn_n && get_queued_command(actors_list[i], 0)<=turn_nw) {
 							float rotation_angle;
 
 							int horse_angle=0;
@@ -1665,7 +1870,7 @@ void next_command()
 								//if(actors_list[i]->actor_id==yourself) printf("%i, %s rotates\n",thecount, ACTOR(i)->actor_name);
 								//if(MY_HORSE(i)->actor_id==yourself) printf("%i, Horse %s rotates\n",thecount, MY_HORSE(i)->actor_name);
 							}
-							targeted_z_rot=(ACTOR(i)->que[0]-turn_n)*45.0f-horse_angle;
+							targeted_z_rot=(get_queued_command(ACTOR(i), 0)-turn_n)*45.0f-horse_angle;
 							rotation_angle=get_rotation_vector(ACTOR(i)->z_rot,targeted_z_rot);
 							ACTOR(i)->rotate_z_speed=rotation_angle/360.0f;
 							ACTOR(i)->rotate_time_left=360;
@@ -1673,7 +1878,7 @@ void next_command()
 							ACTOR(i)->stop_animation=1;
 
 							if(ACTOR(i)->fighting&&horse_angle!=0) ACTOR(i)->horse_rotated=1;
-							missiles_log_message("%s (%d): rotation %d requested", actors_list[i]->actor_name, actors_list[i]->actor_id, actors_list[i]->que[0] - turn_n);
+							missiles_log_message("%s (%d): rotation %d requested", actors_list[i]->actor_name, actors_list[i]->actor_id, get_queued_command(actors_list[i], 0) - turn_n);
 						}
 					}
 
@@ -1683,7 +1888,7 @@ void next_command()
 					else if(HAS_HORSE(i)) ACTOR(i)->in_aim_mode=3; //needed to unfreeze the horse in move_to_next_frame
 					//if (actors_list[i]->actor_id==yourself) LOG_TO_CONSOLE(c_green2,"Busy");
 					//save the last command. It is especially good for run and walk
-					actors_list[i]->last_command=actors_list[i]->que[0];
+					actors_list[i]->last_command=get_queued_command(actors_list[i], 0);
 
 					/* We do the enter in aim mode in two steps in order the actor have
 					 * the time to do the load animation before rotating bones. This is
@@ -1691,7 +1896,7 @@ void next_command()
 					 * his foot to reload. So here, we don't remove the enter aim mode
 					 * from the queue in order to treat it again but this time in aim mode.
 					 */
-					if (actors_list[i]->que[0] == enter_aim_mode && actors_list[i]->in_aim_mode == 0) {
+					if (get_queued_command(actors_list[i], 0) == enter_aim_mode && actors_list[i]->in_aim_mode == 0) {
 						actors_list[i]->in_aim_mode = 1;
 						actors_list[i]->last_command=missile_miss; //dirty hack to avoid processing enter_aim_mode twice :/
 						continue;
@@ -1733,6 +1938,7 @@ static void destroy_actor_common(size_t actor_list_index)
 		return; // return of not valid actor
 	free_actor_special_effect(actors_list[actor_list_index]->actor_id);
 	free_actor_data(actor_list_index);
+	remove_actor_from_id_index(actor_list_index);
 	free(actors_list[actor_list_index]);
 	actors_list[actor_list_index]=NULL;
 }
@@ -1740,50 +1946,50 @@ static void destroy_actor_common(size_t actor_list_index)
 void destroy_actor(int actor_id)
 {
 	int i;
-    int attached_actor = -1;
+	int attached_actor = -1;
 
 #ifdef EXTRA_DEBUG
 	ERR();
 #endif
-	for(i=0;i<max_actors;i++){
-		if(actors_list[i])//The timer thread doesn't free memory
-			if(actors_list[i]->actor_id==actor_id){
-				LOCK_ACTORS_LISTS();
-                attached_actor = actors_list[i]->attached_actor;
-
-				if (actor_id == yourself)
-					set_our_actor (NULL);
-				destroy_actor_common(i);
-				if(i==max_actors-1)max_actors--;
-				else {
-					//copy the last one down and fill in the hole
-					max_actors--;
-					actors_list[i]=actors_list[max_actors];
-					actors_list[max_actors]=NULL;
-                    if (attached_actor == max_actors) attached_actor = i;
-					if (actors_list[i] && actors_list[i]->attached_actor >= 0)
-						actors_list[actors_list[i]->attached_actor]->attached_actor = i;
-				}
+	LOCK_ACTORS_LISTS();
+	i = get_actor_index_from_id(actor_id);
+	if (i >= 0)
+	{
+		attached_actor = actors_list[i]->attached_actor;
 
-                if (attached_actor >= 0)
-                {
-                    destroy_actor_common(attached_actor);
-                    if(attached_actor==max_actors-1)max_actors--;
-                    else {
-                        //copy the last one down and fill in the hole
-                        max_actors--;
-                        actors_list[attached_actor]=actors_list[max_actors];
-                        actors_list[max_actors]=NULL;
-						if (actors_list[attached_actor] && actors_list[attached_actor]->attached_actor >= 0)
-							actors_list[actors_list[attached_actor]->attached_actor]->attached_actor = attached_actor;
-                    }
-                }
+		if (actor_id == yourself)
+			set_our_actor (NULL);
+		destroy_actor_common(i);
+		if(i==max_actors-1)max_actors--;
+		else {
+			//copy the last one down and fill in the hole
+			max_actors--;
+			actors_list[i]=actors_list[max_actors];
+			actors_list[max_actors]=NULL;
+			add_actor_to_id_index(i);
+			if (attached_actor == max_actors) attached_actor = i;
+			if (actors_list[i] && actors_list[i]->attached_actor >= 0)
+				actors_list[actors_list[i]->attached_actor]->attached_actor = i;
+		}
 
-				actor_under_mouse = NULL;
-				UNLOCK_ACTORS_LISTS();
-				break;
+		if (attached_actor >= 0)
+		{
+			destroy_actor_common(attached_actor);
+			if(attached_actor==max_actors-1)max_actors--;
+			else {
+				//copy the last one down and fill in the hole
+				max_actors--;
+				actors_list[attached_actor]=actors_list[max_actors];
+				actors_list[max_actors]=NULL;
+				add_actor_to_id_index(attached_actor);
+				if (actors_list[attached_actor] && actors_list[attached_actor]->attached_actor >= 0)
+					actors_list[actors_list[attached_actor]->attached_actor]->attached_actor = attached_actor;
 			}
+		}
+
+		actor_under_mouse = NULL;
 	}
+	UNLOCK_ACTORS_LISTS();
 }
 
 void destroy_all_actors()
@@ -1791,6 +1997,7 @@ void destroy_all_actors()
 	int i=0;
 	LOCK_ACTORS_LISTS();	//lock it to avoid timing issues
 	set_our_actor (NULL);
+	clear_actor_id_index();
 	for(i=0;i<max_actors;i++) {
 		if(actors_list[i]){
 			destroy_actor_common(i);
@@ -1819,51 +2026,210 @@ void update_all_actors(int log_the_update)
 	my_tcp_send(my_socket,str,1);
 }
 
+/*
+ * Appends a command and returns its position. A queue holding
+ * MAX_CMD_QUEUE-1 commands is full: the command is dropped and the returned
+ * position is MAX_CMD_QUEUE-1.
+ */
 int push_command_in_actor_queue(unsigned int command, actor *act)
 {
-	int k;
-	for(k=0;k<MAX_CMD_QUEUE;k++){
-		if(act->que[k]==nothing){
-			//if we are SEVERLY behind, just update all the actors in range
-			if(k>MAX_CMD_QUEUE-2) break;
-			else if(k>MAX_CMD_QUEUE-8){
-				// is the front a sit/stand spam?
-				if((act->que[0]==stand_up||act->que[0]==sit_down)
-				   &&(act->que[1]==stand_up||act->que[1]==sit_down)){
-					int j;
-					//move que down with one command
-					for(j=0;j<=k;j++){
-						act->que[j]=act->que[j+1];
-					}
-					act->que[j]=nothing;
-					//backup one entry
-					k--;
-				}
+	int k = act->que_length;
+
+	if(command==nothing)
+		return k;
+
+	//if we are SEVERLY behind, just update all the actors in range
+	if(k>MAX_CMD_QUEUE-2){
+		act->que_overflows++;
+		return k;
+	}
+	else if(k>MAX_CMD_QUEUE-8){
+		// is the front a sit/stand spam?
+		if((get_queued_command(act, 0)==stand_up||get_queued_command(act, 0)==sit_down)
+		   &&(get_queued_command(act, 1)==stand_up||get_queued_command(act, 1)==sit_down)){
+			remove_queued_command(act, 0);
+			//backup one entry
+			k--;
+		}
 
-				// is the end a sit/stand spam?
-				else if((command==stand_up||command==sit_down)
-						&& (act->que[k-1]==stand_up||act->que[k-1]==sit_down)) {
-					act->que[k-1]=command;
-					break;
-				}
+		// is the end a sit/stand spam?
+		else if((command==stand_up||command==sit_down)
+				&& (get_queued_command(act, k-1)==stand_up||get_queued_command(act, k-1)==sit_down)) {
+			set_queued_command(act, k-1, command);
+			return k;
+		}
+	}
 
-			}
+	set_queued_command(act, k, command);
+	act->que_length++;
+	if (act->que_length > act->que_max_length)
+		act->que_max_length = act->que_length;
+	return k;
+}
 
-			act->que[k]=command;
-			break;
+/* Removes the pain and attack commands, combat starts or ends anyway */
+static void strip_attack_commands(actor *act)
+{
+	actor_commands command;
+	int j, k;
+
+	for(k=0, j=0; k<act->que_length; k++){
+		command = get_queued_command(act, k);
+		switch(command){
+			case pain1:
+			case pain2:
+			case attack_up_1:
+			case attack_up_2:
+			case attack_up_3:
+			case attack_up_4:
+			case attack_down_1:
+			case attack_down_2:
+				break;
+
+			default:
+				set_queued_command(act, j, command);
+				j++;
+				break;
 		}
 	}
-	return k;
+	act->que_length = j;
 }
 
+/*
+ * Makes room in a full queue by dropping its newest emote, from the queue of
+ * the attached actor as well. Returns 0 if there is no emote to drop.
+ */
+static int skip_queued_emote(actor *act)
+{
+	actor_commands command;
+	int k;
+
+	for(k=act->que_length-1; k>=0; k--){
+		command = get_queued_command(act, k);
+		if(command>=emote_cmd&&command<wait_cmd){
+			remove_queued_command(act, k);
+			if(act->attached_actor>=0)
+				remove_queued_command(actors_list[act->attached_actor], k);
+			return 1;
+		}
+	}
+	return 0;
+}
 
-void sanitize_cmd_queue(actor *act){
-	int k,j;
-	for(k=0,j=0;k<MAX_CMD_QUEUE-1-j;k++){
-		if(act->que[k]==nothing) j++;
-		act->que[k]=act->que[k+j];
+/* Tracks where the server has the actor, ahead of the animated position */
+static void update_async_position(actor *act, unsigned char command)
+{
+	int isme = 0;
+
+	{
+		actor * me = get_our_actor();
+		if (me!=NULL)
+			isme = act->actor_id == me->actor_id;
+	}
+
+	switch(command) {
+	case enter_combat:
+		act->async_fighting= 1;
+		check_to_auto_disable_ranging_lock();
+		break;
+	case leave_combat:
+		act->async_fighting= 0;
+		break;
+	case move_n:
+	case run_n:
+		act->async_y_tile_pos++;
+		act->async_z_rot= 0;
+		if(isme && pf_follow_path)
+		{
+			if(checkvisitedlist(act->async_x_tile_pos,act->async_y_tile_pos))
+				pf_destroy_path();
+		}
+		break;
+	case move_ne:
+	case run_ne:
+		act->async_x_tile_pos++;
+		act->async_y_tile_pos++;
+		act->async_z_rot= 45;
+		if(isme && pf_follow_path)
+		{
+			if(checkvisitedlist(act->async_x_tile_pos,act->async_y_tile_pos))
+				pf_destroy_path();
+		}
+		break;
+	case move_e:
+	case run_e:
+		act->async_x_tile_pos++;
+		act->async_z_rot= 90;
+		if(isme && pf_follow_path)
+		{
+			if(checkvisitedlist(act->async_x_tile_pos,act->async_y_tile_pos))
+				pf_destroy_path();
+		}
+		break;
+	case move_se:
+	case run_se:
+		act->async_x_tile_pos++;
+		act->async_y_tile_pos--;
+		act->async_z_rot= 135;
+		if(isme && pf_follow_path)
+		{
+			if(checkvisitedlist(act->async_x_tile_pos,act->async_y_tile_pos))
+				pf_destroy_path();
+		}
+		break;
+	case move_s:
+	case run_s:
+		act->async_y_tile_pos--;
+		act->async_z_rot= 180;
+		if(isme && pf_follow_path)
+		{
+			if(checkvisitedlist(act->async_x_tile_pos,act->async_y_tile_pos))
+				pf_destroy_path();
+		}
+		break;
+	case move_sw:
+	case run_sw:
+		act->async_x_tile_pos--;
+		act->async_y_tile_pos--;
+		act->async_z_rot= 225;
+		if(isme && pf_follow_path)
+		{
+			if(checkvisitedlist(act->async_x_tile_pos,act->async_y_tile_pos))
+				pf_destroy_path();
+		}
+		break;
+	case move_w:
+	case run_w:
+		act->async_x_tile_pos--;
+		act->async_z_rot= 270;
+		if(isme && pf_follow_path)
+		{
+			if(checkvisitedlist(act->async_x_tile_pos,act->async_y_tile_pos))
+				pf_destroy_path();
+		}
+		break;
+	case move_nw:
+	case run_nw:
+		act->async_x_tile_pos--;
+		act->async_y_tile_pos++;
+		act->async_z_rot= 315;
+		if(isme && pf_follow_path)
+		{
+			if(checkvisitedlist(act->async_x_tile_pos,act->async_y_tile_pos))
+				pf_destroy_path();
+		}
+		break;
+	case turn_n:
+	case turn_ne:
+	case turn_e:
+	case turn_se:
+	case turn_s:
+	case turn_sw:
+	case turn_w:
+	case turn_nw:
+		act->async_z_rot= (command-turn_n)*45;
+		break;
 	}
-	for(k=MAX_CMD_QUEUE-1;k>0&&j>0;k--,j--) act->que[k]=nothing;
 }
 
 void add_command_to_actor(int actor_id, unsigned char command)
@@ -1874,7 +2240,6 @@ void add_command_to_actor(int actor_id, unsigned char command)
 	//int have_actor=0;
 //if ((actor_id==yourself)&&(command==enter_combat)) LOG_TO_CONSOLE(c_green2,"FIGHT!");
 	actor * act;
-	int isme = 0;
 #ifdef EXTRA_DEBUG
 	ERR();
 #endif
@@ -1933,62 +2298,14 @@ void add_command_to_actor(int actor_id, unsigned char command)
 
 		if(command==leave_combat||command==enter_combat||command==die1||command==die2)
 		{
-			int j= 0;
-
 			//Strip the queue for attack messages
-			for(k=0; k<MAX_CMD_QUEUE; k++){
-				switch(act->que[k]){
-					case pain1:
-					case pain2:
-					case attack_up_1:
-					case attack_up_2:
-					case attack_up_3:
-					case attack_up_4:
-					case attack_down_1:
-					case attack_down_2:
-						act->que[k]= nothing;
-						break;
-
-					default:
-						act->que[j]= act->que[k];
-						j++;
-						if(j<=k){
-							act->que[k]= nothing;
-						}
-						break;
-				}
-			}
+			strip_attack_commands(act);
 
 			if(act->attached_actor>=0) {
 				//strip horse queue too
-				int j=0;
-				actor *horse=actors_list[act->attached_actor];
-				
-			for(k=0; k<MAX_CMD_QUEUE; k++){
-				switch(horse->que[k]){
-					case pain1:
-					case pain2:
-					case attack_up_1:
-					case attack_up_2:
-					case attack_up_3:
-					case attack_up_4:
-					case attack_down_1:
-					case attack_down_2:
-						horse->que[k]= nothing;
-						break;
-
-					default:
-						horse->que[j]= horse->que[k];
-						j++;
-						if(j<=k){
-							horse->que[k]= nothing;
-						}
-						break;
-				}
-			}
+				strip_attack_commands(actors_list[act->attached_actor]);
 			}
-				
-			
+
 
 			if(act->last_command == nothing)
 			{
@@ -2003,6 +2320,34 @@ void add_command_to_actor(int actor_id, unsigned char command)
 			}
 		}
 
+		//if we are SEVERLY behind, drop an emote or update all the actors in range
+		if(act->que_length>MAX_CMD_QUEUE-2){
+			int i;
+			if (max_fps == limit_fps)
+				LOG_ERROR("Too much commands in the queue for actor %d (%s) => skip emotes!",
+					  act->actor_id, act->actor_name);
+			act->que_overflows++;
+			if(!skip_queued_emote(act)){
+				//if we are here no emotes have been skipped
+				if (max_fps == limit_fps)
+				{
+					LOG_ERROR("Too much commands in the queue for actor %d (%s) => resync!\n",
+						act->actor_id, act->actor_name);
+#ifdef	ANIMATION_SCALING
+					LOG_ERROR("animation_scale: %f\n", act->animation_scale);
+#endif	/* ANIMATION_SCALING */
+					for (i = 0; i < act->que_length; ++i)
+						LOG_ERROR("%dth command in the queue: %d\n", i, (int)get_queued_command(act, i));
+				}
+				cmd_queue_resyncs++;
+				update_all_actors(max_fps == limit_fps);
+				// the command is dropped, but the server did move the actor
+				update_async_position(act, command);
+				UNLOCK_ACTORS_LISTS();
+				return;
+			}
+		}
+
 		k = push_command_in_actor_queue(command, act);
 
 		if (act->attached_actor >= 0){
@@ -2022,11 +2367,6 @@ void add_command_to_actor(int actor_id, unsigned char command)
 		}
 		else
 			k2 = k;
-		{
-			actor * me = get_our_actor();
-			if (me!=NULL)
-				isme = act->actor_id == me->actor_id;
-		}
 
 
 		//if(act->actor_id==yourself) printf("COMMAND: %i at pos %i (and %i)\n",command,k,k2);
@@ -2039,22 +2379,20 @@ void add_command_to_actor(int actor_id, unsigned char command)
 			
 			int j=k-1;
 			int j2=k2-1;
-			while(act->que[j]>=turn_n&&act->que[j]<=turn_nw&&j>=0) j--; //skip rotations
+			while(j>=0&&get_queued_command(act, j)>=turn_n&&get_queued_command(act, j)<=turn_nw) j--; //skip rotations
 			if (act->attached_actor >= 0)
-				while(actors_list[act->attached_actor]->que[j2]>=turn_n
-					&&actors_list[act->attached_actor]->que[j2]<=turn_nw
-					&&j2>=0) j2--; //skip rotations for horse
-			if(j>=0&&act->que[j]==leave_combat) {
+				while(j2>=0
+					&&get_queued_command(actors_list[act->attached_actor], j2)>=turn_n
+					&&get_queued_command(actors_list[act->attached_actor], j2)<=turn_nw) j2--; //skip rotations for horse
+			if(j>=0&&get_queued_command(act, j)==leave_combat) {
 				//remove leave_combat and enter_combat
-				act->que[j]=nothing;
-				act->que[k]=nothing;
-				sanitize_cmd_queue(act);
+				remove_queued_command(act, k);
+				remove_queued_command(act, j);
 				//if(act->actor_id==yourself) printf("   actor %s: skipped %i and %i\n",act->actor_name,j,k);
-				if(act->attached_actor >=0&&j2>=0&&actors_list[act->attached_actor]->que[j2]==wait_cmd) {
+				if(act->attached_actor >=0&&j2>=0&&get_queued_command(actors_list[act->attached_actor], j2)==wait_cmd) {
 					//remove leave_combat and enter_combat for horse
-					actors_list[act->attached_actor]->que[j2]=nothing;
-					actors_list[act->attached_actor]->que[k2]=nothing;
-					sanitize_cmd_queue(actors_list[act->attached_actor]);
+					remove_queued_command(actors_list[act->attached_actor], k2);
+					remove_queued_command(actors_list[act->attached_actor], j2);
 					//if(act->actor_id==yourself) printf("   horse %s: skipped %i and %i\n",act->actor_name,j2,k2);
 				}
 			}
@@ -2066,109 +2404,7 @@ void add_command_to_actor(int actor_id, unsigned char command)
 
 
 
-		switch(command) {
-		case enter_combat:
-			act->async_fighting= 1;
-			check_to_auto_disable_ranging_lock();
-			break;
-		case leave_combat:
-			act->async_fighting= 0;
-			break;
-		case move_n:
-		case run_n:
-			act->async_y_tile_pos++;
-			act->async_z_rot= 0;
-			if(isme && pf_follow_path)
-			{
-                if(checkvisitedlist(act->async_x_tile_pos,act->async_y_tile_pos))
-                    pf_destroy_path();
-            }
-			break;
-		case move_ne:
-		case run_ne:
-			act->async_x_tile_pos++;
-			act->async_y_tile_pos++;
-			act->async_z_rot= 45;
-			if(isme && pf_follow_path)
-			{
-                if(checkvisitedlist(act->async_x_tile_pos,act->async_y_tile_pos))
-                    pf_destroy_path();
-            }
-			break;
-		case move_e:
-		case run_e:
-			act->async_x_tile_pos++;
-			act->async_z_rot= 90;
-			if(isme && pf_follow_path)
-			{
-                if(checkvisitedlist(act->async_x_tile_pos,act->async_y_tile_pos))
-                    pf_destroy_path();
-            }
-			break;
-		case move_se:
-		case run_se:
-			act->async_x_tile_pos++;
-			act->async_y_tile_pos--;
-			act->async_z_rot= 135;
-			if(isme && pf_follow_path)
-			{
-                if(checkvisitedlist(act->async_x_tile_pos,act->async_y_tile_pos))
-                    pf_destroy_path();
-            }
-			break;
-		case move_s:
-		case run_s:
-			act->async_y_tile_pos--;
-			act->async_z_rot= 180;
-			if(isme && pf_follow_path)
-			{
-                if(checkvisitedlist(act->async_x_tile_pos,act->async_y_tile_pos))
-                    pf_destroy_path();
-            }
-			break;
-		case move_sw:
-		case run_sw:
-			act->async_x_tile_pos--;
-			act->async_y_tile_pos--;
-			act->async_z_rot= 225;
-			if(isme && pf_follow_path)
-			{
-                if(checkvisitedlist(act->async_x_tile_pos,act->async_y_tile_pos))
-                    pf_destroy_path();
-            }
-			break;
-		case move_w:
-		case run_w:
-			act->async_x_tile_pos--;
-			act->async_z_rot= 270;
-			if(isme && pf_follow_path)
-			{
-                if(checkvisitedlist(act->async_x_tile_pos,act->async_y_tile_pos))
-                    pf_destroy_path();
-            }
-			break;
-		case move_nw:
-		case run_nw:
-			act->async_x_tile_pos--;
-			act->async_y_tile_pos++;
-			act->async_z_rot= 315;
-			if(isme && pf_follow_path)
-			{
-                if(checkvisitedlist(act->async_x_tile_pos,act->async_y_tile_pos))
-                    pf_destroy_path();
-            }
-			break;
-		case turn_n:
-		case turn_ne:
-		case turn_e:
-		case turn_se:
-		case turn_s:
-		case turn_sw:
-		case turn_w:
-		case turn_nw:
-			 act->async_z_rot= (command-turn_n)*45;
-			 break;
-		}
+		update_async_position(act, command);
 
 		if (k != k2) {
 			LOG_ERROR("Inconsistency between queues of attached actors %s (%d) and %s (%d)!",
@@ -2177,41 +2413,6 @@ void add_command_to_actor(int actor_id, unsigned char command)
 					  actors_list[act->attached_actor]->actor_name,
 					  actors_list[act->attached_actor]->actor_id);
 		}
-		else
-		if(k>MAX_CMD_QUEUE-2){
-			int i;
-			int k;
-			if (max_fps == limit_fps)
-				LOG_ERROR("Too much commands in the queue for actor %d (%s) => skip emotes!",
-					  act->actor_id, act->actor_name);
-			for(i=MAX_CMD_QUEUE-1;i>=0;i--) {
-				if(act->que[i]>=emote_cmd&&act->que[i]<wait_cmd) {
-					//skip this emote
-					for(k=i;k<MAX_CMD_QUEUE-1;k++) {
-						act->que[k]=act->que[k+1];
-						if(act->attached_actor>=0)
-						actors_list[act->attached_actor]->que[k]=actors_list[act->attached_actor]->que[k+1];
-					}
-					act->que[k]=nothing;
-					actors_list[act->attached_actor]->que[k]=nothing;
-					add_command_to_actor(actor_id,command); //RECURSIVE!!!! should be done only one time
-					UNLOCK_ACTORS_LISTS();
-					return;
-				}
-			}
-			//if we are here no emotes have been skipped
-			if (max_fps == limit_fps)
-			{
-				LOG_ERROR("Too much commands in the queue for actor %d (%s) => resync!\n",
-					act->actor_id, act->actor_name);
-#ifdef	ANIMATION_SCALING
-				LOG_ERROR("animation_scale: %f\n", act->animation_scale);
-#endif	/* ANIMATION_SCALING */
-				for (i = 0; i < MAX_CMD_QUEUE; ++i)
-					LOG_ERROR("%dth command in the queue: %d\n", i, (int)act->que[i]);
-			}
-			update_all_actors(max_fps == limit_fps);
-		}
 	}
 	UNLOCK_ACTORS_LISTS();
 }
@@ -2783,6 +2984,7 @@ int read_emotes_defs(const char *dir, const char *index)
 	int ok = 1;
 
 	safe_snprintf(fname, sizeof(fname), "%s/%s", dir, index);
+	record_actor_def_file(fname);
 
 	doc = xmlReadFile(fname, NULL, 0);
 	if (doc == NULL) {
@@ -3767,6 +3969,7 @@ struct cal_anim cal_load_idle(actor_types *act, char *str)
 	struct CalCoreAnimation *coreanim;
 
 	res.anim_index=CalCoreModel_ELLoadCoreAnimation(act->coremodel,str,act->scale);
+	record_actor_def_load(act, ACTOR_DEF_LOAD_ANIMATION, str, act->scale, res.anim_index);
 	if(res.anim_index == -1) {
 		LOG_ERROR("Cal3d error: %s: %s\n", str, CalError_GetLastErrorDescription());
 		return res;
@@ -4293,6 +4496,7 @@ int cal_load_mesh(actor_types *act, const char *fn, const char *kind)
 
 	//Load coremesh
 	res=CalCoreModel_ELLoadCoreMesh(act->coremodel,fn);
+	record_actor_def_load(act, ACTOR_DEF_LOAD_MESH, fn, act->mesh_scale, res);
 
 	//Scale coremesh
 	if (res >= 0) {
@@ -4322,6 +4526,7 @@ int cal_load_weapon_mesh (actor_types *act, const char *fn, const char *kind)
 
 	//Load coremesh
 	res=CalCoreModel_ELLoadCoreMesh(act->coremodel,fn);
+	record_actor_def_load(act, ACTOR_DEF_LOAD_MESH, fn, act->skel_scale, res);
 
 	//Scale coremesh
 	if (res>=0) {
@@ -4372,6 +4577,7 @@ int parse_actor_nodes(actor_types *act, const xmlNode *cfg, const xmlNode *defau
 				else {
 					act->skeleton_type = get_skeleton(act->coremodel, skeleton_name);
 				}
+				record_actor_def_load(act, ACTOR_DEF_LOAD_SKELETON, skeleton_name, 1.0f, act->skeleton_type);
 			} else if (!strcmp(name, "walk_speed")) { // unused
 				act->walk_speed= get_float_value(item);
 			} else if (!strcmp(name, "run_speed")) { // unused
@@ -4515,6 +4721,7 @@ int parse_actor_script(const xmlNode *cfg)
 		skel=CalCoreModel_GetCoreSkeleton(act->coremodel);
 		if(skel){
 			CalCoreSkeleton_Scale(skel,act->skel_scale);
+			record_actor_def_load(act, ACTOR_DEF_SCALE_SKELETON, NULL, act->skel_scale, 0);
 		}
 
 		// If this not an enhanced actor, load the single mesh and exit
@@ -4759,12 +4966,14 @@ int read_actor_defs (const char *dir, const char *index)
 	int ok = 1;
 
 	safe_snprintf (fname, sizeof(fname), "%s/%s", dir, index);
+	record_actor_def_file (fname);
 
 	doc = xmlReadFile (fname, NULL, XML_PARSE_NOENT);
 	if (doc == NULL) {
 		LOG_ERROR("Unable to read actor definition file %s", fname);
 		return 0;
 	}
+	record_actor_def_entities (doc);
 
 	root = xmlDocGetRootElement (doc);
 	if (root == NULL) {
@@ -4802,6 +5011,9 @@ void init_actor_defs()
 void free_actor_defs()
 {
 	int i;
+	// the skinning data and the poses point into the core models
+	clear_skinning_data();
+	clear_pose_cache();
 	for (i=0; i<MAX_ACTOR_DEFS; i++)
 	{
 		if (actors_defs[i].head)
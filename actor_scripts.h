@@ -9,11 +9,42 @@
 #include <SDL_types.h>
 
 #include "actors.h"			// Should we just move the function that needs this include away?
+#ifdef EXT_ACTOR_DICT
+#include "asc.h"
+#endif // EXT_ACTOR_DICT
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+#ifndef	DYNAMIC_ANIMATIONS
+extern int parallel_animation; /*!< if set, \ref animate_actors updates the skeletons on the worker threads */
+
+/*!
+ * \name Animation level of detail
+ * \brief How often the skeleton of an actor is updated.
+ */
+/*! \{ */
+#define ANIMATION_LOD_FULL	0	/*!< every frame, used near you */
+#define ANIMATION_LOD_REDUCED	1	/*!< about 15 times a second, between the near and far distance */
+#define ANIMATION_LOD_LOW	2	/*!< about 5 times a second, beyond the far distance */
+#define ANIMATION_LOD_FROZEN	3	/*!< not at all, the actor is out of view */
+#define ANIMATION_LOD_COUNT	4
+/*! \} */
+
+extern int animation_lod; /*!< if set, far and hidden actors are animated at lower rates */
+extern float animation_lod_near_distance; /*!< actors closer than this are animated every frame */
+extern float animation_lod_far_distance; /*!< actors farther than this are animated at the lowest visible rate */
+
+/*!
+ * \ingroup	move_actors
+ * \brief	Gets how many actors were in each animation level of detail in the last frame.
+ * \param	counts the number of actors, ANIMATION_LOD_COUNT values
+ * \param	updates the number of skeletons updated in the last frame, may be NULL
+ */
+void get_animation_lod_stats(Uint32 *counts, Uint32 *updates);
+#endif	//DYNAMIC_ANIMATIONS
+
 /*!
  * \ingroup	move_actors
  * \brief	Gives the motion vector of an actor for a given move.
@@ -43,6 +74,7 @@ void move_to_next_frame();
  *
  * 		This function is called from the display/network loop, when the timer thread calls SDL_PushEvent EVENT_ANIMATE_ACTORS.
  * 		It's purpose is to animate the actors - that is, to change their x,y,z positions according to their current movement frames
+ * 		The skeletons are updated afterwards, spread over the worker threads if \ref parallel_animation is set.
  *
  */
 void animate_actors();
@@ -119,6 +151,8 @@ void update_all_actors(int log_the_update);
  */
 void add_command_to_actor(int actor_id, unsigned char command);
 
+extern Uint32 cmd_queue_resyncs; /*!< how often a full command queue made all actors update */
+
 void add_emote_command_to_actor(actor * act, emote_data *emote);
 void add_emote_to_actor(int actor_id, int emote_id);
 
@@ -199,6 +233,29 @@ int read_emotes_defs(const char *dir, const char *index);
 
 void free_emotes();
 
+/*!
+ * \ingroup other
+ * \brief adds a new emote to the emotes table
+ *
+ * \param id the emote id
+ * \retval emote_data* the emote, with the default values
+ */
+emote_data *new_emote(int id);
+
+extern int actor_part_sizes[ACTOR_NUM_PARTS]; /*!< number of elements of each part array of the actor types */
+
+#ifdef EXT_ACTOR_DICT
+#define MAX_SKIN_COLORS 7
+#define MAX_GLOW_MODES 5
+#define MAX_HEAD_NUMBERS 5
+extern dict_elem skin_color_dict[MAX_SKIN_COLORS];
+extern dict_elem head_number_dict[MAX_GLOW_MODES];
+extern dict_elem glow_mode_dict[MAX_HEAD_NUMBERS];
+extern int num_skin_colors;
+extern int num_head_numbers;
+extern int num_glow_modes;
+#endif // EXT_ACTOR_DICT
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
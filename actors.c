@@ -43,6 +43,7 @@
 
 actor *actors_list[MAX_ACTORS];
 int max_actors=0;
+static Uint16 actor_id_index[ACTOR_ID_INDEX_SIZE];	//position in the actors_list + 1 of each server actor id, 0 if none
 SDL_mutex *actors_lists_mutex = NULL;	//used for locking between the timer and main threads
 actor *your_actor = NULL;
 
@@ -109,9 +110,77 @@ void init_actors_lists()
 	LOCK_ACTORS_LISTS();	//lock it to avoid timing issues
 	for (i=0; i < MAX_ACTORS; i++)
 		actors_list[i] = NULL;
+	memset(actor_id_index, 0, sizeof(actor_id_index));
 	UNLOCK_ACTORS_LISTS();	// release now that we are done
 }
 
+//  Assumed LOCK_ACTORS_LISTS mutex already held
+void add_actor_to_id_index(int pos)
+{
+	int actor_id;
+	int old_pos;
+
+	if (actors_list[pos] == NULL)
+		return;
+
+	actor_id = actors_list[pos]->actor_id;
+	if ((actor_id < 0) || (actor_id >= ACTOR_ID_INDEX_SIZE))
+		return;
+
+	// like the scan it replaces, keep the first actor with a shared id
+	old_pos = actor_id_index[actor_id] - 1;
+	if ((old_pos >= 0) && (old_pos < pos) && actors_list[old_pos] &&
+		(actors_list[old_pos]->actor_id == actor_id))
+		return;
+
+	actor_id_index[actor_id] = pos + 1;
+}
+
+//  Assumed LOCK_ACTORS_LISTS mutex already held
+void remove_actor_from_id_index(int pos)
+{
+	int actor_id;
+	int i;
+
+	if (actors_list[pos] == NULL)
+		return;
+
+	actor_id = actors_list[pos]->actor_id;
+	if ((actor_id < 0) || (actor_id >= ACTOR_ID_INDEX_SIZE) || (actor_id_index[actor_id] != pos + 1))
+		return;
+
+	actor_id_index[actor_id] = 0;
+
+	// the server ids are unique, but a local actor may share one
+	for (i = 0; i < max_actors; i++)
+		if ((i != pos) && actors_list[i] && (actors_list[i]->actor_id == actor_id))
+		{
+			actor_id_index[actor_id] = i + 1;
+			break;
+		}
+}
+
+//  Assumed LOCK_ACTORS_LISTS mutex already held
+void clear_actor_id_index(void)
+{
+	memset(actor_id_index, 0, sizeof(actor_id_index));
+}
+
+int get_actor_index_from_id(int actor_id)
+{
+	int i;
+
+	if ((actor_id >= 0) && (actor_id < ACTOR_ID_INDEX_SIZE))
+		return actor_id_index[actor_id] - 1;
+
+	// negative ids are the attached actors, they are not indexed
+	for (i = 0; i < max_actors; i++)
+		if (actors_list[i] && (actors_list[i]->actor_id == actor_id))
+			return i;
+
+	return -1;
+}
+
 //return the ID (number in the actors_list[]) of the new allocated actor
 int add_actor (int actor_type, char * skin_name, float x_pos, float y_pos, float z_pos, float z_rot, float scale, char remappable, short skin_color, short hair_color, short eyes_color, short shirt_color, short pants_color, short boots_color, int actor_id)
 {
@@ -201,7 +270,8 @@ int add_actor (int actor_type, char * skin_name, float x_pos, float y_pos, float
 	our_actor->has_alpha = get_texture_alpha(texture_id);
 
 	//clear the que
-	for(k=0;k<MAX_CMD_QUEUE;k++)	our_actor->que[k]=nothing;
+	our_actor->que_head=0;
+	our_actor->que_length=0;
 	//clear emotes
 	for(k=0;k<MAX_EMOTE_QUEUE;k++)	{
 		our_actor->emote_que[k].emote=NULL;
@@ -254,6 +324,7 @@ int add_actor (int actor_type, char * skin_name, float x_pos, float y_pos, float
 
 	actors_list[i]=our_actor;
 	if(i>=max_actors)max_actors=i+1;
+	add_actor_to_id_index(i);
 
 	//It's unlocked later
 
@@ -266,12 +337,9 @@ void add_actor_attachment(int actor_id, int attachment_type)
 	int i;
 	actor *parent = NULL;
 
-	for (i = 0; i < max_actors; ++i)
-		if (actors_list[i]->actor_id == actor_id)
-		{
-			parent = actors_list[i];
-			break;
-		}
+	i = get_actor_index_from_id(actor_id);
+	if (i >= 0)
+		parent = actors_list[i];
 
 	if (!parent)
 		LOG_ERROR("unable to add an attached actor: actor with id %d doesn't exist!", actor_id);
@@ -344,8 +412,8 @@ void remove_actor_attachment(int actor_id)
 
 	LOCK_ACTORS_LISTS();
 
-	for (i = 0; i < max_actors; ++i)
-		if (actors_list[i]->actor_id == actor_id)
+	i = get_actor_index_from_id(actor_id);
+	if (i >= 0)
 		{
 			int att = actors_list[i]->attached_actor;
 			actors_list[i]->attached_actor = -1;
@@ -354,6 +422,7 @@ void remove_actor_attachment(int actor_id)
 			actors_list[i]->attachment_shift[2] = 0.0;
 			free_actor_special_effect(actors_list[att]->actor_id);
 			free_actor_data(att);
+			remove_actor_from_id_index(att);
 			free(actors_list[att]);
 			actors_list[att]=NULL;
 			if(att==max_actors-1)max_actors--;
@@ -362,10 +431,10 @@ void remove_actor_attachment(int actor_id)
 				max_actors--;
 				actors_list[att]=actors_list[max_actors];
 				actors_list[max_actors]=NULL;
+				add_actor_to_id_index(att);
 				if (actors_list[att] && actors_list[att]->attached_actor >= 0)
 					actors_list[actors_list[att]->attached_actor]->attached_actor = att;
 			}
-			break;
 		}
 
 	UNLOCK_ACTORS_LISTS();
@@ -1167,6 +1236,7 @@ void get_actors_in_range()
 				}
 
 				actors_list[i]->max_z = actors_list[i]->bbox.bbmax[Z];
+				actors_list[i]->last_visible_time = cur_time;
 
 				if (read_mouse_now && (get_cur_intersect_type(main_bbox_tree) == INTERSECTION_TYPE_DEFAULT))
 				{
@@ -1553,15 +1623,10 @@ void add_actor_from_server (const char *in_data, int len)
 	//find out if there is another actor with that ID
 	//ideally this shouldn't happen, but just in case
 
-	for(i=0;i<max_actors;i++)
+	while ((i = get_actor_index_from_id(actor_id)) >= 0)
 		{
-			if(actors_list[i])
-				if(actors_list[i]->actor_id==actor_id)
-					{
-						LOG_ERROR(duplicate_actors_str,actor_id, actors_list[i]->actor_name, &in_data[17]);
-						destroy_actor(actors_list[i]->actor_id);//we don't want two actors with the same ID
-						i--;// last actor was put here, he needs to be checked too
-					}
+			LOG_ERROR(duplicate_actors_str,actor_id, actors_list[i]->actor_name, &in_data[17]);
+			destroy_actor(actor_id);//we don't want two actors with the same ID
 		}
 
 	i= add_actor(actor_type, actors_defs[actor_type].skin_name, f_x_pos, f_y_pos, 0.0, f_z_rot, scale, 0, 0, 0, 0, 0, 0, 0, actor_id);
@@ -1688,13 +1753,9 @@ void	add_displayed_text_to_actor( actor * actor_ptr, const char* text )
 //--- LoganDugenoux [5/25/2004]
 actor *	get_actor_ptr_from_id( int actor_id )
 {
-	int i;
-	for (i = 0; i < max_actors; i++)
-	{
-		if (actors_list[i]->actor_id == actor_id)
-			return actors_list[i];
-	}
-	return NULL;
+	int i = get_actor_index_from_id(actor_id);
+
+	return (i >= 0) ? actors_list[i] : NULL;
 }
 
 void end_actors_lists()
@@ -1706,7 +1767,7 @@ void end_actors_lists()
 
 int on_the_move (const actor *act){
 	if (act == NULL) return 0;
-	return act->moving || (act->que[0] >= move_n && act->que[0] <= move_nw);
+	return act->moving || (get_queued_command(act, 0) >= move_n && get_queued_command(act, 0) <= move_nw);
 }
 
 void get_actor_rotation_matrix(actor *in_act, float *out_rot)
@@ -1833,18 +1894,16 @@ void check_if_new_actor_last_summoned(actor *new_actor)
 // Return the id of the last sucessful summoned creature, if its still present
 int get_id_last_summoned(void)
 {
-	size_t i;
+	int i;
 	if (last_summoned_var.actor_id < 0)
 		return -1;
 
 	// check if the actor is still present
 	LOCK_ACTORS_LISTS();
-	for (i=0; i<max_actors; i++)
-		if (actors_list[i]->actor_id == last_summoned_var.actor_id)
-			break;
+	i = get_actor_index_from_id(last_summoned_var.actor_id);
 	UNLOCK_ACTORS_LISTS();
 
-	if (i == max_actors)
+	if (i < 0)
 		last_summoned_var.actor_id = -1;
 	return last_summoned_var.actor_id;
 }
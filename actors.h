@@ -28,6 +28,7 @@ extern "C" {
 #define	MAX_FILE_PATH	128	// the max chars allowed int a path/filename for actor textures/masks
 #define MAX_ACTOR_DEFS  256
 #define MAX_ACTORS      1000    /*!< The maximum number of actors the client can hold */
+#define ACTOR_ID_INDEX_SIZE	32768	/*!< server actor ids below this are found by \ref get_actor_index_from_id without a search */
 #define ACTOR_DEF_NAME_SIZE 256
 
 extern int yourself; 	/*!< This variable holds the actor_id (as the server sees it, not the position in the actors_list) of your character.*/
@@ -490,7 +491,10 @@ typedef struct _emote_command {
 #define EMOTE_MOTION(act) ((act->buffs & BUFF_DOUBLE_SPEED) ? (EMOTE_RUNNING):(EMOTE_WALKING))
 
 /*! The main actor structure.*/
-#define	MAX_CMD_QUEUE	31
+#define	MAX_CMD_QUEUE	31	/* one less than a power of two, it masks the slots of the command ring */
+#if ((MAX_CMD_QUEUE + 1) & MAX_CMD_QUEUE) != 0
+#error MAX_CMD_QUEUE + 1 must be a power of two
+#endif
 #define MAX_RANGE_ACTION_QUEUE 16
 #define MAX_ITEM_CHANGES_QUEUE 16
 typedef struct
@@ -522,6 +526,14 @@ typedef struct
 	Uint32	last_anim_update;
 	AABBOX bbox;
 
+	/*! \name Animation level of detail */
+	/*! \{ */
+	int animation_lod;		/*!< How often the skeleton is updated, one of the ANIMATION_LOD_* values */
+	float animation_lod_step;	/*!< The animation time in seconds that is not yet applied to the skeleton */
+	Uint32 last_skeleton_update;	/*!< When the skeleton was updated last */
+	Uint32 last_visible_time;	/*!< When the actor was inside a view frustum last */
+	/*! \} */
+
 	/*! \name Range mode parameters */
 	/*! \{ */
 	float cal_h_rot_start;    /*!< The starting horizontal rotation */
@@ -590,7 +602,11 @@ typedef struct
 
 	/*! \name Command queue and current animations*/
 	/*! \{ */
-	actor_commands que[MAX_CMD_QUEUE+1];	/*!< Holds the current command queue*/
+	actor_commands que[MAX_CMD_QUEUE+1];	/*!< Ring buffer of the command queue, read it with get_queued_command()*/
+	Uint8 que_head;		/*!< The slot of the next command in que*/
+	Uint8 que_length;	/*!< The number of queued commands*/
+	Uint8 que_max_length;	/*!< The longest the queue was since the statistics were reset*/
+	Uint32 que_overflows;	/*!< The commands that found the queue full*/
 #ifdef	ANIMATION_SCALING
 	float animation_scale;			/*!< scale factor for animations */
 #endif	/* ANIMATION_SCALING */
@@ -792,6 +808,46 @@ void	add_displayed_text_to_actor( actor * actor_ptr, const char* text);
  */
 actor *	get_actor_ptr_from_id( int actor_id );
 
+/*!
+ * \ingroup	misc_utils
+ * \brief	Gets the position in the actors_list of the actor given by the actor_id
+ *
+ * 		Server ids are looked up in an index that is kept up to date when
+ * 		actors are added, moved or removed, other ids are searched for.
+ *
+ * \param	actor_id The server-side actor_id
+ * \retval int	The position in the actors_list, -1 if the actor is not found
+ * \pre		The actors lists must be locked, or the caller must be the main thread
+ * \sa		get_actor_ptr_from_id
+ */
+int get_actor_index_from_id(int actor_id);
+
+/*!
+ * \ingroup	misc_utils
+ * \brief	Adds the actor at the given position of the actors_list to the id index
+ *
+ * 		If actors share the id, the index keeps the one first in the actors_list.
+ *
+ * \param	pos The position in the actors_list
+ * \pre		The actors lists must be locked
+ */
+void add_actor_to_id_index(int pos);
+
+/*!
+ * \ingroup	misc_utils
+ * \brief	Removes the actor at the given position of the actors_list from the id index
+ * \param	pos The position in the actors_list, the actor must still be there
+ * \pre		The actors lists must be locked
+ */
+void remove_actor_from_id_index(int pos);
+
+/*!
+ * \ingroup	misc_utils
+ * \brief	Removes all actors from the id index
+ * \pre		The actors lists must be locked
+ */
+void clear_actor_id_index(void);
+
 void end_actors_lists(void);
 
 int on_the_move (const actor *act);
@@ -847,6 +903,19 @@ static __inline__ float get_actor_z(actor *a)
 	return get_tile_height(a->x_tile_pos, a->y_tile_pos);
 }
 
+/*!
+ * \brief Get a command from the queue of an actor
+ * \param a the actor
+ * \param k the position in the queue, 0 is the next command
+ * \return the command, or nothing if fewer commands are queued
+ */
+static __inline__ actor_commands get_queued_command(const actor *a, int k)
+{
+	if (k < 0 || k >= a->que_length)
+		return nothing;
+	return a->que[(a->que_head + k) & MAX_CMD_QUEUE];
+}
+
 /*!
  * \brief Get the scale factor of an actor
  * \param a the actor
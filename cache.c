@@ -11,27 +11,23 @@
 #include "text.h"
 #include "textures.h"
 #include "translate.h"
+#include "hash.h"
 
 cache_struct *cache_system = NULL;
 cache_struct *cache_e3d = NULL;
 
 static Uint32 cache_system_clean();
 static Uint32 cache_system_compact();
-static Uint32 cache_clean(cache_struct *cache);
-static Uint32 cache_compact(cache_struct *cache);
+static Uint32 cache_expire(cache_struct *cache);
+static void cache_enforce_size_limit(cache_struct *cache);
 static cache_item_struct *cache_find_ptr(cache_struct *cache, const void *item);
 static void cache_remove(cache_struct *cache, cache_item_struct *item);
 static void cache_remove_all(cache_struct *cache);
 
-#ifdef FASTER_MAP_LOAD
-// Compare string \a str with the name of item \a iptr.
-static int cache_item_cmp_str(const void* str, const void *iptr)
+static __inline__ Uint32 cache_ptr_hash(const void *item)
 {
-	const cache_item_struct *item = *((const cache_item_struct **)iptr);
-	if (!item) return -1;
-	return strcmp(str, item->name);
+	return ((Uint32)(((size_t)item) >> 4)) * 2654435761u;
 }
-#endif
 
 // top level cache system routines
 void cache_system_init(Uint32 max_items)
@@ -46,15 +42,12 @@ void cache_dump_sizes(const cache_struct *cache)
 	char str[256];
 	const cache_item_struct *item;
 	Sint32 i;
+	Uint32 bucket;
 
-#ifdef FASTER_MAP_LOAD
-	for (i = 0; i < cache->num_items; i++)
-#else
-	for (i = 0; i < cache->max_item; i++)
-#endif
+	i = 0;
+	for (bucket = 0; bucket <= cache->table_mask; bucket++)
 	{
-		item = cache->cached_items[i];
-		if (item)
+		for (item = cache->name_table[bucket]; item; item = item->name_next)
 		{
 			Uint8 scale = ' ';
 			Uint32 size = item->size;
@@ -71,12 +64,9 @@ void cache_dump_sizes(const cache_struct *cache)
 			if(cache==cache_system)
 			{
 				cache_struct *temp = item->cache_item;
-				safe_snprintf(str, sizeof(str), "%s %6d%c - %d: %s (%d %s)",
-#ifdef FASTER_MAP_LOAD
-					cache_size_str, size, scale, i, item->name, temp->num_items, cache_items_str);
-#else
-					cache_size_str, size, scale, i, item->name, temp->max_item, cache_items_str);
-#endif
+				safe_snprintf(str, sizeof(str), "%s %6d%c - %d: %s (%d %s, %u hits, %u misses, %u evictions, %u expirations)",
+					cache_size_str, size, scale, i, item->name, temp->num_items, cache_items_str,
+					temp->hits, temp->misses, temp->evictions, temp->expirations);
 			}
 			else
 				safe_snprintf(str, sizeof(str), "%s %6d%c - %d: %s",
@@ -87,6 +77,7 @@ void cache_dump_sizes(const cache_struct *cache)
 #else
 			write_to_log(CHAT_SERVER, (unsigned char*)str, strlen(str));
 #endif
+			i++;
 		}
 	}
 }
@@ -108,24 +99,23 @@ void cache_system_maint()
 static Uint32 cache_system_clean()
 {
 	cache_item_struct *item;
-	Sint32 i;
+	Uint32 bucket;
 	Uint32 mem_freed = 0;
 
 	if (!cache_system || !cache_system->time_limit
-		|| !cache_system->cached_items) return 0;
+		|| !cache_system->name_table) return 0;
 	// make sure we are in a safe place
 #ifdef	ELC
 	if ( !get_show_window (game_root_win) ) return 0;
 #endif	/* ELC */
-#ifdef FASTER_MAP_LOAD
-	for (i = 0; i < cache_system->num_items; i++)
-#else
-	for (i = 0; i < cache_system->max_item; i++)
-#endif
+	for (bucket = 0; bucket <= cache_system->table_mask; bucket++)
 	{
-		item = cache_system->cached_items[i];
-		if (item && item->cache_item)
-			mem_freed += cache_clean(item->cache_item);
+		for (item = cache_system->name_table[bucket]; item; item = item->name_next)
+		{
+			cache_struct *cache = item->cache_item;
+			if (cache && cache->free_item)
+				mem_freed += cache_expire(cache);
+		}
 	}
 
 	//adjust the LRU time-stamp
@@ -137,21 +127,20 @@ static Uint32 cache_system_clean()
 static Uint32 cache_system_compact()
 {
 	cache_item_struct *item;
-	Sint32 i;
+	Uint32 bucket;
 	Uint32 mem_freed = 0;
 
 	if (!cache_system || !cache_system->time_limit
-		|| !cache_system->cached_items) return 0;
+		|| !cache_system->name_table) return 0;
 
-#ifdef FASTER_MAP_LOAD
-	for (i = 0; i < cache_system->num_items; i++)
-#else
-	for (i = 0; i < cache_system->max_item; i++)
-#endif
+	for (bucket = 0; bucket <= cache_system->table_mask; bucket++)
 	{
-		item = cache_system->cached_items[i];
-		if (item && item->cache_item)
-			mem_freed += cache_compact(item->cache_item);
+		for (item = cache_system->name_table[bucket]; item; item = item->name_next)
+		{
+			cache_struct *cache = item->cache_item;
+			if (cache && !cache->free_item && cache->compact_item)
+				mem_freed += cache_expire(cache);
+		}
 	}
 
 	//adjust the LRU time-stamp
@@ -165,27 +154,38 @@ cache_struct *cache_init(const char* name, Uint32 max_items,
 	void (*free_item)())
 {
 	cache_struct *cache;
+	Uint32 table_size;
 
 	cache = calloc(1, sizeof(cache_struct));
 	if(!cache)
 		return NULL;	//oops, not enough memory
 
-	cache->cached_items = calloc(max_items, sizeof(cache_item_struct *));
-	if (!cache->cached_items)
+	// keep the hash chains short
+	table_size = 16;
+	while (table_size < max_items * 2)
+		table_size *= 2;
+
+	cache->name_table = calloc(table_size, sizeof(cache_item_struct *));
+	cache->ptr_table = calloc(table_size, sizeof(cache_item_struct *));
+	if (!cache->name_table || !cache->ptr_table)
 	{
+		free(cache->name_table);
+		free(cache->ptr_table);
 		free(cache);
 		return NULL;	//oops, not enough memory
 	}
+	cache->table_mask = table_size - 1;
 	cache->recent_item = NULL;
 	cache->num_allocated = max_items;
 	cache->LRU_time = cur_time;
 	cache->time_limit = 0;	// 0 == no time based LRU check
+	cache->size_limit = 0;	// 0 == no size limit
 	cache->free_item = free_item;
 	cache->compact_item = NULL;
 	if (cache_system)
 	{
 		cache_add_item(cache_system, name, cache,
-			sizeof(cache_struct) + max_items*sizeof(cache_item_struct *));
+			sizeof(cache_struct) + 2*table_size*sizeof(cache_item_struct *));
 	}
 
 	//all done, send the data back
@@ -197,11 +197,13 @@ void cache_delete(cache_struct *cache)
 	static int cache_delete_loop_block = 0;
 
 	if (!cache) return;
-	if (cache->cached_items)
+	if (cache->name_table)
 	{
 		cache_remove_all(cache);
-		free(cache->cached_items);
-		cache->cached_items = NULL;	//failsafe
+		free(cache->name_table);
+		free(cache->ptr_table);
+		cache->name_table = NULL;	//failsafe
+		cache->ptr_table = NULL;	//failsafe
 		cache->recent_item = NULL;	//failsafe
 	}
 	if (cache_system && cache != cache_system && !cache_delete_loop_block)
@@ -227,33 +229,55 @@ void cache_set_time_limit(cache_struct *cache, Uint32 time_limit)
 	cache->time_limit=time_limit;
 }
 
-static Uint32 cache_clean(cache_struct *cache)
+void cache_set_size_limit(cache_struct *cache, Uint32 size_limit)
+{
+	cache->size_limit=size_limit;
+	cache_enforce_size_limit(cache);
+}
+
+// frees or compacts the least recently used item, returns the memory freed
+static Uint32 cache_release(cache_struct *cache, cache_item_struct *item)
+{
+	Uint32 freed;
+
+	if (cache->free_item)
+	{
+		freed = item->size;
+		cache_remove(cache, item);
+		return freed;
+	}
+
+	// compacted items only go back into the LRU list when used again
+	cache_lru_unlink(item);
+
+	if (!cache->compact_item || !item->size)
+		return 0;
+
+	freed = (*cache->compact_item)(item->cache_item);
+	if (freed)
+	{
+		if (cache != cache_system)
+			cache_adj_size(cache_system, -freed, cache);
+		item->size -= freed;
+		cache->total_size -= freed;
+	}
+	return freed;
+}
+
+// walks the LRU list from the oldest item, until an item is recent enough
+static Uint32 cache_expire(cache_struct *cache)
 {
 	cache_item_struct *item;
-	Sint32 i;
 	Uint32 mem_freed = 0;
 
-	if (!cache->cached_items || !cache->time_limit || !cache->free_item)
+	if (!cache->name_table || !cache->time_limit)
 		return 0;
 
-#ifdef FASTER_MAP_LOAD
-	for (i = cache->num_items-1; i >= 0; i--)
-#else
-	for (i = 0; i < cache->max_item; i++)
-#endif
+	while ((item = cache->lru_tail) != NULL
+		&& item->access_time + cache->time_limit < cur_time)
 	{
-		item = cache->cached_items[i];
-		if (item && item->cache_item)
-		{
-			// decide if this entry needs to be cleaned
-			if (item->access_count == 0
-				&& item->access_time + cache->time_limit < cur_time)
-			{
-				cache_remove(cache, item);
-				mem_freed += item->size;
-			}
-			//item->access_count=0;
-		}
+		mem_freed += cache_release(cache, item);
+		cache->expirations++;
 	}
 
 	//adjust the LRU time-stamp
@@ -262,47 +286,32 @@ static Uint32 cache_clean(cache_struct *cache)
 	return mem_freed;
 }
 
-static Uint32 cache_compact(cache_struct *cache)
+Uint32 cache_release_lru(cache_struct *cache, Uint32 size, Uint32 time)
 {
 	cache_item_struct *item;
-	Sint32 i;
-	Uint32 freed;
-	Uint32 mem_freed=0;
+	Uint32 freed, mem_freed = 0;
 
-	if (!cache->cached_items || !cache->time_limit || !cache->compact_item)
-		return 0;
-
-#ifdef FASTER_MAP_LOAD
-	for (i = 0; i < cache->num_items; i++)
-#else
-	for (i = 0; i < cache->max_item; i++)
-#endif
+	while (mem_freed < size
+		&& (item = cache->lru_tail) != NULL
+		&& item->access_time < time)
 	{
-		item = cache->cached_items[i];
-		if (item && item->cache_item)
-		{
-			//decide if this entry needs to be cleaned
-			if (item->access_count == 0
-				&& item->access_time + cache->time_limit < cur_time)
-			//if(cache->cached_items[i]->access_time+cache->time_limit < cur_time)
-			{
-				freed = (*cache->compact_item)(cache->cached_items[i]->cache_item);
-				mem_freed += freed;
-				cache_adj_size(cache, -freed, cache->cached_items[i]->cache_item);
-			}
-			else
-			{
-				cache->cached_items[i]->access_count = 0;	// clear the counter
-			}
-		}
+		freed = cache_release(cache, item);
+		if (freed)
+			cache->evictions++;
+		mem_freed += freed;
 	}
 
-	//adjust the LRU time-stamp
-	cache->LRU_time = cur_time;
-	//return how much memory was freed
 	return mem_freed;
 }
 
+static void cache_enforce_size_limit(cache_struct *cache)
+{
+	if (!cache->size_limit || cache->total_size <= cache->size_limit)
+		return;
+
+	// never release items used right now, they might be in use
+	cache_release_lru(cache, cache->total_size - cache->size_limit, cur_time);
+}
 
 #ifndef	USE_INLINE
 // detailed items
@@ -312,61 +321,49 @@ void cache_use(cache_item_struct *item_ptr)
 	{
 		item_ptr->access_time = cur_time;
 		item_ptr->access_count++;
+		cache_lru_push_front(item_ptr);
 	}
 }
 #endif	//USE_INLINE
 
 cache_item_struct *cache_find(cache_struct *cache, const char *name)
 {
-#ifdef FASTER_MAP_LOAD
-	cache_item_struct **item;
-#else
-	Sint32 i;
-#endif
+	cache_item_struct *item;
+	Uint32 hash;
 
-	if (!cache->cached_items)
+	if (!cache->name_table)
 		return NULL;
 
 	// quick check for the most recent item
 	if (cache->recent_item && cache->recent_item->name
 		&& strcmp(cache->recent_item->name, name) == 0)
 	{
+		cache->hits++;
 		cache_use(cache->recent_item);
 		return cache->recent_item;
 	}
 
-
-#ifdef FASTER_MAP_LOAD
-	item = bsearch(name, cache->cached_items, cache->num_items,
-		sizeof(cache_item_struct*), cache_item_cmp_str);
-	if (!item)
-		return NULL;
-	cache_use(*item);
-	cache->recent_item = *item;
-	return *item;
-#else
-	// not the most recent, then scan the list
-	for (i = 0; i < cache->max_item; i++)
+	hash = mem_hash(name, strlen(name));
+	for (item = cache->name_table[hash & cache->table_mask]; item; item = item->name_next)
 	{
-		if (cache->cached_items[i] && cache->cached_items[i]->name
-			&& strcmp(cache->cached_items[i]->name, name) == 0)
+		if (item->name_hash == hash && strcmp(item->name, name) == 0)
 		{
-			cache_use(cache->cached_items[i]);
-			cache->recent_item = cache->cached_items[i];
-			return cache->cached_items[i];
+			cache->hits++;
+			cache_use(item);
+			cache->recent_item = item;
+			return item;
 		}
 	}
 
+	cache->misses++;
 	return NULL;
-#endif
 }
 
 static cache_item_struct *cache_find_ptr(cache_struct *cache, const void *item)
 {
 	cache_item_struct *citem;
-	Sint32 i;
 
-	if (!cache->cached_items)
+	if (!cache->ptr_table)
 		return NULL;
 
 	// quick check for the most recent item
@@ -377,15 +374,9 @@ static cache_item_struct *cache_find_ptr(cache_struct *cache, const void *item)
 		return cache->recent_item;
 	}
 
-	// TODO: how about a sorted list or a hash system?
-#ifdef FASTER_MAP_LOAD
-	for (i = 0; i < cache->num_items; i++)
-#else
-	for (i = 0; i < cache->max_item; i++)
-#endif
+	for (citem = cache->ptr_table[cache_ptr_hash(item) & cache->table_mask]; citem; citem = citem->ptr_next)
 	{
-		citem = cache->cached_items[i];
-		if (citem && citem->name && citem->cache_item == item)
+		if (citem->name && citem->cache_item == item)
 		{
 			cache_use(citem);
 			cache->recent_item = citem;
@@ -409,11 +400,10 @@ void *cache_find_item(cache_struct *cache, const char *name)
 cache_item_struct *cache_add_item(cache_struct *cache, const char* name,
 	void *item, Uint32 size)
 {
-#ifdef FASTER_MAP_LOAD
 	cache_item_struct *new_item;
-	int i;
+	Uint32 bucket;
 
-	if (!cache->cached_items)
+	if (!cache->name_table)
 		return NULL;
 
 	if (cache->num_items >= cache->num_allocated)
@@ -427,64 +417,31 @@ cache_item_struct *cache_add_item(cache_struct *cache, const char* name,
 	new_item->cache_item = item;
 	new_item->size = size;
 	new_item->name = name;
+	new_item->cache = cache;
 	new_item->access_time = cur_time;
 	new_item->access_count = 1;	//start at 0 or 1? Is this a usage
+	new_item->name_hash = mem_hash(name, strlen(name));
 
-	for (i = 0; i < cache->num_items; i++)
-	{
-		if (strcmp(name, cache->cached_items[i]->name) <= 0)
-		{
-			memmove(cache->cached_items + (i+1), cache->cached_items + i,
-				(cache->num_items-i) * sizeof(cache_item_struct*));
-			break;
-		}
-	}
-	cache->recent_item = cache->cached_items[i] = new_item;
+	bucket = new_item->name_hash & cache->table_mask;
+	new_item->name_next = cache->name_table[bucket];
+	cache->name_table[bucket] = new_item;
+
+	bucket = cache_ptr_hash(item) & cache->table_mask;
+	new_item->ptr_next = cache->ptr_table[bucket];
+	cache->ptr_table[bucket] = new_item;
+
+	cache_lru_push_front(new_item);
+
+	cache->recent_item = new_item;
 	cache->num_items++;
+	cache->total_size += size;
 
 	if (cache != cache_system)
 		cache_adj_size(cache_system, size, cache);
 
-	return new_item;
-#else
-	Sint32 i;
+	cache_enforce_size_limit(cache);
 
-	if(!cache->cached_items) return NULL;
-	//find an empty slot
-	for(i=cache->first_unused; i<cache->max_item; i++)
-		{
-			//is the slot empty
-			if(!cache->cached_items[i])
-				{
-					break;
-				}
-		}
-	// do we have a slot or expand the list?
-	if(i >= cache->max_item)
-		{
-			// make sure we have room - consider dynamic expansion if not
-			if(cache->max_item >= cache->num_allocated) return NULL;
-			// keep track of the highesr used
-			i= cache->max_item;
-			cache->max_item++;
-		}
-	//allocate the memory
-	cache->cached_items[i]=calloc(1,sizeof(cache_item_struct));
-	if(!cache->cached_items[i]) return NULL;
-	//adjusted the lowest unsued size
-	cache->first_unused= i+1;
-	//memorize the information
-	cache->cached_items[i]->cache_item=item;
-	cache->cached_items[i]->size=size;
-	cache->cached_items[i]->name=name;
-	cache->cached_items[i]->access_time=cur_time;
-	cache->cached_items[i]->access_count=1;	//start at 0 or 1? Is this a usage
-	cache->num_items++;
-	if(cache != cache_system) cache_adj_size(cache_system, size, cache);
-	//return the pointer to the detailed item
-	cache->recent_item = cache->cached_items[i];
-	return(cache->recent_item);
-#endif
+	return new_item;
 }
 
 void cache_adj_size(cache_struct *cache, Uint32 size, void *item)
@@ -495,111 +452,71 @@ void cache_adj_size(cache_struct *cache, Uint32 size, void *item)
         if (cache != cache_system)
             cache_adj_size(cache_system, size, cache);
 		item_ptr->size += size;
+		cache->total_size += size;
 		cache_use(item_ptr);
+		// negative adjustments come in as huge unsigned values
+		if ((Sint32)size > 0)
+			cache_enforce_size_limit(cache);
+	}
+}
+
+static void cache_unlink_bucket(cache_item_struct **bucket, cache_item_struct *item, int by_name)
+{
+	cache_item_struct **link = bucket;
+
+	while (*link)
+	{
+		if (*link == item)
+		{
+			*link = by_name ? item->name_next : item->ptr_next;
+			return;
+		}
+		link = by_name ? &(*link)->name_next : &(*link)->ptr_next;
 	}
 }
 
 static void cache_remove(cache_struct *cache, cache_item_struct *item)
 {
-	if (!item || !cache->cached_items)
+	if (!item || !cache->name_table)
 		return;		//nothing to do
 	if (cache != cache_system)
 		cache_adj_size(cache_system, -item->size, cache);
-	if (item->cache_item && cache->free_item)
-		(*cache->free_item)(item->cache_item);
+	cache->total_size -= item->size;
+
+	// unhook it first, free_item might delete the cache it is part of
+	cache_lru_unlink(item);
+	cache_unlink_bucket(&cache->name_table[item->name_hash & cache->table_mask], item, 1);
+	cache_unlink_bucket(&cache->ptr_table[cache_ptr_hash(item->cache_item) & cache->table_mask], item, 0);
 	cache->num_items--;
 	cache->recent_item = NULL;	//forget where we are just incase
 
+	if (item->cache_item && cache->free_item)
+		(*cache->free_item)(item->cache_item);
+
 	item->cache_item = NULL;	//failsafe
 	item->name = NULL;		//failsafe
 	item->size = 0;			//failsafe
-#ifdef FASTER_MAP_LOAD
-	if (cache->num_items >= 0)
-	{
-		cache_item_struct **ci = cache->cached_items + cache->num_items;
-		if (*ci == item)
-		{
-			free(*ci);
-		}
-		else
-		{
-			while (ci-- > cache->cached_items)
-			{
-				if (*ci == item)
-				{
-					free(*ci);
-					memmove(ci, ci+1,
-						(cache->num_items-(ci-cache->cached_items))*sizeof(cache_item_struct*));
-					break;
-				}
-			}
-		}
-	}
-#else  // FASTER_MAP_LOAD
-	if(cache->max_item > 0)
-		{
-			// special case, at end (most common usage)
-			if(cache->cached_items[cache->max_item-1] == item)
-				{
-					Sint32	i=cache->max_item-1;
-					// remove it from the list
-					free(cache->cached_items[i]);
-					cache->cached_items[i]=NULL;
-					// work backwards to skip over empty slots
-					while(i>0 && cache->cached_items[i]==NULL)
-						{
-							i--;
-						}
-					// now memorize the new high mark
-					cache->max_item=i+1;
-					// and adjust first unused if needed
-					if(cache->first_unused > i)	cache->first_unused= i;;
-				}
-			else
-				{
-					Sint32	i;
-					// start at the end and work backwards looking for this item
-					for(i=cache->max_item-1; i>=0 ; i--)
-						{
-							if(cache->cached_items[i] == item)
-								{
-									//remove it from the list
-									free(cache->cached_items[i]);
-									cache->cached_items[i]=NULL;
-									// and adjust first unused if needed
-									if(cache->first_unused > i)	cache->first_unused= i;;
-									break;
-								}
-						}
-				}
-		}
-#endif // FASTER_MAP_LOAD
+	free(item);
 }
 
 static void cache_remove_all(cache_struct *cache)
 {
-	Sint32 i;
+	Uint32 bucket;
 
-	if (!cache->cached_items)
+	if (!cache->name_table)
 		return;
 
-#ifdef FASTER_MAP_LOAD
-	for (i = cache->num_items-1; i >= 0; i--)
-#else
-	for(i=cache->max_item-1; i>=0; i--)
-#endif
+	for (bucket = 0; bucket <= cache->table_mask; bucket++)
 	{
-		if(cache->cached_items[i])
+		while (cache->name_table[bucket])
 		{
-			cache_remove(cache, cache->cached_items[i]);
-			cache->cached_items[i]=NULL;
+			cache_remove(cache, cache->name_table[bucket]);
 		}
 	}
 
-#ifdef FASTER_MAP_LOAD
 	cache->num_items = 0;
-#else
-	cache->num_items = cache->max_item = 0;
-#endif
+	cache->total_size = 0;
+	cache->lru_head = NULL;
+	cache->lru_tail = NULL;
 	cache->recent_item = NULL;	//forget where we are just incase
 }
@@ -13,33 +13,48 @@
 extern "C" {
 #endif
 
+struct cache_struct;
+
 /*!
  * a single item storable in the cache
  */
-typedef struct
+typedef struct cache_item_struct
 {
 	void	*cache_item;	/*!< pointer to the item we are caching */
 	Uint32	size;			/*!< size of item */
 	Uint32	access_time;	/*!< last time used */
 	Uint32	access_count;	/*!< number of usages since last checkpoint */
 	const char *name;	/*!< original source or name, NOTE: this is NOT free()'d and allows dups! */
+	struct cache_struct	*cache;	/*!< the cache this item belongs to */
+	struct cache_item_struct	*lru_prev;	/*!< the more recently used item */
+	struct cache_item_struct	*lru_next;	/*!< the less recently used item */
+	struct cache_item_struct	*name_next;	/*!< next item in the same name hash bucket */
+	struct cache_item_struct	*ptr_next;	/*!< next item in the same pointer hash bucket */
+	Uint32	name_hash;		/*!< hash value of the name */
+	Uint8	in_lru;			/*!< if the item is in the LRU list */
 } cache_item_struct;
 
 /*!
  * structure of the cache used
  */
-typedef struct
+typedef struct cache_struct
 {
-	cache_item_struct	**cached_items; /*!< list of cached items */
+	cache_item_struct	**name_table; /*!< hash index of the items by name */
+	cache_item_struct	**ptr_table; /*!< hash index of the items by item pointer */
 	cache_item_struct	*recent_item; /*!< pointer to the last used item */
+	cache_item_struct	*lru_head; /*!< the most recently used item */
+	cache_item_struct	*lru_tail; /*!< the least recently used item */
+	Uint32	table_mask;		/*!< size of the hash tables minus one */
 	Sint32	num_items;		/*!< the number of active items in the list */
-#ifndef FASTER_MAP_LOAD
-	Sint32	max_item;		/*!< the highest slot used */
-	Sint32	first_unused;	/*!< the lowest possible unused slow (might be in use!!) */
-#endif
-	Sint32	num_allocated;	/*!< the allocated space for the list */
+	Sint32	num_allocated;	/*!< the max. number of items */
+	Uint32	total_size;		/*!< the summed size of all items */
+	Uint32	size_limit;		/*!< max. summed size of all items, zero for no limit */
 	Uint32	LRU_time;		/*!< last time LRU processing done */
 	Uint32	time_limit;		/*!< limit on LRU time before forcing a scan */
+	Uint32	hits;			/*!< number of successful lookups */
+	Uint32	misses;			/*!< number of failed lookups */
+	Uint32	evictions;		/*!< number of items freed or compacted by cache_release_lru, e.g. to stay in the size limit */
+	Uint32	expirations;	/*!< number of items freed or compacted because of the time limit */
 	void	(*free_item)();	/*!< routine to call to free an item */
 	Uint32	(*compact_item)();	/*!< routine to call to reduce memory usage without freeing */
 } cache_struct;
@@ -129,6 +144,35 @@ void cache_set_compact(cache_struct *cache, Uint32 (*compact_item)());
  */
 void cache_set_time_limit(cache_struct *cache, Uint32 time_limit);
 
+/*!
+ * \ingroup cache
+ * \brief   sets the \a size_limit for \a cache.
+ *
+ *      Sets the max. summed size of the items in \a cache. If it gets
+ *      exceeded, the least recently used items are freed or compacted.
+ *      Items used at the current time are never freed or compacted.
+ *
+ * \param cache         the cache for which the size limit should be set.
+ * \param size_limit    the max. summed size of the items, zero for no limit.
+ */
+void cache_set_size_limit(cache_struct *cache, Uint32 size_limit);
+
+/*!
+ * \ingroup cache
+ * \brief   frees or compacts the least recently used items of \a cache.
+ *
+ *      Frees or compacts items from the least recently used end of the LRU
+ *      list, until at least \a size bytes are freed. Items used at or after
+ *      \a time are never freed or compacted.
+ *
+ * \param cache         the cache to shrink.
+ * \param size          the number of bytes to free.
+ * \param time          the items used since this time are kept.
+ * \retval Uint32       the number of bytes freed.
+ * \callgraph
+ */
+Uint32 cache_release_lru(cache_struct *cache, Uint32 size, Uint32 time);
+
 /*!
  * \ingroup cache
  * \brief adds the given \a item to \a cache with the given \a name.
@@ -159,11 +203,54 @@ cache_item_struct *cache_add_item(cache_struct *cache, const char* name,
  */
 void cache_adj_size(cache_struct *cache, Uint32 size, void *item);
 
+/* removes an item from the LRU list of its cache */
+static __inline__ void cache_lru_unlink(cache_item_struct *item_ptr)
+{
+	cache_struct *cache = item_ptr->cache;
+
+	if (!item_ptr->in_lru)
+		return;
+
+	if (item_ptr->lru_prev)
+		item_ptr->lru_prev->lru_next = item_ptr->lru_next;
+	else
+		cache->lru_head = item_ptr->lru_next;
+
+	if (item_ptr->lru_next)
+		item_ptr->lru_next->lru_prev = item_ptr->lru_prev;
+	else
+		cache->lru_tail = item_ptr->lru_prev;
+
+	item_ptr->lru_prev = NULL;
+	item_ptr->lru_next = NULL;
+	item_ptr->in_lru = 0;
+}
+
+/* moves an item to the most recently used end of the LRU list */
+static __inline__ void cache_lru_push_front(cache_item_struct *item_ptr)
+{
+	cache_struct *cache = item_ptr->cache;
+
+	if (cache->lru_head == item_ptr)
+		return;
+
+	cache_lru_unlink(item_ptr);
+
+	item_ptr->lru_next = cache->lru_head;
+	if (cache->lru_head)
+		cache->lru_head->lru_prev = item_ptr;
+	else
+		cache->lru_tail = item_ptr;
+	cache->lru_head = item_ptr;
+	item_ptr->in_lru = 1;
+}
+
 /*!
  * \ingroup cache
  * \brief   update the last use time of a cache item
  *
  *      Sets the time a cache item was accessed last to the current time
+ *      and moves it to the front of the LRU list of its cache.
  *
  * \param item      the item for which to set the access time
  */
@@ -178,6 +265,7 @@ static __inline__ void	cache_use(cache_item_struct *item_ptr)
 	{
 		item_ptr->access_time = cur_time;
 		item_ptr->access_count++;
+		cache_lru_push_front(item_ptr);
 	}
 }
 #endif	//USE_INLINE
@@ -1,5 +1,6 @@
 #include <stdlib.h>
 #include "actors.h"
+#include "actor_defs_cache.h"
 #include "actor_init.h"
 #include "cal.h"
 #include "draw_scene.h"
@@ -23,6 +24,15 @@
 #include "io/elfilewrapper.h"
 #include "io/cal3d_io_wrapper.h"
 
+void cal_flush_animation_lod(actor *pActor)
+{
+	if (pActor->animation_lod_step > 0.0f)
+	{
+		CalModel_Update(pActor->calmodel, pActor->animation_lod_step);
+		pActor->animation_lod_step = 0.0f;
+	}
+}
+
 #ifdef MORE_EMOTES
 void start_transition(actor *act, int to, int msec){
 
@@ -43,6 +53,8 @@ int do_transition(actor *act){
 	if (act->calmodel==NULL) return 0;
 	if (act->startIdle==act->endIdle) return 0;
 
+	cal_flush_animation_lod(act);
+
 	printf("doing transition from %i to %i at %i of %i\n",act->startIdle,act->endIdle,cur_time-act->idleTime,act->idleDuration);
 
 	mixer=CalModel_GetMixer(act->calmodel);	
@@ -103,6 +115,7 @@ void cal_reset_emote_anims(actor *pActor, int cycles_too){
 	if (pActor->calmodel==NULL)
 		return;
 
+	cal_flush_animation_lod(pActor);
 	mixer=CalModel_GetMixer(pActor->calmodel);	
 	cur_emote=&pActor->cur_emote;
 
@@ -146,6 +159,7 @@ void cal_actor_set_emote_anim(actor *pActor, emote_frame *anims){
 
 	if (pActor->calmodel==NULL)
 		return;
+	cal_flush_animation_lod(pActor);
 	mixer=CalModel_GetMixer(pActor->calmodel);
 	cur_emote=&pActor->cur_emote;
 	cur_emote->start_time=cur_time;
@@ -232,6 +246,8 @@ void cal_actor_set_anim_delay(int id, struct cal_anim anim, float delay)
 
 	if (pActor->cur_anim.anim_index==anim.anim_index)
 		return;
+
+	cal_flush_animation_lod(pActor);
 	
 	//this shouldnt happend but its happends if actor doesnt have
 	//animation so we add this workaround to prevent "freezing"
@@ -405,6 +421,7 @@ struct cal_anim cal_load_anim(actor_types *act, const char *str, int duration)
 #endif	//NEW_SOUND
 
 	res.anim_index=CalCoreModel_ELLoadCoreAnimation(act->coremodel,fname,act->scale);
+	record_actor_def_load(act, ACTOR_DEF_LOAD_ANIMATION, fname, act->scale, res.anim_index);
 	if(res.anim_index == -1) {
 		LOG_ERROR("Cal3d error: %s: %s\n", fname, CalError_GetLastErrorDescription());
 		return res;
@@ -544,38 +561,20 @@ CHECK_GL_ERRORS();
 }
 
 
-static __inline__ void render_submesh(int meshId, int submeshCount, struct CalRenderer * pCalRenderer, float meshVertices[30000][3], float meshNormals[30000][3], float meshTextureCoordinates[30000][2], CalIndex meshFaces[50000][3], Uint32 use_lightning, Uint32 use_textures)
+static __inline__ void render_submesh(actor *act, int meshId, int submeshCount, Uint32 use_lightning, Uint32 use_textures)
 {
+	skinned_submesh_t submesh;
 	int submeshId;
-	int faceCount=0;
 
 	for(submeshId = 0; submeshId < submeshCount; submeshId++) {
-		// select mesh and submesh for further data access
-		if(CalRenderer_SelectMeshSubmesh(pCalRenderer,meshId, submeshId)) {
-			// get the transformed vertices of the submesh
-			CalRenderer_GetVertices(pCalRenderer,&meshVertices[0][0]);
-
-			// get the transformed normals of the submesh
-			if (use_lightning)
-			{
-				CalRenderer_GetNormals(pCalRenderer,&meshNormals[0][0]);
-			}
-
-			// get the texture coordinates of the submesh
-			if (use_textures)
-			{
-				CalRenderer_GetTextureCoordinates(pCalRenderer,0,&meshTextureCoordinates[0][0]);
-			}
-
-			// get the faces of the submesh
-			faceCount = CalRenderer_GetFaces(pCalRenderer, &meshFaces[0][0]);
-
+		// get the vertices, normals and faces skinned by skin_actor()
+		if(get_skinned_submesh(act, meshId, submeshId, &submesh)) {
 			// set the vertex and normal buffers
-			glVertexPointer(3, GL_FLOAT, 0, &meshVertices[0][0]);
-			if (use_lightning)
+			glVertexPointer(3, GL_FLOAT, 0, submesh.vertices);
+			if (use_lightning && submesh.normals)
 			{
 				glEnableClientState(GL_NORMAL_ARRAY);
-				glNormalPointer(GL_FLOAT, 0, &meshNormals[0][0]);
+				glNormalPointer(GL_FLOAT, 0, submesh.normals);
 			}
 			else
 			{
@@ -583,10 +582,10 @@ static __inline__ void render_submesh(int meshId, int submeshCount, struct CalRe
 			}
 
 			// draw the submesh
-			if (use_textures)
+			if (use_textures && submesh.texture_coordinates)
 			{
 				glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-				glTexCoordPointer(2, GL_FLOAT, 0, &meshTextureCoordinates[0][0]);
+				glTexCoordPointer(2, GL_FLOAT, 0, submesh.texture_coordinates);
 			}
 			else
 			{
@@ -594,9 +593,9 @@ static __inline__ void render_submesh(int meshId, int submeshCount, struct CalRe
 			}
 
 			if(sizeof(CalIndex)==2)
-				glDrawElements(GL_TRIANGLES, faceCount * 3, GL_UNSIGNED_SHORT, &meshFaces[0][0]);
+				glDrawElements(GL_TRIANGLES, submesh.face_count * 3, GL_UNSIGNED_SHORT, submesh.faces);
 			else
-				glDrawElements(GL_TRIANGLES, faceCount * 3, GL_UNSIGNED_INT, &meshFaces[0][0]);
+				glDrawElements(GL_TRIANGLES, submesh.face_count * 3, GL_UNSIGNED_INT, submesh.faces);
 		}
 	}
 #ifdef OPENGL_TRACE
@@ -610,10 +609,6 @@ void cal_render_actor(actor *act, Uint32 use_lightning, Uint32 use_textures, Uin
 	struct CalRenderer *pCalRenderer;
 	int meshCount,meshId,submeshCount/*,submeshId, vertexCount*/;
 	float points[1024][3];
-	static float meshVertices[30000][3];
-	static float meshNormals[30000][3];
-	static float meshTextureCoordinates[30000][2];
-	static CalIndex meshFaces[50000][3];
 	struct CalSkeleton *skel;
 	struct CalMesh *_mesh;
 	struct CalCoreMesh *_coremesh;
@@ -667,6 +662,9 @@ void cal_render_actor(actor *act, Uint32 use_lightning, Uint32 use_textures, Uin
 				//glDisable(GL_CULL_FACE);
 			}
 
+			// skin all meshes at once, on all cores
+			skin_actor(act, use_lightning);
+
 			// will use vertex arrays, so enable them
 			glEnableClientState(GL_VERTEX_ARRAY);
 
@@ -745,15 +743,15 @@ void cal_render_actor(actor *act, Uint32 use_lightning, Uint32 use_textures, Uin
 						glColor4f(glow_colors[glow].r, glow_colors[glow].g, glow_colors[glow].b, 0.5f);
 						glPushMatrix();
 						glScalef(0.99f, 0.99f, 0.99f);
-						render_submesh(meshId, submeshCount, pCalRenderer, meshVertices, meshNormals, meshTextureCoordinates, meshFaces, 0, use_textures);
+						render_submesh(act, meshId, submeshCount, 0, use_textures);
 						glPopMatrix();
 
 						glColor4f(glow_colors[glow].r, glow_colors[glow].g, glow_colors[glow].b, 0.85f);
-						render_submesh(meshId, submeshCount, pCalRenderer, meshVertices, meshNormals, meshTextureCoordinates, meshFaces, 0, use_textures);
+						render_submesh(act, meshId, submeshCount, 0, use_textures);
 						glColor4f(glow_colors[glow].r, glow_colors[glow].g, glow_colors[glow].b, 0.99f);
 						glPushMatrix();
 						glScalef(1.01f, 1.01f, 1.01f);
-						render_submesh(meshId, submeshCount, pCalRenderer, meshVertices, meshNormals, meshTextureCoordinates, meshFaces, 0, use_textures);
+						render_submesh(act, meshId, submeshCount, 0, use_textures);
 						glPopMatrix();
 
 						if(use_shadow_mapping){
@@ -772,7 +770,7 @@ void cal_render_actor(actor *act, Uint32 use_lightning, Uint32 use_textures, Uin
 						}
 					} else {
 						// enhanced actors without glowing items
-						render_submesh(meshId, submeshCount, pCalRenderer, meshVertices, meshNormals, meshTextureCoordinates, meshFaces, use_lightning, use_textures);
+						render_submesh(act, meshId, submeshCount, use_lightning, use_textures);
 					}
 					if(boneid >= 0){
 						//if this was a weapon or shield, restore the transformation matrix
@@ -780,7 +778,7 @@ void cal_render_actor(actor *act, Uint32 use_lightning, Uint32 use_textures, Uin
 					}
 				} else {
 					// non-enhanced actors, or enhanced without attached meshes
-					render_submesh(meshId, submeshCount, pCalRenderer, meshVertices, meshNormals, meshTextureCoordinates, meshFaces, use_lightning, use_textures);
+					render_submesh(act, meshId, submeshCount, use_lightning, use_textures);
 				}
 			}
 
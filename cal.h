@@ -21,6 +21,16 @@ void cal_set_anim_sound(struct cal_anim *my_cal_anim, const char *sound, const c
 enum CalBoolean CalMixer_ExecuteActionExt(struct CalMixer *self, int id, float delayIn, float delayOut, float weight, int autoLock);
  
 
+/*!
+ * \brief	Applies the animation time an actor has saved up to its skeleton
+ *
+ *		Called before the animations of an actor change, so the old
+ *		animations are played for the time that passed while the
+ *		skeleton was updated at a lower rate.
+ *
+ * \param	pActor The actor
+ */
+void cal_flush_animation_lod(actor *pActor);
 void cal_actor_set_emote_anim(actor *pActor, emote_frame *anims);
 void handle_cur_emote(actor *pActor);
 void cal_reset_emote_anims(actor *pActor, int cycles_too);
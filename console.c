@@ -28,6 +28,8 @@
 #include "manufacture.h"
 #include "misc.h"
 #include "multiplayer.h"
+#include "net_stats.h"
+#include "packet_record.h"
 #include "notepad.h"
 #include "password_manager.h"
 #include "pm_log.h"
@@ -37,6 +39,7 @@
 #include "spells.h"
 #include "tabs.h"
 #include "translate.h"
+#include "textures.h"
 #include "url.h"
 #include "command_queue.h"
 #include "counters.h"
@@ -49,6 +52,8 @@
 #include "text_aliases.h"
 //only for debugging command #add_emote <actor name> <emote id>, can be removed later
 #include "actor_scripts.h"
+#include "actor_init.h"
+#include "pose_cache.h"
 #include "emotes.h"
 #ifdef	CUSTOM_UPDATE
 #include "custom_update.h"
@@ -922,11 +927,7 @@ int command_time(char *text, int len)
 
 int command_ping(char *text, int len)
 {
-	Uint8 str[8];
-
-	str[0] = PING;
-	*((Uint32 *)(str+1)) = SDL_SwapLE32(SDL_GetTicks());
-	my_tcp_send(my_socket, str, 5);
+	send_net_stats_ping(0);
 	return 1;
 }
 
@@ -947,10 +948,37 @@ int command_quit(char *text, int len)
 
 int command_mem(char *text, int len)
 {
+	texture_residency_stats_t residency;
+	texture_loading_stats_t stats;
+	char str[256];
+
 	cache_dump_sizes(cache_system);
 #ifdef	DEBUG
 	cache_dump_sizes(cache_e3d);
 #endif	//DEBUG
+	get_texture_loading_stats(&stats);
+	safe_snprintf(str, sizeof(str), "Texture loading: %u pending, "
+		"%u decoding, %u ready, %u uploaded (%llu KB)", stats.pending,
+		stats.decoding, stats.ready, stats.uploaded,
+		(unsigned long long)(stats.uploaded_bytes / 1024));
+	LOG_TO_CONSOLE(c_green1, str);
+	get_texture_residency_stats(&residency);
+	safe_snprintf(str, sizeof(str), "Texture memory: %u textures, "
+		"%llu KB resident (peak %llu KB, budget %llu KB), %llu KB "
+		"decoded", residency.resident,
+		(unsigned long long)(residency.resident_bytes / 1024),
+		(unsigned long long)(residency.peak_resident_bytes / 1024),
+		(unsigned long long)(residency.budget / 1024),
+		(unsigned long long)(residency.decoded_bytes / 1024));
+	LOG_TO_CONSOLE(c_green1, str);
+	safe_snprintf(str, sizeof(str), "Texture binds: %llu, hit rate "
+		"%.1f%%, %llu evictions (%llu KB)",
+		(unsigned long long)residency.binds,
+		(residency.binds > 0) ? (100.0 * residency.hits /
+		residency.binds) : 100.0,
+		(unsigned long long)residency.evictions,
+		(unsigned long long)(residency.evicted_bytes / 1024));
+	LOG_TO_CONSOLE(c_green1, str);
 	return 1;
 }
 int command_ver(char *text, int len)
@@ -1313,6 +1341,421 @@ int command_log_conn_data(char *text, int len)
 	return 1;
 }
 
+int command_net_stats(char *text, int len)
+{
+	message_ring_stats_t stats;
+	tcp_send_stats_t send_stats;
+	double frequency, seconds;
+	char str[256];
+
+	message_ring_get_stats(server_message_ring, &stats);
+	frequency = SDL_GetPerformanceFrequency();
+	safe_snprintf(str, sizeof(str), "Server messages: %llu (%llu KB), "
+		"queue wait avg %.3f ms, max %.3f ms",
+		(unsigned long long)stats.messages,
+		(unsigned long long)(stats.bytes / 1024),
+		(stats.messages > 0) ? (1000.0 * stats.total_wait /
+		stats.messages / frequency) : 0.0,
+		1000.0 * stats.max_wait / frequency);
+	LOG_TO_CONSOLE(c_green1, str);
+	safe_snprintf(str, sizeof(str), "Message ring: %u KB used (peak %u KB) "
+		"of %u KB, %llu wraps (%llu bytes moved), %llu times full",
+		stats.used / 1024, stats.peak_used / 1024, stats.size / 1024,
+		(unsigned long long)stats.wraps,
+		(unsigned long long)stats.moved_bytes,
+		(unsigned long long)stats.full);
+	LOG_TO_CONSOLE(c_green1, str);
+	safe_snprintf(str, sizeof(str), "Processed in %llu batches, "
+		"%llu messages through the overflow queue",
+		(unsigned long long)stats.batches,
+		(unsigned long long)stats.overflows);
+	LOG_TO_CONSOLE(c_green1, str);
+
+	get_tcp_send_stats(&send_stats);
+	seconds = (SDL_GetTicks() - send_stats.start_time) / 1000.0;
+	if (seconds < 1.0)
+		seconds = 1.0;
+	safe_snprintf(str, sizeof(str), "Sent %llu commands (%llu coalesced) "
+		"in %llu writes, %.2f writes/s, %.2f KB/s",
+		(unsigned long long)send_stats.commands,
+		(unsigned long long)send_stats.coalesced,
+		(unsigned long long)send_stats.sends, send_stats.sends / seconds,
+		send_stats.bytes / 1024.0 / seconds);
+	LOG_TO_CONSOLE(c_green1, str);
+	return 1;
+}
+
+static int command_record_packets(char *text, int len)
+{
+	while (isspace(*text))
+		text++;
+
+	if (is_recording_packets() && (*text == '\0'))
+		stop_packet_recording();
+	else
+		start_packet_recording(text);
+	return 1;
+}
+
+static int command_replay_packets(char *text, int len)
+{
+	char file_name[128];
+	int i;
+
+	while (isspace(*text))
+		text++;
+
+	if (*text == '\0')
+	{
+		stop_packet_replay();
+		return 1;
+	}
+
+	for (i = 0; (i < sizeof(file_name) - 1) && text[i] && !isspace(text[i]); i++)
+		file_name[i] = text[i];
+	file_name[i] = '\0';
+	text += i;
+	while (isspace(*text))
+		text++;
+
+	start_packet_replay(file_name, strcmp(text, "fast") == 0);
+	return 1;
+}
+
+static void dump_message_stats(const char *file_name)
+{
+	const message_stats_t *stats;
+	const char *name;
+	double frequency;
+	FILE *f;
+	int i, j;
+
+	f = open_file_config(file_name, "w");
+	if (f == NULL)
+	{
+		LOG_TO_CONSOLE(c_red1, cant_open_file);
+		return;
+	}
+
+	frequency = SDL_GetPerformanceFrequency();
+	fprintf(f, "type,name,count,bytes,total_us,avg_us,max_us");
+	for (i = 0; i < MESSAGE_STATS_BUCKETS - 1; i++)
+		fprintf(f, ",lt_%dus", 1 << i);
+	// the last bucket has no upper bound
+	fprintf(f, ",ge_%dus", 1 << (MESSAGE_STATS_BUCKETS - 2));
+	fprintf(f, "\n");
+
+	for (i = 0; i < 256; i++)
+	{
+		stats = get_message_stats(i);
+		if (stats->count == 0)
+			continue;
+		name = get_message_name(i);
+		fprintf(f, "%d,%s,%u,%llu,%.1f,%.2f,%.1f", i, name ? name : "unknown",
+			stats->count, (unsigned long long)stats->bytes,
+			1000000.0 * stats->total_time / frequency,
+			1000000.0 * stats->total_time / stats->count / frequency,
+			1000000.0 * stats->max_time / frequency);
+		for (j = 0; j < MESSAGE_STATS_BUCKETS; j++)
+			fprintf(f, ",%u", stats->histogram[j]);
+		fprintf(f, "\n");
+	}
+
+	fclose(f);
+	LOG_TO_CONSOLE(c_green1, "Message statistics saved");
+}
+
+static int command_message_stats(char *text, int len)
+{
+	Uint8 top[10];
+	int top_count, i, j;
+	const message_stats_t *stats;
+	const char *name;
+	double frequency;
+	char str[256];
+
+	while (isspace(*text))
+		text++;
+
+	if (my_strncompare(text, "on", 2))
+	{
+		if (!message_stats)
+			toggle_OPT_BOOL_by_name("message_stats");
+		return 1;
+	}
+	else if (my_strncompare(text, "off", 3))
+	{
+		if (message_stats)
+			toggle_OPT_BOOL_by_name("message_stats");
+		return 1;
+	}
+	else if (my_strncompare(text, "reset", 5))
+	{
+		reset_message_stats();
+		return 1;
+	}
+	else if (my_strncompare(text, "dump", 4))
+	{
+		text += 4;
+		while (isspace(*text))
+			text++;
+		dump_message_stats(*text ? text : "message_stats.csv");
+		return 1;
+	}
+
+	/* the message types with the most processing time */
+	top_count = 0;
+	for (i = 0; i < 256; i++)
+	{
+		if (get_message_stats(i)->count == 0)
+			continue;
+		for (j = top_count; (j > 0) && (get_message_stats(top[j - 1])->total_time < get_message_stats(i)->total_time); j--)
+		{
+			if (j < sizeof(top))
+				top[j] = top[j - 1];
+		}
+		if (j < sizeof(top))
+		{
+			top[j] = i;
+			if (top_count < sizeof(top))
+				top_count++;
+		}
+	}
+
+	if (top_count == 0)
+	{
+		if (message_stats)
+			LOG_TO_CONSOLE(c_green1, "No messages measured yet");
+		else
+			LOG_TO_CONSOLE(c_green1, "Message statistics are off, use #msgstats on");
+		return 1;
+	}
+
+	frequency = SDL_GetPerformanceFrequency();
+	for (i = 0; i < top_count; i++)
+	{
+		stats = get_message_stats(top[i]);
+		name = get_message_name(top[i]);
+		safe_snprintf(str, sizeof(str), "%s (%d): %u msgs, %.2f ms total, "
+			"avg %.1f us, max %.1f us", name ? name : "unknown", top[i],
+			stats->count, 1000.0 * stats->total_time / frequency,
+			1000000.0 * stats->total_time / stats->count / frequency,
+			1000000.0 * stats->max_time / frequency);
+		LOG_TO_CONSOLE(c_green1, str);
+	}
+	return 1;
+}
+
+static int command_latency_stats(char *text, int len)
+{
+	const net_stats_summary_t *summary;
+	char str[256];
+	int i;
+
+	while (isspace(*text))
+		text++;
+
+	if (my_strncompare(text, "on", 2))
+	{
+		if (!net_stats)
+			toggle_OPT_BOOL_by_name("net_stats");
+		return 1;
+	}
+	else if (my_strncompare(text, "off", 3))
+	{
+		if (net_stats)
+			toggle_OPT_BOOL_by_name("net_stats");
+		return 1;
+	}
+	else if (my_strncompare(text, "reset", 5))
+	{
+		reset_net_stats();
+		return 1;
+	}
+	else if (my_strncompare(text, "dump", 4))
+	{
+		text += 4;
+		while (isspace(*text))
+			text++;
+		if (save_net_stats(*text ? text : "net_stats.csv"))
+			LOG_TO_CONSOLE(c_green1, "Network statistics saved");
+		else
+			LOG_TO_CONSOLE(c_red1, cant_open_file);
+		return 1;
+	}
+	else if (my_strncompare(text, "samples", 7))
+	{
+		text += 7;
+		while (isspace(*text))
+			text++;
+		if (save_net_stats_samples(*text ? text : "net_samples.csv"))
+			LOG_TO_CONSOLE(c_green1, "Network samples saved");
+		else
+			LOG_TO_CONSOLE(c_red1, cant_open_file);
+		return 1;
+	}
+
+	if (!net_stats && !show_net_stats)
+	{
+		LOG_TO_CONSOLE(c_green1, "Network statistics are off, use #netstats on");
+		return 1;
+	}
+
+	update_net_stats();
+	for (i = 0; i < NET_STATS_KINDS; i++)
+	{
+		summary = get_net_stats(i);
+		safe_snprintf(str, sizeof(str), "%s: %u samples, min %.2f ms, "
+			"avg %.2f ms, p50 %.2f ms, p95 %.2f ms, p99 %.2f ms, max %.2f ms",
+			get_net_stats_name(i), summary->count, summary->min / 1000.0,
+			summary->avg / 1000.0, summary->p50 / 1000.0,
+			summary->p95 / 1000.0, summary->p99 / 1000.0,
+			summary->max / 1000.0);
+		LOG_TO_CONSOLE(c_green1, str);
+	}
+	safe_snprintf(str, sizeof(str), "smoothed jitter: %.2f ms",
+		get_net_stats_jitter() / 1000.0);
+	LOG_TO_CONSOLE(c_green1, str);
+	return 1;
+}
+
+/* compares the actor skinning on the CPU with the output of cal3d */
+static int command_skinning_test(char *text, int len)
+{
+	float vertex_error = 0.0f, normal_error = 0.0f;
+	Uint32 vertices = 0;
+	int i, actors = 0, passed;
+	char str[256];
+
+	LOCK_ACTORS_LISTS();
+	for (i = 0; i < max_actors; i++)
+	{
+		if ((actors_list[i] != NULL) && (actors_list[i]->calmodel != NULL))
+		{
+			vertices += check_actor_skinning(actors_list[i], &vertex_error, &normal_error);
+			actors++;
+		}
+	}
+	UNLOCK_ACTORS_LISTS();
+
+	// rounding differs, as the matrices are blended before transforming
+	passed = (vertex_error < 0.001f) && (normal_error < 0.001f);
+	safe_snprintf(str, sizeof(str), "Skinning test %s: %d actors, %u vertices, "
+		"max. difference to cal3d %g (positions), %g (normals)",
+		passed ? "passed" : "failed", actors, vertices, vertex_error, normal_error);
+	LOG_TO_CONSOLE(passed ? c_green1 : c_red1, str);
+	return 1;
+}
+
+#ifndef	DYNAMIC_ANIMATIONS
+/* shows how many actors are animated at which rate */
+static int command_animation_stats(char *text, int len)
+{
+	Uint32 counts[ANIMATION_LOD_COUNT], updates;
+	Uint32 hits, misses, skipped, entries;
+	char str[256];
+
+	text = getparams(text);
+
+	LOCK_ACTORS_LISTS();
+	get_animation_lod_stats(counts, &updates);
+	get_pose_cache_stats(&hits, &misses, &skipped, &entries);
+	if (my_strncompare(text, "reset", 5))
+	{
+		reset_pose_cache_stats();
+	}
+	UNLOCK_ACTORS_LISTS();
+
+	safe_snprintf(str, sizeof(str), "Animation level of detail %s: %u full, "
+		"%u reduced, %u low, %u frozen, %u skeletons updated in the last frame",
+		animation_lod ? "on" : "off", counts[ANIMATION_LOD_FULL],
+		counts[ANIMATION_LOD_REDUCED], counts[ANIMATION_LOD_LOW],
+		counts[ANIMATION_LOD_FROZEN], updates);
+	LOG_TO_CONSOLE(c_green1, str);
+	safe_snprintf(str, sizeof(str), "Shared poses (%d ms): %u hits, %u misses "
+		"(%.1f%% hit rate), %u not shareable, %u poses cached",
+		pose_cache_quantum, hits, misses,
+		hits + misses > 0 ? 100.0f * hits / (hits + misses) : 0.0f,
+		skipped, entries);
+	LOG_TO_CONSOLE(c_green1, str);
+	return 1;
+}
+#endif	//DYNAMIC_ANIMATIONS
+
+/* shows how far the actors are behind the server, the longest queues first */
+static int command_queue_stats(char *text, int len)
+{
+	actor *deepest[5];
+	actor *act;
+	Uint32 queued, overflows, resyncs;
+	char str[6][256];
+	int i, j, k, count;
+
+	text = getparams(text);
+
+	queued = 0;
+	overflows = 0;
+	count = 0;
+
+	LOCK_ACTORS_LISTS();
+	for (i = 0; i < max_actors; i++)
+	{
+		act = actors_list[i];
+		if (act == NULL)
+			continue;
+
+		queued += act->que_length;
+		overflows += act->que_overflows;
+
+		// keep the actors with the longest queues, sorted
+		for (j = 0; j < count; j++)
+		{
+			if (act->que_max_length > deepest[j]->que_max_length)
+				break;
+		}
+		if (j >= 5 || act->que_max_length == 0)
+			continue;
+		if (count < 5)
+			count++;
+		for (k = count - 1; k > j; k--)
+			deepest[k] = deepest[k - 1];
+		deepest[j] = act;
+	}
+
+	for (j = 0; j < count; j++)
+	{
+		safe_snprintf(str[j + 1], sizeof(str[j + 1]), "%s: %d commands "
+			"queued, up to %d, %u found the queue full",
+			deepest[j]->actor_name, deepest[j]->que_length,
+			deepest[j]->que_max_length, deepest[j]->que_overflows);
+	}
+
+	resyncs = cmd_queue_resyncs;
+
+	if (my_strncompare(text, "reset", 5))
+	{
+		for (i = 0; i < max_actors; i++)
+		{
+			if (actors_list[i] == NULL)
+				continue;
+			actors_list[i]->que_max_length = actors_list[i]->que_length;
+			actors_list[i]->que_overflows = 0;
+		}
+		cmd_queue_resyncs = 0;
+	}
+	UNLOCK_ACTORS_LISTS();
+
+	safe_snprintf(str[0], sizeof(str[0]), "Command queues: %u commands "
+		"queued, %u found a full queue, %u resyncs", queued, overflows,
+		resyncs);
+	for (j = 0; j <= count; j++)
+	{
+		LOG_TO_CONSOLE(j == 0 ? c_green1 : c_green2, str[j]);
+	}
+
+	return 1;
+}
+
 // TODO: make this automatic or a better command, m is too short
 int command_msg(char *text, int len)
 {
@@ -1751,6 +2194,16 @@ add_command("horse", &horse_cmd);
 	add_command(cmd_knowledge_short, &knowledge_command);
 	add_command(cmd_knowledge, &knowledge_command);
 	add_command("log conn data", &command_log_conn_data);
+	add_command("net", &command_net_stats);
+	add_command("record", &command_record_packets);
+	add_command("replay", &command_replay_packets);
+	add_command("msgstats", &command_message_stats);
+	add_command("netstats", &command_latency_stats);
+	add_command("skintest", &command_skinning_test);
+#ifndef	DYNAMIC_ANIMATIONS
+	add_command("animstats", &command_animation_stats);
+#endif	//DYNAMIC_ANIMATIONS
+	add_command("queuestats", &command_queue_stats);
 	add_command(cmd_msg, &command_msg);
 	add_command(cmd_afk, &command_afk);
 	add_command("jc", &command_jlc);//since we only mess with the part after the
@@ -6,31 +6,33 @@
  ****************************************************************************/
 
 #include "dds.h"
+#include <string.h>
 
-void unpack_dxt_color(DXTColorBlock *block, Uint8 *values, Uint32 dxt1)
+static void get_dxt_color_palette(const Uint16 color0, const Uint16 color1,
+	const Uint32 dxt1, Uint8 palette[4][4])
 {
 	float colors[4][4];
-	Uint32 i, j, index;
+	Uint32 i, j;
 
-	colors[0][0] = (block->m_colors[0] & 0xF800) >> 11;
-	colors[0][1] = (block->m_colors[0] & 0x07E0) >> 5;
-	colors[0][2] = block->m_colors[0] & 0x001F;
+	colors[0][0] = (color0 & 0xF800) >> 11;
+	colors[0][1] = (color0 & 0x07E0) >> 5;
+	colors[0][2] = color0 & 0x001F;
 	colors[0][3] = 255.0f;
 
 	colors[0][0] *= 255.0f / 31.0f;
 	colors[0][1] *= 255.0f / 63.0f;
 	colors[0][2] *= 255.0f / 31.0f;
 
-	colors[1][0] = (block->m_colors[1] & 0xF800) >> 11;
-	colors[1][1] = (block->m_colors[1] & 0x07E0) >> 5;
-	colors[1][2] = block->m_colors[1] & 0x001F;
+	colors[1][0] = (color1 & 0xF800) >> 11;
+	colors[1][1] = (color1 & 0x07E0) >> 5;
+	colors[1][2] = color1 & 0x001F;
 	colors[1][3] = 255.0f;
 
 	colors[1][0] *= 255.0f / 31.0f;
 	colors[1][1] *= 255.0f / 63.0f;
 	colors[1][2] *= 255.0f / 31.0f;
 
-	if ((dxt1 == 1) && (block->m_colors[0] <= block->m_colors[1]))
+	if ((dxt1 == 1) && (color0 <= color1))
 	{
 		// 1-bit alpha
 		// one intermediate colour, half way between the other two
@@ -58,6 +60,22 @@ void unpack_dxt_color(DXTColorBlock *block, Uint8 *values, Uint32 dxt1)
 		colors[3][3] = (colors[0][3] + 2.0f * colors[1][3]) / 3.0f;
 	}
 
+	for (i = 0; i < 4; i++)
+	{
+		for (j = 0; j < 4; j++)
+		{
+			palette[i][j] = colors[i][j];
+		}
+	}
+}
+
+void unpack_dxt_color(DXTColorBlock *block, Uint8 *values, Uint32 dxt1)
+{
+	Uint8 palette[4][4];
+	Uint32 i, j, index;
+
+	get_dxt_color_palette(block->m_colors[0], block->m_colors[1], dxt1, palette);
+
 	// Process 4x4 block of texels
 	for (i = 0; i < 4; ++i)
 	{
@@ -66,14 +84,14 @@ void unpack_dxt_color(DXTColorBlock *block, Uint8 *values, Uint32 dxt1)
 			// LSB come first
 			index = block->m_indices[i] >> (j * 2) & 0x3;
 
-			values[((i * 4) + j) * 4 + 0] = colors[index][0];
-			values[((i * 4) + j) * 4 + 1] = colors[index][1];
-			values[((i * 4) + j) * 4 + 2] = colors[index][2];
+			values[((i * 4) + j) * 4 + 0] = palette[index][0];
+			values[((i * 4) + j) * 4 + 1] = palette[index][1];
+			values[((i * 4) + j) * 4 + 2] = palette[index][2];
 
 			if (dxt1)
 			{
 				// Overwrite entire colour
-				values[((i * 4) + j) * 4 + 3] = colors[index][3];
+				values[((i * 4) + j) * 4 + 3] = palette[index][3];
 			}
 		}
 	}
@@ -97,16 +115,16 @@ void unpack_dxt_explicit_alpha(DXTExplicitAlphaBlock *block, Uint8 *values)
 	}
 }
 
-void unpack_dxt_interpolated_alpha(DXTInterpolatedAlphaBlock *block, Uint8 *values)
+static void get_dxt_alpha_palette(const Uint8 alpha0, const Uint8 alpha1, Uint8 palette[8])
 {
 	float alphas[8];
 	float scale, f0, f1;
-	Uint32 i, index, idx0, idx1;
+	Uint32 i;
 
-	alphas[0] = block->m_alphas[0];
-	alphas[1] = block->m_alphas[1];
+	alphas[0] = alpha0;
+	alphas[1] = alpha1;
 
-	if (block->m_alphas[0] > block->m_alphas[1])
+	if (alpha0 > alpha1)
 	{
 		scale = 1.0f / 7.0f;
 
@@ -114,7 +132,7 @@ void unpack_dxt_interpolated_alpha(DXTInterpolatedAlphaBlock *block, Uint8 *valu
 		{
 			f0 = (6 - i) * scale;
 			f1 = (i + 1) * scale;
-			alphas[i + 2] = (f0 * block->m_alphas[0]) + (f1 * block->m_alphas[1]);
+			alphas[i + 2] = (f0 * alpha0) + (f1 * alpha1);
 		}
 	}
 	else
@@ -129,13 +147,26 @@ void unpack_dxt_interpolated_alpha(DXTInterpolatedAlphaBlock *block, Uint8 *valu
 		{
 			f0 = (4 - i) * scale;
 			f1 = (i + 1) * scale;
-			alphas[i + 2] = (f0 * block->m_alphas[0]) + (f1 * block->m_alphas[1]);
+			alphas[i + 2] = (f0 * alpha0) + (f1 * alpha1);
 		}
 
 		alphas[6] = 0.0f;
 		alphas[7] = 255.0f;
 	}
 
+	for (i = 0; i < 8; i++)
+	{
+		palette[i] = alphas[i];
+	}
+}
+
+void unpack_dxt_interpolated_alpha(DXTInterpolatedAlphaBlock *block, Uint8 *values)
+{
+	Uint8 alphas[8];
+	Uint32 i, index, idx0, idx1;
+
+	get_dxt_alpha_palette(block->m_alphas[0], block->m_alphas[1], alphas);
+
 	for (i = 0; i < 16; i++)
 	{
 		idx0 = (i * 3) / 8;
@@ -217,3 +248,169 @@ void unpack_ati2(DXTInterpolatedAlphaBlock *first_block, DXTInterpolatedAlphaBlo
 		values[i * 4 + 3] = second_values[i];
 	}
 }
+
+/*
+ * The functions below decode straight from the compressed data into the
+ * RGBA8 image, a whole row of blocks at a time, instead of going through a
+ * 4x4 temporary block per el_read(). The palettes are built by the same
+ * functions as above, so the results are identical.
+ */
+static void decompress_dxt_color(const Uint8 *src, const Uint32 dxt1,
+	const Uint32 pitch, const Uint32 count_x, const Uint32 count_y,
+	Uint8 *dst)
+{
+	Uint8 palette[4][4];
+	Uint32 i, j, size, index;
+
+	get_dxt_color_palette(src[0] | (src[1] << 8), src[2] | (src[3] << 8),
+		dxt1, palette);
+
+	// the alpha is written later for all but dxt1
+	size = dxt1 ? 4 : 3;
+
+	for (i = 0; i < count_y; i++)
+	{
+		for (j = 0; j < count_x; j++)
+		{
+			index = src[4 + i] >> (j * 2) & 0x3;
+
+			memcpy(dst + i * pitch + j * 4, palette[index], size);
+		}
+	}
+}
+
+static void decompress_dxt_explicit_alpha(const Uint8 *src,
+	const Uint32 pitch, const Uint32 count_x, const Uint32 count_y,
+	Uint8 *dst)
+{
+	Uint32 i, j, alphas;
+
+	for (i = 0; i < count_y; i++)
+	{
+		alphas = src[i * 2] | (src[i * 2 + 1] << 8);
+
+		for (j = 0; j < count_x; j++)
+		{
+			dst[i * pitch + j * 4] = (alphas >> (j * 4) & 0xF) * 17;
+		}
+	}
+}
+
+static void decompress_dxt_interpolated_alpha(const Uint8 *src,
+	const Uint32 pitch, const Uint32 count_x, const Uint32 count_y,
+	const Uint32 channels, Uint8 *dst)
+{
+	Uint64 indices;
+	Uint8 palette[8];
+	Uint32 i, j, k, index;
+
+	get_dxt_alpha_palette(src[0], src[1], palette);
+
+	indices = 0;
+
+	for (i = 0; i < 6; i++)
+	{
+		indices |= ((Uint64)src[2 + i]) << (i * 8);
+	}
+
+	for (i = 0; i < count_y; i++)
+	{
+		for (j = 0; j < count_x; j++)
+		{
+			index = (indices >> ((i * 4 + j) * 3)) & 0x07;
+
+			for (k = 0; k < channels; k++)
+			{
+				dst[i * pitch + j * 4 + k] = palette[index];
+			}
+		}
+	}
+}
+
+Uint32 get_dxt_block_size(const Uint32 format)
+{
+	switch (format)
+	{
+		case DDSFMT_DXT1:
+		case DDSFMT_ATI1:
+			return 8;
+		case DDSFMT_DXT2:
+		case DDSFMT_DXT3:
+		case DDSFMT_DXT4:
+		case DDSFMT_DXT5:
+		case DDSFMT_ATI2:
+			return 16;
+		default:
+			return 0;
+	}
+}
+
+void decompress_dxt_rows(const Uint32 format, const Uint8 *src,
+	const Uint32 width, const Uint32 height, const Uint32 first_row,
+	const Uint32 row_count, Uint8 *dst)
+{
+	const Uint8 *block;
+	Uint8 *texels;
+	Uint32 x, y, w, pitch, block_size, count_x, count_y;
+
+	w = (width + 3) / 4;
+	pitch = width * 4;
+	block_size = get_dxt_block_size(format);
+
+	for (y = first_row; y < (first_row + row_count); y++)
+	{
+		count_y = height - y * 4;
+
+		if (count_y > 4)
+		{
+			count_y = 4;
+		}
+
+		for (x = 0; x < w; x++)
+		{
+			count_x = width - x * 4;
+
+			if (count_x > 4)
+			{
+				count_x = 4;
+			}
+
+			block = src + (y * w + x) * block_size;
+			texels = dst + y * 4 * pitch + x * 16;
+
+			switch (format)
+			{
+				case DDSFMT_DXT1:
+					decompress_dxt_color(block, 1, pitch,
+						count_x, count_y, texels);
+					break;
+				case DDSFMT_DXT2:
+				case DDSFMT_DXT3:
+					decompress_dxt_color(block + 8, 0, pitch,
+						count_x, count_y, texels);
+					decompress_dxt_explicit_alpha(block, pitch,
+						count_x, count_y, texels + 3);
+					break;
+				case DDSFMT_DXT4:
+				case DDSFMT_DXT5:
+					decompress_dxt_color(block + 8, 0, pitch,
+						count_x, count_y, texels);
+					decompress_dxt_interpolated_alpha(block,
+						pitch, count_x, count_y, 1,
+						texels + 3);
+					break;
+				case DDSFMT_ATI1:
+					decompress_dxt_interpolated_alpha(block,
+						pitch, count_x, count_y, 4, texels);
+					break;
+				case DDSFMT_ATI2:
+					decompress_dxt_interpolated_alpha(block,
+						pitch, count_x, count_y, 3, texels);
+					decompress_dxt_interpolated_alpha(block + 8,
+						pitch, count_x, count_y, 1,
+						texels + 3);
+					break;
+			}
+		}
+	}
+}
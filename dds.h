@@ -173,6 +173,13 @@ void unpack_ati1(DXTInterpolatedAlphaBlock *block, Uint8 *values);
 void unpack_ati2(DXTInterpolatedAlphaBlock *first_block, DXTInterpolatedAlphaBlock *second_block,
 	Uint8 *values);
 
+Uint32 get_dxt_block_size(const Uint32 format);
+/* Decompresses row_count rows of 4x4 blocks, starting at block row first_row,
+ * of one compressed level at src into the RGBA8 image dst of the same level. */
+void decompress_dxt_rows(const Uint32 format, const Uint8 *src,
+	const Uint32 width, const Uint32 height, const Uint32 first_row,
+	const Uint32 row_count, Uint8 *dst);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
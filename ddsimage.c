@@ -13,6 +13,8 @@
 #include "el_memory.h"
 #include "io/elfilewrapper.h"
 #include <assert.h>
+#include <SDL_cpuinfo.h>
+#include <SDL_thread.h>
 
 static Uint32 decompression_needed(const DdsHeader *header,
 	const Uint32 compression, const Uint32 unpack)
@@ -416,127 +418,84 @@ static Uint32 init_dds_image(el_file_ptr file, DdsHeader *header)
 	return validate_header(header, el_file_name(file));
 }
 
-static void read_colors_block(el_file_ptr file, DXTColorBlock *colors)
-{
-	Uint32 i;
-
-	el_read(file, sizeof(DXTColorBlock), colors);
-
-	for (i = 0; i < 2; i++)
-	{
-		colors->m_colors[i] = SDL_SwapLE16(colors->m_colors[i]);
-	}
-}
+/* levels with at least this many texels are decompressed by several threads */
+#define DDS_THREADED_DECOMPRESS_SIZE	(512 * 512)
+#define DDS_MAX_DECOMPRESS_THREADS	8
 
-static void read_interpolated_alphas_block(el_file_ptr file, DXTInterpolatedAlphaBlock *alphas)
+typedef struct
 {
-	el_read(file, sizeof(DXTInterpolatedAlphaBlock), alphas);
-}
-
-static void read_explicit_alphas_block(el_file_ptr file, DXTExplicitAlphaBlock *alphas)
-{
-	Uint32 i;
-
-	el_read(file, sizeof(DXTExplicitAlphaBlock), alphas);
-
-	for (i = 0; i < 4; i++)
-	{
-		alphas->m_alphas[i] = SDL_SwapLE16(alphas->m_alphas[i]);
-	}
-}
-
-static void read_and_decompress_dxt1_block(el_file_ptr file, Uint8 *values)
+	const Uint8 *src;
+	Uint8 *dst;
+	Uint32 format;
+	Uint32 width;
+	Uint32 height;
+	Uint32 first_row;
+	Uint32 row_count;
+} dds_decompress_job;
+
+static int decompress_dds_rows_thread(void *data)
 {
-	DXTColorBlock colors;
-
-	read_colors_block(file, &colors);
-
-	unpack_dxt1(&colors, values);
-}
+	dds_decompress_job *job;
 
-static void read_and_decompress_dxt3_block(el_file_ptr file, Uint8 *values)
-{
-	DXTExplicitAlphaBlock alphas;
-	DXTColorBlock colors;
+	job = (dds_decompress_job *)data;
 
-	read_explicit_alphas_block(file, &alphas);
-	read_colors_block(file, &colors);
+	decompress_dxt_rows(job->format, job->src, job->width, job->height,
+		job->first_row, job->row_count, job->dst);
 
-	unpack_dxt3(&alphas, &colors, values);
+	return 0;
 }
 
-static void read_and_decompress_dxt5_block(el_file_ptr file, Uint8 *values)
+static void decompress_dds_level(const Uint32 format, const Uint8 *src,
+	const Uint32 width, const Uint32 height, Uint8 *dst)
 {
-	DXTInterpolatedAlphaBlock alphas;
-	DXTColorBlock colors;
+	dds_decompress_job jobs[DDS_MAX_DECOMPRESS_THREADS];
+	SDL_Thread *threads[DDS_MAX_DECOMPRESS_THREADS];
+	Uint32 i, rows, thread_count, first_row;
 
-	read_interpolated_alphas_block(file, &alphas);
-	read_colors_block(file, &colors);
+	rows = (height + 3) / 4;
+	thread_count = 1;
 
-	unpack_dxt5(&alphas, &colors, values);
-}
+	if ((width * height) >= DDS_THREADED_DECOMPRESS_SIZE)
+	{
+		thread_count = min2u(max2i(SDL_GetCPUCount(), 1),
+			DDS_MAX_DECOMPRESS_THREADS);
+		thread_count = min2u(thread_count, rows);
+	}
 
-static void read_and_decompress_ati1_block(el_file_ptr file, Uint8 *values)
-{
-	DXTInterpolatedAlphaBlock alphas;
+	first_row = 0;
 
-	read_interpolated_alphas_block(file, &alphas);
+	for (i = 0; i < thread_count; i++)
+	{
+		jobs[i].src = src;
+		jobs[i].dst = dst;
+		jobs[i].format = format;
+		jobs[i].width = width;
+		jobs[i].height = height;
+		jobs[i].first_row = first_row;
+		jobs[i].row_count = (rows * (i + 1)) / thread_count - first_row;
 
-	unpack_ati1(&alphas, values);
-}
+		first_row += jobs[i].row_count;
+	}
 
-static void read_and_decompress_ati2_block(el_file_ptr file, Uint8 *values)
-{
-	DXTInterpolatedAlphaBlock first_block;
-	DXTInterpolatedAlphaBlock second_block;
+	// the calling thread takes the first part itself
+	for (i = 1; i < thread_count; i++)
+	{
+		threads[i] = SDL_CreateThread(decompress_dds_rows_thread,
+			"DDSDecompressThread", &jobs[i]);
 
-	read_interpolated_alphas_block(file, &first_block);
-	read_interpolated_alphas_block(file, &second_block);
+		if (threads[i] == 0)
+		{
+			decompress_dds_rows_thread(&jobs[i]);
+		}
+	}
 
-	unpack_ati2(&first_block, &second_block, values);
-}
+	decompress_dds_rows_thread(&jobs[0]);
 
-static void decompress_block(el_file_ptr file, const Uint32 format,
-	const Uint32 x, const Uint32 y, const Uint32 width, const Uint32 height,
-	const Uint32 offset, Uint8 *dst)
-{
-	Uint8 values[64];
-	Uint32 i, j, index, count_x, count_y;
-
-	switch (format)
-	{
-		case DDSFMT_DXT1:
-			read_and_decompress_dxt1_block(file, values);
-			break;
-		case DDSFMT_DXT2:
-		case DDSFMT_DXT3:
-			read_and_decompress_dxt3_block(file, values);
-			break;
-		case DDSFMT_DXT4:
-		case DDSFMT_DXT5:
-			read_and_decompress_dxt5_block(file, values);
-			break;
-		case DDSFMT_ATI1:
-			read_and_decompress_ati1_block(file, values);
-			break;
-		case DDSFMT_ATI2:
-			read_and_decompress_ati2_block(file, values);
-			break;
-	}
-
-	count_x = min2u(width - x, 4);
-	count_y = min2u(height - y, 4);
-
-	// write 4x4 block to decompressed version
-	for (i = 0; i < count_y; i++)
-	{
-		for (j = 0; j < count_x; j++)
+	for (i = 1; i < thread_count; i++)
+	{
+		if (threads[i] != 0)
 		{
-			index = offset + (y + i) * width + x + j;
-			dst[index * 4 + 0] = values[(i * 4 + j) * 4 + 0];
-			dst[index * 4 + 1] = values[(i * 4 + j) * 4 + 1];
-			dst[index * 4 + 2] = values[(i * 4 + j) * 4 + 2];
-			dst[index * 4 + 3] = values[(i * 4 + j) * 4 + 3];
+			SDL_WaitThread(threads[i], 0);
 		}
 	}
 }
@@ -643,8 +602,9 @@ static void* decompress_dds(el_file_ptr file, DdsHeader *header,
 	const Uint32 strip_mipmaps, const Uint32 base_level)
 {
 	Uint32 width, height, size, format, mipmap_count;
-	Uint32 x, y, i, w, h;
+	Uint32 i, offset;
 	Uint32 index;
+	const Uint8 *src;
 	Uint8 *dest;
 
 	if ((header->m_height % 4) != 0)
@@ -688,27 +648,28 @@ static void* decompress_dds(el_file_ptr file, DdsHeader *header,
 		}
 	}
 
-	dest = malloc_aligned(size, 16);
+	offset = sizeof(DdsHeader) + 4 + get_dds_offset(header, base_level);
 
-	el_seek(file, get_dds_offset(header, base_level), SEEK_CUR);
+	if ((offset + get_dds_size(header, 0, strip_mipmaps, base_level)) >
+		el_get_size(file))
+	{
+		LOG_ERROR("Can`t decompressed DDS file %s because it is too"
+			" small.", el_file_name(file));
+		return 0;
+	}
+
+	src = (const Uint8 *)el_get_pointer(file) + offset;
+
+	dest = malloc_aligned(size, 16);
 
 	for (i = base_level; i < mipmap_count; i++)
 	{
-		w = (width + 3) / 4;
-		h = (height + 3) / 4;
-
 		assert(index * 4 <= size);
 
-		// 4x4 blocks in x/y
-		for (y = 0; y < h; y++)
-		{
-			for (x = 0; x < w; x++)
-			{
-				decompress_block(file, format, x * 4, y * 4,
-					width, height, index, dest);
-			}
-		}
+		decompress_dds_level(format, src, width, height,
+			dest + index * 4);
 
+		src += get_dds_level_size(header, i, 0, 0);
 		index += width * height;
 
 		if (width > 1)
@@ -834,6 +795,7 @@ Uint32 load_dds(el_file_ptr file, const Uint32 compression,
 		image->width = max2u(header.m_width >> start_mipmap, 1);
 		image->height = max2u(header.m_height >> start_mipmap, 1);
 		image->mipmaps = mipmap_count;
+		image->base_level = start_mipmap;
 		image->format = detect_dds_file_format(&header, &image->alpha,
 			&format_unpack);
 
@@ -19,6 +19,7 @@
 #include "items.h"
 #include "map.h"
 #include "multiplayer.h"
+#include "net_stats.h"
 #include "new_actors.h"
 #include "new_character.h"
 #include "pm_log.h"
@@ -180,6 +181,8 @@ void draw_scene()
 			check_then_do_buff_duration_request();
 			/* check if we are doing a server connection test */
 			check_if_testing_server_connection();
+			/* send the automatic pings of the latency statistics */
+			net_stats_timer();
 			/* check if used item counter confirmation has expired */
 			used_item_counter_timer();
 			/* make sure minimised or restored window is noticed */
@@ -0,0 +1,745 @@
+/*
+ * Offline optimizer for e3d meshes.
+ *
+ * Reorders the triangles of every material for the post-transform vertex
+ * cache (using optimize_vertex_cache_order()), then reorders the vertices in
+ * order of first use so vertex fetches are sequential, and writes the file
+ * back with an updated MD5. The file format is unchanged, so the client loads
+ * optimized meshes exactly like any other e3d file.
+ *
+ * Meshes shipped as .e3d.gz or .e3d.xz are decompressed in memory and
+ * written back with the same compression.
+ *
+ * Usage: e3d_optimizer [-c cache_size] [-n] [-f] <file.e3d | directory>...
+ *   -c  size of the simulated vertex cache (default 24)
+ *   -n  dry run, only report the ACMR
+ *   -f  also process files that are already marked as optimized
+ */
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#include "io/elc_io.h"
+#include "io/e3d_io.h"
+#include "io/fileutil.h"
+#include "md5.h"
+#include "optimizer.hpp"
+#include "xz/XzEnc.h"
+
+/* set in e3d_header.reserved_2 for meshes that went through this tool */
+#define E3D_OPTIMIZED_FLAG 0x01
+
+struct optimize_options
+{
+	Uint32 cache_size;
+	bool dry_run;
+	bool force;
+};
+
+enum mesh_compression
+{
+	mc_none,
+	mc_gzip,
+	mc_xz
+};
+
+/* the encoder reads the mesh from memory */
+struct xz_in_stream
+{
+	ISeqInStream stream;
+	const std::vector<Uint8>* data;
+	size_t pos;
+};
+
+/* and writes the compressed file to memory */
+struct xz_out_stream
+{
+	ISeqOutStream stream;
+	std::vector<Uint8>* data;
+};
+
+struct optimize_totals
+{
+	Uint32 files;
+	Uint32 optimized;
+	double triangles;
+	double misses_before;
+	double misses_after;
+};
+
+static Uint32 read_le32(const Uint8* ptr)
+{
+	Uint32 value;
+
+	memcpy(&value, ptr, sizeof(value));
+
+	return SDL_SwapLE32(value);
+}
+
+static void write_le32(Uint8* ptr, const Uint32 value)
+{
+	Uint32 tmp;
+
+	tmp = SDL_SwapLE32(value);
+	memcpy(ptr, &tmp, sizeof(tmp));
+}
+
+static Uint32 read_index(const Uint8* ptr, const Uint32 index_size)
+{
+	Uint16 tmp;
+
+	if (index_size == sizeof(Uint16))
+	{
+		memcpy(&tmp, ptr, sizeof(tmp));
+		return SDL_SwapLE16(tmp);
+	}
+
+	return read_le32(ptr);
+}
+
+static void write_index(Uint8* ptr, const Uint32 index_size, const Uint32 value)
+{
+	Uint16 tmp;
+
+	if (index_size == sizeof(Uint16))
+	{
+		tmp = SDL_SwapLE16(value);
+		memcpy(ptr, &tmp, sizeof(tmp));
+	}
+	else
+	{
+		write_le32(ptr, value);
+	}
+}
+
+static bool read_file(const std::string &name, std::vector<Uint8> &data)
+{
+	FILE* file;
+	long size;
+
+	file = fopen(name.c_str(), "rb");
+	if (file == 0)
+	{
+		return false;
+	}
+
+	fseek(file, 0, SEEK_END);
+	size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	if (size <= 0)
+	{
+		fclose(file);
+		return false;
+	}
+
+	data.resize(size);
+
+	if (fread(&data[0], 1, size, file) != (size_t)size)
+	{
+		fclose(file);
+		return false;
+	}
+
+	fclose(file);
+
+	return true;
+}
+
+static bool write_file(const std::string &name, const std::vector<Uint8> &data)
+{
+	FILE* file;
+	bool result;
+
+	file = fopen(name.c_str(), "wb");
+	if (file == 0)
+	{
+		return false;
+	}
+
+	result = fwrite(&data[0], 1, data.size(), file) == data.size();
+
+	return (fclose(file) == 0) && result;
+}
+
+/* gzip and xz streams, as read by the el file wrappers */
+static mesh_compression get_compression(const std::vector<Uint8> &data)
+{
+	static const Uint8 gz_magic[2] = { 0x1F, 0x8B };
+	static const Uint8 xz_magic[6] = { 0xFD, '7', 'z', 'X', 'Z', 0x00 };
+
+	if ((data.size() >= sizeof(gz_magic)) &&
+		(memcmp(&data[0], gz_magic, sizeof(gz_magic)) == 0))
+	{
+		return mc_gzip;
+	}
+
+	if ((data.size() >= sizeof(xz_magic)) &&
+		(memcmp(&data[0], xz_magic, sizeof(xz_magic)) == 0))
+	{
+		return mc_xz;
+	}
+
+	return mc_none;
+}
+
+static bool gzip_decompress(const std::vector<Uint8> &data, std::vector<Uint8> &mesh)
+{
+	z_stream stream;
+	Uint8 buffer[65536];
+	int result;
+
+	memset(&stream, 0, sizeof(stream));
+
+	/* 16 selects the gzip header */
+	if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK)
+	{
+		return false;
+	}
+
+	stream.next_in = (Bytef*)&data[0];
+	stream.avail_in = data.size();
+	mesh.clear();
+
+	do
+	{
+		stream.next_out = buffer;
+		stream.avail_out = sizeof(buffer);
+		result = inflate(&stream, Z_NO_FLUSH);
+		mesh.insert(mesh.end(), buffer, buffer + sizeof(buffer) - stream.avail_out);
+	}
+	while (result == Z_OK);
+
+	inflateEnd(&stream);
+
+	return result == Z_STREAM_END;
+}
+
+static bool gzip_compress(const std::vector<Uint8> &mesh, std::vector<Uint8> &data)
+{
+	z_stream stream;
+	Uint8 buffer[65536];
+	int result;
+
+	memset(&stream, 0, sizeof(stream));
+
+	if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 9,
+		Z_DEFAULT_STRATEGY) != Z_OK)
+	{
+		return false;
+	}
+
+	stream.next_in = (Bytef*)&mesh[0];
+	stream.avail_in = mesh.size();
+	data.clear();
+
+	do
+	{
+		stream.next_out = buffer;
+		stream.avail_out = sizeof(buffer);
+		result = deflate(&stream, Z_FINISH);
+		data.insert(data.end(), buffer, buffer + sizeof(buffer) - stream.avail_out);
+	}
+	while (result == Z_OK);
+
+	deflateEnd(&stream);
+
+	return result == Z_STREAM_END;
+}
+
+static bool xz_decompress(const std::string &name, std::vector<Uint8> &mesh)
+{
+	FILE* file;
+	void* buffer;
+	Uint64 size;
+	Uint32 result;
+
+	file = fopen(name.c_str(), "rb");
+	if (file == 0)
+	{
+		return false;
+	}
+
+	result = xz_file_read(file, &buffer, &size);
+	fclose(file);
+
+	if (result != 0)
+	{
+		return false;
+	}
+
+	mesh.assign((Uint8*)buffer, (Uint8*)buffer + size);
+	free(buffer);
+
+	return true;
+}
+
+static SRes xz_read(void* p, void* buf, size_t* size)
+{
+	xz_in_stream* in = (xz_in_stream*)p;
+
+	*size = std::min(*size, in->data->size() - in->pos);
+	memcpy(buf, &(*in->data)[in->pos], *size);
+	in->pos += *size;
+
+	return SZ_OK;
+}
+
+static size_t xz_write(void* p, const void* buf, size_t size)
+{
+	xz_out_stream* out = (xz_out_stream*)p;
+
+	out->data->insert(out->data->end(), (const Uint8*)buf, (const Uint8*)buf + size);
+
+	return size;
+}
+
+static bool xz_compress(const std::vector<Uint8> &mesh, std::vector<Uint8> &data)
+{
+	CLzma2EncProps props;
+	xz_in_stream in;
+	xz_out_stream out;
+
+	in.stream.Read = xz_read;
+	in.data = &mesh;
+	in.pos = 0;
+	out.stream.Write = xz_write;
+	out.data = &data;
+	data.clear();
+
+	Lzma2EncProps_Init(&props);
+	props.lzmaProps.level = 9;
+
+	return Xz_Encode(&out.stream, &in.stream, &props, False, 0) == SZ_OK;
+}
+
+/* reads a mesh, decompressed if it is a .e3d.gz or .e3d.xz file */
+static bool read_mesh(const std::string &name, std::vector<Uint8> &mesh,
+	mesh_compression &compression)
+{
+	std::vector<Uint8> data;
+
+	if (!read_file(name, data))
+	{
+		return false;
+	}
+
+	compression = get_compression(data);
+
+	switch (compression)
+	{
+		case mc_gzip:
+			return gzip_decompress(data, mesh);
+		case mc_xz:
+			return xz_decompress(name, mesh);
+		default:
+			mesh.swap(data);
+			return true;
+	}
+}
+
+/* writes a mesh back with the compression it was read with */
+static bool write_mesh(const std::string &name, const std::vector<Uint8> &mesh,
+	const mesh_compression compression)
+{
+	std::vector<Uint8> data;
+
+	switch (compression)
+	{
+		case mc_gzip:
+			return gzip_compress(mesh, data) && write_file(name, data);
+		case mc_xz:
+			return xz_compress(mesh, data) && write_file(name, data);
+		default:
+			return write_file(name, mesh);
+	}
+}
+
+static double count_misses(const std::vector<Uint32> &indices, const Uint32 cache_size)
+{
+	std::vector<Uint32> unique;
+	float acmr;
+
+	acmr = calculate_average_cache_miss_ratio(&indices[0], 0, indices.size(), cache_size);
+
+	/* too small for the cache, every vertex is loaded exactly once */
+	if (acmr < 0.0f)
+	{
+		unique = indices;
+		std::sort(unique.begin(), unique.end());
+
+		return std::unique(unique.begin(), unique.end()) - unique.begin();
+	}
+
+	return acmr * (indices.size() / 3.0);
+}
+
+static void optimize_file(const std::string &name, const optimize_options &options,
+	optimize_totals &totals)
+{
+	std::vector<Uint8> data;
+	std::vector<Uint32> indices, reordered, remap, vertex_order;
+	std::vector<Uint8> vertices;
+	elc_file_header file_header;
+	e3d_header header;
+	MD5 md5;
+	Uint32 header_offset, vertex_no, vertex_size, vertex_offset;
+	Uint32 index_no, index_size, index_offset;
+	Uint32 material_no, material_size, material_offset;
+	Uint32 i, j, index, count, min_index, max_index, next_vertex;
+	Uint8* material;
+	double before, after, file_before, file_after, triangles;
+	mesh_compression compression;
+
+	if (!read_mesh(name, data, compression) || (data.size() < sizeof(elc_file_header)))
+	{
+		fprintf(stderr, "%s: can't read file\n", name.c_str());
+		return;
+	}
+
+	memcpy(&file_header, &data[0], sizeof(file_header));
+
+	if (memcmp(file_header.magic, EL3D_FILE_MAGIC_NUMBER, sizeof(magic_number)) != 0)
+	{
+		fprintf(stderr, "%s: not an e3d file\n", name.c_str());
+		return;
+	}
+
+	if ((file_header.version[0] != 1) || (file_header.version[1] > 1))
+	{
+		fprintf(stderr, "%s: unknown version %d.%d\n", name.c_str(),
+			file_header.version[0], file_header.version[1]);
+		return;
+	}
+
+	header_offset = SDL_SwapLE32(file_header.header_offset);
+
+	if ((header_offset + sizeof(e3d_header)) > data.size())
+	{
+		fprintf(stderr, "%s: file too small\n", name.c_str());
+		return;
+	}
+
+	memcpy(&header, &data[header_offset], sizeof(header));
+
+	totals.files++;
+
+	if (((header.reserved_2 & E3D_OPTIMIZED_FLAG) != 0) && !options.force)
+	{
+		printf("%s: already optimized\n", name.c_str());
+		return;
+	}
+
+	vertex_no = SDL_SwapLE32(header.vertex_no);
+	vertex_size = SDL_SwapLE32(header.vertex_size);
+	vertex_offset = SDL_SwapLE32(header.vertex_offset);
+	index_no = SDL_SwapLE32(header.index_no);
+	index_size = SDL_SwapLE32(header.index_size);
+	index_offset = SDL_SwapLE32(header.index_offset);
+	material_no = SDL_SwapLE32(header.material_no);
+	material_size = SDL_SwapLE32(header.material_size);
+	material_offset = SDL_SwapLE32(header.material_offset);
+
+	if (((index_size != sizeof(Uint16)) && (index_size != sizeof(Uint32))) ||
+		(material_size < sizeof(e3d_material)) ||
+		((vertex_offset + (Uint64)vertex_no * vertex_size) > data.size()) ||
+		((index_offset + (Uint64)index_no * index_size) > data.size()) ||
+		((material_offset + (Uint64)material_no * material_size) > data.size()))
+	{
+		fprintf(stderr, "%s: invalid header\n", name.c_str());
+		return;
+	}
+
+	indices.resize(index_no);
+
+	for (i = 0; i < index_no; i++)
+	{
+		indices[i] = read_index(&data[index_offset + i * index_size], index_size);
+
+		if (indices[i] >= vertex_no)
+		{
+			fprintf(stderr, "%s: index %d out of range\n", name.c_str(), indices[i]);
+			return;
+		}
+	}
+
+	file_before = 0.0;
+	file_after = 0.0;
+	triangles = 0.0;
+
+	for (i = 0; i < material_no; i++)
+	{
+		material = &data[material_offset + i * material_size];
+		index = read_le32(material + offsetof(e3d_material, index));
+		count = read_le32(material + offsetof(e3d_material, count));
+
+		if (((Uint64)index + count) > index_no)
+		{
+			fprintf(stderr, "%s: material %d out of range\n", name.c_str(), i);
+			return;
+		}
+
+		if (count < 3)
+		{
+			continue;
+		}
+
+		reordered.assign(indices.begin() + index, indices.begin() + index + count);
+
+		before = count_misses(reordered, options.cache_size);
+		after = before;
+
+		if (optimize_vertex_cache_order(&reordered[0], 0, count, options.cache_size))
+		{
+			after = count_misses(reordered, options.cache_size);
+
+			if (after < before)
+			{
+				std::copy(reordered.begin(), reordered.end(), indices.begin() + index);
+			}
+			else
+			{
+				after = before;
+			}
+		}
+
+		file_before += before;
+		file_after += after;
+		triangles += count / 3;
+	}
+
+	/* order the vertices by first use, unused vertices go to the end */
+	remap.assign(vertex_no, 0xFFFFFFFF);
+	vertex_order.reserve(vertex_no);
+
+	for (i = 0; i < index_no; i++)
+	{
+		if (remap[indices[i]] == 0xFFFFFFFF)
+		{
+			remap[indices[i]] = vertex_order.size();
+			vertex_order.push_back(indices[i]);
+		}
+	}
+
+	for (i = 0; i < vertex_no; i++)
+	{
+		if (remap[i] == 0xFFFFFFFF)
+		{
+			remap[i] = vertex_order.size();
+			vertex_order.push_back(i);
+		}
+	}
+
+	vertices.resize(vertex_no * vertex_size);
+
+	for (i = 0; i < vertex_no; i++)
+	{
+		memcpy(&vertices[i * vertex_size], &data[vertex_offset + vertex_order[i] * vertex_size],
+			vertex_size);
+	}
+
+	if (vertex_no > 0)
+	{
+		memcpy(&data[vertex_offset], &vertices[0], vertices.size());
+	}
+
+	for (i = 0; i < index_no; i++)
+	{
+		indices[i] = remap[indices[i]];
+		write_index(&data[index_offset + i * index_size], index_size, indices[i]);
+	}
+
+	/* the vertex range of every material changed with the remap */
+	for (i = 0; i < material_no; i++)
+	{
+		material = &data[material_offset + i * material_size];
+		index = read_le32(material + offsetof(e3d_material, index));
+		count = read_le32(material + offsetof(e3d_material, count));
+
+		if (count == 0)
+		{
+			continue;
+		}
+
+		min_index = 0xFFFFFFFF;
+		max_index = 0;
+
+		for (j = index; j < (index + count); j++)
+		{
+			next_vertex = indices[j];
+			min_index = std::min(min_index, next_vertex);
+			max_index = std::max(max_index, next_vertex);
+		}
+
+		write_le32(material + offsetof(e3d_material, triangles_min_index), min_index);
+		write_le32(material + offsetof(e3d_material, triangles_max_index), max_index);
+	}
+
+	if (triangles > 0.0)
+	{
+		printf("%s: %d triangles, ACMR %.3f -> %.3f\n", name.c_str(), (int)triangles,
+			file_before / triangles, file_after / triangles);
+	}
+	else
+	{
+		printf("%s: no triangles\n", name.c_str());
+	}
+
+	totals.triangles += triangles;
+	totals.misses_before += file_before;
+	totals.misses_after += file_after;
+
+	if (options.dry_run)
+	{
+		return;
+	}
+
+	header.reserved_2 |= E3D_OPTIMIZED_FLAG;
+	memcpy(&data[header_offset], &header, sizeof(header));
+
+	MD5Open(&md5);
+	MD5Digest(&md5, &data[header_offset], data.size() - header_offset);
+	MD5Close(&md5, file_header.md5);
+	memcpy(&data[0], &file_header, sizeof(file_header));
+
+	if (!write_mesh(name, data, compression))
+	{
+		fprintf(stderr, "%s: can't write file\n", name.c_str());
+		return;
+	}
+
+	totals.optimized++;
+}
+
+static bool has_extension(const std::string &name, const char* extension)
+{
+	const size_t length = strlen(extension);
+
+	return (name.size() > length) &&
+		(strcasecmp(name.c_str() + name.size() - length, extension) == 0);
+}
+
+static void optimize_path(const std::string &path, const optimize_options &options,
+	optimize_totals &totals)
+{
+	struct stat path_stat;
+	struct dirent* entry;
+	DIR* dir;
+	std::string name;
+
+	if (stat(path.c_str(), &path_stat) != 0)
+	{
+		fprintf(stderr, "%s: no such file or directory\n", path.c_str());
+		return;
+	}
+
+	if (!S_ISDIR(path_stat.st_mode))
+	{
+		optimize_file(path, options, totals);
+		return;
+	}
+
+	dir = opendir(path.c_str());
+	if (dir == 0)
+	{
+		fprintf(stderr, "%s: can't open directory\n", path.c_str());
+		return;
+	}
+
+	while ((entry = readdir(dir)) != 0)
+	{
+		name = entry->d_name;
+
+		if ((name == ".") || (name == ".."))
+		{
+			continue;
+		}
+
+		name = path + "/" + name;
+
+		if ((stat(name.c_str(), &path_stat) == 0) && S_ISDIR(path_stat.st_mode))
+		{
+			optimize_path(name, options, totals);
+		}
+		else if (has_extension(name, ".e3d") || has_extension(name, ".e3d.gz") ||
+			has_extension(name, ".e3d.xz"))
+		{
+			optimize_file(name, options, totals);
+		}
+	}
+
+	closedir(dir);
+}
+
+static void usage(const char* name)
+{
+	fprintf(stderr, "Usage: %s [-c cache_size] [-n] [-f] <file.e3d | directory>...\n", name);
+}
+
+int main(int argc, char* argv[])
+{
+	optimize_options options;
+	optimize_totals totals;
+	int i;
+
+	options.cache_size = 24;
+	options.dry_run = false;
+	options.force = false;
+
+	memset(&totals, 0, sizeof(totals));
+
+	// for the xz checks
+	init_crc_tables();
+
+	for (i = 1; i < argc; i++)
+	{
+		if ((strcmp(argv[i], "-c") == 0) && ((i + 1) < argc))
+		{
+			options.cache_size = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-n") == 0)
+		{
+			options.dry_run = true;
+		}
+		else if (strcmp(argv[i], "-f") == 0)
+		{
+			options.force = true;
+		}
+		else if (argv[i][0] == '-')
+		{
+			usage(argv[0]);
+			return 1;
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	if ((i >= argc) || (options.cache_size < 4))
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	for (; i < argc; i++)
+	{
+		optimize_path(argv[i], options, totals);
+	}
+
+	if (totals.triangles > 0.0)
+	{
+		printf("%d files, %d rewritten, %.0f triangles, ACMR %.3f -> %.3f\n",
+			totals.files, totals.optimized, totals.triangles,
+			totals.misses_before / totals.triangles,
+			totals.misses_after / totals.triangles);
+	}
+
+	return 0;
+}
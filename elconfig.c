@@ -54,6 +54,8 @@
  #include "mapwin.h"
  #include "missiles.h"
  #include "multiplayer.h"
+ #include "net_stats.h"
+#include "packet_record.h"
  #include "new_character.h"
  #include "openingwin.h"
  #include "particles.h"
@@ -96,6 +98,8 @@
 #include "eye_candy_wrapper.h"
 #include "sendvideoinfo.h"
 #include "actor_init.h"
+#include "actor_scripts.h"
+#include "pose_cache.h"
 #include "io/elpathwrapper.h"
 #include "textures.h"
 #ifdef	FSAA
@@ -2069,6 +2073,7 @@ static void init_ELC_vars(void)
 
 	// HUD TAB
 	add_var(OPT_BOOL,"show_fps","fps",&show_fps,change_var,1,"Show FPS","Show the current frames per second in the corner of the window",HUD);
+	add_var(OPT_BOOL,"show_net_stats","netoverlay",&show_net_stats,change_var,0,"Show Network Latency","Show the round trip time, the wait of received messages and the receive jitter below the frames per second. Measures them while shown.",HUD);
 	add_var(OPT_BOOL,"view_analog_clock","analog",&view_analog_clock,change_var,1,"Analog Clock","Toggle the analog clock",HUD);
 	add_var(OPT_BOOL,"view_digital_clock","digit",&view_digital_clock,change_var,1,"Digital Clock","Toggle the digital clock",HUD);
 	add_var(OPT_BOOL,"view_knowledge_bar","knowledge_bar",&view_knowledge_bar,change_var,1,"Knowledge Bar","Toggle the knowledge bar",HUD);
@@ -2196,6 +2201,10 @@ static void init_ELC_vars(void)
 	add_var(OPT_STRING,"browser","b",browser_name,change_string,70,"Browser","Location of your web browser (Windows users leave blank to use default browser)",SERVER);
 	add_var(OPT_BOOL,"write_ini_on_exit", "wini", &write_ini_on_exit, change_var, 1,"Save INI","Save options when you quit",SERVER);
 	add_var(OPT_STRING,"data_dir","dir",datadir,change_dir_name,90,"Data Directory","Place were we keep our data. Can only be changed with a Client restart.",SERVER);
+	add_var(OPT_BOOL,"record_packets","recpkt",&record_packets,change_var,0,"Record Server Messages","Record all messages from the server to the packets folder of the config directory. Recordings can be replayed with #replay <file> [fast].",SERVER);
+	add_var(OPT_INT,"send_delay","senddelay",&tcp_send_delay,change_int,0,"Send Delay","Hold the commands for the server back up to this many milliseconds, so that more of them go out together. With zero, the commands of each frame are sent together.",SERVER,0,250);
+	add_var(OPT_BOOL,"message_stats","msgstats",&message_stats,change_var,0,"Measure Server Messages","Measure the processing time of each type of server message. Use #msgstats to show the slowest types, #msgstats dump [file] to save all statistics.",SERVER);
+	add_var(OPT_BOOL,"net_stats","netstats",&net_stats,change_var,0,"Measure Network Latency","Ping the server every few seconds and measure the round trip time, how long received messages wait before they are processed and the gaps between receives. Use #netstats to show them, #netstats dump [file] or #netstats samples [file] to save them.",SERVER);
 	add_var(OPT_BOOL,"serverpopup","spu",&use_server_pop_win,change_var,1,"Use Special Text Window","Toggles whether server messages from channel 255 are displayed in a pop up window.",SERVER);
 	/* Note: We don't take any action on the already-running thread, as that wouldn't necessarily be good. */
 	add_var(OPT_BOOL,"autoupdate","aup",&auto_update,change_var,1,"Automatic Updates","Toggles whether updates are automatically downloaded.",SERVER);
@@ -2261,6 +2270,11 @@ static void init_ELC_vars(void)
 	add_var (OPT_BOOL, "use_frame_buffer", "fb", &use_frame_buffer, change_frame_buffer, 0, "Toggle Frame Buffer Support", "Toggle frame buffer support. Used for reflection and shadow mapping.", VIDEO);
 	add_var(OPT_INT_F,"water_shader_quality","water_shader_quality",&water_shader_quality,change_water_shader_quality,1,"  water shader quality","Defines what shader is used for water rendering. Higher values are slower but look better. Needs \"toggle frame buffer support\" to be turned on.",VIDEO, int_zero_func, int_max_water_shader_quality);
 	add_var(OPT_BOOL,"small_actor_texture_cache","small_actor_tc",&small_actor_texture_cache,change_small_actor_texture_cache,0,"Small actor texture cache","A small Actor texture cache uses less video memory, but actor loading can be slower.",VIDEO);
+	add_var(OPT_BOOL,"actor_texture_disk_cache","actor_tdc",&actor_texture_disk_cache,change_var,0,"Actor texture disk cache","Store composed actor textures in the actor_textures folder of the config directory, so they don't have to be composed again after a restart. Clear that folder after updating the textures.",VIDEO);
+	add_var(OPT_BOOL,"threaded_texture_loading","threaded_tl",&threaded_texture_loading,change_var,1,"Threaded texture loading","Decode mesh textures in background threads. Objects are drawn with a plain texture until their textures are ready.",VIDEO);
+	add_var(OPT_INT,"texture_memory_budget","tex_budget",&texture_memory_budget,change_int,0,"Texture memory budget","Maximum amount of video memory in megabytes used by textures. The least recently used textures are unloaded when it is exceeded. Zero means no limit.",VIDEO,0,INT_MAX);
+	add_var(OPT_BOOL,"texture_streaming","tex_stream",&texture_streaming,change_var,0,"Texture streaming","Load only the small mipmaps of object textures first and load the detailed ones when objects get close. Needs threaded texture loading.",VIDEO);
+	add_var(OPT_INT,"texture_upload_budget","tex_upload",&texture_upload_budget,change_int,4096,"Texture upload budget","Maximum amount of decoded texture data in kilobytes uploaded to the graphics card per frame. At least one texture is uploaded each frame.",VIDEO,0,INT_MAX);
 	add_var(OPT_BOOL,"use_vertex_buffers","vbo",&use_vertex_buffers,change_vertex_buffers,0,"Vertex Buffer Objects","Toggle the use of the vertex buffer objects, restart required to activate it",VIDEO);
 	add_var(OPT_BOOL, "use_animation_program", "uap", &use_animation_program, change_use_animation_program, 1, "Use animation program", "Use GL_ARB_vertex_program for actor animation", VIDEO);
 	add_var(OPT_BOOL_INI, "video_info_sent", "svi", &video_info_sent, change_var, 0, "Video info sent", "Video information are sent to the server (like OpenGL version and OpenGL extentions)", VIDEO);
@@ -2295,6 +2309,12 @@ static void init_ELC_vars(void)
 	add_var(OPT_FLOAT,"min_ec_framerate","ecminf",&min_ec_framerate,change_min_ec_framerate,15,"Min Effects Framerate","If your framerate is below this amount, eye candy will use minimum detail.",GFX,1.0,FLT_MAX,1.0);
 	add_var(OPT_INT,"light_columns_threshold","lct",&light_columns_threshold,change_int,5,"Light columns threshold","If your framerate is below this amount, you will not get columns of light around teleportation effects (useful for slow systems).",GFX, 0, INT_MAX);
 	add_var(OPT_INT,"max_idle_cycles_per_second","micps",&max_idle_cycles_per_second,change_int,40,"Max Idle Cycles Per Second","The eye candy 'idle' function, which moves particles around, will run no more than this often.  If your CPU is your limiting factor, lowering this can give you a higher framerate.  Raising it gives smoother particle motion (up to the limit of your framerate).",GFX, 1, INT_MAX);
+#ifndef	DYNAMIC_ANIMATIONS
+	add_var(OPT_BOOL,"animation_lod","alod",&animation_lod,change_var,1,"Animation Level of Detail","Animate the actors far away from you less often, and the actors you can't see not at all. Their animations catch up when they come closer.",GFX);
+	add_var(OPT_FLOAT,"animation_lod_near_distance","alodnear",&animation_lod_near_distance,change_float,10.0f,"Animation Near Distance","Actors closer to you than this are animated in every frame.",GFX,1.0,100.0,1.0);
+	add_var(OPT_FLOAT,"animation_lod_far_distance","alodfar",&animation_lod_far_distance,change_float,20.0f,"Animation Far Distance","Actors farther away from you than this are animated at the lowest rate.",GFX,1.0,100.0,1.0);
+	add_var(OPT_INT,"pose_cache_quantum","pcache",&pose_cache_quantum,change_int,0,"Shared Poses","Actors playing the same animations within this many milliseconds share their skeleton pose, which is faster with many actors around. Larger values make the animations less smooth, 0 disables it.",GFX,0,200);
+#endif	//DYNAMIC_ANIMATIONS
 #ifdef	NEW_ALPHA
 	add_var(OPT_BOOL,"use_3d_alpha_blend","3dalpha",&use_3d_alpha_blend,change_var,1,"3D Alpha Blending","Toggle the use of the alpha blending on 3D objects",GFX);
 #endif	//NEW_ALPHA
@@ -2347,6 +2367,10 @@ static void init_ELC_vars(void)
 	add_var(OPT_BOOL, "square_buttons", "sqbutt",&square_buttons,change_var,1,"Square Buttons","Use square buttons rather than rounded",TROUBLESHOOT);
 #endif
 	add_var(OPT_BOOL, "use_animation_program", "uap", &use_animation_program, change_use_animation_program, 1, "Use animation program", "Use GL_ARB_vertex_program for actor animation", TROUBLESHOOT);
+	add_var(OPT_BOOL, "use_fast_skinning", "fskin", &use_fast_skinning, change_var, 1, "Fast skinning", "Use the built in SIMD code to skin the actors on all CPU cores when the animation program is not used. Disable this if actors look distorted.", TROUBLESHOOT);
+#ifndef	DYNAMIC_ANIMATIONS
+	add_var(OPT_BOOL, "parallel_animation", "panim", &parallel_animation, change_var, 1, "Parallel animation", "Update the actor animations on all CPU cores. Disable this if actors are animated wrongly.", TROUBLESHOOT);
+#endif	//DYNAMIC_ANIMATIONS
 	add_var(OPT_BOOL,"poor_man","poor",&poor_man,change_poor_man,0,"Poor Man","If the game is running very slow for you, toggle this setting.",TROUBLESHOOT);
 	// TROUBLESHOOT TAB
 
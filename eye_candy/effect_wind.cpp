@@ -270,9 +270,9 @@ namespace ec
 					state = 1;
 					return true;
 				}
-				effect->particles.erase(this);
+				effect->unregister_particle(this);
 				effect = iter->neighbor;
-				effect->particles[this] = true;
+				effect->register_particle(this);
 			}
 		}
 		else
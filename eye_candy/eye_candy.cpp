@@ -3,6 +3,7 @@
 #include <SDL.h>
 #include <SDL_image.h>
 #include <errno.h>
+#include <new>
 
 #include "eye_candy.h"
 #include "../platform.h"
@@ -129,7 +130,7 @@ namespace ec
 
 	void Effect::build_particle_buffer(const Uint64 time_diff)
 	{
-		std::map<Particle*, bool>::const_iterator iter;
+		ParticleList<&Particle::effect_index>::const_iterator iter;
 		const Vec3 center(base->center);
 		Uint32 size;
 
@@ -162,7 +163,7 @@ namespace ec
 		{
 			for (iter = particles.begin(); iter != particles.end(); iter++)
 			{
-				Particle* p = iter->first;
+				Particle* p = *iter;
 				const coord_t dist_squared = (p->pos - center).magnitude_squared();
 				if (dist_squared < MAX_DRAW_DISTANCE_SQUARED)
 					p->draw(time_diff);
@@ -172,7 +173,7 @@ namespace ec
 		{
 			for (iter = particles.begin(); iter != particles.end(); iter++)
 			{
-				Particle* p = iter->first;
+				Particle* p = *iter;
 				p->draw(time_diff);
 			}
 		}
@@ -1098,15 +1099,60 @@ namespace ec
 		return ret;
 	}
 
+	// Particles are allocated from one pool for each multiple of the
+	// granularity.  Freed blocks are kept for the next particle of the same
+	// size, so effects that keep spawning and killing particles don't
+	// allocate once their pools are large enough.  The chunks are never
+	// freed; plain arrays are used because the global EyeCandy object still
+	// deletes particles while the statics are destroyed.
+#define PARTICLE_POOL_GRANULARITY 16
+#define PARTICLE_POOL_COUNT 64 // Larger particles use the global operator new.
+#define PARTICLE_POOL_CHUNK_SIZE (64 * 1024)
+
+	union ParticlePoolBlock
+	{
+		ParticlePoolBlock* next;
+		char padding[PARTICLE_POOL_GRANULARITY];
+	};
+
+	static ParticlePoolBlock* particle_pool_free[PARTICLE_POOL_COUNT];
+	static ParticlePoolBlock* particle_pool_chunks = NULL;
+
+	static void fill_particle_pool(const size_t pool)
+	{
+		const size_t block_size = pool * PARTICLE_POOL_GRANULARITY;
+		ParticlePoolBlock* chunk = static_cast<ParticlePoolBlock*>(malloc(PARTICLE_POOL_CHUNK_SIZE));
+
+		if (!chunk)
+			throw std::bad_alloc();
+
+		// The first block links the chunks, so they stay reachable.
+		chunk->next = particle_pool_chunks;
+		particle_pool_chunks = chunk;
+
+		for (size_t offset = PARTICLE_POOL_GRANULARITY; offset + block_size
+			<= PARTICLE_POOL_CHUNK_SIZE; offset += block_size)
+		{
+			ParticlePoolBlock* block = reinterpret_cast<ParticlePoolBlock*>(
+				reinterpret_cast<char*>(chunk) + offset);
+			block->next = particle_pool_free[pool];
+			particle_pool_free[pool] = block;
+		}
+	}
+
 	Particle::Particle(Effect* _effect, ParticleMover* _mover, const Vec3 _pos,
 		const Vec3 _velocity, const coord_t _size)
 	{
 		effect = _effect;
 		base = effect->base;
 		cur_motion_blur_point = 0;
-		motion_blur = new ParticleHistory[effect->motion_blur_points];
-		for (int i = 0; i < effect->motion_blur_points; i++)
-			motion_blur[i].alpha = 0;
+		motion_blur = NULL;
+		if (effect->motion_blur_points > 0)
+		{
+			motion_blur = new ParticleHistory[effect->motion_blur_points];
+			for (int i = 0; i < effect->motion_blur_points; i++)
+				motion_blur[i].alpha = 0;
+		}
 		mover = _mover;
 		pos = _pos;
 		velocity = _velocity;
@@ -1124,6 +1170,39 @@ namespace ec
 	}
 	;
 
+	void* Particle::operator new(size_t size)
+	{
+		const size_t pool = (size + PARTICLE_POOL_GRANULARITY - 1) / PARTICLE_POOL_GRANULARITY;
+
+		if (pool >= PARTICLE_POOL_COUNT)
+			return ::operator new(size);
+
+		if (!particle_pool_free[pool])
+			fill_particle_pool(pool);
+
+		ParticlePoolBlock* block = particle_pool_free[pool];
+		particle_pool_free[pool] = block->next;
+		return block;
+	}
+
+	void Particle::operator delete(void* ptr, size_t size)
+	{
+		const size_t pool = (size + PARTICLE_POOL_GRANULARITY - 1) / PARTICLE_POOL_GRANULARITY;
+
+		if (!ptr)
+			return;
+
+		if (pool >= PARTICLE_POOL_COUNT)
+		{
+			::operator delete(ptr);
+			return;
+		}
+
+		ParticlePoolBlock* block = static_cast<ParticlePoolBlock*>(ptr);
+		block->next = particle_pool_free[pool];
+		particle_pool_free[pool] = block;
+	}
+
 	void Particle::draw(const Uint64 usec)
 	{
 		alpha_t burn = get_burn();
@@ -1754,7 +1833,7 @@ namespace ec
 
 	EyeCandy::~EyeCandy()
 	{
-		for (std::vector<Particle*>::iterator iter = particles.begin(); iter
+		for (ParticleList<&Particle::base_index>::iterator iter = particles.begin(); iter
 			!= particles.end(); iter++)
 			delete *iter;
 		for (std::vector<Effect*>::iterator iter = effects.begin(); iter
@@ -1902,7 +1981,7 @@ namespace ec
 		}
 		else
 		{
-			particles.push_back(p);
+			particles.insert(p);
 			p->effect->register_particle(p);
 			light_estimate += p->estimate_light_level();
 			//    allowable_particles_to_add--;
@@ -2228,8 +2307,7 @@ namespace ec
 			for (int i = 0; i < (int)particles.size(); ) //Iterate using an int, not an iterator, because we may be adding/deleting entries, and that messes up iterators.
 
 			{
-				std::vector<Particle*>::iterator iter = particles.begin() + i;
-				Particle* p = *iter;
+				Particle* p = particles[i];
 
 				counter -= particle_cleanout_rate;
 				if (counter < 0) // Kill off a random particle.
@@ -2238,7 +2316,7 @@ namespace ec
 					counter++;
 					if ((p->deletable()) && (!p->effect->active))
 					{
-						particles.erase(iter);
+						particles.erase(p); // Moves the last particle to i, which is done next.
 						for (int j = 0; j < (int)light_particles.size(); )
 						{
 							std::vector< std::pair<Particle*, light_t> >::iterator iter2 = light_particles.begin() + j;
@@ -2252,6 +2330,7 @@ namespace ec
 						p->effect->unregister_particle(p);
 						light_estimate -= p->estimate_light_level();
 						delete p;
+						continue;
 					}
 
 					i++;
@@ -2268,8 +2347,7 @@ namespace ec
 				const bool ret = p->idle(time_diff);
 				if (!ret)
 				{
-					iter = particles.begin() + i; //Why the heck do I need to redo this just because I've push_back'ed entries to the vector in idle()?  :P  Makes no sense.  My best guess: array resizing.
-					particles.erase(iter);
+					particles.erase(p);
 					for (int j = 0; j < (int)light_particles.size(); )
 					{
 						std::vector< std::pair<Particle*, light_t> >::iterator iter2 = light_particles.begin() + j;
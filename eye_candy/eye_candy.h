@@ -1007,6 +1007,10 @@ namespace ec
 				const Vec3 _velocity, const coord_t _size = 1.0f);
 			virtual ~Particle();
 
+			// Particles of the same size share a pool of fixed size blocks.
+			static void* operator new(size_t size);
+			static void operator delete(void* ptr, size_t size);
+
 			virtual bool idle(const Uint64 delta_t) = 0;
 			virtual Uint32 get_texture() = 0;
 			virtual light_t estimate_light_level() const = 0;
@@ -1046,7 +1050,77 @@ namespace ec
 
 			ParticleHistory* motion_blur;
 			int cur_motion_blur_point;
+			Uint32 effect_index; // Position in the particles of the effect.
+			Uint32 base_index; // Position in the particles of the EyeCandy object.
+
+	};
+
+	/*!
+	 \brief A dense, unordered list of particles
+
+	 Each particle stores its position in the list, given by the index member,
+	 so it is removed in constant time by moving the last particle into its
+	 place.  This changes the order of the particles, but never reallocates
+	 once the list has been as long as it gets.
+	 */
+	template <Uint32 Particle::*index> class ParticleList
+	{
+		public:
+			typedef std::vector<Particle*>::iterator iterator;
+			typedef std::vector<Particle*>::const_iterator const_iterator;
+
+			void insert(Particle* p)
+			{
+				p->*index = (Uint32)list.size();
+				list.push_back(p);
+			}
+			;
+			void erase(Particle* p)
+			{
+				Particle* last = list.back();
+				list[p->*index] = last;
+				last->*index = p->*index;
+				list.pop_back();
+			}
+			;
+			size_t size() const
+			{
+				return list.size();
+			}
+			;
+			bool empty() const
+			{
+				return list.empty();
+			}
+			;
+			Particle* operator[](const size_t i) const
+			{
+				return list[i];
+			}
+			;
+			iterator begin()
+			{
+				return list.begin();
+			}
+			;
+			iterator end()
+			{
+				return list.end();
+			}
+			;
+			const_iterator begin() const
+			{
+				return list.begin();
+			}
+			;
+			const_iterator end() const
+			{
+				return list.end();
+			}
+			;
 
+		private:
+			std::vector<Particle*> list;
 	};
 
 	/*!
@@ -2009,12 +2083,12 @@ namespace ec
 
 			void register_particle(Particle* p)
 			{
-				particles[p] = true;
+				particles.insert(p);
 			}
 			;
 			void unregister_particle(Particle* p)
 			{
-				particles.erase(particles.find(p));
+				particles.erase(p);
 			}
 			;
 
@@ -2022,13 +2096,13 @@ namespace ec
 			virtual bool idle(const Uint64 usec) = 0;
 			virtual void draw(const Uint64 usec)
 			{
-				for (std::map<Particle*, bool>::iterator iter2 =
+				for (ParticleList<&Particle::effect_index>::iterator iter2 =
 					particles.begin(); iter2 != particles.end(); iter2++)
 				{
 					for (std::vector<Obstruction*>::iterator iter =
 						obstructions->begin(); iter != obstructions->end(); iter++)
 					{
-						(*iter)->get_force_gradient(*(iter2->first));
+						(*iter)->get_force_gradient(**iter2);
 					}
 				}
 			}
@@ -2073,7 +2147,7 @@ namespace ec
 			bool* dead; //Provided by the effect caller; set when this effect is going away.
 			Vec3* pos;
 			std::vector<Obstruction*>* obstructions;
-			std::map<Particle*, bool> particles;
+			ParticleList<&Particle::effect_index> particles;
 			BoundingRange* bounds;
 			bool active;
 			bool recall;
@@ -2184,7 +2258,7 @@ namespace ec
 			Vec3 corner_offset1;
 			Vec3 corner_offset2;
 			std::vector<Effect*> effects;
-			std::vector<Particle*> particles;
+			ParticleList<&Particle::base_index> particles;
 			std::vector<GLenum> lights;
 		};
 
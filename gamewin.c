@@ -34,6 +34,7 @@
 #include "minimap.h"
 #include "missiles.h"
 #include "multiplayer.h"
+#include "net_stats.h"
 #include "paste.h"
 #include "pathfinder.h"
 #ifdef PAWN
@@ -1431,6 +1432,21 @@ static int display_game_handler (window_info *win)
 	}
 	else
 		fps_default_width = 0;
+	if (show_net_stats)
+	{
+		const net_stats_summary_t *rtt = get_net_stats(NET_STATS_RTT);
+		const net_stats_summary_t *wait = get_net_stats(NET_STATS_QUEUE_WAIT);
+		int net_x = win->len_x - hud_x - 22 * win->default_font_len_x;
+		int net_y = (4 + (show_fps ? 2 : 0) * SMALL_FONT_Y_LEN) * win->current_scale;
+
+		glColor3f (1.0f, 1.0f, 1.0f);
+		safe_snprintf((char*)str, sizeof(str), "RTT: %.0f ms p95 %.0f", rtt->last / 1000.0, rtt->p95 / 1000.0);
+		draw_string_zoomed (net_x, net_y, str, 1, win->current_scale);
+		safe_snprintf((char*)str, sizeof(str), "Wait: %.1f ms p95 %.1f", wait->avg / 1000.0, wait->p95 / 1000.0);
+		draw_string_zoomed (net_x, net_y + SMALL_FONT_Y_LEN * win->current_scale, str, 1, win->current_scale);
+		safe_snprintf((char*)str, sizeof(str), "Jitter: %.1f ms", get_net_stats_jitter() / 1000.0);
+		draw_string_zoomed (net_x, net_y + 2 * SMALL_FONT_Y_LEN * win->current_scale, str, 1, win->current_scale);
+	}
 	draw_spell_icon_strings(win);
 
 	CHECK_GL_ERRORS ();
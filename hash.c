@@ -4,19 +4,174 @@
 #include <stdlib.h>
 #include <stdint.h>
 
+/* number of slots of the previous store moved per hash_add()/hash_delete() */
+#define HASH_MOVE_STEP 8
+
+static Uint32 mix_hash(unsigned long int value)
+{
+	Uint32 hash;
+
+	hash = (Uint32)value ^ (Uint32)((value >> 16) >> 16);
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6b;
+	hash ^= hash >> 13;
+	hash *= 0xc2b2ae35;
+	hash ^= hash >> 16;
+
+	/* zero marks an empty slot */
+	return hash | 0x80000000u;
+}
+
+static void insert_slot(hash_table *table, Uint32 hash, void *key, void *item, int append){
+	Uint32 mask=table->size-1;
+	Uint32 pos=hash&mask;
+	Uint32 dist=0, d, th;
+	hash_entry te;
+
+	for(;;){
+		if(!table->hashes[pos]){
+			table->hashes[pos]=hash;
+			table->store[pos].key=key;
+			table->store[pos].item=item;
+			if((int)dist>table->max_dist) table->max_dist=dist;
+			return;
+		}
+		d=(pos-(table->hashes[pos]&mask))&mask;
+		/* new items go in front of the ones with the same home slot, so
+		 * duplicated keys find the last added item first like before */
+		if(d<dist||(d==dist&&!append)){
+			th=table->hashes[pos];
+			te=table->store[pos];
+			table->hashes[pos]=hash;
+			table->store[pos].key=key;
+			table->store[pos].item=item;
+			if((int)dist>table->max_dist) table->max_dist=dist;
+			hash=th;
+			key=te.key;
+			item=te.item;
+			dist=d;
+			append=0;
+		}
+		pos=(pos+1)&mask;
+		dist++;
+	}
+}
+
+static void remove_slot(hash_table *table, Uint32 pos){
+	Uint32 mask=table->size-1;
+	Uint32 next=(pos+1)&mask;
+
+	/* shift the following entries back, there are no tombstones */
+	while(table->hashes[next]&&((next-(table->hashes[next]&mask))&mask)!=0){
+		table->hashes[pos]=table->hashes[next];
+		table->store[pos]=table->store[next];
+		pos=next;
+		next=(next+1)&mask;
+	}
+	table->hashes[pos]=0;
+	table->store[pos].key=NULL;
+	table->store[pos].item=NULL;
+}
+
+static int find_slot(hash_table *table, Uint32 hash, void *key){
+	Uint32 mask=table->size-1;
+	Uint32 pos=hash&mask;
+	Uint32 dist, th;
+
+	for(dist=0;(int)dist<=table->max_dist;dist++){
+		th=table->hashes[pos];
+		if(!th||((pos-(th&mask))&mask)<dist) break;
+		if(th==hash&&table->key_cmp(key,table->store[pos].key)!=0) return pos;
+		pos=(pos+1)&mask;
+	}
+	return -1;
+}
+
+/* the previous store gets emptied while moving, so its entries are only
+ * looked for up to the longest probe distance it had */
+static int find_old_slot(hash_table *table, Uint32 hash, void *key){
+	Uint32 mask=table->old_size-1;
+	Uint32 pos;
+	int dist;
+
+	if(!table->old_store) return -1;
+	for(dist=0;dist<=table->old_max_dist;dist++){
+		pos=(hash+dist)&mask;
+		if(table->old_hashes[pos]==hash&&table->key_cmp(key,table->old_store[pos].key)!=0) return pos;
+	}
+	return -1;
+}
+
+static void move_old_slots(hash_table *table, int count){
+	Uint32 pos;
+
+	while(count-->0&&table->old_store){
+		pos=(table->old_start+table->old_moved)&(table->old_size-1);
+		if(table->old_hashes[pos]){
+			/* moved items are older than the ones already in the new store */
+			insert_slot(table,table->old_hashes[pos],table->old_store[pos].key,table->old_store[pos].item,1);
+			table->old_hashes[pos]=0;
+		}
+		if(++table->old_moved>=table->old_size){
+			free(table->old_store);
+			free(table->old_hashes);
+			table->old_store=NULL;
+			table->old_hashes=NULL;
+			table->old_size=0;
+			table->old_max_dist=0;
+		}
+	}
+}
+
+static int grow_hash_table(hash_table *table){
+	hash_entry *store;
+	Uint32 *hashes;
+	int i;
+
+	if(table->old_store) move_old_slots(table,table->old_size);
+
+	store=(hash_entry*)calloc(table->size*2,sizeof(hash_entry));
+	hashes=(Uint32*)calloc(table->size*2,sizeof(Uint32));
+	if(!store||!hashes) { free(store); free(hashes); return 0; }
+
+	table->old_store=table->store;
+	table->old_hashes=table->hashes;
+	table->old_size=table->size;
+	table->old_max_dist=table->max_dist;
+	table->old_moved=0;
+	/* start at an empty slot, so no probe sequence wraps around */
+	for(i=0;i<table->old_size&&table->old_hashes[i];i++);
+	table->old_start=i;
+
+	table->store=store;
+	table->hashes=hashes;
+	table->size*=2;
+	table->max_dist=0;
+	return 1;
+}
+
 hash_table *create_hash_table(int size, 
 			     unsigned long int (*hashfn)(void *), 
 			     int (*keyfn)(void *, void*),
 			     void (*freefn)(void *)){
 	hash_table *new_table;
+	int slots;
 	
 	new_table=(hash_table*)calloc(1,sizeof(hash_table));
 	if(!new_table) return NULL;
 
-	new_table->store=(hash_entry**)calloc(size,sizeof(hash_entry*));
-	if(!new_table->store) { free(new_table); return NULL;}
+	for(slots=8;slots<size;slots*=2);
+
+	new_table->store=(hash_entry*)calloc(slots,sizeof(hash_entry));
+	new_table->hashes=(Uint32*)calloc(slots,sizeof(Uint32));
+	if(!new_table->store||!new_table->hashes) {
+		free(new_table->store);
+		free(new_table->hashes);
+		free(new_table);
+		return NULL;
+	}
 	
-	new_table->size=size;
+	new_table->size=slots;
 	new_table->items=0;
 	new_table->hash_fun=hashfn;
 	new_table->key_cmp=keyfn;
@@ -27,22 +182,18 @@ hash_table *create_hash_table(int size,
 
 int destroy_hash_table(hash_table *table){
 	int i;
-	hash_entry *he=NULL, *ht=NULL;
 
 	if(table){
-		if(table->store) {
-			if (table->free_fun)
-				for(i=0;i<table->size;i++){
-					he=table->store[i];
-					while(he){
-						ht=he->next;
-						table->free_fun(he->item);
-						free(he);
-						he=ht;
-					}
-				}
-			free(table->store);
+		if (table->free_fun) {
+			for(i=0;i<table->size;i++)
+				if(table->hashes[i]) table->free_fun(table->store[i].item);
+			for(i=0;i<table->old_size;i++)
+				if(table->old_hashes[i]) table->free_fun(table->old_store[i].item);
 		}
+		free(table->store);
+		free(table->hashes);
+		free(table->old_store);
+		free(table->old_hashes);
 		free(table);
 		return 1;
 	}
@@ -50,97 +201,86 @@ int destroy_hash_table(hash_table *table){
 }
 
 hash_entry *hash_get(hash_table *table, void* key){
-	unsigned int pos;
-	hash_entry *he=NULL;
+	Uint32 hash;
+	int pos;
 
 	if(!table||!table->hash_fun||!table->key_cmp) return NULL;
 	
-	pos=(table->hash_fun(key))%table->size;
+	hash=mix_hash(table->hash_fun(key));
 
-	he=table->store[pos];
-	while(he){
-		if(table->key_cmp(key,he->key)!=0) break;
-		he=he->next;
-	}
-	return he;
+	pos=find_slot(table,hash,key);
+	if(pos>=0) return &table->store[pos];
+	pos=find_old_slot(table,hash,key);
+	if(pos>=0) return &table->old_store[pos];
+	return NULL;
 }
 
 int hash_add(hash_table *table, void* key, void *item){
-	unsigned int pos;
-	hash_entry *he=NULL;
 
 	if(!table||!table->hash_fun) return 0;
-	
-	pos=table->hash_fun(key)%table->size;
-	
-	he=(hash_entry*)calloc(1,sizeof(hash_entry));
-	if(!he) return 0;
-	he->key=key;
-	he->item=item;
-	he->next=table->store[pos];
-	table->store[pos]=he;
+
+	if(table->old_store) move_old_slots(table,HASH_MOVE_STEP);
+	/* keep the load below 7/8, the probe sequences stay short */
+	if((table->items+1)*8>table->size*7&&!grow_hash_table(table)
+		&&table->items+1>=table->size) return 0;
+
+	insert_slot(table,mix_hash(table->hash_fun(key)),key,item,0);
 	table->items++;
 	return 1;
 }
 
 int hash_delete(hash_table *table, void *key){
-
-	hash_entry *he,*ht,*hp;
+	Uint32 hash;
+	void *item;
 	int del=0,pos;
 
 	if(!table||!table->hash_fun||!table->key_cmp) return del;
 	
-	pos=table->hash_fun(key)%table->size;
-	he=table->store[pos];
-	ht=NULL;
-	while(he){
-		hp=he->next;
-		if(table->key_cmp(key,he->key)!=0) {
-			if (ht) ht->next=he->next;
-			else table->store[pos]=he->next;
-			if (table->free_fun) 
-				table->free_fun(he->item);			
-			free(he);
-			del++;
-			table->items--;	
-		} else ht=he;
-		he=hp;
+	hash=mix_hash(table->hash_fun(key));
+	while((pos=find_slot(table,hash,key))>=0){
+		item=table->store[pos].item;
+		remove_slot(table,pos);
+		if (table->free_fun) 
+			table->free_fun(item);
+		del++;
+		table->items--;
+	}
+	while((pos=find_old_slot(table,hash,key))>=0){
+		item=table->old_store[pos].item;
+		table->old_hashes[pos]=0;
+		table->old_store[pos].key=NULL;
+		table->old_store[pos].item=NULL;
+		if (table->free_fun) 
+			table->free_fun(item);
+		del++;
+		table->items--;
 	}
+
+	if(table->old_store) move_old_slots(table,HASH_MOVE_STEP);
 	return del;
 }
 
 
 void hash_start_iterator(hash_table *table){ 
 	if(!table) return;
-	table->cur=table->store[0];
-	table->where=-1;
+	table->where=0;
 }
 
 hash_entry *hash_get_next(hash_table *table){
+	int i;
 
-	if(!table||table->where>=table->size) {
-		return NULL;
-	}
-
-	if(table->where==-1&&table->cur&&table->cur==table->store[0]) {
-		table->where++;
-		return table->store[0];
-	}
-
-	if(table->cur&&table->cur->next){
-			return (table->cur = table->cur->next);
-			}
+	if(!table) return NULL;
 
-	table->cur=NULL;
-	table->where++;
-	while(table->where<table->size){
-		if(table->store[table->where]){
-			table->cur=table->store[table->where];
-			break;
+	/* the previous store first, then the current one */
+	while(table->where<table->old_size+table->size){
+		i=table->where++;
+		if(i<table->old_size){
+			if(table->old_hashes[i]) return &table->old_store[i];
 		}
-		table->where++;	  
+		else if(table->hashes[i-table->old_size])
+			return &table->store[i-table->old_size];
 	}
-	return table->cur;
+	return NULL;
 }
 
 
@@ -171,16 +311,48 @@ int cmp_fn_str(void *key1, void *key2){
 
 Uint32 mem_hash(const void* str, const Uint32 len)
 {
-	Uint32 hash, i;
+	const Uint8* data = (const Uint8*)str;
+	Uint32 hash, block, i;
 
 	hash = 2166136261u;
 
-	for (i = 0; i < len; i++)
+	/* MurmurHash3 (x86, 32 bit), four bytes per step */
+	for (i = 0; i + 4 <= len; i += 4)
 	{
-		hash = hash * 1607;
-		hash = hash ^ ((Uint8*)str)[i];
+		memcpy(&block, data + i, 4);
+		block *= 0xcc9e2d51;
+		block = (block << 15) | (block >> 17);
+		block *= 0x1b873593;
+		hash ^= block;
+		hash = (hash << 13) | (hash >> 19);
+		hash = hash * 5 + 0xe6546b64;
 	}
 
+	if (i < len)
+	{
+		block = 0;
+		if (len - i == 3)
+		{
+			block ^= data[i + 2] << 16;
+		}
+		if (len - i >= 2)
+		{
+			block ^= data[i + 1] << 8;
+		}
+		block ^= data[i];
+		block *= 0xcc9e2d51;
+		block = (block << 15) | (block >> 17);
+		block *= 0x1b873593;
+		hash ^= block;
+	}
+
+	hash ^= len;
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6b;
+	hash ^= hash >> 13;
+	hash *= 0xc2b2ae35;
+	hash ^= hash >> 16;
+
 	return hash;
 }
 
@@ -6,15 +6,29 @@
 typedef struct _hash_entry{
 	void *key;
 	void *item;
-	struct _hash_entry *next;
 } hash_entry;
 
+/*
+ * Open addressing table with linear probing and Robin Hood ordering.
+ * When the table grows, the entries of the previous store are moved
+ * over a few at a time by later hash_add()/hash_delete() calls.
+ * Returned entries are only valid until the next hash_add() or
+ * hash_delete() call.
+ */
 typedef struct _hash_table{
 	int size;
 	int items;
-	hash_entry **store;
+	hash_entry *store;
+	Uint32 *hashes;		/* mixed hash of each slot, 0 for an empty slot */
+	int max_dist;		/* the longest probe distance in the store */
+
+	hash_entry *old_store;	/* the previous store, while moving it over */
+	Uint32 *old_hashes;
+	int old_size;
+	int old_max_dist;
+	int old_start;		/* first slot to move, an empty one */
+	int old_moved;		/* number of slots moved so far */
 
-	hash_entry *cur;
 	int where;
 
 	unsigned long int (*hash_fun)(void *);
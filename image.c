@@ -6,10 +6,28 @@
  ****************************************************************************/
 
 #include "image.h"
-#ifdef	USE_SIMD
+
+#if	defined(USE_SIMD) || defined(__SSE2__) || defined(_M_X64)
+#define	IMAGE_SSE2
+#endif
+
+#ifdef	IMAGE_SSE2
+#if	defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define	IMAGE_AVX2
+#define	TARGET_AVX2 __attribute__((target("avx2")))
+#elif	defined(_MSC_VER)
+#define	IMAGE_AVX2
+#define	TARGET_AVX2
+#endif
+#endif
+
+#ifdef	IMAGE_SSE2
 #include "errors.h"
 #include <SDL.h>
-#include <xmmintrin.h>
+#include <emmintrin.h>
+#ifdef	IMAGE_AVX2
+#include <immintrin.h>
+#endif
 
 void unpack_rgba8_sse2(const Uint8* source, const Uint32 size, Uint8* dest)
 {
@@ -196,27 +214,7 @@ void blend_sse2(const Uint8* alpha, const Uint32 size, const Uint8* source0,
 	__m128i t11;
 	Uint32 i;
 
-	LOG_DEBUG_VERBOSE("source0[0]: %d", source0[0]);
-	LOG_DEBUG_VERBOSE("&source0[0]: %p", &(source0[0]));
-	LOG_DEBUG_VERBOSE("source1[0]: %d", source1[0]);
-	LOG_DEBUG_VERBOSE("&source1[0]: %p", &(source1[0]));
-	LOG_DEBUG_VERBOSE("alpha[0]: %d", alpha[0]);
-	LOG_DEBUG_VERBOSE("&alpha[0]: %p", &(alpha[0]));
-	LOG_DEBUG_VERBOSE("dest[0]: %d", dest[0]);
-	LOG_DEBUG_VERBOSE("&dest[0]: %p", &(dest[0]));
-	LOG_DEBUG_VERBOSE("size: %p", size);
-
-	t11 = _mm_cmpeq_epi32(t11, t11);
-
-	LOG_DEBUG_VERBOSE("cmp");
-
-	t2 = (__m128i)_mm_load_ss((float*)alpha);
-
-	LOG_DEBUG_VERBOSE("load");
-
-	t11 = _mm_or_si128(t11, t2);
-
-	LOG_DEBUG_VERBOSE("or");
+	t11 = _mm_set1_epi32(-1);
 
 	for (i = 0; i < (size / 4); i++)
 	{
@@ -263,7 +261,266 @@ Uint32 check_pointer_aligment(const void* ptr)
 {
 	return (((ptrdiff_t)ptr) & 0x0F) == 0;
 }
-#endif
+
+#ifdef	IMAGE_AVX2
+/* The AVX2 kernels do the same math as the SSE2 ones on twice the number
+ * of pixels, using unaligned loads and stores. */
+TARGET_AVX2 static void unpack_rgba8_avx2(const Uint8* source,
+	const Uint32 size, Uint8* dest)
+{
+	__m256i t0, t1, t2;
+	Uint32 i;
+
+	for (i = 0; i < (size / 32); i++)
+	{
+		t0 = _mm256_loadu_si256((__m256i*)&source[i * 32]);
+
+		t1 = _mm256_and_si256(t0, _mm256_set1_epi16(0x00FF));
+		t2 = _mm256_and_si256(t0, _mm256_set1_epi16(0xFF00));
+		t1 = _mm256_shufflelo_epi16(t1, _MM_SHUFFLE(2, 3, 0, 1));
+		t1 = _mm256_shufflehi_epi16(t1, _MM_SHUFFLE(2, 3, 0, 1));
+		t1 = _mm256_or_si256(t1, t2);
+
+		_mm256_storeu_si256((__m256i*)&dest[i * 32], t1);
+	}
+}
+
+/* Unpacks 8 16 bit pixels to 8 RGBA8 pixels, using the masks and factors
+ * of the SSE2 versions. */
+TARGET_AVX2 static inline __m256i unpack_16bit_avx2(const __m128i source,
+	const __m256i mask, const __m256i shift, const __m256i scale0,
+	const __m256i scale1)
+{
+	__m256i t0, t1, t2;
+
+	t0 = _mm256_cvtepu16_epi32(source);
+	t0 = _mm256_or_si256(t0, _mm256_slli_epi32(t0, 16));
+	t1 = _mm256_unpacklo_epi32(t0, t0);
+	t1 = _mm256_and_si256(t1, mask);
+	t1 = _mm256_mullo_epi16(t1, shift);
+	t1 = _mm256_mulhi_epu16(t1, scale0);
+	t1 = _mm256_mulhi_epu16(t1, scale1);
+	t2 = _mm256_unpackhi_epi32(t0, t0);
+	t2 = _mm256_and_si256(t2, mask);
+	t2 = _mm256_mullo_epi16(t2, shift);
+	t2 = _mm256_mulhi_epu16(t2, scale0);
+	t2 = _mm256_mulhi_epu16(t2, scale1);
+
+	return _mm256_packus_epi16(t1, t2);
+}
+
+TARGET_AVX2 static void unpack_r5g6b5_avx2(const Uint8* source,
+	const Uint32 size, Uint8* dest)
+{
+	__m256i mask, shift, scale0, scale1, t0;
+	Uint32 i;
+
+	mask = _mm256_set1_epi64x(0x0000001F07E0F800LL);
+	shift = _mm256_set1_epi64x(0x0000080000080001LL);
+	scale0 = _mm256_set1_epi64x(0x020002605B000260LL);
+	scale1 = _mm256_set1_epi64x(0xFF006ED50B636ED5LL);
+
+	for (i = 0; i < (size / 16); i++)
+	{
+		t0 = unpack_16bit_avx2(
+			_mm_loadu_si128((__m128i*)&source[i * 16]), mask,
+			shift, scale0, scale1);
+		t0 = _mm256_or_si256(t0, _mm256_set1_epi32(0xFF000000));
+
+		_mm256_storeu_si256((__m256i*)&dest[i * 32], t0);
+	}
+}
+
+TARGET_AVX2 static void unpack_rgb5a1_avx2(const Uint8* source,
+	const Uint32 size, Uint8* dest)
+{
+	__m256i mask, shift, scale0, scale1, t0;
+	Uint32 i;
+
+	mask = _mm256_set1_epi64x(0x8000001F03E07C00LL);
+	shift = _mm256_set1_epi64x(0x0001080000400002LL);
+	scale0 = _mm256_set1_epi64x(0x0200026002600260LL);
+	scale1 = _mm256_set1_epi64x(0xFF006ED56ED56ED5LL);
+
+	for (i = 0; i < (size / 16); i++)
+	{
+		t0 = unpack_16bit_avx2(
+			_mm_loadu_si128((__m128i*)&source[i * 16]), mask,
+			shift, scale0, scale1);
+
+		_mm256_storeu_si256((__m256i*)&dest[i * 32], t0);
+	}
+}
+
+TARGET_AVX2 static void unpack_rgba4_avx2(const Uint8* source,
+	const Uint32 size, Uint8* dest)
+{
+	__m256i mask, shift, t0, t1, t2;
+	Uint32 i;
+
+	mask = _mm256_set1_epi64x(0xF000000F00F00F00LL);
+	shift = _mm256_set1_epi64x(0x0001100001000010LL);
+
+	for (i = 0; i < (size / 16); i++)
+	{
+		t0 = _mm256_cvtepu16_epi32(
+			_mm_loadu_si128((__m128i*)&source[i * 16]));
+		t0 = _mm256_or_si256(t0, _mm256_slli_epi32(t0, 16));
+		// converts 4 bit values to 8 bit values (multiply with 17)
+		t1 = _mm256_unpacklo_epi32(t0, t0);
+		t1 = _mm256_and_si256(t1, mask);
+		t1 = _mm256_mullo_epi16(t1, shift);
+		t1 = _mm256_mulhi_epu16(t1, _mm256_set1_epi16(0x0110));
+		t2 = _mm256_unpackhi_epi32(t0, t0);
+		t2 = _mm256_and_si256(t2, mask);
+		t2 = _mm256_mullo_epi16(t2, shift);
+		t2 = _mm256_mulhi_epu16(t2, _mm256_set1_epi16(0x0110));
+		t1 = _mm256_packus_epi16(t1, t2);
+
+		_mm256_storeu_si256((__m256i*)&dest[i * 32], t1);
+	}
+}
+
+TARGET_AVX2 static void unpack_a8_avx2(const Uint8* source,
+	const Uint32 size, Uint8* dest)
+{
+	__m256i t0;
+	Uint32 i;
+
+	for (i = 0; i < (size / 8); i++)
+	{
+		t0 = _mm256_cvtepu8_epi32(
+			_mm_loadl_epi64((__m128i*)&source[i * 8]));
+		t0 = _mm256_slli_epi32(t0, 24);
+
+		_mm256_storeu_si256((__m256i*)&dest[i * 32], t0);
+	}
+}
+
+TARGET_AVX2 static void unpack_l8_avx2(const Uint8* source,
+	const Uint32 size, Uint8* dest)
+{
+	__m256i t0;
+	Uint32 i;
+
+	for (i = 0; i < (size / 8); i++)
+	{
+		t0 = _mm256_cvtepu8_epi32(
+			_mm_loadl_epi64((__m128i*)&source[i * 8]));
+		t0 = _mm256_or_si256(t0, _mm256_slli_epi32(t0, 8));
+		t0 = _mm256_or_si256(t0, _mm256_slli_epi32(t0, 16));
+		t0 = _mm256_or_si256(t0, _mm256_set1_epi32(0xFF000000));
+
+		_mm256_storeu_si256((__m256i*)&dest[i * 32], t0);
+	}
+}
+
+TARGET_AVX2 static void unpack_la8_avx2(const Uint8* source,
+	const Uint32 size, Uint8* dest)
+{
+	__m256i t0, t1;
+	Uint32 i;
+
+	for (i = 0; i < (size / 16); i++)
+	{
+		t0 = _mm256_cvtepu16_epi32(
+			_mm_loadu_si128((__m128i*)&source[i * 16]));
+
+		t1 = _mm256_and_si256(t0, _mm256_set1_epi32(0x000000FF));
+		t1 = _mm256_or_si256(t1, _mm256_slli_epi32(t1, 8));
+		t0 = _mm256_slli_epi32(t0, 16);
+		t1 = _mm256_or_si256(t1, t0);
+
+		_mm256_storeu_si256((__m256i*)&dest[i * 32], t1);
+	}
+}
+
+TARGET_AVX2 static void replace_a8_rgba8_avx2(const Uint8* alpha,
+	const Uint32 size, Uint8* source)
+{
+	__m256i t0, t1;
+	Uint32 i;
+
+	for (i = 0; i < (size / 8); i++)
+	{
+		t0 = _mm256_cvtepu8_epi32(
+			_mm_loadl_epi64((__m128i*)&alpha[i * 8]));
+		t0 = _mm256_slli_epi32(t0, 24);
+		t1 = _mm256_loadu_si256((__m256i*)&source[i * 32]);
+		t1 = _mm256_and_si256(t1, _mm256_set1_epi32(0x00FFFFFF));
+		t1 = _mm256_or_si256(t1, t0);
+
+		_mm256_storeu_si256((__m256i*)&source[i * 32], t1);
+	}
+}
+
+TARGET_AVX2 static void replace_alpha_rgba8_avx2(const Uint8 alpha,
+	const Uint32 size, Uint8* source)
+{
+	__m256i t0, t1;
+	Uint32 i;
+
+	t0 = _mm256_set1_epi32(((Uint32)alpha) << 24);
+
+	for (i = 0; i < (size / 8); i++)
+	{
+		t1 = _mm256_loadu_si256((__m256i*)&source[i * 32]);
+		t1 = _mm256_and_si256(t1, _mm256_set1_epi32(0x00FFFFFF));
+		t1 = _mm256_or_si256(t1, t0);
+
+		_mm256_storeu_si256((__m256i*)&source[i * 32], t1);
+	}
+}
+
+TARGET_AVX2 static void blend_avx2(const Uint8* alpha, const Uint32 size,
+	const Uint8* source0, const Uint8* source1, Uint8* dest)
+{
+	__m256i t0, t1, t2, t3, t4, t5, t6, t7, t8, t9, t10, t11;
+	Uint32 i;
+
+	t11 = _mm256_set1_epi16(0xFFFF);
+
+	for (i = 0; i < (size / 8); i++)
+	{
+		t0 = _mm256_loadu_si256((__m256i*)&(source0[i * 32]));
+		t1 = _mm256_loadu_si256((__m256i*)&(source1[i * 32]));
+		t2 = _mm256_cvtepu8_epi32(
+			_mm_loadl_epi64((__m128i*)&(alpha[i * 8])));
+
+		t2 = _mm256_or_si256(t2, _mm256_slli_epi32(t2, 8));
+		t2 = _mm256_or_si256(t2, _mm256_slli_epi32(t2, 16));
+
+		t3 = _mm256_unpacklo_epi8(t0, t0);
+		t4 = _mm256_unpacklo_epi8(t1, t1);
+
+		t5 = _mm256_unpacklo_epi32(t2, t2);
+		t6 = _mm256_sub_epi16(t11, t5);
+
+		t7 = _mm256_mulhi_epu16(t3, t6);
+		t8 = _mm256_mulhi_epu16(t4, t5);
+
+		t9 = _mm256_adds_epu16(t7, t8);
+		t9 = _mm256_srli_epi16(t9, 8);
+
+		t3 = _mm256_unpackhi_epi8(t0, t0);
+		t4 = _mm256_unpackhi_epi8(t1, t1);
+
+		t5 = _mm256_unpackhi_epi32(t2, t2);
+		t6 = _mm256_sub_epi16(t11, t5);
+
+		t7 = _mm256_mulhi_epu16(t3, t6);
+		t8 = _mm256_mulhi_epu16(t4, t5);
+
+		t10 = _mm256_adds_epu16(t7, t8);
+		t10 = _mm256_srli_epi16(t10, 8);
+
+		t10 = _mm256_packus_epi16(t9, t10);
+
+		_mm256_storeu_si256((__m256i*)&(dest[i * 32]), t10);
+	}
+}
+#endif	/* IMAGE_AVX2 */
+#endif	/* IMAGE_SSE2 */
 
 void unpack(const Uint8* source, const Uint32 count, const Uint32 red,
 	const Uint32 green, const Uint32 blue, const Uint32 alpha, Uint8* dest)
@@ -352,7 +609,60 @@ void unpack(const Uint8* source, const Uint32 count, const Uint32 red,
 void fast_unpack(const Uint8* source, const Uint32 size, const Uint32 red,
 	const Uint32 green, const Uint32 blue, const Uint32 alpha, Uint8* dest)
 {
-#ifdef	USE_SIMD
+#ifdef	IMAGE_AVX2
+	if (SDL_HasAVX2() && ((size & 0x07) == 0))
+	{
+		if ((red == 0x000000FF) && (green == 0x000000FF) &&
+			(blue == 0x000000FF) && (alpha == 0x00000000))
+		{
+			unpack_l8_avx2(source, size, dest);
+			return;
+		}
+
+		if ((red == 0x00000000) && (green == 0x00000000) &&
+			(blue == 0x00000000) && (alpha == 0x000000FF))
+		{
+			unpack_a8_avx2(source, size, dest);
+			return;
+		}
+
+		if ((red == 0x000000FF) && (green == 0x000000FF) &&
+			(blue == 0x000000FF) && (alpha == 0x0000FF00))
+		{
+			unpack_la8_avx2(source, size * 2, dest);
+			return;
+		}
+
+		if ((red == 0x00FF0000) && (green == 0x0000FF00) &&
+			(blue == 0x000000FF) && (alpha == 0xFF000000))
+		{
+			unpack_rgba8_avx2(source, size * 4, dest);
+			return;
+		}
+
+		if ((red == 0x0000F800) && (green == 0x000007E0) &&
+			(blue == 0x0000001F) && (alpha == 0x00000000))
+		{
+			unpack_r5g6b5_avx2(source, size * 2, dest);
+			return;
+		}
+
+		if ((red == 0x00007C00) && (green == 0x000003E0) &&
+			(blue == 0x0000001F) && (alpha == 0x00008000))
+		{
+			unpack_rgb5a1_avx2(source, size * 2, dest);
+			return;
+		}
+
+		if ((red == 0x00000F00) && (green == 0x000000F0) &&
+			(blue == 0x0000000F) && (alpha == 0x0000F000))
+		{
+			unpack_rgba4_avx2(source, size * 2, dest);
+			return;
+		}
+	}
+#endif	/* IMAGE_AVX2 */
+#ifdef	IMAGE_SSE2
 	if (SDL_HasSSE2())
 	{
 		if (((size & 0x0F) == 0) && check_pointer_aligment(source) &&
@@ -416,7 +726,14 @@ void fast_replace_a8_rgba8(const Uint8* alpha, const Uint32 size, Uint8* source)
 {
 	Uint32 i;
 
-#ifdef	USE_SIMD
+#ifdef	IMAGE_AVX2
+	if (SDL_HasAVX2() && ((size & 0x07) == 0))
+	{
+		replace_a8_rgba8_avx2(alpha, size, source);
+		return;
+	}
+#endif	/* IMAGE_AVX2 */
+#ifdef	IMAGE_SSE2
 	if (SDL_HasSSE2())
 	{
 		if (((size & 0x03) == 0) && check_pointer_aligment(source))
@@ -437,7 +754,14 @@ void fast_replace_alpha_rgba8(const Uint8 alpha, const Uint32 size, Uint8* sourc
 {
 	Uint32 i;
 
-#ifdef	USE_SIMD
+#ifdef	IMAGE_AVX2
+	if (SDL_HasAVX2() && ((size & 0x07) == 0))
+	{
+		replace_alpha_rgba8_avx2(alpha, size, source);
+		return;
+	}
+#endif	/* IMAGE_AVX2 */
+#ifdef	IMAGE_SSE2
 	if (SDL_HasSSE2())
 	{
 		if (((size & 0x03) == 0) && check_pointer_aligment(source))
@@ -459,7 +783,14 @@ void fast_blend(const Uint8* alpha, const Uint32 size, const Uint8* source0,
 {
 	Uint32 i, j, tmp;
 
-#ifdef	USE_SIMD
+#ifdef	IMAGE_AVX2
+	if (SDL_HasAVX2() && ((size & 0x07) == 0))
+	{
+		blend_avx2(alpha, size, source0, source1, dest);
+		return;
+	}
+#endif	/* IMAGE_AVX2 */
+#ifdef	IMAGE_SSE2
 	if (SDL_HasSSE2())
 	{
 		if (((size & 0x03) == 0) && check_pointer_aligment(source0) &&
@@ -228,6 +228,7 @@ static Uint32 load_image_SDL(el_file_ptr file, image_t* image)
 	image->width = image_width;
 	image->height = image_height;
 	image->mipmaps = 1;
+	image->base_level = 0;
 	image->format = ift_rgba8;
 	image->sizes[0] = image_width * image_height * 4;
 
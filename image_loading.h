@@ -60,6 +60,7 @@ typedef struct
 	Uint32 width;				/*!< the width of the image in pixels */
 	Uint32 height;				/*!< the height of the image in pixels */
 	Uint32 mipmaps;				/*!< the number of mipmaps of the image */
+	Uint32 base_level;			/*!< the mipmap level of the file the image starts with */
 	image_format_type format;		/*!< the format of the image */
 	Uint8 alpha;				/*!< the image has an alpha channel */
 } image_t;
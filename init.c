@@ -12,6 +12,7 @@
 #include "astrology.h"
 #include "init.h"
 #include "2d_objects.h"
+#include "actor_defs_cache.h"
 #include "actor_scripts.h"
 #include "asc.h"
 #include "books.h"
@@ -86,6 +87,7 @@
 #include "image_loading.h"
 #include "main.h"
 #include "io/fileutil.h"
+#include "worker_pool.h"
 #ifdef  CUSTOM_UPDATE
 #include "custom_update.h"
 #endif  //CUSTOM_UPDATE
@@ -594,6 +596,7 @@ void init_e3d_cache(void)
 	cache_e3d = cache_init("E3d cache", 1500, NULL);	//no aut- free permitted
 	cache_set_compact(cache_e3d, &free_e3d_va);	// to compact, free VA arrays
 	cache_set_time_limit(cache_e3d, 5*60*1000);
+	cache_set_size_limit(cache_e3d, 64*1024*1024);	// compact the meshes not drawn for a while beyond this
 }
 
 #ifndef FASTER_MAP_LOAD
@@ -746,6 +749,7 @@ void init_stuff(void)
 
 	update_loading_win(init_lists_str, 2);
 	init_actors_lists();
+	init_worker_pool();
 	update_loading_win("init particles", 4);
 	memset(tile_list, 0, sizeof(tile_list));
 	memset(lights_list, 0, sizeof(lights_list));
@@ -756,12 +760,9 @@ void init_stuff(void)
 	load_sound_config_data(SOUND_CONFIG_PATH);
 #endif // NEW_SOUND
 	update_loading_win(init_actor_defs_str, 4);
-	memset(actors_defs, 0, sizeof(actors_defs));
-
 	LOG_DEBUG("Init actor defs");
-	init_actor_defs();
+	load_actor_defs();
 	LOG_DEBUG("Init actor defs done");
-	read_emotes_defs("", "emotes.xml");
 
 	missiles_init_defs();
 
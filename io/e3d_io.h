@@ -46,7 +46,7 @@ typedef struct
 	
 	char vertex_options;	/*!< flag determining whether this is a ground object, has tangents or extra uv's */
 	char vertex_format;	/*!< flag determining whether haf floats are used for position, uv and/or extra uv's and if normals and tangents are compressed */
-	char reserved_2;
+	char reserved_2;	/*!< bit 0 is set by e3d_optimizer once the indices and vertices have been reordered */
 	char reserved_3;
 
 } e3d_header;
@@ -48,11 +48,12 @@
 #include "map.h"
 #include "minimap.h"
 #include "multiplayer.h"
+#include "net_stats.h"
+#include "packet_record.h"
 #include "particles.h"
 #include "password_manager.h"
 #include "pm_log.h"
 #include "questlog.h"
-#include "queue.h"
 #include "reflection.h"
 #include "rules.h"
 #include "session.h"
@@ -68,6 +69,7 @@
 #include "url.h"
 #include "user_menus.h"
 #include "weather.h"
+#include "worker_pool.h"
 #ifdef MEMORY_DEBUG
 #include "elmemory.h"
 #endif
@@ -112,6 +114,8 @@ void cleanup_mem(void)
 	destroy_all_actors();
 	LOG_INFO("end_actors_lists()");
 	end_actors_lists();
+	LOG_INFO("free_worker_pool()");
+	free_worker_pool();
 	LOG_INFO("cleanup_lights()");
 	cleanup_lights();
 	/* 2d objects */
@@ -160,13 +164,12 @@ int start_rendering()
 	static Uint32 last_frame_and_command_update = 0;
 
 	SDL_Thread *network_thread;
-	queue_t *message_queue;
 
 #ifndef WINDOWS
 	SDL_EventState(SDL_SYSWMEVENT,SDL_ENABLE);
 #endif
-	queue_initialise(&message_queue);
-	network_thread_data[0] = message_queue;
+	message_ring_initialise(&server_message_ring, MESSAGE_RING_SIZE);
+	network_thread_data[0] = server_message_ring;
 	network_thread_data[1] = &done;
 	network_thread = SDL_CreateThread(get_message_from_server, "NetworkThread", network_thread_data);
 
@@ -190,20 +193,28 @@ int start_rendering()
 			update_session_distance();
 
 			//check for network data
-			if(!queue_isempty(message_queue)) {
-				message_t *message;
+			{
+				const Uint8 *messages[MESSAGE_RING_MAX_BATCH];
+				Uint32 lengths[MESSAGE_RING_MAX_BATCH];
+				Uint32 i, count;
 
-				while((message = queue_pop(message_queue)) != NULL)
+				// the messages are processed where the network thread received them
+				while((count = message_ring_peek_batch(server_message_ring, messages, lengths, MESSAGE_RING_MAX_BATCH)) > 0)
 				{
-					process_message_from_server(message->data, message->length);
-					free(message->data);
-					free(message);
+					for (i = 0; i < count; i++)
+					{
+						record_packet(messages[i], lengths[i]);
+						net_stats_dispatch(message_ring_get_receive_time(server_message_ring, i));
+						process_message_from_server(messages[i], lengths[i]);
+					}
+					message_ring_pop_batch(server_message_ring);
 				}
 			}
+			replay_packets();
 #ifdef	OLC
 			olc_process();
 #endif	//OLC
-			my_tcp_flush(my_socket);    // make sure the tcp output buffer is set
+			my_tcp_flush_due(my_socket, tcp_send_delay);    // send the commands of this frame together
 			
 			if (have_a_map && cur_time > last_frame_and_command_update + 60) {
 				LOCK_ACTORS_LISTS();
@@ -229,6 +240,8 @@ int start_rendering()
 				weather_update();
 
                 animate_actors();
+				check_texture_memory_budget();
+				upload_decoded_textures();
 				//draw everything
 				draw_scene();
 				last_time=cur_time;
@@ -256,8 +269,12 @@ int start_rendering()
 	LOG_INFO("Client closing");
 	LOG_INFO("SDL_WaitThread(network_thread)");
 	SDL_WaitThread(network_thread,&done);
-	LOG_INFO("queue_destroy()");
-	queue_destroy(message_queue);
+	LOG_INFO("stop_packet_recording()");
+	stop_packet_recording();
+	stop_packet_replay();
+	LOG_INFO("message_ring_destroy()");
+	message_ring_destroy(server_message_ring);
+	server_message_ring = NULL;
 	LOG_INFO("free_pm_log()");
 	free_pm_log();
 
@@ -499,6 +516,8 @@ void check_log_level_on_command_line()
 	}
 }
 
+// the actor benchmark has its own main()
+#ifndef	ACTOR_BENCHMARK
 #ifdef WINDOWS
 int Main(int argc, char **argv)
 #else
@@ -632,3 +651,5 @@ int APIENTRY WinMain (HINSTANCE hInst, HINSTANCE hPrev, LPSTR lpCmd, int nShow)
 }
 
 #endif
+
+#endif	//ACTOR_BENCHMARK
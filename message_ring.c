@@ -0,0 +1,490 @@
+#include <stdlib.h>
+#include <string.h>
+#include <SDL_timer.h>
+#include "message_ring.h"
+#include "threads.h"
+#include "errors.h"
+
+#define MESSAGE_RING_STAGE_SIZE	(2 * MESSAGE_RING_MAX_MESSAGE)
+
+int message_ring_initialise(message_ring_t **ring, Uint32 size)
+{
+	if (size < 4 * MESSAGE_RING_MAX_MESSAGE)
+	{
+		size = 4 * MESSAGE_RING_MAX_MESSAGE;
+	}
+
+	(*ring) = calloc(1, sizeof(message_ring_t));
+
+	if ((*ring) == 0)
+	{
+		LOG_ERROR("Failed to allocate memory for message ring");
+
+		return 0;
+	}
+
+	(*ring)->buffer = malloc(size);
+	(*ring)->stage = malloc(MESSAGE_RING_STAGE_SIZE);
+
+	if (((*ring)->buffer == 0) || ((*ring)->stage == 0) ||
+		!queue_initialise(&(*ring)->overflow_queue))
+	{
+		LOG_ERROR("Failed to allocate memory for message ring buffer");
+		free((*ring)->buffer);
+		free((*ring)->stage);
+		free(*ring);
+		(*ring) = 0;
+
+		return 0;
+	}
+
+	(*ring)->size = size;
+	(*ring)->stats.size = size;
+	(*ring)->stats_mutex = SDL_CreateMutex();
+	SDL_AtomicSet(&(*ring)->commit_pos, 0);
+	SDL_AtomicSet(&(*ring)->read_pos, 0);
+	SDL_AtomicSet(&(*ring)->wrap_pos, -1);
+	SDL_AtomicSet(&(*ring)->batch_write, 0);
+	SDL_AtomicSet(&(*ring)->batch_read, 0);
+	SDL_AtomicSet(&(*ring)->overflow_bytes, 0);
+
+	return 1;
+}
+
+void message_ring_destroy(message_ring_t *ring)
+{
+	Uint32 i;
+
+	if (ring == 0)
+	{
+		return;
+	}
+
+	/* the overflow messages of the last peek are no longer in the queue */
+	for (i = 0; i < ring->peek_count; i++)
+	{
+		free(ring->peek_overflow[i]);
+	}
+
+	queue_destroy(ring->overflow_queue);
+	SDL_DestroyMutex(ring->stats_mutex);
+	free(ring->stage);
+	free(ring->buffer);
+	free(ring);
+}
+
+/* skips the end of the ring, the consumer continues at the start */
+static void skip_ring_end(message_ring_t *ring)
+{
+	/* the consumer must see the new wrap position together with the padding */
+	SDL_AtomicSet(&ring->wrap_pos, ring->produced);
+	ring->produced += ring->size - ring->commit;
+	SDL_MemoryBarrierRelease();
+	SDL_AtomicSet(&ring->commit_pos, ring->produced);
+
+	ring->commit = 0;
+	ring->write = 0;
+}
+
+static void start_overflow(message_ring_t *ring)
+{
+	Uint32 partial;
+
+	/* continue the partial message in the stage */
+	partial = ring->write - ring->commit;
+	memcpy(ring->stage, ring->buffer + ring->commit, partial);
+	ring->write = ring->commit;
+	ring->stage_commit = 0;
+	ring->stage_write = partial;
+	ring->overflow = 1;
+}
+
+static int stop_overflow(message_ring_t *ring)
+{
+	Uint32 partial;
+
+	/* keep the order, continue in the ring once the consumer has taken everything */
+	if ((SDL_AtomicGet(&ring->overflow_bytes) != 0) ||
+		((Uint32)SDL_AtomicGet(&ring->read_pos) != ring->produced))
+	{
+		return 0;
+	}
+
+	/* the consumer is done with the bytes before read_pos */
+	SDL_MemoryBarrierAcquire();
+
+	partial = ring->stage_write - ring->stage_commit;
+
+	if (ring->write + partial > ring->size)
+	{
+		skip_ring_end(ring);
+	}
+
+	memcpy(ring->buffer + ring->write, ring->stage + ring->stage_commit, partial);
+	ring->write += partial;
+	ring->overflow = 0;
+
+	return 1;
+}
+
+static Uint8 *get_stage_space(message_ring_t *ring, Uint32 *space)
+{
+	Uint32 partial;
+
+	if (ring->stage_commit > 0)
+	{
+		partial = ring->stage_write - ring->stage_commit;
+		memmove(ring->stage, ring->stage + ring->stage_commit, partial);
+		ring->stage_commit = 0;
+		ring->stage_write = partial;
+	}
+
+	if (SDL_AtomicGet(&ring->overflow_bytes) + MESSAGE_RING_MAX_MESSAGE > MESSAGE_RING_MAX_OVERFLOW)
+	{
+		*space = 0;
+	}
+	else
+	{
+		*space = MESSAGE_RING_STAGE_SIZE - ring->stage_write;
+	}
+
+	return ring->stage + ring->stage_write;
+}
+
+Uint8 *message_ring_get_space(message_ring_t *ring, Uint32 *space)
+{
+	Uint32 used, partial, padding;
+
+	if (ring->overflow && !stop_overflow(ring))
+	{
+		return get_stage_space(ring, space);
+	}
+
+	used = ring->produced - (Uint32)SDL_AtomicGet(&ring->read_pos);
+	SDL_MemoryBarrierAcquire();
+	partial = ring->write - ring->commit;
+
+	if (used > ring->commit)
+	{
+		/* the consumer is still before the end of the ring, the free space is up to it */
+		*space = ring->size - used - partial;
+	}
+	else if (ring->commit + MESSAGE_RING_MAX_MESSAGE <= ring->size)
+	{
+		*space = ring->size - ring->write;
+	}
+	else if (ring->commit - used > partial)
+	{
+		/* the next message might not fit, so skip the end of the ring */
+		memcpy(ring->buffer, ring->buffer + ring->commit, partial);
+		padding = ring->size - ring->commit;
+		skip_ring_end(ring);
+		ring->write = partial;
+		*space = ring->size - used - padding - partial;
+
+		CHECK_AND_LOCK_MUTEX(ring->stats_mutex);
+		ring->stats.wraps++;
+		ring->stats.moved_bytes += partial;
+		CHECK_AND_UNLOCK_MUTEX(ring->stats_mutex);
+	}
+	else
+	{
+		*space = ring->size - ring->write;
+	}
+
+	if (*space == 0)
+	{
+		start_overflow(ring);
+
+		CHECK_AND_LOCK_MUTEX(ring->stats_mutex);
+		ring->stats.full++;
+		CHECK_AND_UNLOCK_MUTEX(ring->stats_mutex);
+
+		return get_stage_space(ring, space);
+	}
+
+	return ring->buffer + ring->write;
+}
+
+void message_ring_received(message_ring_t *ring, Uint32 size)
+{
+	if (ring->overflow)
+	{
+		ring->stage_write += size;
+	}
+	else
+	{
+		ring->write += size;
+	}
+	ring->receive_time = SDL_GetPerformanceCounter();
+}
+
+Uint8 *message_ring_get_pending(message_ring_t *ring, Uint32 *size)
+{
+	if (ring->overflow)
+	{
+		*size = ring->stage_write - ring->stage_commit;
+
+		return ring->stage + ring->stage_commit;
+	}
+
+	*size = ring->write - ring->commit;
+
+	return ring->buffer + ring->commit;
+}
+
+static void commit_overflow(message_ring_t *ring, Uint32 size)
+{
+	message_ring_overflow_t *message;
+
+	message = malloc(sizeof(message_ring_overflow_t) + size);
+
+	if (message == 0)
+	{
+		LOG_ERROR("Failed to allocate memory for message ring overflow");
+		ring->stage_commit += size;
+
+		return;
+	}
+
+	message->time = ring->receive_time;
+	message->length = size;
+	memcpy(message + 1, ring->stage + ring->stage_commit, size);
+	ring->stage_commit += size;
+
+	/* counted first, so the producer never sees zero while the consumer holds a message */
+	SDL_AtomicAdd(&ring->overflow_bytes, size);
+	queue_push(ring->overflow_queue, message);
+
+	CHECK_AND_LOCK_MUTEX(ring->stats_mutex);
+	ring->stats.overflows++;
+	CHECK_AND_UNLOCK_MUTEX(ring->stats_mutex);
+}
+
+void message_ring_commit(message_ring_t *ring, Uint32 size)
+{
+	Uint32 count;
+
+	if (ring->overflow)
+	{
+		commit_overflow(ring, size);
+
+		return;
+	}
+
+	/* all messages of one receive share the receive time */
+	if (ring->batch_time != ring->receive_time)
+	{
+		count = SDL_AtomicGet(&ring->batch_write);
+
+		if (count - (Uint32)SDL_AtomicGet(&ring->batch_read) < MESSAGE_RING_BATCHES)
+		{
+			/* the consumer is done with the batch before batch_read */
+			SDL_MemoryBarrierAcquire();
+			ring->batches[count % MESSAGE_RING_BATCHES].pos = ring->produced;
+			ring->batches[count % MESSAGE_RING_BATCHES].time = ring->receive_time;
+			SDL_MemoryBarrierRelease();
+			SDL_AtomicSet(&ring->batch_write, count + 1);
+			ring->batch_time = ring->receive_time;
+		}
+		/* else out of batches, the message counts as received with the last one */
+	}
+
+	ring->commit += size;
+	ring->produced += size;
+	/* the message bytes before the new commit position */
+	SDL_MemoryBarrierRelease();
+	SDL_AtomicSet(&ring->commit_pos, ring->produced);
+}
+
+void message_ring_discard(message_ring_t *ring)
+{
+	if (ring->overflow)
+	{
+		ring->stage_write = ring->stage_commit;
+	}
+	else
+	{
+		ring->write = ring->commit;
+	}
+}
+
+static Uint64 get_receive_time(message_ring_t *ring, Uint32 pos)
+{
+	Uint32 count, next;
+
+	count = SDL_AtomicGet(&ring->batch_write);
+	SDL_MemoryBarrierAcquire();
+
+	/* the newest batch that started at or before the message holds it */
+	while ((ring->batch_first + 1 != count) && (count != ring->batch_first))
+	{
+		next = (ring->batch_first + 1) % MESSAGE_RING_BATCHES;
+		if ((Sint32)(ring->batches[next].pos - pos) > 0)
+		{
+			break;
+		}
+		ring->batch_first++;
+	}
+
+	if (count == ring->batch_first)
+	{
+		return 0;
+	}
+
+	return ring->batches[ring->batch_first % MESSAGE_RING_BATCHES].time;
+}
+
+Uint32 message_ring_peek_batch(message_ring_t *ring, const Uint8 **messages,
+	Uint32 *lengths, Uint32 max)
+{
+	message_ring_overflow_t *message;
+	Uint32 commit, wrap, pos, offset, count;
+
+	if (max > MESSAGE_RING_MAX_BATCH)
+	{
+		max = MESSAGE_RING_MAX_BATCH;
+	}
+
+	pos = ring->consumed;
+	offset = ring->read;
+	count = 0;
+	commit = SDL_AtomicGet(&ring->commit_pos);
+	SDL_MemoryBarrierAcquire();
+
+	/* messages that went to the overflow queue are newer than any in the ring */
+	if ((pos == commit) && (SDL_AtomicGet(&ring->overflow_bytes) != 0))
+	{
+		commit = SDL_AtomicGet(&ring->commit_pos);
+		SDL_MemoryBarrierAcquire();
+
+		while ((pos == commit) && (count < max) &&
+			((message = queue_pop(ring->overflow_queue)) != 0))
+		{
+			ring->peek_overflow[count] = message;
+			ring->peek_time[count] = message->time;
+			messages[count] = (const Uint8 *)(message + 1);
+			lengths[count] = message->length;
+			count++;
+		}
+	}
+
+	/* read after commit_pos, so it is current for all messages up to there */
+	wrap = SDL_AtomicGet(&ring->wrap_pos);
+	ring->peek_bytes = 0;
+
+	while ((pos != commit) && (count < max))
+	{
+		if (pos == wrap)
+		{
+			pos += ring->size - offset;
+			offset = 0;
+
+			continue;
+		}
+
+		ring->peek_pos[count] = pos;
+		ring->peek_overflow[count] = 0;
+		ring->peek_time[count] = get_receive_time(ring, pos);
+		messages[count] = ring->buffer + offset;
+		lengths[count] = SDL_SwapLE16(*((Uint16*)(ring->buffer + offset + 1))) + 2;
+		pos += lengths[count];
+		offset += lengths[count];
+		ring->peek_bytes += lengths[count];
+		count++;
+	}
+
+	if (commit - ring->consumed > ring->stats.peak_used)
+	{
+		ring->stats.peak_used = commit - ring->consumed;
+	}
+
+	ring->peek_count = count;
+	ring->peek_end = pos;
+	ring->peek_end_offset = offset;
+
+	return count;
+}
+
+void message_ring_pop_batch(message_ring_t *ring)
+{
+	Uint64 now, time, wait;
+	Uint32 i, bytes;
+
+	if (ring->peek_count == 0)
+	{
+		return;
+	}
+
+	now = SDL_GetPerformanceCounter();
+	bytes = 0;
+
+	for (i = 0; i < ring->peek_count; i++)
+	{
+		time = ring->peek_time[i];
+
+		if (ring->peek_overflow[i] != 0)
+		{
+			bytes += ring->peek_overflow[i]->length;
+			ring->stats.bytes += ring->peek_overflow[i]->length;
+			free(ring->peek_overflow[i]);
+			ring->peek_overflow[i] = 0;
+		}
+
+		if (time != 0)
+		{
+			wait = now - time;
+			ring->stats.total_wait += wait;
+			if (wait > ring->stats.max_wait)
+			{
+				ring->stats.max_wait = wait;
+			}
+		}
+	}
+
+	ring->stats.messages += ring->peek_count;
+	ring->stats.batches++;
+	ring->peek_count = 0;
+
+	if (bytes > 0)
+	{
+		SDL_AtomicAdd(&ring->overflow_bytes, -(int)bytes);
+	}
+	else
+	{
+		ring->stats.bytes += ring->peek_bytes;
+		ring->consumed = ring->peek_end;
+		ring->read = ring->peek_end_offset;
+		/* done with the bytes, before the producer may reuse them */
+		SDL_MemoryBarrierRelease();
+		SDL_AtomicSet(&ring->batch_read, ring->batch_first);
+		SDL_AtomicSet(&ring->read_pos, ring->consumed);
+	}
+}
+
+Uint64 message_ring_get_receive_time(const message_ring_t *ring, Uint32 index)
+{
+	if (index >= ring->peek_count)
+	{
+		return 0;
+	}
+
+	return ring->peek_time[index];
+}
+
+void message_ring_get_stats(message_ring_t *ring, message_ring_stats_t *stats)
+{
+	if (ring == 0)
+	{
+		memset(stats, 0, sizeof(message_ring_stats_t));
+
+		return;
+	}
+
+	CHECK_AND_LOCK_MUTEX(ring->stats_mutex);
+
+	*stats = ring->stats;
+	stats->used = (Uint32)SDL_AtomicGet(&ring->commit_pos) - ring->consumed;
+
+	CHECK_AND_UNLOCK_MUTEX(ring->stats_mutex);
+}
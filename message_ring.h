@@ -0,0 +1,217 @@
+/*!
+ * \file
+ * \ingroup network_text
+ * \brief Lock-free byte ring for the messages received from the server.
+ *
+ *      The network thread receives straight into the ring and frames the
+ *      messages in place, the main loop processes them from there. No
+ *      memory is allocated per message. A message is always contiguous,
+ *      if it would not fit before the end of the ring, its received part
+ *      is moved to the start and the end of the ring is skipped.
+ *
+ *      There is exactly one producer (the network thread) and one consumer
+ *      (the main loop). They only share three positions, which are
+ *      exchanged with atomics, so neither side ever waits for the other.
+ *      If the ring is full, the producer continues with a heap allocated
+ *      copy of each message in an overflow queue, until the consumer has
+ *      caught up. Only this overflow path takes a lock.
+ */
+#ifndef	MESSAGE_RING_H
+#define	MESSAGE_RING_H
+
+#include <SDL_types.h>
+#include <SDL_mutex.h>
+#include <SDL_atomic.h>
+#include "queue.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MESSAGE_RING_SIZE		(256 * 1024)	/*!< default size of the ring */
+#define MESSAGE_RING_MAX_MESSAGE	8192	/*!< max. size of one message, including the header */
+#define MESSAGE_RING_BATCHES		64	/*!< receive times kept for the queue wait statistics */
+#define MESSAGE_RING_MAX_BATCH		64	/*!< max. messages returned by one \ref message_ring_peek_batch */
+#define MESSAGE_RING_MAX_OVERFLOW	(4 * 1024 * 1024)	/*!< max. bytes in the overflow queue */
+
+/*!
+ * Statistics of a message ring.
+ */
+typedef struct
+{
+	Uint64 messages;	/*!< messages processed */
+	Uint64 bytes;		/*!< bytes processed */
+	Uint64 batches;		/*!< batches processed */
+	Uint64 wraps;		/*!< how often the producer wrapped to the start */
+	Uint64 moved_bytes;	/*!< bytes of partial messages moved while wrapping */
+	Uint64 overflows;	/*!< messages that went through the overflow queue */
+	Uint64 full;		/*!< how often the producer found the ring full */
+	Uint64 total_wait;	/*!< summed time between receive and processing in performance counter ticks */
+	Uint64 max_wait;	/*!< longest time between receive and processing in performance counter ticks */
+	Uint32 used;		/*!< bytes currently in the ring */
+	Uint32 peak_used;	/*!< max. bytes in the ring */
+	Uint32 size;		/*!< size of the ring */
+} message_ring_stats_t;
+
+/*!
+ * When the receive of a batch of messages started.
+ */
+typedef struct
+{
+	Uint32 pos;		/*!< position of the first message of the batch */
+	Uint64 time;		/*!< performance counter of the receive */
+} message_ring_batch_t;
+
+/*!
+ * A message in the overflow queue.
+ */
+typedef struct
+{
+	Uint64 time;		/*!< performance counter of the receive */
+	Uint32 length;		/*!< size of the message, including the header */
+} message_ring_overflow_t;
+
+/*!
+ * The ring. Positions count the bytes since the ring was created and wrap
+ * around, their offset in the buffer is kept by the side that owns them.
+ * Unprocessed data is in [read_pos, commit_pos), the skipped end of the
+ * ring counts as data. The received part of the next message is in
+ * [commit, write).
+ */
+typedef struct
+{
+	Uint8 *buffer;		/*!< the ring memory */
+	Uint32 size;		/*!< size of the ring memory */
+
+	/* shared */
+	SDL_atomic_t commit_pos;	/*!< end of the complete messages, set by the producer */
+	SDL_atomic_t wrap_pos;	/*!< where the producer last skipped the end of the ring */
+	SDL_atomic_t batch_write;	/*!< number of batches added, set by the producer */
+	SDL_atomic_t overflow_bytes;	/*!< bytes in the overflow queue */
+	Uint8 padding0[64];	/*!< keeps the producer and consumer fields on different cache lines */
+	SDL_atomic_t read_pos;	/*!< start of the unprocessed messages, set by the consumer */
+	SDL_atomic_t batch_read;	/*!< the oldest batch still in use, set by the consumer */
+	Uint8 padding1[64];
+
+	/* producer only */
+	Uint32 produced;	/*!< the value of commit_pos */
+	Uint32 commit;		/*!< offset of commit_pos */
+	Uint32 write;		/*!< end of the received bytes */
+	Uint64 receive_time;	/*!< performance counter of the last receive */
+	Uint64 batch_time;	/*!< receive time of the last batch added */
+	int overflow;		/*!< set while the producer writes to the overflow queue */
+	Uint8 *stage;		/*!< receive buffer while overflowing */
+	Uint32 stage_commit;	/*!< end of the complete messages in the stage */
+	Uint32 stage_write;	/*!< end of the received bytes in the stage */
+	message_ring_batch_t batches[MESSAGE_RING_BATCHES];	/*!< the receive times, written by the producer */
+	Uint8 padding2[64];
+
+	/* consumer only */
+	Uint32 consumed;	/*!< the value of read_pos */
+	Uint32 read;		/*!< offset of read_pos */
+	Uint32 batch_first;	/*!< the value of batch_read */
+	Uint32 peek_count;	/*!< messages returned by the last peek */
+	Uint32 peek_end;	/*!< position after the last peeked message */
+	Uint32 peek_end_offset;	/*!< offset of peek_end */
+	Uint32 peek_bytes;	/*!< size of the peeked messages */
+	Uint32 peek_pos[MESSAGE_RING_MAX_BATCH];	/*!< positions of the peeked messages */
+	message_ring_overflow_t *peek_overflow[MESSAGE_RING_MAX_BATCH];	/*!< the peeked messages, if taken from the overflow queue */
+	Uint64 peek_time[MESSAGE_RING_MAX_BATCH];	/*!< receive times of the peeked messages, zero if unknown */
+	message_ring_stats_t stats;	/*!< the statistics, the producer ones guarded by stats_mutex */
+
+	queue_t *overflow_queue;	/*!< messages that did not fit into the ring */
+	SDL_mutex *stats_mutex;	/*!< guards the statistics updated by the producer */
+} message_ring_t;
+
+/*!
+ * \brief Creates a message ring.
+ * \param ring	where to store the ring
+ * \param size	size of the ring in bytes, at least four times \ref MESSAGE_RING_MAX_MESSAGE
+ * \retval int	one on success, zero on failure
+ */
+int message_ring_initialise(message_ring_t **ring, Uint32 size);
+
+/*!
+ * \brief Frees a message ring.
+ * \param ring	the ring
+ */
+void message_ring_destroy(message_ring_t *ring);
+
+/*!
+ * \brief Gets the free space for receiving, producer only.
+ *
+ *      Moves the partial message to the start of the ring if needed. Returns
+ *      the overflow stage if the ring is full.
+ * \param ring	the ring
+ * \param space	set to the number of contiguous free bytes, zero if the ring and the overflow queue are full
+ * \retval Uint8*	where to receive to
+ */
+Uint8 *message_ring_get_space(message_ring_t *ring, Uint32 *space);
+
+/*!
+ * \brief Adds received bytes, producer only.
+ * \param ring	the ring
+ * \param size	the number of bytes received into the space
+ */
+void message_ring_received(message_ring_t *ring, Uint32 size);
+
+/*!
+ * \brief Gets the received bytes that are not yet framed, producer only.
+ * \param ring	the ring
+ * \param size	set to the number of bytes
+ * \retval Uint8*	the start of the next message
+ */
+Uint8 *message_ring_get_pending(message_ring_t *ring, Uint32 *size);
+
+/*!
+ * \brief Makes the next received message available, producer only.
+ * \param ring	the ring
+ * \param size	size of the message, including the header
+ */
+void message_ring_commit(message_ring_t *ring, Uint32 size);
+
+/*!
+ * \brief Drops the received bytes that are not yet framed, producer only.
+ * \param ring	the ring
+ */
+void message_ring_discard(message_ring_t *ring);
+
+/*!
+ * \brief Gets the next messages to process, consumer only.
+ *
+ *      The messages stay valid until \ref message_ring_pop_batch is called.
+ * \param ring		the ring
+ * \param messages	set to the messages
+ * \param lengths	set to the sizes of the messages, including the header
+ * \param max		the size of the arrays, at most \ref MESSAGE_RING_MAX_BATCH are returned
+ * \retval Uint32	the number of messages, zero if there are none
+ */
+Uint32 message_ring_peek_batch(message_ring_t *ring, const Uint8 **messages,
+	Uint32 *lengths, Uint32 max);
+
+/*!
+ * \brief Releases the messages returned by \ref message_ring_peek_batch, consumer only.
+ * \param ring	the ring
+ */
+void message_ring_pop_batch(message_ring_t *ring);
+
+/*!
+ * \brief Gets when a peeked message was received, consumer only.
+ * \param ring	the ring
+ * \param index	the index of the message in the last \ref message_ring_peek_batch
+ * \retval Uint64	the performance counter of the receive, zero if unknown
+ */
+Uint64 message_ring_get_receive_time(const message_ring_t *ring, Uint32 index);
+
+/*!
+ * \brief Gets the statistics of a ring, consumer only.
+ * \param ring	the ring
+ * \param stats	where to store the statistics
+ */
+void message_ring_get_stats(message_ring_t *ring, message_ring_stats_t *stats);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif	/* MESSAGE_RING_H */
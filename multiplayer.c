@@ -34,6 +34,7 @@
 #include "new_character.h"
 #include "password_manager.h"
 #include "particles.h"
+#include "packet_record.h"
 #include "pathfinder.h"
 #include "questlog.h"
 #include "queue.h"
@@ -55,6 +56,7 @@
 #include "servers.h"
 #include "popup.h"
 #include "missiles.h"
+#include "net_stats.h"
 #include "threads.h"
 
 /* NOTE: This file contains implementations of the following, currently unused, and commented functions:
@@ -78,10 +80,14 @@ unsigned char server_address[60];
 TCPsocket my_socket= 0;
 SDLNet_SocketSet set= 0;
 #define MAX_TCP_BUFFER  8192
-Uint8 tcp_in_data[MAX_TCP_BUFFER];
 Uint8 tcp_out_data[MAX_TCP_BUFFER];
-int in_data_used=0;
+message_ring_t *server_message_ring = NULL;
 int tcp_out_loc= 0;
+int tcp_send_delay= 0;
+static int tcp_out_last= 0;	/* start of the last command in tcp_out_data */
+static int tcp_out_heart_beat= 0;	/* set if tcp_out_data holds a heart beat */
+static Uint32 tcp_out_time= 0;	/* when the first command in tcp_out_data was queued */
+static tcp_send_stats_t tcp_send_stats;
 int previously_logged_in= 0;
 volatile int disconnected= 1;
 time_t last_heart_beat;
@@ -287,6 +293,45 @@ void send_heart_beat()
 	my_tcp_send(my_socket, command, len);
 }
 
+/* writes to the socket and counts the write */
+static int send_to_server(TCPsocket my_socket, const Uint8 *data, int len)
+{
+	int ret;
+
+#ifdef	OLC
+	ret= olc_tcp_send(my_socket, data, len);
+	if (ret > 0)
+	{
+		ret= olc_tcp_flush();
+	}
+#else	//OLC
+	ret= SDLNet_TCP_Send(my_socket, data, len);
+#endif	//OLC
+
+	tcp_send_stats.sends++;
+	if (ret > 0)
+	{
+		tcp_send_stats.bytes += ret;
+	}
+
+	return ret;
+}
+
+/* writes the tcp output buffer out and empties it, the caller holds the lock */
+static int send_tcp_out_data(TCPsocket my_socket)
+{
+	int ret;
+
+	// send all the data in the buffer
+	ret= send_to_server(my_socket, tcp_out_data, tcp_out_loc);
+
+	// empty the buffer
+	tcp_out_loc= 0;
+	tcp_out_heart_beat= 0;
+
+	return ret;
+}
+
 /*!
  * This function sends the tcp output buffer, but without locking
  */
@@ -305,19 +350,7 @@ static int my_locked_tcp_flush(TCPsocket my_socket)
 		send_heart_beat();
 	}
 
-	// send all the data in the buffer
-#ifdef	OLC
-	ret= olc_tcp_send(my_socket, tcp_out_data, tcp_out_loc);
-	if (ret > 0)
-	{
-		ret= olc_tcp_flush();
-	}
-#else	//OLC
-	ret= SDLNet_TCP_Send(my_socket, tcp_out_data, tcp_out_loc);
-#endif	//OLC
-
-	// empty the buffer
-	tcp_out_loc= 0;
+	ret= send_tcp_out_data(my_socket);
 
 	tcp_cache[0]=0;
 
@@ -331,7 +364,8 @@ int my_tcp_send (TCPsocket my_socket, const Uint8 *str, int len)
 
 	CHECK_AND_LOCK_MUTEX(tcp_out_data_mutex);
 
-	if (disconnected)
+	// nothing goes to the server while replaying recorded messages
+	if (disconnected || packet_replay_active)
 	{
 		CHECK_AND_UNLOCK_MUTEX(tcp_out_data_mutex);
 
@@ -418,10 +452,37 @@ int my_tcp_send (TCPsocket my_socket, const Uint8 *str, int len)
 	//update the heartbeat timer
 	last_heart_beat= time(NULL);
 
+	// a new destination supersedes a move that is still waiting in the buffer
+	if ((str[0] == MOVE_TO || str[0] == RUN_TO) && tcp_out_loc > 0 && tcp_out_data[tcp_out_last] == str[0])
+	{
+		tcp_out_loc= tcp_out_last;
+		tcp_send_stats.coalesced++;
+	}
+	// one heart beat per write is enough
+	else if (str[0] == HEART_BEAT && len == 1 && tcp_out_heart_beat)
+	{
+		tcp_send_stats.coalesced++;
+
+		CHECK_AND_UNLOCK_MUTEX(tcp_out_data_mutex);
+
+		return len + 2;
+	}
+
+	tcp_send_stats.commands++;
+
 	// check to see if the data would fit in the buffer
 	if (len + 2 < MAX_TCP_BUFFER)
 	{
 		// yes, buffer it for later processing
+		if (tcp_out_loc == 0)
+		{
+			tcp_out_time= SDL_GetTicks();
+		}
+		if (str[0] == HEART_BEAT)
+		{
+			tcp_out_heart_beat= 1;
+		}
+		tcp_out_last= tcp_out_loc;
 		tcp_out_data[tcp_out_loc] = str[0];	//copy the protocol byte
 		*((short *)(tcp_out_data+tcp_out_loc+1)) = SDL_SwapLE16((Uint16)len);//the data length
 		// copy the rest of the data
@@ -444,11 +505,11 @@ int my_tcp_send (TCPsocket my_socket, const Uint8 *str, int len)
 	*((short *)(new_str+1)) = SDL_SwapLE16((Uint16)len);//the data length
 	// copy the rest of the data
 	memcpy(&new_str[3], &str[1], len-1);
-#ifdef	OLC
-	ret_status = olc_tcp_send(my_socket, new_str, len+2);
-#else	//OLC
-	ret_status = SDLNet_TCP_Send(my_socket, new_str, len+2);
-#endif	//OLC
+	CHECK_AND_LOCK_MUTEX(tcp_out_data_mutex);
+	// keep the order, the buffered commands go first
+	my_locked_tcp_flush(my_socket);
+	ret_status = send_to_server(my_socket, new_str, len+2);
+	CHECK_AND_UNLOCK_MUTEX(tcp_out_data_mutex);
 	free(new_str);
 	return ret_status;
 }
@@ -466,6 +527,48 @@ int my_tcp_flush(TCPsocket my_socket)
 	return result;
 }
 
+int my_tcp_flush_due(TCPsocket my_socket, Uint32 delay)
+{
+	int result = 0;
+
+	CHECK_AND_LOCK_MUTEX(tcp_out_data_mutex);
+
+	if (tcp_out_loc > 0 && SDL_GetTicks() - tcp_out_time >= delay)
+	{
+		result = my_locked_tcp_flush(my_socket);
+	}
+
+	CHECK_AND_UNLOCK_MUTEX(tcp_out_data_mutex);
+
+	return result;
+}
+
+int my_tcp_flush_stalled(TCPsocket my_socket, Uint32 delay)
+{
+	int result = 0;
+
+	CHECK_AND_LOCK_MUTEX(tcp_out_data_mutex);
+
+	// the heart beat and the spam filter cache are left to the main thread
+	if (!disconnected && tcp_out_loc > 0 && SDL_GetTicks() - tcp_out_time >= delay)
+	{
+		result = send_tcp_out_data(my_socket);
+	}
+
+	CHECK_AND_UNLOCK_MUTEX(tcp_out_data_mutex);
+
+	return result;
+}
+
+void get_tcp_send_stats(tcp_send_stats_t *stats)
+{
+	CHECK_AND_LOCK_MUTEX(tcp_out_data_mutex);
+
+	*stats = tcp_send_stats;
+
+	CHECK_AND_UNLOCK_MUTEX(tcp_out_data_mutex);
+}
+
 
 void send_version_to_server(IPaddress *ip)
 {
@@ -509,6 +612,9 @@ void connect_to_server()
 	IPaddress	ip;
 
 	tcp_out_loc= 0; // clear the tcp output buffer
+	tcp_out_heart_beat= 0;
+	memset(&tcp_send_stats, 0, sizeof(tcp_send_stats));
+	tcp_send_stats.start_time= SDL_GetTicks();
 	if(this_version_is_invalid) return;
 	if(set)
 		{
@@ -560,6 +666,8 @@ void connect_to_server()
 			exit(2);
 		}
 	disconnected= 0;
+	if (record_packets)
+		start_packet_recording(NULL);
 	have_storage_list = 0;  //With a reconnect, our cached copy of what's in storage may no longer be accurate
 
 	//send the current version to the server
@@ -672,1614 +780,1759 @@ void send_new_char(char * user_str, char * pass_str, char skin, char hair, char
 #endif
 //---
 
-void process_message_from_server (const Uint8 *in_data, int data_length)
+static void process_raw_text(const Uint8 *in_data, int data_length)
 {
 	Uint8 text_buf[MAX_TCP_BUFFER];
-
-	if (data_length <= 2)
+	int len;
+	
+	if (data_length <= 4)
 	{
-		LOG_WARNING("CAUTION: Possibly forged packet received.\n");
-		return;
+	  LOG_WARNING("CAUTION: Possibly forged RAW_TEXT packet received.\n");
+	  return;
 	}
 
-	//see what kind of data we got
-	switch (in_data[PROTOCOL])
-		{
-		case RAW_TEXT:
-			{
-				int len;
-				
-				if (data_length <= 4)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged RAW_TEXT packet received.\n");
-				  break;
-				}
-
-				safe_strncpy2((char*)text_buf, (char*)&in_data[4], sizeof(text_buf), data_length - 4);
-				len = strlen((char*)text_buf);
+	safe_strncpy2((char*)text_buf, (char*)&in_data[4], sizeof(text_buf), data_length - 4);
+	len = strlen((char*)text_buf);
 
-				// if from the server popup channel
-				if (in_data[3] == server_pop_chan)
-				{
-					if (use_server_pop_win)
-						display_server_popup_win((char*)text_buf);
-					else
-						put_text_in_buffer (in_data[3], text_buf, len);
-					// if we're expecting a quest entry, this will be it
-					if (waiting_for_questlog_entry())
-					{
-						char cur_npc_name[sizeof(npc_name)];
-						safe_strncpy2(cur_npc_name, (char *)npc_name, sizeof(npc_name), sizeof(npc_name));
-						safe_strncpy((char *)npc_name, "<None>", sizeof(npc_name));
-						add_questlog((char*)text_buf, len);
-						safe_strncpy2((char *)npc_name, cur_npc_name, sizeof(npc_name), sizeof(npc_name));
-					}
-				}
+	// if from the server popup channel
+	if (in_data[3] == server_pop_chan)
+	{
+		if (use_server_pop_win)
+			display_server_popup_win((char*)text_buf);
+		else
+			put_text_in_buffer (in_data[3], text_buf, len);
+		// if we're expecting a quest entry, this will be it
+		if (waiting_for_questlog_entry())
+		{
+			char cur_npc_name[sizeof(npc_name)];
+			safe_strncpy2(cur_npc_name, (char *)npc_name, sizeof(npc_name), sizeof(npc_name));
+			safe_strncpy((char *)npc_name, "<None>", sizeof(npc_name));
+			add_questlog((char*)text_buf, len);
+			safe_strncpy2((char *)npc_name, cur_npc_name, sizeof(npc_name), sizeof(npc_name));
+		}
+	}
 
-				// for all other messages do filtering, ignoring and counters checking etc
-				else
-				{
-					len= filter_or_ignore_text((char*)text_buf, len, sizeof (text_buf), in_data[3]);
-					if (len > 0)
-						put_text_in_buffer (in_data[3], text_buf, len);
-				}
-			}
-			break;
+	// for all other messages do filtering, ignoring and counters checking etc
+	else
+	{
+		len= filter_or_ignore_text((char*)text_buf, len, sizeof (text_buf), in_data[3]);
+		if (len > 0)
+			put_text_in_buffer (in_data[3], text_buf, len);
+	}
+}
 
-		case ADD_NEW_ACTOR:
-			{
+static void process_add_new_actor(const Uint8 *in_data, int data_length)
+{
 #ifdef EXTRA_DEBUG
 	ERR();
 #endif
-				if (data_length <= 17)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged ADD_NEW_ACTOR packet received.\n");
-				  break;
-				}
-				add_actor_from_server((char*)&in_data[3], data_length-3);
-			}
-			break;
+	if (data_length <= 17)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged ADD_NEW_ACTOR packet received.\n");
+	  return;
+	}
+	add_actor_from_server((char*)&in_data[3], data_length-3);
+}
 
-		case ADD_NEW_ENHANCED_ACTOR:
-			{
+static void process_add_new_enhanced_actor(const Uint8 *in_data, int data_length)
+{
 #ifdef EXTRA_DEBUG
 	ERR();
 #endif
-				//print_packet(in_data,data_length);
-				if (data_length <= 32)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged ADD_ENHANCED_ACTOR packet received.\n");
-				  break;
-				}
-				add_enhanced_actor_from_server((char*)&in_data[3], data_length-3);
-			}
-			break;
+	//print_packet(in_data,data_length);
+	if (data_length <= 32)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged ADD_ENHANCED_ACTOR packet received.\n");
+	  return;
+	}
+	add_enhanced_actor_from_server((char*)&in_data[3], data_length-3);
+}
 
-		case ADD_ACTOR_COMMAND:
-			{
+static void process_add_actor_command(const Uint8 *in_data, int data_length)
+{
 #ifdef EXTRA_DEBUG
 	ERR();
 #endif
-				// allow for multiple packets in a row
-				while(data_length >= 6){
-					add_command_to_actor(SDL_SwapLE16(*((short *)(in_data+3))), in_data[5]);
-					in_data+= 3;
-					data_length-= 3;
-				}
-			}
-			break;
-		case ADD_ACTOR_ANIMATION:
-			{
+	// allow for multiple packets in a row
+	while(data_length >= 6){
+		add_command_to_actor(SDL_SwapLE16(*((short *)(in_data+3))), in_data[5]);
+		in_data+= 3;
+		data_length-= 3;
+	}
+}
+
+static void process_add_actor_animation(const Uint8 *in_data, int data_length)
+{
 #ifdef EXTRA_DEBUG
 	ERR();
 #endif
-				// allow for multiple packets in a row
-				while(data_length >= 7){
-					add_emote_to_actor(SDL_SwapLE16(*((short *)(in_data+3))),SDL_SwapLE16(*((short *)(in_data+5))));
-					in_data+= 4;
-					data_length-= 4;
-				}
-			}
-			break;
-		case REMOVE_ACTOR:
-			{
+	// allow for multiple packets in a row
+	while(data_length >= 7){
+		add_emote_to_actor(SDL_SwapLE16(*((short *)(in_data+3))),SDL_SwapLE16(*((short *)(in_data+5))));
+		in_data+= 4;
+		data_length-= 4;
+	}
+}
+
+static void process_remove_actor(const Uint8 *in_data, int data_length)
+{
 #ifdef EXTRA_DEBUG
 	ERR();
 #endif
-				// allow for multiple packets in a row
-				while(data_length >= 5){
-					destroy_actor(SDL_SwapLE16(*((short *)(in_data+3))));
-					in_data+= 2;
-					data_length-= 2;
-				}
-			}
-			break;
+	// allow for multiple packets in a row
+	while(data_length >= 5){
+		destroy_actor(SDL_SwapLE16(*((short *)(in_data+3))));
+		in_data+= 2;
+		data_length-= 2;
+	}
+}
 
-		case KILL_ALL_ACTORS:
-			{
+static void process_kill_all_actors(const Uint8 *in_data, int data_length)
+{
 #ifdef EXTRA_DEBUG
 	ERR();
 #endif
-				destroy_all_actors();
-			}
-			break;
+	destroy_all_actors();
+}
 
-		case NEW_MINUTE:
-			{
-				static short last_real_game_minute = -1;
+static void process_new_minute(const Uint8 *in_data, int data_length)
+{
+	static short last_real_game_minute = -1;
 #ifdef EXTRA_DEBUG
 	ERR();
 #endif
 #ifdef DEBUG_TIME
-				return;
+	return;
 #endif
-				if (data_length <= 4)
-				{
-					LOG_WARNING("CAUTION: Possibly forged NEW_MINUTE packet received.\n");
-					break;
-				}
-				real_game_minute= SDL_SwapLE16(*((short *)(in_data+3)));
-				real_game_minute %= 360;
-				real_game_second = 0;
-				set_real_game_second_valid();
-				next_second_time = cur_time+1000;
-				if (real_game_minute < last_real_game_minute)
-					invalidate_date();
-				last_real_game_minute = real_game_minute;
-				new_minute();
-				new_minute_console();
-			}
-			break;
+	if (data_length <= 4)
+	{
+		LOG_WARNING("CAUTION: Possibly forged NEW_MINUTE packet received.\n");
+		return;
+	}
+	real_game_minute= SDL_SwapLE16(*((short *)(in_data+3)));
+	real_game_minute %= 360;
+	real_game_second = 0;
+	set_real_game_second_valid();
+	next_second_time = cur_time+1000;
+	if (real_game_minute < last_real_game_minute)
+		invalidate_date();
+	last_real_game_minute = real_game_minute;
+	new_minute();
+	new_minute_console();
+}
 
-		case LOG_IN_OK:
-			{
-				char str[256];
-				// login and/or new character windows are no longer needed
-				if (login_root_win >= 0) destroy_window (login_root_win);
-				login_root_win = -1;
-				if (newchar_root_win >= 0) {
-					destroy_new_character_interface();
-				}
-				newchar_root_win = -1;
-				if (!get_show_window(console_root_win))
-					show_window (game_root_win);
+static void process_log_in_ok(const Uint8 *in_data, int data_length)
+{
+	char str[256];
+	// login and/or new character windows are no longer needed
+	if (login_root_win >= 0) destroy_window (login_root_win);
+	login_root_win = -1;
+	if (newchar_root_win >= 0) {
+		destroy_new_character_interface();
+	}
+	newchar_root_win = -1;
+	if (!get_show_window(console_root_win))
+		show_window (game_root_win);
 
-				safe_snprintf(str,sizeof(str),"(%s on %s) %s",get_username(),get_server_name(),win_principal);
-				SDL_SetWindowTitle(el_gl_window, str);
+	safe_snprintf(str,sizeof(str),"(%s on %s) %s",get_username(),get_server_name(),win_principal);
+	SDL_SetWindowTitle(el_gl_window, str);
 
 #if defined NEW_SOUND
-				// Try to turn on the music as it isn't needed up until now
-				if (music_on)
-					turn_music_on();
+	// Try to turn on the music as it isn't needed up until now
+	if (music_on)
+		turn_music_on();
 #endif // NEW_SOUND
 
-				passmngr_save_login();
-				load_quickspells();
-				load_recipes();
-				load_server_markings();
-				load_questlog();
-				load_counters();
-				load_channel_colors();
-				send_video_info();
-				check_glow_perk();
-				previously_logged_in=1;
-				last_save_time= time(NULL);
-
-				// Print the game date cos its pretty (its also needed for SKY_FPV to set moons for signs, wonders, times and seasons)
-				command_date("", 0);
-				// print the game time in order to get the seconds for the SKY_FPV feature
-				command_time("", 0);
-				// print the invading monster count
-				safe_snprintf(str, sizeof(str), "%c#il", RAW_TEXT);
-				my_tcp_send(my_socket, (Uint8*)str, strlen(str+1)+1);
-				break;
-			}
+	passmngr_save_login();
+	load_quickspells();
+	load_recipes();
+	load_server_markings();
+	load_questlog();
+	load_counters();
+	load_channel_colors();
+	send_video_info();
+	check_glow_perk();
+	previously_logged_in=1;
+	last_save_time= time(NULL);
+
+	// Print the game date cos its pretty (its also needed for SKY_FPV to set moons for signs, wonders, times and seasons)
+	command_date("", 0);
+	// print the game time in order to get the seconds for the SKY_FPV feature
+	command_time("", 0);
+	// print the invading monster count
+	safe_snprintf(str, sizeof(str), "%c#il", RAW_TEXT);
+	my_tcp_send(my_socket, (Uint8*)str, strlen(str+1)+1);
+}
 
-		case HERE_YOUR_STATS:
-			{
-				if (data_length <= 167)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged HERE_YOUR_STATS packet received.\n");
-				  break;
-				}
-				get_the_stats((Sint16 *)(in_data+3), data_length-3);
-				update_research_rate();
-			}
-			break;
+static void process_here_your_stats(const Uint8 *in_data, int data_length)
+{
+	if (data_length <= 167)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged HERE_YOUR_STATS packet received.\n");
+	  return;
+	}
+	get_the_stats((Sint16 *)(in_data+3), data_length-3);
+	update_research_rate();
+}
 
-		case SEND_PARTIAL_STAT:
-			{
-				// allow for multiple stats in a row
-				while (data_length >= 8)
-				{
-					get_partial_stat (in_data[3], SDL_SwapLE32(*((Sint32 *)(in_data+4))));
-					in_data+= 5;
-					data_length-= 5;
-				}
-				update_research_rate();
-			}
-			break;
+static void process_send_partial_stat(const Uint8 *in_data, int data_length)
+{
+	// allow for multiple stats in a row
+	while (data_length >= 8)
+	{
+		get_partial_stat (in_data[3], SDL_SwapLE32(*((Sint32 *)(in_data+4))));
+		in_data+= 5;
+		data_length-= 5;
+	}
+	update_research_rate();
+}
 
-		case GET_KNOWLEDGE_LIST:
-			{
-				Uint16 size;
-				if (data_length <= 1)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged GET_KNOWLEDGE_LIST packet received.\n");
-				  break;
-				}
-				size = SDL_SwapLE16(*(Uint16 *)(in_data+1))-1;
-				if (data_length <= size + 2)
-				{
-				  LOG_WARNING("CAUTION(2): Possibly forged GET_KNOWLEDGE_LIST packet received.\n");
-				  break;
-				}
-				get_knowledge_list(size, (char*)in_data+3);
-			}
-			break;
+static void process_get_knowledge_list(const Uint8 *in_data, int data_length)
+{
+	Uint16 size;
+	if (data_length <= 1)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged GET_KNOWLEDGE_LIST packet received.\n");
+	  return;
+	}
+	size = SDL_SwapLE16(*(Uint16 *)(in_data+1))-1;
+	if (data_length <= size + 2)
+	{
+	  LOG_WARNING("CAUTION(2): Possibly forged GET_KNOWLEDGE_LIST packet received.\n");
+	  return;
+	}
+	get_knowledge_list(size, (char*)in_data+3);
+}
 
-		case GET_NEW_KNOWLEDGE:
-			{
-				if (data_length <= 4)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged GET_NEW_KNOWLEDGE packet received.\n");
-				  break;
-				}
-				get_new_knowledge(SDL_SwapLE16(*(Uint16 *)(in_data+3)));
-			}
-			break;
+static void process_get_new_knowledge(const Uint8 *in_data, int data_length)
+{
+	if (data_length <= 4)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged GET_NEW_KNOWLEDGE packet received.\n");
+	  return;
+	}
+	get_new_knowledge(SDL_SwapLE16(*(Uint16 *)(in_data+3)));
+}
 
-		case HERE_YOUR_INVENTORY:
-			{
-				int items;
-				int plen;
+static void process_here_your_inventory(const Uint8 *in_data, int data_length)
+{
+	int items;
+	int plen;
 		
-				if (data_length <= 3)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged HERE_YOUR_INVENTORY packet received.\n");
-				  break;
-				}
-				items = in_data[3];
+	if (data_length <= 3)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged HERE_YOUR_INVENTORY packet received.\n");
+	  return;
+	}
+	items = in_data[3];
 
-				// only consider changing item_uid_enabled if we can be sure
-				if ((items > 0) && ((data_length - 4) > 0))
-				{
-					if (data_length - 4 == items * 8 )
-						item_uid_enabled = 0;
-					else if (data_length - 4 == items * 10 )
-						item_uid_enabled = 1;
-					//printf("HERE_YOUR_INVENTORY item_uid_enabled=%d\n", item_uid_enabled);
-				}
+	// only consider changing item_uid_enabled if we can be sure
+	if ((items > 0) && ((data_length - 4) > 0))
+	{
+		if (data_length - 4 == items * 8 )
+			item_uid_enabled = 0;
+		else if (data_length - 4 == items * 10 )
+			item_uid_enabled = 1;
+		//printf("HERE_YOUR_INVENTORY item_uid_enabled=%d\n", item_uid_enabled);
+	}
+
+	if (item_uid_enabled == 0)
+		plen = 8;
+	else
+		plen = 10;
 
-				if (item_uid_enabled == 0)
-					plen = 8;
-				else
-					plen = 10;
+	if (data_length - 4 != items * plen)
+	{
+	  LOG_WARNING("CAUTION(2): Possibly forged HERE_YOUR_INVENTORY packet received.\n");
+	  return;
+	}
+	inventory_item_string[0]=0;
+	inventory_item_string_id=0;
+	get_your_items(in_data+3);
+	trade_post_inventory();
+}
 
-				if (data_length - 4 != items * plen)
-				{
-				  LOG_WARNING("CAUTION(2): Possibly forged HERE_YOUR_INVENTORY packet received.\n");
-				  break;
-				}
-				inventory_item_string[0]=0;
-				inventory_item_string_id=0;
-				get_your_items(in_data+3);
-				trade_post_inventory();
-			}
-			break;
+static void process_get_new_inventory_item(const Uint8 *in_data, int data_length)
+{
+	int plen;
+	if (item_uid_enabled)
+		plen=10;
+	else
+		plen=8;
+	
+	// allow for multiple packets in a row
+	while(data_length >= 3+plen){
+		get_new_inventory_item(in_data+3);
+		in_data+= plen;
+		data_length-= plen;
+	}
+}
+
+static void process_remove_item_from_inventory(const Uint8 *in_data, int data_length)
+{
+	// allow for multiple packets in a row
+	while(data_length >= 4)
+	{
+		remove_item_from_inventory (in_data[3]);
+		in_data+= 1;
+		data_length-= 1;
+	}
+}
 
-		case GET_NEW_INVENTORY_ITEM:
+static void process_inventory_item_text(const Uint8 *in_data, int data_length)
+{
+	if (data_length <= 3)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged INVENTORY_ITEM_TEXT packet received.\n");
+	  return;
+	}
+	safe_strncpy2(inventory_item_string, (const char *)&in_data[3], sizeof(inventory_item_string)-1, data_length - 3);
+	inventory_item_string[sizeof(inventory_item_string)-1] = 0;
+	inventory_item_string_id++;
+	// Start a new block, since C doesn't like variables declared in the middle of a block.
+	{
+		char *teststring = "You successfully created ";
+		int testlen = strlen(teststring);
+		int is_created_message = 0;
+		if ( (data_length > testlen+4) && (!strncmp((char*)in_data+4, teststring, testlen)) )
+		{
+			char *restofstring = malloc(data_length - 4 - testlen + 1);
+			safe_strncpy(restofstring, (char*)in_data + 4 + testlen, data_length - 4 - testlen + 1);
+			if (strlen(restofstring) > 0)
 			{
-				int plen;
-				if (item_uid_enabled)
-					plen=10;
-				else
-					plen=8;
-				
-				// allow for multiple packets in a row
-				while(data_length >= 3+plen){
-					get_new_inventory_item(in_data+3);
-					in_data+= plen;
-					data_length-= plen;
+				int product_count = atoi(restofstring);
+				char *product = restofstring;
+				while (*product!='\0' && *product!= ' ')
+					product++;
+				if (strlen(product)>1)
+				{
+					counters_set_product_info(product+1, product_count);
+					check_for_recipe_name(product+1);
 				}
 			}
-			break;
+			free(restofstring);
+			is_created_message = 1;
+		}
+		// if we don't get the product name, make sure we don't just count it as the last item.
+		else
+			counters_set_product_info("",0);
+		if(!((is_created_message&&mixed_message_filter)||get_show_window(items_win)||get_show_window(manufacture_win)||get_show_window(trade_win)))
+			put_text_in_buffer(CHAT_SERVER, &in_data[3], data_length-3);
+	}  // End successs counters block
+	/* You failed to create a[n] ..., and lost the ingredients */
+	if (my_strncompare(inventory_item_string+1, "You failed to create a[n] ", 26))
+	{
+		size_t item_name_len = 0;
+		char item_name[128];
+		const char *item_string = &inventory_item_string[27];
 
-		case REMOVE_ITEM_FROM_INVENTORY:
-			{
-				// allow for multiple packets in a row
-				while(data_length >= 4)
-				{
-					remove_item_from_inventory (in_data[3]);
-					in_data+= 1;
-					data_length-= 1;
-				}
-			}
-			break;
+		/* look for the ending, if found use it to locate the item name */
+		char *located = strstr(item_string, ", and lost the ingredients");
+		if (located) item_name_len = (size_t)((located - item_string)/sizeof(char));
 
-		case INVENTORY_ITEM_TEXT:
-			{
-				if (data_length <= 3)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged INVENTORY_ITEM_TEXT packet received.\n");
-				  break;
-				}
-				safe_strncpy2(inventory_item_string, (const char *)&in_data[3], sizeof(inventory_item_string)-1, data_length - 3);
-				inventory_item_string[sizeof(inventory_item_string)-1] = 0;
-				inventory_item_string_id++;
-				// Start a new block, since C doesn't like variables declared in the middle of a block.
-				{
-					char *teststring = "You successfully created ";
-					int testlen = strlen(teststring);
-					int is_created_message = 0;
-					if ( (data_length > testlen+4) && (!strncmp((char*)in_data+4, teststring, testlen)) )
-					{
-						char *restofstring = malloc(data_length - 4 - testlen + 1);
-						safe_strncpy(restofstring, (char*)in_data + 4 + testlen, data_length - 4 - testlen + 1);
-						if (strlen(restofstring) > 0)
-						{
-							int product_count = atoi(restofstring);
-							char *product = restofstring;
-							while (*product!='\0' && *product!= ' ')
-								product++;
-							if (strlen(product)>1)
-							{
-								counters_set_product_info(product+1, product_count);
-								check_for_recipe_name(product+1);
-							}
-						}
-						free(restofstring);
-						is_created_message = 1;
-					}
-					// if we don't get the product name, make sure we don't just count it as the last item.
-					else
-						counters_set_product_info("",0);
-					if(!((is_created_message&&mixed_message_filter)||get_show_window(items_win)||get_show_window(manufacture_win)||get_show_window(trade_win)))
-						put_text_in_buffer(CHAT_SERVER, &in_data[3], data_length-3);
-				}  // End successs counters block
-				/* You failed to create a[n] ..., and lost the ingredients */
-				if (my_strncompare(inventory_item_string+1, "You failed to create a[n] ", 26))
-				{
-					size_t item_name_len = 0;
-					char item_name[128];
-					const char *item_string = &inventory_item_string[27];
-
-					/* look for the ending, if found use it to locate the item name */
-					char *located = strstr(item_string, ", and lost the ingredients");
-					if (located) item_name_len = (size_t)((located - item_string)/sizeof(char));
-
-					/* if there was no match then its not a crit fail string */
-					if (item_name_len)
-					{
-						safe_strncpy2(item_name, item_string, sizeof(item_name), item_name_len);
-						increment_critfail_counter(item_name);
-					}
-				}  // End critfail counters block
-			}
-			break;
-		case SPELL_ITEM_TEXT:
-			{
-				if (data_length <= 3)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged SPELL_ITEM_TEXT packet received.\n");
-				  break;
-				}
-				spell_text_from_server(in_data+3, data_length-3);
-			}
-			break;
+		/* if there was no match then its not a crit fail string */
+		if (item_name_len)
+		{
+			safe_strncpy2(item_name, item_string, sizeof(item_name), item_name_len);
+			increment_critfail_counter(item_name);
+		}
+	}  // End critfail counters block
+}
 
-		case GET_KNOWLEDGE_TEXT:
-			{
-				if (data_length <= 3)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged GET_KNOWLEDGE_TEXT packet received.\n");
-				  break;
-				}
-				set_knowledge_string(&in_data[3],data_length-3);
-			}
-			break;
+static void process_spell_item_text(const Uint8 *in_data, int data_length)
+{
+	if (data_length <= 3)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged SPELL_ITEM_TEXT packet received.\n");
+	  return;
+	}
+	spell_text_from_server(in_data+3, data_length-3);
+}
 
-		case CHANGE_MAP:
-			{
-			        char mapname[1024];
-				if (data_length <= 4)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged CHANGE_MAP packet received.\n");
-				  break;
-				}
-				if(in_data[3] == '.' && in_data[4] == '/')
-				{
-					safe_strncpy2(mapname, (char*)in_data + 3, sizeof(mapname), data_length - 3);
-				} else 
-				{
-					safe_snprintf(mapname, sizeof(mapname), "./%s", (char*)in_data + 3);
-				}
-				change_map(mapname);
-			}
-			break;
+static void process_get_knowledge_text(const Uint8 *in_data, int data_length)
+{
+	if (data_length <= 3)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged GET_KNOWLEDGE_TEXT packet received.\n");
+	  return;
+	}
+	set_knowledge_string(&in_data[3],data_length-3);
+}
 
-		case GET_TELEPORTERS_LIST:
-			{
-				Uint16 teleporters_no;
+static void process_change_map(const Uint8 *in_data, int data_length)
+{
+	        char mapname[1024];
+		if (data_length <= 4)
+		{
+		  LOG_WARNING("CAUTION: Possibly forged CHANGE_MAP packet received.\n");
+		  return;
+		}
+		if(in_data[3] == '.' && in_data[4] == '/')
+		{
+			safe_strncpy2(mapname, (char*)in_data + 3, sizeof(mapname), data_length - 3);
+		} else 
+		{
+			safe_snprintf(mapname, sizeof(mapname), "./%s", (char*)in_data + 3);
+		}
+		change_map(mapname);
+}
+
+static void process_get_teleporters_list(const Uint8 *in_data, int data_length)
+{
+	Uint16 teleporters_no;
 #ifdef EXTRA_DEBUG
 	ERR();
 #endif
-				if (data_length <= 4)
-				{
-					LOG_WARNING("CAUTION: Possibly forged GET_TELEPORTERS_LIST packet received.\n");
-					break;
-				}
-				teleporters_no = SDL_SwapLE16 (*((Uint16 *)(in_data + 3)));
-				if (data_length <= teleporters_no * 5 + 4)
-				{
-					LOG_WARNING("CAUTION(2): Possibly forged GET_TELEPORTERS_LIST packet received.\n");
-					break;
-				}
-				add_teleporters_from_list (in_data+3);
-			}
-			break;
+	if (data_length <= 4)
+	{
+		LOG_WARNING("CAUTION: Possibly forged GET_TELEPORTERS_LIST packet received.\n");
+		return;
+	}
+	teleporters_no = SDL_SwapLE16 (*((Uint16 *)(in_data + 3)));
+	if (data_length <= teleporters_no * 5 + 4)
+	{
+		LOG_WARNING("CAUTION(2): Possibly forged GET_TELEPORTERS_LIST packet received.\n");
+		return;
+	}
+	add_teleporters_from_list (in_data+3);
+}
 
-		case PLAY_MUSIC:
-			{
+static void process_play_music(const Uint8 *in_data, int data_length)
+{
 #ifdef EXTRA_DEBUG
 	ERR();
 #endif
 #ifdef NEW_SOUND
-				if (data_length <= 4)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged PLAY_MUSIC packet received.\n");
-				  break;
-				}
-				if(music_on)play_music(SDL_SwapLE16(*((short *)(in_data+3))));
+	if (data_length <= 4)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged PLAY_MUSIC packet received.\n");
+	  return;
+	}
+	if(music_on)play_music(SDL_SwapLE16(*((short *)(in_data+3))));
 #endif // NEW_SOUND
-			}
-			break;
+}
 
-		case PLAY_SOUND:
-			{
+static void process_play_sound(const Uint8 *in_data, int data_length)
+{
 #ifdef EXTRA_DEBUG
 	ERR();
 #endif
 #ifdef NEW_SOUND
-				if (data_length <= 8)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged PLAY_SOUND packet received.\n");
-				  break;
-				}
-				if (sound_on) add_server_sound(SDL_SwapLE16(*((short *)(in_data+3))), SDL_SwapLE16(*((short *)(in_data+5))), SDL_SwapLE16(*((short *)(in_data+7))), 1.0f);
+	if (data_length <= 8)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged PLAY_SOUND packet received.\n");
+	  return;
+	}
+	if (sound_on) add_server_sound(SDL_SwapLE16(*((short *)(in_data+3))), SDL_SwapLE16(*((short *)(in_data+5))), SDL_SwapLE16(*((short *)(in_data+7))), 1.0f);
 #endif // NEW_SOUND
-			}
-			break;
+}
 
-		case TELEPORT_OUT:
-			{
+static void process_teleport_out(const Uint8 *in_data, int data_length)
+{
 #ifdef EXTRA_DEBUG
 	ERR();
 #endif
 
-				if (data_length <= 6)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged TELEPORT_OUT packet received.\n");
-				  break;
-				}
-				add_particle_sys_at_tile("./particles/teleport_out.part", SDL_SwapLE16(*((short *)(in_data+3))), SDL_SwapLE16 (*((short *)(in_data+5))), 1);
-			}
-			break;
+	if (data_length <= 6)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged TELEPORT_OUT packet received.\n");
+	  return;
+	}
+	add_particle_sys_at_tile("./particles/teleport_out.part", SDL_SwapLE16(*((short *)(in_data+3))), SDL_SwapLE16 (*((short *)(in_data+5))), 1);
+}
 
-		case TELEPORT_IN:
-			{
+static void process_teleport_in(const Uint8 *in_data, int data_length)
+{
 #ifdef EXTRA_DEBUG
 	ERR();
 #endif
 
-				if (data_length <= 6)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged TELEPORT_IN packet received.\n");
-				  break;
-				}
-				add_particle_sys_at_tile("./particles/teleport_in.part", SDL_SwapLE16(*((short *)(in_data+3))), SDL_SwapLE16(*((short *)(in_data+5))), 1);
-			}
-			break;
-		case LOG_IN_NOT_OK:
-			{
-				if (data_length <= 4)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged LOG_IN_NOT_OK packet received.\n");
-				  break;
-				}
-				set_login_error ((char*)&in_data[3], data_length - 3, 1);
-			}
-			break;
-
-		case REDEFINE_YOUR_COLORS:
-			{
-				set_login_error (redefine_your_colours, strlen (redefine_your_colours), 0);
-			}
-			break;
+	if (data_length <= 6)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged TELEPORT_IN packet received.\n");
+	  return;
+	}
+	add_particle_sys_at_tile("./particles/teleport_in.part", SDL_SwapLE16(*((short *)(in_data+3))), SDL_SwapLE16(*((short *)(in_data+5))), 1);
+}
 
-		case YOU_DONT_EXIST:
-			{
-				set_login_error (char_dont_exist, strlen (char_dont_exist), 1);
-			}
-			break;
+static void process_log_in_not_ok(const Uint8 *in_data, int data_length)
+{
+	if (data_length <= 4)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged LOG_IN_NOT_OK packet received.\n");
+	  return;
+	}
+	set_login_error ((char*)&in_data[3], data_length - 3, 1);
+}
 
+static void process_redefine_your_colors(const Uint8 *in_data, int data_length)
+{
+	set_login_error (redefine_your_colours, strlen (redefine_your_colours), 0);
+}
 
-		case CREATE_CHAR_NOT_OK:
-			{
-				if (data_length <= 4)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged CREATE_CHAR_NOT_OKAY packet received.\n");
-				  break;
-				}
-				set_create_char_error ((char*)&in_data[3], data_length - 3);
-				return;
-			}
-			break;
+static void process_you_dont_exist(const Uint8 *in_data, int data_length)
+{
+	set_login_error (char_dont_exist, strlen (char_dont_exist), 1);
+}
 
+static void process_create_char_not_ok(const Uint8 *in_data, int data_length)
+{
+	if (data_length <= 4)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged CREATE_CHAR_NOT_OKAY packet received.\n");
+	  return;
+	}
+	set_create_char_error ((char*)&in_data[3], data_length - 3);
+}
 
-		case CREATE_CHAR_OK:
-			{
-				login_from_new_char();
-			}
-			break;
+static void process_create_char_ok(const Uint8 *in_data, int data_length)
+{
+	login_from_new_char();
+}
 
-		case YOU_ARE:
-			{
+static void process_you_are(const Uint8 *in_data, int data_length)
+{
 #ifdef EXTRA_DEBUG
 	ERR();
 #endif
-				if (data_length <= 4)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged YOU_ARE packet received.\n");
-				  break;
-				}
-				LOCK_ACTORS_LISTS();
-				yourself= SDL_SwapLE16(*((short *)(in_data+3)));
-				set_our_actor (get_actor_ptr_from_id (yourself));
-				UNLOCK_ACTORS_LISTS();
-			}
-			break;
+	if (data_length <= 4)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged YOU_ARE packet received.\n");
+	  return;
+	}
+	LOCK_ACTORS_LISTS();
+	yourself= SDL_SwapLE16(*((short *)(in_data+3)));
+	set_our_actor (get_actor_ptr_from_id (yourself));
+	UNLOCK_ACTORS_LISTS();
+}
 
-		case START_RAIN:
-			{
-				weather_type w_type;
-				float severity;
+static void process_start_rain(const Uint8 *in_data, int data_length)
+{
+	weather_type w_type;
+	float severity;
 #ifdef EXTRA_DEBUG
 	ERR();
 #endif
-				if (data_length <= 3)
-				{
-					LOG_WARNING("CAUTION: Possibly forged START_RAIN packet received.\n");
-					break;
-				}
+	if (data_length <= 3)
+	{
+		LOG_WARNING("CAUTION: Possibly forged START_RAIN packet received.\n");
+		return;
+	}
 
-				if (data_length > 4)
-					severity= 0.1f + 0.9f * (in_data[4] / 255.0f);
-				else
-					severity= 1.0f;
+	if (data_length > 4)
+		severity= 0.1f + 0.9f * (in_data[4] / 255.0f);
+	else
+		severity= 1.0f;
 
-				if ((data_length > 5) && (in_data[5] < MAX_WEATHER_TYPES))
-					w_type = in_data[5];
-				else
-					w_type = get_weather_type_for_map();
+	if ((data_length > 5) && (in_data[5] < MAX_WEATHER_TYPES))
+		w_type = in_data[5];
+	else
+		w_type = get_weather_type_for_map();
 
-				//printf("START_RAIN from server using type=%d duration=%d severity=%.2f data_length=%d\n", w_type, in_data[3], severity, data_length);
+	//printf("START_RAIN from server using type=%d duration=%d severity=%.2f data_length=%d\n", w_type, in_data[3], severity, data_length);
 
-				if (show_weather)
-					weather_set_area(0, tile_map_size_x*1.5, tile_map_size_y*1.5, 100000.0, w_type, severity, in_data[3]);
-			}
-			break;
+	if (show_weather)
+		weather_set_area(0, tile_map_size_x*1.5, tile_map_size_y*1.5, 100000.0, w_type, severity, in_data[3]);
+}
 
-		case STOP_RAIN:
-			{
-				weather_type w_type;
+static void process_stop_rain(const Uint8 *in_data, int data_length)
+{
+	weather_type w_type;
 #ifdef EXTRA_DEBUG
 	ERR();
 #endif
-				if (data_length <= 3)
-				{
-					LOG_WARNING("CAUTION: Possibly forged STOP_RAIN packet received.\n");
-					break;
-				}
+	if (data_length <= 3)
+	{
+		LOG_WARNING("CAUTION: Possibly forged STOP_RAIN packet received.\n");
+		return;
+	}
 
-				if ((data_length > 4) && (in_data[4] < MAX_WEATHER_TYPES))
-					w_type = in_data[4];
-				else
-					w_type = get_weather_type_for_map();
+	if ((data_length > 4) && (in_data[4] < MAX_WEATHER_TYPES))
+		w_type = in_data[4];
+	else
+		w_type = get_weather_type_for_map();
 
-				//printf("STOP_RAIN from server using type=%d duration=%d data_length=%d\n", w_type, in_data[3], data_length);
+	//printf("STOP_RAIN from server using type=%d duration=%d data_length=%d\n", w_type, in_data[3], data_length);
 
-				weather_set_area(0, tile_map_size_x*1.5, tile_map_size_y*1.5, 100000.0, w_type, 0.0, in_data[3]);
-			}
-			break;
+	weather_set_area(0, tile_map_size_x*1.5, tile_map_size_y*1.5, 100000.0, w_type, 0.0, in_data[3]);
+}
 
-		case THUNDER:
-			{
+static void process_thunder(const Uint8 *in_data, int data_length)
+{
 #ifdef EXTRA_DEBUG
 	ERR();
 #endif
-				if (data_length <= 3)
-				{
-					LOG_WARNING("CAUTION: Possibly forged THUNDER packet received.\n");
-					break;
-				}
-				if (show_weather)
-				{
-					weather_add_lightning(rand()%5,
+	if (data_length <= 3)
+	{
+		LOG_WARNING("CAUTION: Possibly forged THUNDER packet received.\n");
+		return;
+	}
+	if (show_weather)
+	{
+		weather_add_lightning(rand()%5,
                                       		-camera_x + (50.0 + rand()%101)*(rand()%2 ? 1.0 : -1.0),
                                       		-camera_y + (50.0 + rand()%101)*(rand()%2 ? 1.0 : -1.0));
-				}
-			}
-			break;
-
-
-		case SEND_WEATHER:
-			{
-				// nothing for the moment
-			}
-			break;
+	}
+}
 
+static void process_send_weather(const Uint8 *in_data, int data_length)
+{
+	// nothing for the moment
+}
 
-		case SYNC_CLOCK:
-			{
+static void process_sync_clock(const Uint8 *in_data, int data_length)
+{
 #ifdef EXTRA_DEBUG
 	ERR();
 #endif
-				if (data_length <= 6)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged SYNC_CLOCK packet received.\n");
-				  break;
-				}
-				server_time_stamp= SDL_SwapLE32(*((int *)(in_data+3)));
-				client_time_stamp= SDL_GetTicks();
-				client_server_delta_time= server_time_stamp-client_time_stamp;
-			}
-			break;
+	if (data_length <= 6)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged SYNC_CLOCK packet received.\n");
+	  return;
+	}
+	server_time_stamp= SDL_SwapLE32(*((int *)(in_data+3)));
+	client_time_stamp= SDL_GetTicks();
+	client_server_delta_time= server_time_stamp-client_time_stamp;
+}
 
-		case PONG:
-			{
-				char str[160];
-				if (data_length <= 6)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged SYNC_CLOCK packet received.\n");
-				  break;
-				}
-				testing_server_connection_time = 0;
-				safe_snprintf(str, sizeof(str), "%s: %i ms",server_latency, SDL_GetTicks()-SDL_SwapLE32(*((Uint32 *)(in_data+3))));
-				LOG_TO_CONSOLE(c_green1,str);
-			}
-			break;
+static void process_pong(const Uint8 *in_data, int data_length)
+{
+	char str[160];
+	Uint32 stamp;
+	if (data_length <= 6)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged SYNC_CLOCK packet received.\n");
+	  return;
+	}
+	testing_server_connection_time = 0;
+	stamp = SDL_SwapLE32(*((Uint32 *)(in_data+3)));
+	/* the automatic pings of the latency statistics are not shown */
+	if (net_stats_pong(stamp))
+		return;
+	safe_snprintf(str, sizeof(str), "%s: %i ms",server_latency, SDL_GetTicks()-stamp);
+	LOG_TO_CONSOLE(c_green1,str);
+}
 
-		case UPGRADE_NEW_VERSION:
-			{
-				LOG_TO_CONSOLE(c_red1,update_your_client);
-				LOG_TO_CONSOLE(c_red1,(char*)web_update_address);
-			}
-			break;
+static void process_upgrade_new_version(const Uint8 *in_data, int data_length)
+{
+	LOG_TO_CONSOLE(c_red1,update_your_client);
+	LOG_TO_CONSOLE(c_red1,(char*)web_update_address);
+}
 
-		case UPGRADE_TOO_OLD:
-			{
-				LOG_TO_CONSOLE(c_red1,client_ver_not_supported);
-				LOG_TO_CONSOLE(c_red1,(char*)web_update_address);
-				this_version_is_invalid=1;
-			}
-			break;
+static void process_upgrade_too_old(const Uint8 *in_data, int data_length)
+{
+	LOG_TO_CONSOLE(c_red1,client_ver_not_supported);
+	LOG_TO_CONSOLE(c_red1,(char*)web_update_address);
+	this_version_is_invalid=1;
+}
 
-		case GET_NEW_BAG:
-			{
+static void process_get_new_bag(const Uint8 *in_data, int data_length)
+{
 #ifdef EXTRA_DEBUG
 	ERR();
 #endif
-				if (data_length <= 7)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged GET_NEW_BAG packet received.\n");
-				  break;
-				}
-				put_bag_on_ground(SDL_SwapLE16(*((Uint16 *)(in_data+3))), SDL_SwapLE16(*((Uint16 *)(in_data+5))), in_data[7]);
-			}
-			break;
+	if (data_length <= 7)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged GET_NEW_BAG packet received.\n");
+	  return;
+	}
+	put_bag_on_ground(SDL_SwapLE16(*((Uint16 *)(in_data+3))), SDL_SwapLE16(*((Uint16 *)(in_data+5))), in_data[7]);
+}
 
-		case GET_BAGS_LIST:
-			{
-				Uint16 bags_no;
+static void process_get_bags_list(const Uint8 *in_data, int data_length)
+{
+	Uint16 bags_no;
 #ifdef EXTRA_DEBUG
 	ERR();
 #endif
-				if (data_length <= 3)
-				{
-					LOG_WARNING("CAUTION: Possibly forged GET_BAGS_LIST packet received.\n");
-					break;
-				}
-				bags_no = in_data[3];
-				if (data_length <= bags_no * 5 + 3)
-				{
-					LOG_WARNING("CAUTION(2): Possibly forged GET_BAGS_LIST packet received.\n");
-					break;
-				}
-				add_bags_from_list(&in_data[3]);
-			}
-			break;
+	if (data_length <= 3)
+	{
+		LOG_WARNING("CAUTION: Possibly forged GET_BAGS_LIST packet received.\n");
+		return;
+	}
+	bags_no = in_data[3];
+	if (data_length <= bags_no * 5 + 3)
+	{
+		LOG_WARNING("CAUTION(2): Possibly forged GET_BAGS_LIST packet received.\n");
+		return;
+	}
+	add_bags_from_list(&in_data[3]);
+}
 
-		case SPAWN_BAG_PARTICLES:
-			{
+static void process_spawn_bag_particles(const Uint8 *in_data, int data_length)
+{
 #ifdef EXTRA_DEBUG
 	ERR();
 #endif
-				if (data_length <= 6)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged SPAWN_BAG_PARTICLES packet received.\n");
-				  break;
-				}
-
-			}
-			break;
+	if (data_length <= 6)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged SPAWN_BAG_PARTICLES packet received.\n");
+	  return;
+	}
+}
 
-		case FIRE_PARTICLES:
-			{
+static void process_fire_particles(const Uint8 *in_data, int data_length)
+{
 #ifdef EXTRA_DEBUG
-				ERR();
+	ERR();
 #endif
-				if (data_length <= 6)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged FIRE_PARTICLES packet received.\n");
-				  break;
-				}
-				add_fire_at_tile (SDL_SwapLE16(*(Uint16 *)(in_data+7)), SDL_SwapLE16(*((Uint16 *)(in_data+3))), SDL_SwapLE16(*((Uint16 *)(in_data+5))), 0);
-			}
-			break;
+	if (data_length <= 6)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged FIRE_PARTICLES packet received.\n");
+	  return;
+	}
+	add_fire_at_tile (SDL_SwapLE16(*(Uint16 *)(in_data+7)), SDL_SwapLE16(*((Uint16 *)(in_data+3))), SDL_SwapLE16(*((Uint16 *)(in_data+5))), 0);
+}
 
-		case REMOVE_FIRE_AT:
-			{
+static void process_remove_fire_at(const Uint8 *in_data, int data_length)
+{
 #ifdef EXTRA_DEBUG
 	ERR();
 #endif
-				if (data_length <= 6)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged REMOVE_FIRE_AT packet received.\n");
-				  break;
-				}
-				remove_fire_at_tile (SDL_SwapLE16(*((Uint16 *)(in_data+3))),SDL_SwapLE16(*((Uint16 *)(in_data+5))));
-			}
-			break;
+	if (data_length <= 6)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged REMOVE_FIRE_AT packet received.\n");
+	  return;
+	}
+	remove_fire_at_tile (SDL_SwapLE16(*((Uint16 *)(in_data+3))),SDL_SwapLE16(*((Uint16 *)(in_data+5))));
+}
 
-		case GET_NEW_GROUND_ITEM:
-			{
+static void process_get_new_ground_item(const Uint8 *in_data, int data_length)
+{
 #ifdef EXTRA_DEBUG
 	ERR();
 #endif
-				if (data_length <= 6)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged GET_NEW_GROUND_ITEM packet received.\n");
-				  break;
-				}
-				get_bag_item(in_data+3);
-			}
-			break;
+	if (data_length <= 6)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged GET_NEW_GROUND_ITEM packet received.\n");
+	  return;
+	}
+	get_bag_item(in_data+3);
+}
 
-		case HERE_YOUR_GROUND_ITEMS:
-			{
-				int bags_no;
+static void process_here_your_ground_items(const Uint8 *in_data, int data_length)
+{
+	int bags_no;
 #ifdef EXTRA_DEBUG
 	ERR();
 #endif
-				if (data_length <= 3)
-				{
-					LOG_WARNING("CAUTION: Possibly forged HERE_YOUR_GROUND_ITEMS packet received.\n");
-					break;
-				}
-				bags_no = in_data[3];
-				if (data_length <= bags_no * 7 + 3)
-				{
-					LOG_WARNING("CAUTION(2): Possibly forged HERE_YOUR_GROUND_ITEMS packet received.\n");
-					break;
-				}
-				get_bags_items_list(&in_data[3]);
-			}
-			break;
+	if (data_length <= 3)
+	{
+		LOG_WARNING("CAUTION: Possibly forged HERE_YOUR_GROUND_ITEMS packet received.\n");
+		return;
+	}
+	bags_no = in_data[3];
+	if (data_length <= bags_no * 7 + 3)
+	{
+		LOG_WARNING("CAUTION(2): Possibly forged HERE_YOUR_GROUND_ITEMS packet received.\n");
+		return;
+	}
+	get_bags_items_list(&in_data[3]);
+}
 
-		case CLOSE_BAG:
-			{
+static void process_close_bag(const Uint8 *in_data, int data_length)
+{
 #ifdef EXTRA_DEBUG
 	ERR();
 #endif
-				hide_window(ground_items_win);
-			}
-			break;
+	hide_window(ground_items_win);
+}
 
-		case REMOVE_ITEM_FROM_GROUND:
-			{
+static void process_remove_item_from_ground(const Uint8 *in_data, int data_length)
+{
 #ifdef EXTRA_DEBUG
 	ERR();
 #endif
-				if (data_length <= 3)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged REMOVE_ITEM_FROM_GROUND packet received.\n");
-				  break;
-				}
-				remove_item_from_ground(in_data[3]);
-			}
-			break;
+	if (data_length <= 3)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged REMOVE_ITEM_FROM_GROUND packet received.\n");
+	  return;
+	}
+	remove_item_from_ground(in_data[3]);
+}
 
-		case DESTROY_BAG:
-			{
+static void process_destroy_bag(const Uint8 *in_data, int data_length)
+{
 #ifdef EXTRA_DEBUG
 	ERR();
 #endif
-				remove_bag(in_data[3]);
-			}
-			break;
+	remove_bag(in_data[3]);
+}
 
-		case NPC_TEXT:
-			{
-				if (data_length <= 4)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged NPC_TEXT packet received.\n");
-				  break;
-				}
-				display_dialogue(&in_data[3], data_length-3);
-				if (is_color (in_data[3]) && is_color (in_data[4]))
-				{
-					// double color code, this text
-					// should be added to the quest log
-					safe_strncpy2((char*)text_buf, (char*)&in_data[4], sizeof(text_buf), data_length - 4);
-					add_questlog ((char*)text_buf, strlen((char*)text_buf));
-				}
-				// if we're expecting a quest entry, this will be it
-				else if (waiting_for_questlog_entry())
-				{
-					safe_strncpy2((char*)text_buf, (char*)&in_data[3], sizeof(text_buf), data_length - 3);
-					add_questlog ((char*)text_buf, strlen((char*)text_buf));
-				}
-			}
-			break;
+static void process_npc_text(const Uint8 *in_data, int data_length)
+{
+	Uint8 text_buf[MAX_TCP_BUFFER];
 
-		case SEND_NPC_INFO:
-			{
-				if (data_length <= 23)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged NPC_INFO packet received.\n");
-				  break;
-				}
-				safe_strncpy2((char*)npc_name, (char*)&in_data[3], sizeof(npc_name), 20);
-				cur_portrait=in_data[23];
-			}
-			break;
+	if (data_length <= 4)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged NPC_TEXT packet received.\n");
+	  return;
+	}
+	display_dialogue(&in_data[3], data_length-3);
+	if (is_color (in_data[3]) && is_color (in_data[4]))
+	{
+		// double color code, this text
+		// should be added to the quest log
+		safe_strncpy2((char*)text_buf, (char*)&in_data[4], sizeof(text_buf), data_length - 4);
+		add_questlog ((char*)text_buf, strlen((char*)text_buf));
+	}
+	// if we're expecting a quest entry, this will be it
+	else if (waiting_for_questlog_entry())
+	{
+		safe_strncpy2((char*)text_buf, (char*)&in_data[3], sizeof(text_buf), data_length - 3);
+		add_questlog ((char*)text_buf, strlen((char*)text_buf));
+	}
+}
 
-		case NPC_OPTIONS_LIST:
-			{
-				// NOTE: an empty response list (data_length == 3) is valid,
-				// and simply means that the response list should be cleared.
-				// Just take care not to try to use the data argument in
-				// build_response_entries ().
-				build_response_entries (in_data+3, SDL_SwapLE16 (*((Uint16 *)(in_data+1))));
-			}
-			break;
+static void process_send_npc_info(const Uint8 *in_data, int data_length)
+{
+	if (data_length <= 23)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged NPC_INFO packet received.\n");
+	  return;
+	}
+	safe_strncpy2((char*)npc_name, (char*)&in_data[3], sizeof(npc_name), 20);
+	cur_portrait=in_data[23];
+}
 
-		case GET_TRADE_ACCEPT:
-			{
-				if (data_length <= 3)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged GET_TRADE_ACCEPT packet received.\n");
-				  break;
-				}
-				if(!in_data[3])
-					trade_you_accepted++;
-				else
-					trade_other_accepted++;
-			}
-			break;
+static void process_npc_options_list(const Uint8 *in_data, int data_length)
+{
+	// NOTE: an empty response list (data_length == 3) is valid,
+	// and simply means that the response list should be cleared.
+	// Just take care not to try to use the data argument in
+	// build_response_entries ().
+	build_response_entries (in_data+3, SDL_SwapLE16 (*((Uint16 *)(in_data+1))));
+}
 
-		case GET_TRADE_REJECT:
-			{
-				if (data_length <= 3)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged GET_TRADE_REJECT packet received.\n");
-				  break;
-				}
-				if(!in_data[3])trade_you_accepted=0;
-				else
-					trade_other_accepted=0;
-			}
-			break;
+static void process_get_trade_accept(const Uint8 *in_data, int data_length)
+{
+	if (data_length <= 3)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged GET_TRADE_ACCEPT packet received.\n");
+	  return;
+	}
+	if(!in_data[3])
+		trade_you_accepted++;
+	else
+		trade_other_accepted++;
+}
 
-		case GET_TRADE_EXIT:
-			{
-				hide_window(trade_win);
-				trade_exit();
-			}
-			break;
+static void process_get_trade_reject(const Uint8 *in_data, int data_length)
+{
+	if (data_length <= 3)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged GET_TRADE_REJECT packet received.\n");
+	  return;
+	}
+	if(!in_data[3])trade_you_accepted=0;
+	else
+		trade_other_accepted=0;
+}
 
-		case GET_YOUR_TRADEOBJECTS:
-			{
-				int items;
-				int plen;
-				if (item_uid_enabled)
-					plen=10;
-				else
-					plen=8;
-
-				if (data_length <= 3)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged GET_YOUR_TRADEOBJECTS packet received.\n");
-				  break;
-				}
-				items = in_data[3];
-				if (data_length <= items * plen + 3)
-				{
-				  LOG_WARNING("CAUTION(2): Possibly forged GET_YOUR_TRADEOBJECTS packet received.\n");
-				  break;
-				}
-				get_your_trade_objects(in_data+3);
-			}
-			break;
+static void process_get_trade_exit(const Uint8 *in_data, int data_length)
+{
+	hide_window(trade_win);
+	trade_exit();
+}
 
-		case GET_TRADE_OBJECT:
-			{
-				int plen;
-				if (item_uid_enabled)
-					plen=10;
-				else
-					plen=8;		
+static void process_get_your_tradeobjects(const Uint8 *in_data, int data_length)
+{
+	int items;
+	int plen;
+	if (item_uid_enabled)
+		plen=10;
+	else
+		plen=8;
+
+	if (data_length <= 3)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged GET_YOUR_TRADEOBJECTS packet received.\n");
+	  return;
+	}
+	items = in_data[3];
+	if (data_length <= items * plen + 3)
+	{
+	  LOG_WARNING("CAUTION(2): Possibly forged GET_YOUR_TRADEOBJECTS packet received.\n");
+	  return;
+	}
+	get_your_trade_objects(in_data+3);
+}
+
+static void process_get_trade_object(const Uint8 *in_data, int data_length)
+{
+	int plen;
+	if (item_uid_enabled)
+		plen=10;
+	else
+		plen=8;		
 			
-				if (data_length <= 3+plen)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged GET_TRADE_OBJECT packet received.\n");
-				  break;
-				}
-				put_item_on_trade(in_data+3);
-			}
-			break;
+	if (data_length <= 3+plen)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged GET_TRADE_OBJECT packet received.\n");
+	  return;
+	}
+	put_item_on_trade(in_data+3);
+}
 
-		case REMOVE_TRADE_OBJECT:
-			{
-				if (data_length <= 8)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged REMOVE_TRADE_OBJECT packet received.\n");
-				  break;
-				}
-				remove_item_from_trade(in_data+3);
-			}
-			break;
+static void process_remove_trade_object(const Uint8 *in_data, int data_length)
+{
+	if (data_length <= 8)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged REMOVE_TRADE_OBJECT packet received.\n");
+	  return;
+	}
+	remove_item_from_trade(in_data+3);
+}
 
-		case GET_TRADE_PARTNER_NAME:
-			{
-				get_trade_partner_name(&in_data[3],SDL_SwapLE16(*((Uint16 *)(in_data+1)))-1);
-			}
-			break;
+static void process_get_trade_partner_name(const Uint8 *in_data, int data_length)
+{
+	get_trade_partner_name(&in_data[3],SDL_SwapLE16(*((Uint16 *)(in_data+1)))-1);
+}
 
-		case GET_YOUR_SIGILS:
-			{
-				// future support for more sigils
-				if (data_length <= 6)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged GET_YOUR_SIGILS packet received.\n");
-				  break;
-				}
-				if(data_length < 11){
-					get_sigils_we_have(SDL_SwapLE32(*((Uint32 *)(in_data+3))), 0);
-				} else {
-					get_sigils_we_have(SDL_SwapLE32(*((Uint32 *)(in_data+3))), SDL_SwapLE32(*((Uint32 *)(in_data+7))));
-				}
-			}
-			break;
+static void process_get_your_sigils(const Uint8 *in_data, int data_length)
+{
+	// future support for more sigils
+	if (data_length <= 6)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged GET_YOUR_SIGILS packet received.\n");
+	  return;
+	}
+	if(data_length < 11){
+		get_sigils_we_have(SDL_SwapLE32(*((Uint32 *)(in_data+3))), 0);
+	} else {
+		get_sigils_we_have(SDL_SwapLE32(*((Uint32 *)(in_data+3))), SDL_SwapLE32(*((Uint32 *)(in_data+7))));
+	}
+}
 
-		case GET_ACTIVE_SPELL:
-			{
-				if (data_length <= 4)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged GET_ACTIVE_SPELL packet received.\n");
-				  break;
-				}
-				get_active_spell(in_data[3],in_data[4]);
-			}
-			break;
+static void process_get_active_spell(const Uint8 *in_data, int data_length)
+{
+	if (data_length <= 4)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged GET_ACTIVE_SPELL packet received.\n");
+	  return;
+	}
+	get_active_spell(in_data[3],in_data[4]);
+}
 
-		case REMOVE_ACTIVE_SPELL:
-			{
-				if (data_length <= 3)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged REMOVE_ACTIVE_SPELL packet received.\n");
-				  break;
-				}
-				remove_active_spell(in_data[3]);
-			}
-			break;
+static void process_remove_active_spell(const Uint8 *in_data, int data_length)
+{
+	if (data_length <= 3)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged REMOVE_ACTIVE_SPELL packet received.\n");
+	  return;
+	}
+	remove_active_spell(in_data[3]);
+}
 
-		case GET_ACTIVE_SPELL_LIST:
-			{
-				if (data_length <= 2+NUM_ACTIVE_SPELLS)
-				{
-					LOG_WARNING("CAUTION: Possibly forged GET_ACTIVE_SPELL_LIST packet received.\n");
-					break;
-				}
-				get_active_spell_list (in_data+3);
-			}
-			break;
+static void process_get_active_spell_list(const Uint8 *in_data, int data_length)
+{
+	if (data_length <= 2+NUM_ACTIVE_SPELLS)
+	{
+		LOG_WARNING("CAUTION: Possibly forged GET_ACTIVE_SPELL_LIST packet received.\n");
+		return;
+	}
+	get_active_spell_list (in_data+3);
+}
 
-		case GET_ACTOR_HEALTH:
-			{
+static void process_get_actor_health(const Uint8 *in_data, int data_length)
+{
 #ifdef EXTRA_DEBUG
 	ERR();
 #endif
-				if (data_length <= 6)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged GET_ACTOR_HEALTH packet received.\n");
-				  break;
-				}
-				get_actor_health(SDL_SwapLE16(*((Uint16 *)(in_data+3))),SDL_SwapLE16(*((Uint16*)(in_data+5))));
-			}
-			break;
+	if (data_length <= 6)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged GET_ACTOR_HEALTH packet received.\n");
+	  return;
+	}
+	get_actor_health(SDL_SwapLE16(*((Uint16 *)(in_data+3))),SDL_SwapLE16(*((Uint16*)(in_data+5))));
+}
 
-		case GET_ACTOR_DAMAGE:
-			{
+static void process_get_actor_damage(const Uint8 *in_data, int data_length)
+{
 #ifdef EXTRA_DEBUG
 	ERR();
 #endif
 #ifdef BANDWIDTH_SAVINGS
-				// allow for multiple packets in a row
-				while (data_length >= 7)
-				{
-					get_actor_damage(SDL_SwapLE16(*((Uint16 *)(in_data+3))),SDL_SwapLE16(*((Uint16*)(in_data+5))));
-					data_length -= 4;
-					in_data += 4;
-				}
+	// allow for multiple packets in a row
+	while (data_length >= 7)
+	{
+		get_actor_damage(SDL_SwapLE16(*((Uint16 *)(in_data+3))),SDL_SwapLE16(*((Uint16*)(in_data+5))));
+		data_length -= 4;
+		in_data += 4;
+	}
 #else
-				if (data_length <= 6)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged GET_ACTOR_DAMAGE packet received.\n");
-				  break;
-				}
-				get_actor_damage(SDL_SwapLE16(*((Uint16 *)(in_data+3))),SDL_SwapLE16(*((Uint16*)(in_data+5))));
+	if (data_length <= 6)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged GET_ACTOR_DAMAGE packet received.\n");
+	  return;
+	}
+	get_actor_damage(SDL_SwapLE16(*((Uint16 *)(in_data+3))),SDL_SwapLE16(*((Uint16*)(in_data+5))));
 #endif
-			}
-			break;
+}
 
-		case GET_ACTOR_HEAL:
-			{
+static void process_get_actor_heal(const Uint8 *in_data, int data_length)
+{
 #ifdef EXTRA_DEBUG
 	ERR();
 #endif
 #ifdef BANDWIDTH_SAVINGS
-				// allow for multiple packets in a row
-				while (data_length >= 7)
-				{
-					get_actor_heal(SDL_SwapLE16(*((Uint16 *)(in_data+3))),SDL_SwapLE16(*((Uint16*)(in_data+5))));
-					data_length -= 4;
-					in_data += 4;
-				}
+	// allow for multiple packets in a row
+	while (data_length >= 7)
+	{
+		get_actor_heal(SDL_SwapLE16(*((Uint16 *)(in_data+3))),SDL_SwapLE16(*((Uint16*)(in_data+5))));
+		data_length -= 4;
+		in_data += 4;
+	}
 #else
-				if (data_length <= 6)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged GET_ACTOR_HEAL packet received.\n");
-				  break;
-				}
-				get_actor_heal(SDL_SwapLE16(*((Uint16 *)(in_data+3))),SDL_SwapLE16(*((Uint16*)(in_data+5))));
+	if (data_length <= 6)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged GET_ACTOR_HEAL packet received.\n");
+	  return;
+	}
+	get_actor_heal(SDL_SwapLE16(*((Uint16 *)(in_data+3))),SDL_SwapLE16(*((Uint16*)(in_data+5))));
 #endif
-			}
-			break;
+}
 
-		case ACTOR_UNWEAR_ITEM:
-			{
+static void process_actor_unwear_item(const Uint8 *in_data, int data_length)
+{
 #ifdef EXTRA_DEBUG
 	ERR();
 #endif
-				if (data_length <= 5)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged ACTOR_UNWEAR_ITEM packet received.\n");
-				  break;
-				}
-				unwear_item_from_actor(SDL_SwapLE16(*((Uint16 *)(in_data+3))),in_data[5]);
-			}
+	if (data_length <= 5)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged ACTOR_UNWEAR_ITEM packet received.\n");
+	  return;
+	}
+	unwear_item_from_actor(SDL_SwapLE16(*((Uint16 *)(in_data+3))),in_data[5]);
+}
+
+static void process_actor_wear_item(const Uint8 *in_data, int data_length)
+{
+#ifdef EXTRA_DEBUG
+	ERR();
+#endif
+	if (data_length <= 6)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged ACTOR_WEAR_ITEM packet received.\n");
+	  return;
+	}
+	actor_wear_item(SDL_SwapLE16(*((Uint16 *)(in_data+3))),in_data[5],in_data[6]);
+}
+
+static void process_npc_say_overtext(const Uint8 *in_data, int data_length)
+{
+	char buf[1024];
+	if (data_length <= 5)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged NPC_SAY_OVERTEXT packet received.\n");
+	  return;
+	}
+	safe_strncpy2(buf, (char*)in_data + 5, sizeof(buf), data_length - 5);
+	add_displayed_text_to_actor(
+		get_actor_ptr_from_id( SDL_SwapLE16(*((Uint16 *)(in_data+3))) ), buf);
+}
+
+static void process_ping_request(const Uint8 *in_data, int data_length)
+{
+#ifdef	OLC
+	// add in the status information
+	char	buf[1024];
+	int	len= data_length;
+	memcpy(buf, in_data, data_length);
+	len+= olc_ping_request(buf+len);
+	my_tcp_send(my_socket, buf, len);
+#else	//OLC
+	// just send the pack back as it is
+	my_tcp_send(my_socket, in_data, data_length);
+#endif	//OLC
+}
+
+static void process_buddy_event(const Uint8 *in_data, int data_length)
+{
+	if (data_length <= 5)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged BUDDY_EVENT packet received.\n");
+	  return;
+	}
+	if(in_data[3]==1)
+		add_buddy((char*)&in_data[5],in_data[4],data_length-5);
+	else if(in_data[3]==0)
+		del_buddy((char*)&in_data[4],data_length-4);
+}
+
+static void process_display_client_window(const Uint8 *in_data, int data_length)
+{
+	if (data_length <= 4)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged DISPLAY_CLIENT_WINDOW packet received.\n");
+	  return;
+	}
+	switch(in_data[3]){
+		case RULE_WIN:
+		case RULE_INTERFACE:
+			highlight_rule(in_data[3],in_data+4,data_length-4);
+			break;
+		case NEW_CHAR_INTERFACE:
+			hide_all_root_windows ();
+			hide_hud_windows ();
+			countdown=0;
+			have_a_map=0;
+			create_newchar_root_window ();
+			show_window (newchar_root_win);
+			connect_to_server();
 			break;
+		default:
+			break;
+	}
+}
+
+static void process_open_book(const Uint8 *in_data, int data_length)
+{
+	if (data_length <= 4)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged OPEN_BOOK packet received.\n");
+	  return;
+	}
+	open_book(SDL_SwapLE16(*((Uint16*)(in_data+3))));
+}
+
+static void process_read_book(const Uint8 *in_data, int data_length)
+{
+	if (data_length <= 7)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged READ_BOOK packet received.\n");
+	  return;
+	}
+	read_network_book((char*)in_data+3, data_length-3);
+}
+
+static void process_close_book(const Uint8 *in_data, int data_length)
+{
+	if (data_length <= 4)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged CLOSE_BOOK packet received.\n");
+	  return;
+	}
+	close_book(SDL_SwapLE16(*((Uint16*)(in_data+3))));
+}
+
+static void process_storage_list(const Uint8 *in_data, int data_length)
+{
+	if (data_length <= 4)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged STORAGE_LIST packet received.\n");
+	  return;
+	}
+	get_storage_categories((char*)in_data+3, data_length-3);
+}
+
+static void process_storage_items(const Uint8 *in_data, int data_length)
+{
+	if (data_length <= 4)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged STORAGE_ITEMS packet received.\n");
+	  return;
+	}
+	get_storage_items(in_data+3, data_length-3);
+	trade_post_storage();
+}
+
+static void process_storage_text(const Uint8 *in_data, int data_length)
+{
+	if (data_length <= 4)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged STORAGE_TEXT packet received.\n");
+	  return;
+	}
+	get_storage_text(in_data+3, data_length-3);
+}
+
+static void process_spell_cast(const Uint8 *in_data, int data_length)
+{
+	{
+		if (data_length <= 3)
+		{
+		  LOG_WARNING("CAUTION: Possibly forged SPELL_CAST packet received.\n");
+		  return;
+		}
+		if (((in_data[3] == S_SUCCES) || (in_data[3] == S_NAME)) && (data_length <= 4))
+		{
+		  LOG_WARNING("CAUTION(2): Possibly forged SPELL_CAST packet received.\n");
+		  return;
+		}
+		process_network_spell((char*)in_data+3, data_length-3);
+		if (in_data[3] == S_SUCCES) {
+			// increment the spell counter
+			increment_spell_counter(in_data[4]);
+		}
+       		}
+}
+
+static void process_get_active_channels(const Uint8 *in_data, int data_length)
+{
+	if (data_length <= 3)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged GET_ACTIVE_CHANNELS packet received.\n");
+	  return;
+	}
+	set_active_channels (in_data[3], (Uint32*)(in_data+4), (data_length-2)/4);
+}
+
+static void process_get_3d_obj_list(const Uint8 *in_data, int data_length)
+{
+	if (data_length <= 3)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged GET_3D_OBJ_LIST packet received.\n");
+	  return;
+	}
+	get_3d_objects_from_server (in_data[3], &in_data[4], data_length - 4);
+}
+
+static void process_get_3d_obj(const Uint8 *in_data, int data_length)
+{
+	get_3d_objects_from_server (1, &in_data[3], data_length - 3);
+}
+
+static void process_remove_3d_obj(const Uint8 *in_data, int data_length)
+{
+	if (data_length <= 4)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged REMOVE_3D_OBJ packet received.\n");
+	  return;
+	}
+	remove_3d_object_from_server (SDL_SwapLE16 (*((Uint16 *)(&in_data[3]))));
+}
+
+// for use by 1.0.3 server and higher
+static void process_map_set_objects(const Uint8 *in_data, int data_length)
+{
+	if (data_length <= 4)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged MAP_SET_OBJECTS packet received.\n");
+	  return;
+	}
+	switch(in_data[3]){
+		case	0:	//2D
+			set_2d_object(in_data[4], in_data+5, data_length-3);
+			break;
+		case	1:	//3D
+			set_3d_object(in_data[4], in_data+5, data_length-3);
+			break;
+	}
+}
+
+// for future expansion
+static void process_map_state_objects(const Uint8 *in_data, int data_length)
+{
+	if (data_length <= 8)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged MAP_STATE_OBJECTS packet received.\n");
+	  return;
+	}
+	switch(in_data[3]){
+		case	0:	//2D
+			state_2d_object(in_data[4], in_data+5, data_length-3);
+			break;
+		case	1:	//3D
+			state_3d_object(in_data[4], in_data+5, data_length-3);
+			break;
+	}
+}
+
+static void process_map_flags(const Uint8 *in_data, int data_length)
+{
+	if (data_length <= 6)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged MAP_FLAGS packet received.\n");
+	  return;
+	}
+	map_flags=SDL_SwapLE32(*((Uint32 *)(in_data+3)));
+}
+
+static void process_get_items_cooldown(const Uint8 *in_data, int data_length)
+{
+		// make sure we interpret the incoming octets as unsigned
+		// in case the function signature changes
+	if (data_length <= 3)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged GET_ITEMS_COOLDOWN packet received.\n");
+	  return;
+	}
+	get_items_cooldown (&in_data[3], data_length - 3);
+}
+
+static void process_send_buffs(const Uint8 *in_data, int data_length)
+{
+#ifdef EXTRA_DEBUG
+	ERR();
+#endif
+	if (data_length < 9)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged SEND_BUFFS packet received.\n");
+	  return;
+	}
+#ifdef BUFF_DEBUG
+	{
+		int actor_id = SDL_SwapLE16(*((short *)(in_data+3)));
+		actor *act = get_actor_ptr_from_id(actor_id);
+		if(act){
+			printf("SEND_BUFFS received for actor %s\n", act->actor_name);
+		}
+		else {
+			printf("SEND_BUFFS received for actor ID %i\n", actor_id);
+		}
+	}
+#endif // BUFF_DEBUG
+	update_actor_buffs(SDL_SwapLE16(*((short *)(in_data+3))), SDL_SwapLE32(*((Uint32 *)(in_data+5))));
+}
+
+static void process_send_special_effect(const Uint8 *in_data, int data_length)
+{
+	if (data_length <= 5)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged SEND_SPECIAL_EFFECT packet received.\n");
+	  return;
+	}
+	if (
+	    (in_data[3] == SPECIAL_EFFECT_POISON) ||
+	    (in_data[3] == SPECIAL_EFFECT_REMOTE_HEAL) ||
+	    (in_data[3] == SPECIAL_EFFECT_HARM) ||
+	    (in_data[3] == SPECIAL_EFFECT_MANA_DRAIN) ||
+	    (in_data[3] == SPECIAL_EFFECT_INVASION_BEAMING) ||
+	    (in_data[3] == SPECIAL_EFFECT_TELEPORT_TO_RANGE)
+	   )
+	{
+		if (data_length <= 7)
+		{
+		  LOG_WARNING("CAUTION(2): Possibly forged SEND_SPECIAL_EFFECT packet received.\n");
+		  return;
+		}
+	}
+		if (special_effects){
+			parse_special_effect(in_data[3], (const Uint16 *) &in_data[4]);
+		}
+}
+
+static void process_remove_mine(const Uint8 *in_data, int data_length)
+{
+#ifdef EXTRA_DEBUG
+	ERR();
+#endif
+	remove_mine(in_data[3]);
+}
+
+static void process_get_new_mine(const Uint8 *in_data, int data_length)
+{
+#ifdef EXTRA_DEBUG
+	ERR();
+#endif
+	if (data_length <= 8)
+	{
+		LOG_WARNING("CAUTION: Possibly forged GET_NEW_MINE packet received.\n");
+		return;
+	}
+	put_mine_on_ground(SDL_SwapLE16(*((Uint16 *)(in_data+3))), SDL_SwapLE16(*((Uint16 *)(in_data+5))), in_data[8], in_data[7]);
+}
+
+static void process_get_mines_list(const Uint8 *in_data, int data_length)
+{
+	Uint16 mines_no;
+#ifdef EXTRA_DEBUG
+	ERR();
+#endif
+	if (data_length <= 3)
+	{
+	  LOG_WARNING("CAUTION: Possibly forged GET_MINES_LIST packet received.\n");
+	  return;
+	}
+	mines_no = in_data[3];
+	if (data_length <= mines_no * 6 + 3)
+	{
+	  LOG_WARNING("CAUTION(2): Possibly forged GET_MINES_LIST packet received.\n");
+	  return;
+	}
+	add_mines_from_list(&in_data[3]);
+}
+
+static void process_display_popup(const Uint8 *in_data, int data_length)
+{
+	if (data_length <= 8) /* At least one char title and one char text */
+	{
+		LOG_WARNING("CAUTION: Possibly forged DISPLAY_POPUP packet received.\n");
+		return;
+	}
+	popup_create_from_network(&in_data[3], data_length - 3);
+}
+
+static void process_missile_aim_a_at_b(const Uint8 *in_data, int data_length)
+{
+	if (data_length >= 7)
+	{
+		missiles_aim_at_b(SDL_SwapLE16(*((short *)(in_data+3))),SDL_SwapLE16(*((short *)(in_data+5))));
+	}
+}
+
+static void process_missile_aim_a_at_xyz(const Uint8 *in_data, int data_length)
+{
+	if (data_length >= 17)
+	{
+		float target[3];
+		target[0] = SwapLEFloat(*((float*)(in_data+5)));
+		target[1] = SwapLEFloat(*((float*)(in_data+9)));
+		target[2] = SwapLEFloat(*((float*)(in_data+13)));
+		missiles_aim_at_xyz(SDL_SwapLE16(*((short *)(in_data+3))),target);
+	}
+}
+
+static void process_missile_fire_a_to_b(const Uint8 *in_data, int data_length)
+{
+	if (data_length >= 7)
+	{
+		missiles_fire_a_to_b(SDL_SwapLE16(*((short *)(in_data+3))),SDL_SwapLE16(*((short *)(in_data+5))));
+	}
+}
+
+static void process_missile_fire_a_to_xyz(const Uint8 *in_data, int data_length)
+{
+	if (data_length >= 17)
+	{
+		float target[3];
+		target[0] = SwapLEFloat(*((float*)(in_data+5)));
+		target[1] = SwapLEFloat(*((float*)(in_data+9)));
+		target[2] = SwapLEFloat(*((float*)(in_data+13)));
+		missiles_fire_a_to_xyz(SDL_SwapLE16(*((short *)(in_data+3))),target);
+	}
+}
+
+static void process_missile_fire_xyz_to_b(const Uint8 *in_data, int data_length)
+{
+	if (data_length >= 17)
+	{
+		float source[3];
+		source[0] = SwapLEFloat(*((float*)(in_data+5)));
+		source[1] = SwapLEFloat(*((float*)(in_data+9)));
+		source[2] = SwapLEFloat(*((float*)(in_data+13)));
+		missiles_fire_xyz_to_b(source,SDL_SwapLE16(*((short *)(in_data+3))));
+	}
+}
+
+static void process_send_map_marker(const Uint8 *in_data, int data_length)
+{
+	//in_data[3]=id
+	//in_data[5]=x;
+	//in_data[7]=y;
+	//map_name\0text\0
+	int i,fl=0,k=0;
+	server_mark *sm;
+
+	if (data_length <= 10)
+		{
+		  LOG_WARNING("CAUTION: Possibly forged SEND_MAP_MARKER packet received.\n");
+		  return;
+		}
+	sm = calloc(1,sizeof(server_mark));//memory is set to zero
+	sm->x=SDL_SwapLE16(*((short *)(in_data+5)));
+	sm->y=SDL_SwapLE16(*((short *)(in_data+7)));
+	sm->id=SDL_SwapLE16(*((short *)(in_data+3)));
+	for(i=9;i<data_length;i++){
+		if(in_data[i]==0) {fl=1; k=0; continue;}
+		if(!fl) sm->map_name[k++]=in_data[i]; //reading map name
+		else sm->text[k++]=in_data[i];//reading mark text
+	}
+	//printf("ADD MARKER: %i %i %i %s %s\n",sm->id,sm->x,sm->y,sm->map_name,sm->text);
+	if(!server_marks) init_server_markers();
+	hash_delete(server_marks, (void *)(uintptr_t)sm->id); //remove old marker if present
+	hash_add(server_marks, (void *)(uintptr_t)sm->id,(void*)sm);
+	save_server_markings();
+	load_map_marks();//load again, so the new marker is added correctly.
+}
+
+static void process_remove_map_marker(const Uint8 *in_data, int data_length)
+{
+	int id;
+	if (data_length <= 4)
+		{
+		  LOG_WARNING("CAUTION: Possibly forged REMOVE_MAP_MARKER packet received.\n");
+		  return;
+		}
+	id=SDL_SwapLE16(*((short *)(in_data+3)));
+	hash_delete(server_marks,(void *)(uintptr_t)id); //remove marker if present
+	save_server_markings();
+	load_map_marks();//load again, so the new marker is removed correctly.
+}
+
+static void process_next_npc_message_is_quest(const Uint8 *in_data, int data_length)
+{
+	if (data_length <= 4)
+	{
+		LOG_WARNING("CAUTION: Possibly forged NEXT_NPC_MESSAGE_IS_QUEST packet received.\n");
+		return;
+	}
+	set_next_quest_entry_id(SDL_SwapLE16(*((short *)(in_data+3))));
+}
+
+static void process_here_is_quest_id(const Uint8 *in_data, int data_length)
+{
+	if (data_length <= 3)
+	{
+		LOG_WARNING("CAUTION: Possibly forged HERE_IS_QUEST_ID packet received.\n");
+		return;
+	}
+	set_quest_title((const char *)&in_data[3], data_length - 3);
+}
+
+static void process_quest_finished(const Uint8 *in_data, int data_length)
+{
+	if (data_length <= 4)
+	{
+		LOG_WARNING("CAUTION: Possibly forged QUEST_FINISHED packet received.\n");
+		return;
+	}
+	set_quest_finished(SDL_SwapLE16(*((short *)(in_data+3))));
+}
 
-		case ACTOR_WEAR_ITEM:
-			{
-#ifdef EXTRA_DEBUG
-	ERR();
-#endif
-				if (data_length <= 6)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged ACTOR_WEAR_ITEM packet received.\n");
-				  break;
-				}
-				actor_wear_item(SDL_SwapLE16(*((Uint16 *)(in_data+3))),in_data[5],in_data[6]);
-			}
-			break;
+static void process_send_achievements(const Uint8 *in_data, int data_length)
+{
+	Uint32 *achievement_data = NULL;
+	size_t word_count = (data_length-3) / sizeof(Uint32);
+	size_t i;
+	if ((word_count < 1) && (word_count < MAX_ACHIEVEMENTS/32))
+	{
+		LOG_WARNING("CAUTION: Possibly forged SEND_ACHIEVEMENTS packet received.\n");
+		return;
+	}
+	achievement_data = (Uint32 *)calloc(word_count, sizeof(Uint32));
+	for (i=0; i<word_count; ++i)
+		achievement_data[i] = SDL_SwapLE32(*((Uint32 *)(in_data+3+i*sizeof(Uint32))));
+	achievements_data(achievement_data, word_count);
+	free(achievement_data);
+}
 
-		case NPC_SAY_OVERTEXT:
-			{
-				char buf[1024];
-				if (data_length <= 5)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged NPC_SAY_OVERTEXT packet received.\n");
-				  break;
-				}
-				safe_strncpy2(buf, (char*)in_data + 5, sizeof(buf), data_length - 5);
-				add_displayed_text_to_actor(
-					get_actor_ptr_from_id( SDL_SwapLE16(*((Uint16 *)(in_data+3))) ), buf);
-			}
-			break;
+static void process_send_buff_duration(const Uint8 *in_data, int data_length)
+{
+	if (data_length <= 3)
+		LOG_WARNING("CAUTION: Possibly forged/invalid SEND_BUFF_DURATION packet received.\n");
+	else
+		here_is_a_buff_duration((Uint8)in_data[3]);
+}
 
-		case PING_REQUEST:
-			{
+static void process_unknown_message(const Uint8 *in_data, int data_length)
+{
+	// Unknown packet type??
 #ifdef	OLC
-				// add in the status information
-				char	buf[1024];
-				int	len= data_length;
-				memcpy(buf, in_data, data_length);
-				len+= olc_ping_request(buf+len);
-				my_tcp_send(my_socket, buf, len);
-#else	//OLC
-				// just send the pack back as it is
-				my_tcp_send(my_socket, in_data, data_length);
+	// do OL specific packet handling
+	olc_packet_handler(in_data, data_length);
 #endif	//OLC
-			}
-			break;
-
-		case BUDDY_EVENT:
-			{
-				if (data_length <= 5)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged BUDDY_EVENT packet received.\n");
-				  break;
-				}
-				if(in_data[3]==1)
-					add_buddy((char*)&in_data[5],in_data[4],data_length-5);
-				else if(in_data[3]==0)
-					del_buddy((char*)&in_data[4],data_length-4);
-			}
-			break;
+}
 
-		case DISPLAY_CLIENT_WINDOW:
-			{
-				if (data_length <= 4)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged DISPLAY_CLIENT_WINDOW packet received.\n");
-				  break;
-				}
-				switch(in_data[3]){
-					case RULE_WIN:
-					case RULE_INTERFACE:
-						highlight_rule(in_data[3],in_data+4,data_length-4);
-						break;
-					case NEW_CHAR_INTERFACE:
-						hide_all_root_windows ();
-						hide_hud_windows ();
-						countdown=0;
-						have_a_map=0;
-						create_newchar_root_window ();
-						show_window (newchar_root_win);
-						connect_to_server();
-						break;
-					default:
-						break;
-				}
-			}
-			break;
-		case OPEN_BOOK:
-			{
-				if (data_length <= 4)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged OPEN_BOOK packet received.\n");
-				  break;
-				}
-				open_book(SDL_SwapLE16(*((Uint16*)(in_data+3))));
-			}
-			break;
+typedef void (*message_handler_t)(const Uint8 *in_data, int data_length);
 
-		case READ_BOOK:
-			{
-				if (data_length <= 7)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged READ_BOOK packet received.\n");
-				  break;
-				}
-				read_network_book((char*)in_data+3, data_length-3);
-			}
-			break;
+static message_handler_t message_handlers[256];
+static const char *message_names[256];
+static int message_handlers_initialised = 0;
 
-		case CLOSE_BOOK:
-			{
-				if (data_length <= 4)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged CLOSE_BOOK packet received.\n");
-				  break;
-				}
-				close_book(SDL_SwapLE16(*((Uint16*)(in_data+3))));
-			}
-			break;
-		case STORAGE_LIST:
-			{
-				if (data_length <= 4)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged STORAGE_LIST packet received.\n");
-				  break;
-				}
-				get_storage_categories((char*)in_data+3, data_length-3);
-			}
-			break;
+#define ADD_MESSAGE_HANDLER(type, handler)	\
+	do	\
+	{	\
+		message_handlers[type] = handler;	\
+		message_names[type] = #type;	\
+	} while (0)
 
-		case STORAGE_ITEMS:
-			{
-				if (data_length <= 4)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged STORAGE_ITEMS packet received.\n");
-				  break;
-				}
-				get_storage_items(in_data+3, data_length-3);
-				trade_post_storage();
-			}
-			break;
+static void init_message_handlers(void)
+{
+	int i;
 
-		case STORAGE_TEXT:
-			{
-				if (data_length <= 4)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged STORAGE_TEXT packet received.\n");
-				  break;
-				}
-				get_storage_text(in_data+3, data_length-3);
-			}
-			break;
-		case SPELL_CAST:
-			{
-				if (data_length <= 3)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged SPELL_CAST packet received.\n");
-				  break;
-				}
-				if (((in_data[3] == S_SUCCES) || (in_data[3] == S_NAME)) && (data_length <= 4))
-				{
-				  LOG_WARNING("CAUTION(2): Possibly forged SPELL_CAST packet received.\n");
-				  break;
-				}
-				process_network_spell((char*)in_data+3, data_length-3);
-				if (in_data[3] == S_SUCCES) {
-					// increment the spell counter
-					increment_spell_counter(in_data[4]);
-				}
-       		}
-			break;
-		case GET_ACTIVE_CHANNELS:
-			if (data_length <= 3)
-			{
-			  LOG_WARNING("CAUTION: Possibly forged GET_ACTIVE_CHANNELS packet received.\n");
-			  break;
-			}
-			set_active_channels (in_data[3], (Uint32*)(in_data+4), (data_length-2)/4);
-			break;
+	for (i = 0; i < 256; i++)
+	{
+		message_handlers[i] = process_unknown_message;
+		message_names[i] = NULL;
+	}
 
-		case GET_3D_OBJ_LIST:
-			if (data_length <= 3)
-			{
-			  LOG_WARNING("CAUTION: Possibly forged GET_3D_OBJ_LIST packet received.\n");
-			  break;
-			}
-			get_3d_objects_from_server (in_data[3], &in_data[4], data_length - 4);
-			break;
+	ADD_MESSAGE_HANDLER(RAW_TEXT, process_raw_text);
+	ADD_MESSAGE_HANDLER(ADD_NEW_ACTOR, process_add_new_actor);
+	ADD_MESSAGE_HANDLER(ADD_NEW_ENHANCED_ACTOR, process_add_new_enhanced_actor);
+	ADD_MESSAGE_HANDLER(ADD_ACTOR_COMMAND, process_add_actor_command);
+	ADD_MESSAGE_HANDLER(ADD_ACTOR_ANIMATION, process_add_actor_animation);
+	ADD_MESSAGE_HANDLER(REMOVE_ACTOR, process_remove_actor);
+	ADD_MESSAGE_HANDLER(KILL_ALL_ACTORS, process_kill_all_actors);
+	ADD_MESSAGE_HANDLER(NEW_MINUTE, process_new_minute);
+	ADD_MESSAGE_HANDLER(LOG_IN_OK, process_log_in_ok);
+	ADD_MESSAGE_HANDLER(HERE_YOUR_STATS, process_here_your_stats);
+	ADD_MESSAGE_HANDLER(SEND_PARTIAL_STAT, process_send_partial_stat);
+	ADD_MESSAGE_HANDLER(GET_KNOWLEDGE_LIST, process_get_knowledge_list);
+	ADD_MESSAGE_HANDLER(GET_NEW_KNOWLEDGE, process_get_new_knowledge);
+	ADD_MESSAGE_HANDLER(HERE_YOUR_INVENTORY, process_here_your_inventory);
+	ADD_MESSAGE_HANDLER(GET_NEW_INVENTORY_ITEM, process_get_new_inventory_item);
+	ADD_MESSAGE_HANDLER(REMOVE_ITEM_FROM_INVENTORY, process_remove_item_from_inventory);
+	ADD_MESSAGE_HANDLER(INVENTORY_ITEM_TEXT, process_inventory_item_text);
+	ADD_MESSAGE_HANDLER(SPELL_ITEM_TEXT, process_spell_item_text);
+	ADD_MESSAGE_HANDLER(GET_KNOWLEDGE_TEXT, process_get_knowledge_text);
+	ADD_MESSAGE_HANDLER(CHANGE_MAP, process_change_map);
+	ADD_MESSAGE_HANDLER(GET_TELEPORTERS_LIST, process_get_teleporters_list);
+	ADD_MESSAGE_HANDLER(PLAY_MUSIC, process_play_music);
+	ADD_MESSAGE_HANDLER(PLAY_SOUND, process_play_sound);
+	ADD_MESSAGE_HANDLER(TELEPORT_OUT, process_teleport_out);
+	ADD_MESSAGE_HANDLER(TELEPORT_IN, process_teleport_in);
+	ADD_MESSAGE_HANDLER(LOG_IN_NOT_OK, process_log_in_not_ok);
+	ADD_MESSAGE_HANDLER(REDEFINE_YOUR_COLORS, process_redefine_your_colors);
+	ADD_MESSAGE_HANDLER(YOU_DONT_EXIST, process_you_dont_exist);
+	ADD_MESSAGE_HANDLER(CREATE_CHAR_NOT_OK, process_create_char_not_ok);
+	ADD_MESSAGE_HANDLER(CREATE_CHAR_OK, process_create_char_ok);
+	ADD_MESSAGE_HANDLER(YOU_ARE, process_you_are);
+	ADD_MESSAGE_HANDLER(START_RAIN, process_start_rain);
+	ADD_MESSAGE_HANDLER(STOP_RAIN, process_stop_rain);
+	ADD_MESSAGE_HANDLER(THUNDER, process_thunder);
+	ADD_MESSAGE_HANDLER(SEND_WEATHER, process_send_weather);
+	ADD_MESSAGE_HANDLER(SYNC_CLOCK, process_sync_clock);
+	ADD_MESSAGE_HANDLER(PONG, process_pong);
+	ADD_MESSAGE_HANDLER(UPGRADE_NEW_VERSION, process_upgrade_new_version);
+	ADD_MESSAGE_HANDLER(UPGRADE_TOO_OLD, process_upgrade_too_old);
+	ADD_MESSAGE_HANDLER(GET_NEW_BAG, process_get_new_bag);
+	ADD_MESSAGE_HANDLER(GET_BAGS_LIST, process_get_bags_list);
+	ADD_MESSAGE_HANDLER(SPAWN_BAG_PARTICLES, process_spawn_bag_particles);
+	ADD_MESSAGE_HANDLER(FIRE_PARTICLES, process_fire_particles);
+	ADD_MESSAGE_HANDLER(REMOVE_FIRE_AT, process_remove_fire_at);
+	ADD_MESSAGE_HANDLER(GET_NEW_GROUND_ITEM, process_get_new_ground_item);
+	ADD_MESSAGE_HANDLER(HERE_YOUR_GROUND_ITEMS, process_here_your_ground_items);
+	ADD_MESSAGE_HANDLER(CLOSE_BAG, process_close_bag);
+	ADD_MESSAGE_HANDLER(REMOVE_ITEM_FROM_GROUND, process_remove_item_from_ground);
+	ADD_MESSAGE_HANDLER(DESTROY_BAG, process_destroy_bag);
+	ADD_MESSAGE_HANDLER(NPC_TEXT, process_npc_text);
+	ADD_MESSAGE_HANDLER(SEND_NPC_INFO, process_send_npc_info);
+	ADD_MESSAGE_HANDLER(NPC_OPTIONS_LIST, process_npc_options_list);
+	ADD_MESSAGE_HANDLER(GET_TRADE_ACCEPT, process_get_trade_accept);
+	ADD_MESSAGE_HANDLER(GET_TRADE_REJECT, process_get_trade_reject);
+	ADD_MESSAGE_HANDLER(GET_TRADE_EXIT, process_get_trade_exit);
+	ADD_MESSAGE_HANDLER(GET_YOUR_TRADEOBJECTS, process_get_your_tradeobjects);
+	ADD_MESSAGE_HANDLER(GET_TRADE_OBJECT, process_get_trade_object);
+	ADD_MESSAGE_HANDLER(REMOVE_TRADE_OBJECT, process_remove_trade_object);
+	ADD_MESSAGE_HANDLER(GET_TRADE_PARTNER_NAME, process_get_trade_partner_name);
+	ADD_MESSAGE_HANDLER(GET_YOUR_SIGILS, process_get_your_sigils);
+	ADD_MESSAGE_HANDLER(GET_ACTIVE_SPELL, process_get_active_spell);
+	ADD_MESSAGE_HANDLER(REMOVE_ACTIVE_SPELL, process_remove_active_spell);
+	ADD_MESSAGE_HANDLER(GET_ACTIVE_SPELL_LIST, process_get_active_spell_list);
+	ADD_MESSAGE_HANDLER(GET_ACTOR_HEALTH, process_get_actor_health);
+	ADD_MESSAGE_HANDLER(GET_ACTOR_DAMAGE, process_get_actor_damage);
+	ADD_MESSAGE_HANDLER(GET_ACTOR_HEAL, process_get_actor_heal);
+	ADD_MESSAGE_HANDLER(ACTOR_UNWEAR_ITEM, process_actor_unwear_item);
+	ADD_MESSAGE_HANDLER(ACTOR_WEAR_ITEM, process_actor_wear_item);
+	ADD_MESSAGE_HANDLER(NPC_SAY_OVERTEXT, process_npc_say_overtext);
+	ADD_MESSAGE_HANDLER(PING_REQUEST, process_ping_request);
+	ADD_MESSAGE_HANDLER(BUDDY_EVENT, process_buddy_event);
+	ADD_MESSAGE_HANDLER(DISPLAY_CLIENT_WINDOW, process_display_client_window);
+	ADD_MESSAGE_HANDLER(OPEN_BOOK, process_open_book);
+	ADD_MESSAGE_HANDLER(READ_BOOK, process_read_book);
+	ADD_MESSAGE_HANDLER(CLOSE_BOOK, process_close_book);
+	ADD_MESSAGE_HANDLER(STORAGE_LIST, process_storage_list);
+	ADD_MESSAGE_HANDLER(STORAGE_ITEMS, process_storage_items);
+	ADD_MESSAGE_HANDLER(STORAGE_TEXT, process_storage_text);
+	ADD_MESSAGE_HANDLER(SPELL_CAST, process_spell_cast);
+	ADD_MESSAGE_HANDLER(GET_ACTIVE_CHANNELS, process_get_active_channels);
+	ADD_MESSAGE_HANDLER(GET_3D_OBJ_LIST, process_get_3d_obj_list);
+	ADD_MESSAGE_HANDLER(GET_3D_OBJ, process_get_3d_obj);
+	ADD_MESSAGE_HANDLER(REMOVE_3D_OBJ, process_remove_3d_obj);
+	ADD_MESSAGE_HANDLER(MAP_SET_OBJECTS, process_map_set_objects);
+	ADD_MESSAGE_HANDLER(MAP_STATE_OBJECTS, process_map_state_objects);
+	ADD_MESSAGE_HANDLER(MAP_FLAGS, process_map_flags);
+	ADD_MESSAGE_HANDLER(GET_ITEMS_COOLDOWN, process_get_items_cooldown);
+	ADD_MESSAGE_HANDLER(SEND_BUFFS, process_send_buffs);
+	ADD_MESSAGE_HANDLER(SEND_SPECIAL_EFFECT, process_send_special_effect);
+	ADD_MESSAGE_HANDLER(REMOVE_MINE, process_remove_mine);
+	ADD_MESSAGE_HANDLER(GET_NEW_MINE, process_get_new_mine);
+	ADD_MESSAGE_HANDLER(GET_MINES_LIST, process_get_mines_list);
+	ADD_MESSAGE_HANDLER(DISPLAY_POPUP, process_display_popup);
+	ADD_MESSAGE_HANDLER(MISSILE_AIM_A_AT_B, process_missile_aim_a_at_b);
+	ADD_MESSAGE_HANDLER(MISSILE_AIM_A_AT_XYZ, process_missile_aim_a_at_xyz);
+	ADD_MESSAGE_HANDLER(MISSILE_FIRE_A_TO_B, process_missile_fire_a_to_b);
+	ADD_MESSAGE_HANDLER(MISSILE_FIRE_A_TO_XYZ, process_missile_fire_a_to_xyz);
+	ADD_MESSAGE_HANDLER(MISSILE_FIRE_XYZ_TO_B, process_missile_fire_xyz_to_b);
+	ADD_MESSAGE_HANDLER(SEND_MAP_MARKER, process_send_map_marker);
+	ADD_MESSAGE_HANDLER(REMOVE_MAP_MARKER, process_remove_map_marker);
+	ADD_MESSAGE_HANDLER(NEXT_NPC_MESSAGE_IS_QUEST, process_next_npc_message_is_quest);
+	ADD_MESSAGE_HANDLER(HERE_IS_QUEST_ID, process_here_is_quest_id);
+	ADD_MESSAGE_HANDLER(QUEST_FINISHED, process_quest_finished);
+	ADD_MESSAGE_HANDLER(SEND_ACHIEVEMENTS, process_send_achievements);
+	ADD_MESSAGE_HANDLER(SEND_BUFF_DURATION, process_send_buff_duration);
+
+	message_handlers_initialised = 1;
+}
 
-		case GET_3D_OBJ:
-			get_3d_objects_from_server (1, &in_data[3], data_length - 3);
-			break;
+int message_stats = 0;
+static message_stats_t message_type_stats[256];
 
-		case REMOVE_3D_OBJ:
-			if (data_length <= 4)
-			{
-			  LOG_WARNING("CAUTION: Possibly forged REMOVE_3D_OBJ packet received.\n");
-			  break;
-			}
-			remove_3d_object_from_server (SDL_SwapLE16 (*((Uint16 *)(&in_data[3]))));
-			break;
+void reset_message_stats(void)
+{
+	memset(message_type_stats, 0, sizeof(message_type_stats));
+}
 
-		// for use by 1.0.3 server and higher
-		case MAP_SET_OBJECTS:
-			if (data_length <= 4)
-			{
-			  LOG_WARNING("CAUTION: Possibly forged MAP_SET_OBJECTS packet received.\n");
-			  break;
-			}
-			switch(in_data[3]){
-				case	0:	//2D
-					set_2d_object(in_data[4], in_data+5, data_length-3);
-					break;
-				case	1:	//3D
-					set_3d_object(in_data[4], in_data+5, data_length-3);
-					break;
-			}
-			break;
+const message_stats_t *get_message_stats(Uint8 type)
+{
+	return &message_type_stats[type];
+}
 
-		// for future expansion
-		case MAP_STATE_OBJECTS:
-			if (data_length <= 8)
-			{
-			  LOG_WARNING("CAUTION: Possibly forged MAP_STATE_OBJECTS packet received.\n");
-			  break;
-			}
-			switch(in_data[3]){
-				case	0:	//2D
-					state_2d_object(in_data[4], in_data+5, data_length-3);
-					break;
-				case	1:	//3D
-					state_3d_object(in_data[4], in_data+5, data_length-3);
-					break;
-			}
-			break;
+const char *get_message_name(Uint8 type)
+{
+	if (!message_handlers_initialised)
+	{
+		init_message_handlers();
+	}
 
-		case MAP_FLAGS:
-			if (data_length <= 6)
-			{
-			  LOG_WARNING("CAUTION: Possibly forged MAP_FLAGS packet received.\n");
-			  break;
-			}
-			map_flags=SDL_SwapLE32(*((Uint32 *)(in_data+3)));
-			break;
+	return message_names[type];
+}
 
-		case GET_ITEMS_COOLDOWN:
-				// make sure we interpret the incoming octets as unsigned
-				// in case the function signature changes
-			if (data_length <= 3)
-			{
-			  LOG_WARNING("CAUTION: Possibly forged GET_ITEMS_COOLDOWN packet received.\n");
-			  break;
-			}
-			get_items_cooldown (&in_data[3], data_length - 3);
-			break;
+static void add_message_stats(Uint8 type, int data_length, Uint64 time)
+{
+	message_stats_t *stats;
+	Uint64 us;
+	int bucket;
+
+	stats = &message_type_stats[type];
+	stats->count++;
+	stats->bytes += data_length;
+	stats->total_time += time;
+	if (time > stats->max_time)
+	{
+		stats->max_time = time;
+	}
 
-		case SEND_BUFFS:
-#ifdef EXTRA_DEBUG
-	ERR();
-#endif
-			if (data_length < 9)
-			{
-			  LOG_WARNING("CAUTION: Possibly forged SEND_BUFFS packet received.\n");
-			  break;
-			}
-#ifdef BUFF_DEBUG
-			{
-				int actor_id = SDL_SwapLE16(*((short *)(in_data+3)));
-				actor *act = get_actor_ptr_from_id(actor_id);
-				if(act){
-					printf("SEND_BUFFS received for actor %s\n", act->actor_name);
-				}
-				else {
-					printf("SEND_BUFFS received for actor ID %i\n", actor_id);
-				}
-			}
-#endif // BUFF_DEBUG
-			update_actor_buffs(SDL_SwapLE16(*((short *)(in_data+3))), SDL_SwapLE32(*((Uint32 *)(in_data+5))));
-			break;
+	/* bucket 0 is below one microsecond, bucket i is [2^(i-1), 2^i) */
+	us = time * 1000000 / SDL_GetPerformanceFrequency();
+	bucket = 0;
+	while ((us > 0) && (bucket < MESSAGE_STATS_BUCKETS - 1))
+	{
+		us >>= 1;
+		bucket++;
+	}
+	stats->histogram[bucket]++;
+}
 
-		case SEND_SPECIAL_EFFECT:
-			if (data_length <= 5)
-			{
-			  LOG_WARNING("CAUTION: Possibly forged SEND_SPECIAL_EFFECT packet received.\n");
-			  break;
-			}
-			if (
-			    (in_data[3] == SPECIAL_EFFECT_POISON) ||
-			    (in_data[3] == SPECIAL_EFFECT_REMOTE_HEAL) ||
-			    (in_data[3] == SPECIAL_EFFECT_HARM) ||
-			    (in_data[3] == SPECIAL_EFFECT_MANA_DRAIN) ||
-			    (in_data[3] == SPECIAL_EFFECT_INVASION_BEAMING) ||
-			    (in_data[3] == SPECIAL_EFFECT_TELEPORT_TO_RANGE)
-			   )
-			{
-				if (data_length <= 7)
-				{
-				  LOG_WARNING("CAUTION(2): Possibly forged SEND_SPECIAL_EFFECT packet received.\n");
-				  break;
-				}
-			}
-				if (special_effects){
-					parse_special_effect(in_data[3], (const Uint16 *) &in_data[4]);
-				}
-			break;
+void process_message_from_server (const Uint8 *in_data, int data_length)
+{
+	Uint64 start;
 
-		case REMOVE_MINE:
-			{
-#ifdef EXTRA_DEBUG
-	ERR();
-#endif
-				remove_mine(in_data[3]);
-			}
-			break;
+	if (data_length <= 2)
+	{
+		LOG_WARNING("CAUTION: Possibly forged packet received.\n");
+		return;
+	}
 
-		case GET_NEW_MINE:
-			{
-#ifdef EXTRA_DEBUG
-	ERR();
-#endif
-				if (data_length <= 8)
-				{
-					LOG_WARNING("CAUTION: Possibly forged GET_NEW_MINE packet received.\n");
-					break;
-				}
-				put_mine_on_ground(SDL_SwapLE16(*((Uint16 *)(in_data+3))), SDL_SwapLE16(*((Uint16 *)(in_data+5))), in_data[8], in_data[7]);
-			}
-			break;
+	if (!message_handlers_initialised)
+	{
+		init_message_handlers();
+	}
 
-		case GET_MINES_LIST:
-			{
-				Uint16 mines_no;
-#ifdef EXTRA_DEBUG
-	ERR();
-#endif
-				if (data_length <= 3)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged GET_MINES_LIST packet received.\n");
-				  break;
-				}
-				mines_no = in_data[3];
-				if (data_length <= mines_no * 6 + 3)
-				{
-				  LOG_WARNING("CAUTION(2): Possibly forged GET_MINES_LIST packet received.\n");
-				  break;
-				}
-				add_mines_from_list(&in_data[3]);
-			}
-			break;
-		case DISPLAY_POPUP:
-			{
-				if (data_length <= 8) /* At least one char title and one char text */
-				{
-					LOG_WARNING("CAUTION: Possibly forged DISPLAY_POPUP packet received.\n");
-					break;
-				}
-				popup_create_from_network(&in_data[3], data_length - 3);
-			}
-			break;
-		case MISSILE_AIM_A_AT_B:
-			if (data_length >= 7)
-			{
-				missiles_aim_at_b(SDL_SwapLE16(*((short *)(in_data+3))),SDL_SwapLE16(*((short *)(in_data+5))));
-			}
-			break;
-		case MISSILE_AIM_A_AT_XYZ:
-			if (data_length >= 17)
-			{
-				float target[3];
-				target[0] = SwapLEFloat(*((float*)(in_data+5)));
-				target[1] = SwapLEFloat(*((float*)(in_data+9)));
-				target[2] = SwapLEFloat(*((float*)(in_data+13)));
-				missiles_aim_at_xyz(SDL_SwapLE16(*((short *)(in_data+3))),target);
-			}
-			break;
-		case MISSILE_FIRE_A_TO_B:
-			if (data_length >= 7)
-			{
-				missiles_fire_a_to_b(SDL_SwapLE16(*((short *)(in_data+3))),SDL_SwapLE16(*((short *)(in_data+5))));
-			}
-			break;
-		case MISSILE_FIRE_A_TO_XYZ:
-			if (data_length >= 17)
-			{
-				float target[3];
-				target[0] = SwapLEFloat(*((float*)(in_data+5)));
-				target[1] = SwapLEFloat(*((float*)(in_data+9)));
-				target[2] = SwapLEFloat(*((float*)(in_data+13)));
-				missiles_fire_a_to_xyz(SDL_SwapLE16(*((short *)(in_data+3))),target);
-			}
-			break;
-		case MISSILE_FIRE_XYZ_TO_B:
-			if (data_length >= 17)
-			{
-				float source[3];
-				source[0] = SwapLEFloat(*((float*)(in_data+5)));
-				source[1] = SwapLEFloat(*((float*)(in_data+9)));
-				source[2] = SwapLEFloat(*((float*)(in_data+13)));
-				missiles_fire_xyz_to_b(source,SDL_SwapLE16(*((short *)(in_data+3))));
-			}
-			break;
-		case SEND_MAP_MARKER:
-			{
-			//in_data[3]=id
-			//in_data[5]=x;
-			//in_data[7]=y;
-			//map_name\0text\0
-			int i,fl=0,k=0;
-			server_mark *sm;
-
-			if (data_length <= 10)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged SEND_MAP_MARKER packet received.\n");
-				  break;
-				}
-			sm = calloc(1,sizeof(server_mark));//memory is set to zero
-			sm->x=SDL_SwapLE16(*((short *)(in_data+5)));
-			sm->y=SDL_SwapLE16(*((short *)(in_data+7)));
-			sm->id=SDL_SwapLE16(*((short *)(in_data+3)));
-			for(i=9;i<data_length;i++){
-				if(in_data[i]==0) {fl=1; k=0; continue;}
-				if(!fl) sm->map_name[k++]=in_data[i]; //reading map name
-				else sm->text[k++]=in_data[i];//reading mark text
-			}
-			//printf("ADD MARKER: %i %i %i %s %s\n",sm->id,sm->x,sm->y,sm->map_name,sm->text);
-			if(!server_marks) init_server_markers();
-			hash_delete(server_marks, (void *)(uintptr_t)sm->id); //remove old marker if present
-			hash_add(server_marks, (void *)(uintptr_t)sm->id,(void*)sm);
-			save_server_markings();
-			load_map_marks();//load again, so the new marker is added correctly.
-			break;
-			}
-		case REMOVE_MAP_MARKER:
-			{
-			int id;
-			if (data_length <= 4)
-				{
-				  LOG_WARNING("CAUTION: Possibly forged REMOVE_MAP_MARKER packet received.\n");
-				  break;
-				}
-			id=SDL_SwapLE16(*((short *)(in_data+3)));
-			hash_delete(server_marks,(void *)(uintptr_t)id); //remove marker if present
-			save_server_markings();
-			load_map_marks();//load again, so the new marker is removed correctly.
-			break;
-			}
-		case NEXT_NPC_MESSAGE_IS_QUEST:
-			{
-				if (data_length <= 4)
-				{
-					LOG_WARNING("CAUTION: Possibly forged NEXT_NPC_MESSAGE_IS_QUEST packet received.\n");
-					break;
-				}
-				set_next_quest_entry_id(SDL_SwapLE16(*((short *)(in_data+3))));
-				break;
-			}
-		case HERE_IS_QUEST_ID:
-			{
-				if (data_length <= 3)
-				{
-					LOG_WARNING("CAUTION: Possibly forged HERE_IS_QUEST_ID packet received.\n");
-					break;
-				}
-				set_quest_title((const char *)&in_data[3], data_length - 3);
-				break;
-			}
-		case QUEST_FINISHED:
-			{
-				if (data_length <= 4)
-				{
-					LOG_WARNING("CAUTION: Possibly forged QUEST_FINISHED packet received.\n");
-					break;
-				}
-				set_quest_finished(SDL_SwapLE16(*((short *)(in_data+3))));
-				break;
-			}
-		case SEND_ACHIEVEMENTS:
-			{
-				Uint32 *achievement_data = NULL;
-				size_t word_count = (data_length-3) / sizeof(Uint32);
-				size_t i;
-				if ((word_count < 1) && (word_count < MAX_ACHIEVEMENTS/32))
-				{
-					LOG_WARNING("CAUTION: Possibly forged SEND_ACHIEVEMENTS packet received.\n");
-					break;
-				}
-				achievement_data = (Uint32 *)calloc(word_count, sizeof(Uint32));
-				for (i=0; i<word_count; ++i)
-					achievement_data[i] = SDL_SwapLE32(*((Uint32 *)(in_data+3+i*sizeof(Uint32))));
-				achievements_data(achievement_data, word_count);
-				free(achievement_data);
-			}
-			break;
-		case SEND_BUFF_DURATION:
-			{
-				if (data_length <= 3)
-					LOG_WARNING("CAUTION: Possibly forged/invalid SEND_BUFF_DURATION packet received.\n");
-				else
-					here_is_a_buff_duration((Uint8)in_data[3]);
-				break;
-			}
-		default:
-			{
-				// Unknown packet type??
-#ifdef	OLC
-				// do OL specific packet handling
-				olc_packet_handler(in_data, data_length);
-#endif	//OLC
-			}
-			break;
-		}
+	//see what kind of data we got
+	if (message_stats)
+	{
+		start = SDL_GetPerformanceCounter();
+		message_handlers[in_data[PROTOCOL]](in_data, data_length);
+		add_message_stats(in_data[PROTOCOL], data_length,
+			SDL_GetPerformanceCounter() - start);
+	}
+	else
+	{
+		message_handlers[in_data[PROTOCOL]](in_data, data_length);
+	}
 }
 
 
@@ -2335,55 +2588,43 @@ void check_if_testing_server_connection(void)
 }
 
 
-static void process_data_from_server(queue_t *queue)
+static void process_data_from_server(message_ring_t *ring)
 {
+	Uint8   *pData;
+	Uint32   pending;
+	Uint32   size;
+
 	/* enough data present for the length field ? */
-	if (3 <= in_data_used) {
-		Uint8   *pData  = tcp_in_data;
-		Uint16   size;
-
-		do { /* while (3 <= in_data_used) (enough data present for the length field) */
-			size = SDL_SwapLE16(*((short*)(pData+1)));
-			size += 2; /* add length field size */
-
-			if (sizeof (tcp_in_data) - 3 >= size) { /* buffer big enough ? */
-
-				if (size <= in_data_used) { /* do we have a complete message ? */
-					message_t *message = malloc(sizeof *message);
-					message->data = malloc(size*sizeof(unsigned char));
-					message->length = size;
-					memcpy(message->data, pData, size);
-					queue_push(queue, message);
-
-					if (log_conn_data){
-						log_conn(pData, size);
-					}
-
-					/* advance to next message */
-					pData         += size;
-					in_data_used  -= size;
-				} else {
-					break;
-				}
-			}
-			else { /* sizeof (tcp_in_data) - 3 < size */
-				LOG_ERROR ("Packet overrun, protocol = %d, size = %u\n", pData[0], size);
-				in_data_used = 0;
-				enter_disconnected_state(packet_overrun);
-			}
-		} while (3 <= in_data_used);
+	while ((pData = message_ring_get_pending(ring, &pending)) && (3 <= pending)) {
+		size = SDL_SwapLE16(*((Uint16*)(pData+1)));
+		size += 2; /* add length field size */
+
+		if (size > MESSAGE_RING_MAX_MESSAGE) { /* message too big for the ring ? */
+			LOG_ERROR ("Packet overrun, protocol = %d, size = %u\n", pData[0], size);
+			message_ring_discard(ring);
+			enter_disconnected_state(packet_overrun);
+			break;
+		}
+
+		if (size > pending) { /* do we have a complete message ? */
+			break;
+		}
 
-		/* move the remaining data to the start of the buffer...(not tested...never happened to me) */
-		if (in_data_used > 0 && pData != tcp_in_data){
-			memmove(tcp_in_data, pData, in_data_used);
+		if (log_conn_data){
+			log_conn(pData, size);
 		}
+
+		/* the message stays where it was received */
+		message_ring_commit(ring, size);
 	}
 }
 
 int get_message_from_server(void *thread_args)
 {
 	int received;
-	void *queue = ((void **) thread_args)[0];
+	Uint8 *space;
+	Uint32 space_size;
+	message_ring_t *ring = ((void **) thread_args)[0];
 	int *done = ((void **) thread_args)[1];
 
 	init_thread_log("server_message");
@@ -2394,17 +2635,29 @@ int get_message_from_server(void *thread_args)
 		if(disconnected){
 			SDL_Delay(100);	// 10 times per second should be often enough
 			continue; //Continue to make the main loop check int done.
-		} else if(SDLNet_CheckSockets(set, 100) <= 0 || !SDLNet_SocketReady(my_socket)) {
+		}
+
+		// send the commands the main loop left waiting, e.g. while loading a map
+		my_tcp_flush_stalled(my_socket, tcp_send_delay + TCP_STALL_FLUSH_DELAY);
+
+		if(SDLNet_CheckSockets(set, 100) <= 0 || !SDLNet_SocketReady(my_socket)) {
 			//if no data, loop back and check again, the delay is in SDLNet_CheckSockets()
 			continue; //Continue to make the main loop check int done.
 		}
 
-		if ((received = SDLNet_TCP_Recv(my_socket, &tcp_in_data[in_data_used], sizeof (tcp_in_data) - in_data_used)) > 0) {
-			in_data_used += received;
-			process_data_from_server(queue);
+		space = message_ring_get_space(ring, &space_size);
+		if (space_size == 0) {
+			//wait for the main loop to process some messages
+			SDL_Delay(1);
+			continue;
+		}
+
+		if ((received = SDLNet_TCP_Recv(my_socket, space, space_size)) > 0) {
+			message_ring_received(ring, received);
+			process_data_from_server(ring);
 		}
 		else { /* 0 >= received (EOF or some error) */
-			in_data_used = 0;
+			message_ring_discard(ring);
 			enter_disconnected_state((received)?SDLNet_GetError():NULL);
 		}
 	}
@@ -7,6 +7,7 @@
 #define __MULTIPLAYER_H__
 
 #include <SDL_net.h>
+#include "message_ring.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -104,6 +105,8 @@ extern time_t last_save_time; /*!< a timestamp inidicating the last #save */
 
 extern int log_conn_data; /*!< indicates whether we should log connection data or not */
 
+extern message_ring_t *server_message_ring; /*!< the messages received from the server, waiting for the main loop */
+
 extern char inventory_item_string[300]; /*!< the last inventory text string */
 extern size_t inventory_item_string_id; /*!< incremented each time we get a new string so users notice */
 
@@ -158,6 +161,57 @@ int my_tcp_send (TCPsocket my_socket, const Uint8 *str, int len);
 
 int my_tcp_flush (TCPsocket my_socket);
 
+#define TCP_STALL_FLUSH_DELAY	100	/*!< ms after \ref tcp_send_delay until the network thread sends commands the main loop did not flush */
+
+extern int tcp_send_delay;	/*!< ms the commands are held back so that more of them go out in one write */
+
+/*!
+ * Counters of the data sent to the server since connecting.
+ */
+typedef struct
+{
+	Uint64 commands;	/*!< commands queued */
+	Uint64 coalesced;	/*!< commands dropped because a newer one superseded them */
+	Uint64 sends;		/*!< socket writes */
+	Uint64 bytes;		/*!< bytes written */
+	Uint32 start_time;	/*!< SDL_GetTicks() when counting started */
+} tcp_send_stats_t;
+
+/*!
+ * \ingroup network_actors
+ * \brief   Sends the tcp output buffer once its oldest command has waited long enough.
+ *
+ *      Called by the main loop once per frame, so all commands of one frame
+ *      go out in one write.
+ *
+ * \param my_socket    the socket to send to
+ * \param delay        ms the oldest command has to be buffered
+ * \retval int         the return value of SDLNet_TCP_Send, 0 if nothing was sent
+ */
+int my_tcp_flush_due(TCPsocket my_socket, Uint32 delay);
+
+/*!
+ * \ingroup network_actors
+ * \brief   Sends the tcp output buffer if the main loop left it waiting.
+ *
+ *      Called by the network thread. Unlike my_tcp_flush_due() it only
+ *      writes the buffer out, the heart beat and the \ref tcp_cache of the
+ *      spam filter are only used by the main thread.
+ *
+ * \param my_socket    the socket to send to
+ * \param delay        ms the oldest command has to be buffered
+ * \retval int         the return value of SDLNet_TCP_Send, 0 if nothing was sent
+ */
+int my_tcp_flush_stalled(TCPsocket my_socket, Uint32 delay);
+
+/*!
+ * \ingroup network_actors
+ * \brief   Gets the counters of the data sent to the server.
+ *
+ * \param stats    where to store the counters
+ */
+void get_tcp_send_stats(tcp_send_stats_t *stats);
+
 
 /*!
  * \ingroup network_actors
@@ -218,8 +272,59 @@ void send_new_char(char * user_str, char * pass_str, char skin, char hair, char
  */
 int get_message_from_server(void *thread_args);
 
+/*!
+ * \ingroup network_actors
+ * \brief   Processes one message from the server.
+ *
+ *      Calls the handler registered for the protocol byte of the message.
+ *      If \ref message_stats is set, the time taken is added to the
+ *      statistics of the message type.
+ *
+ * \param in_data       the message, starting with the protocol byte
+ * \param data_length   size of the message, including the header
+ */
 void process_message_from_server(const Uint8 *in_data, int data_length);
 
+#define MESSAGE_STATS_BUCKETS	16	/*!< buckets of the processing time histogram */
+
+/*!
+ * Processing statistics of one message type.
+ */
+typedef struct
+{
+	Uint32 count;		/*!< messages processed */
+	Uint64 bytes;		/*!< bytes processed */
+	Uint64 total_time;	/*!< summed processing time in performance counter ticks */
+	Uint64 max_time;	/*!< longest processing time in performance counter ticks */
+	Uint32 histogram[MESSAGE_STATS_BUCKETS];	/*!< bucket 0 counts times below 1 us, bucket i times in [2^(i-1), 2^i) us, the last one everything above */
+} message_stats_t;
+
+extern int message_stats;	/*!< if set, the processing time of each message type is measured */
+
+/*!
+ * \ingroup network_actors
+ * \brief   Clears the statistics of all message types.
+ */
+void reset_message_stats(void);
+
+/*!
+ * \ingroup network_actors
+ * \brief   Gets the statistics of a message type.
+ *
+ * \param type  the protocol byte
+ * \retval const message_stats_t*   the statistics
+ */
+const message_stats_t *get_message_stats(Uint8 type);
+
+/*!
+ * \ingroup network_actors
+ * \brief   Gets the name of a message type.
+ *
+ * \param type  the protocol byte
+ * \retval const char*  the name or NULL if the client does not handle the type
+ */
+const char *get_message_name(Uint8 type);
+
 void send_heart_beat();
 
 /*!
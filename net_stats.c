@@ -0,0 +1,380 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL_timer.h>
+#include "net_stats.h"
+#include "client_serv.h"
+#include "multiplayer.h"
+#include "io/elpathwrapper.h"
+
+#define NET_STATS_PINGS	8	/*!< pings waiting for their PONG */
+
+typedef struct
+{
+	Uint32 values[NET_STATS_SAMPLES];	/*!< the samples in us */
+	Uint32 times[NET_STATS_SAMPLES];	/*!< when they were taken, in ms */
+	Uint32 next;		/*!< where the next sample goes */
+	Uint32 count;		/*!< samples in the window */
+	Uint64 total;		/*!< samples since the last reset */
+	int changed;		/*!< set if the summary is out of date */
+	net_stats_summary_t summary;
+} net_stats_samples_t;
+
+typedef struct
+{
+	Uint32 stamp;		/*!< the time stamp sent, zero if unused */
+	Uint64 sent;		/*!< performance counter when it was sent */
+	int automatic;
+} net_stats_ping_t;
+
+int net_stats = 0;
+int show_net_stats = 0;
+
+static net_stats_samples_t samples[NET_STATS_KINDS];
+static net_stats_ping_t pings[NET_STATS_PINGS];
+static Uint32 next_ping = 0;
+static Uint32 last_ping_time = 0;
+static Uint64 current_receive_time = 0;
+static Uint64 last_receive_time = 0;
+static Uint32 last_interval = 0;
+static int have_interval = 0;
+static double jitter = 0.0;
+
+static const char *net_stats_names[NET_STATS_KINDS] =
+{
+	"rtt", "queue_wait", "interval", "jitter"
+};
+
+static int is_measuring(void)
+{
+	return net_stats || show_net_stats;
+}
+
+static Uint32 to_us(Uint64 ticks)
+{
+	double us;
+
+	us = 1000000.0 * ticks / SDL_GetPerformanceFrequency();
+
+	if (us >= 4294967295.0)
+	{
+		return 0xFFFFFFFF;
+	}
+
+	return (Uint32)us;
+}
+
+static void add_sample(net_stats_kind kind, Uint32 value)
+{
+	net_stats_samples_t *s;
+
+	s = &samples[kind];
+	s->values[s->next] = value;
+	s->times[s->next] = SDL_GetTicks();
+	s->next = (s->next + 1) % NET_STATS_SAMPLES;
+
+	if (s->count < NET_STATS_SAMPLES)
+	{
+		s->count++;
+	}
+
+	s->total++;
+	s->changed = 1;
+}
+
+const char *get_net_stats_name(net_stats_kind kind)
+{
+	if ((kind < 0) || (kind >= NET_STATS_KINDS))
+	{
+		return "unknown";
+	}
+
+	return net_stats_names[kind];
+}
+
+void net_stats_dispatch(Uint64 receive_time)
+{
+	Uint32 interval, difference;
+
+	current_receive_time = receive_time;
+
+	if (!is_measuring())
+	{
+		last_receive_time = 0;
+		have_interval = 0;
+
+		return;
+	}
+
+	if (receive_time == 0)
+	{
+		return;
+	}
+
+	add_sample(NET_STATS_QUEUE_WAIT, to_us(SDL_GetPerformanceCounter() - receive_time));
+
+	/* the messages of one receive share its time, messages from the
+	 * overflow queue can be older than the last receive */
+	if (receive_time <= last_receive_time)
+	{
+		return;
+	}
+
+	if (last_receive_time != 0)
+	{
+		interval = to_us(receive_time - last_receive_time);
+		add_sample(NET_STATS_INTERVAL, interval);
+
+		if (have_interval)
+		{
+			difference = (interval > last_interval) ?
+				interval - last_interval : last_interval - interval;
+			add_sample(NET_STATS_JITTER, difference);
+			jitter += (difference - jitter) / 16.0;
+		}
+
+		last_interval = interval;
+		have_interval = 1;
+	}
+
+	last_receive_time = receive_time;
+}
+
+void send_net_stats_ping(int automatic)
+{
+	Uint8 str[8];
+	Uint32 stamp;
+
+	stamp = SDL_GetTicks();
+
+	str[0] = PING;
+	*((Uint32 *)(str+1)) = SDL_SwapLE32(stamp);
+	my_tcp_send(my_socket, str, 5);
+
+	/* the oldest ping is dropped if its PONG never came */
+	pings[next_ping].stamp = stamp;
+	pings[next_ping].sent = SDL_GetPerformanceCounter();
+	pings[next_ping].automatic = automatic;
+	next_ping = (next_ping + 1) % NET_STATS_PINGS;
+
+	/* written now, so the round trip does not include the send delay */
+	my_tcp_flush(my_socket);
+}
+
+int net_stats_pong(Uint32 stamp)
+{
+	Uint64 received;
+	Uint32 i;
+	int automatic;
+
+	for (i = 0; i < NET_STATS_PINGS; i++)
+	{
+		if ((pings[i].stamp == stamp) && (pings[i].sent != 0))
+		{
+			break;
+		}
+	}
+
+	if (i == NET_STATS_PINGS)
+	{
+		return 0;
+	}
+
+	/* the receive time leaves out the wait in the message ring */
+	received = current_receive_time;
+	if (received < pings[i].sent)
+	{
+		received = SDL_GetPerformanceCounter();
+	}
+
+	if (is_measuring())
+	{
+		add_sample(NET_STATS_RTT, to_us(received - pings[i].sent));
+	}
+
+	automatic = pings[i].automatic;
+	memset(&pings[i], 0, sizeof(net_stats_ping_t));
+
+	return automatic;
+}
+
+static int compare_samples(const void *a, const void *b)
+{
+	Uint32 x, y;
+
+	x = *((const Uint32 *)a);
+	y = *((const Uint32 *)b);
+
+	return (x > y) - (x < y);
+}
+
+static void update_summary(net_stats_samples_t *s)
+{
+	Uint32 sorted[NET_STATS_SAMPLES];
+	net_stats_summary_t *summary;
+	Uint64 sum;
+	Uint32 i, us, bucket;
+
+	summary = &s->summary;
+	memset(summary, 0, sizeof(net_stats_summary_t));
+	summary->total = s->total;
+	summary->count = s->count;
+	s->changed = 0;
+
+	if (s->count == 0)
+	{
+		return;
+	}
+
+	summary->last = s->values[(s->next + NET_STATS_SAMPLES - 1) % NET_STATS_SAMPLES];
+
+	/* the window is the whole array once it is full */
+	memcpy(sorted, s->values, s->count * sizeof(Uint32));
+	qsort(sorted, s->count, sizeof(Uint32), compare_samples);
+
+	sum = 0;
+
+	for (i = 0; i < s->count; i++)
+	{
+		sum += sorted[i];
+
+		/* bucket 0 is below one microsecond, bucket i is [2^(i-1), 2^i) */
+		us = sorted[i];
+		bucket = 0;
+		while ((us > 0) && (bucket < NET_STATS_BUCKETS - 1))
+		{
+			us >>= 1;
+			bucket++;
+		}
+		summary->histogram[bucket]++;
+	}
+
+	summary->min = sorted[0];
+	summary->max = sorted[s->count - 1];
+	summary->avg = sum / s->count;
+	summary->p50 = sorted[(s->count - 1) * 50 / 100];
+	summary->p95 = sorted[(s->count - 1) * 95 / 100];
+	summary->p99 = sorted[(s->count - 1) * 99 / 100];
+}
+
+void update_net_stats(void)
+{
+	int i;
+
+	for (i = 0; i < NET_STATS_KINDS; i++)
+	{
+		if (samples[i].changed)
+		{
+			update_summary(&samples[i]);
+		}
+	}
+}
+
+void net_stats_timer(void)
+{
+	Uint32 now;
+
+	if (!is_measuring())
+	{
+		return;
+	}
+
+	now = SDL_GetTicks();
+
+	if (!disconnected && ((now - last_ping_time) >= NET_STATS_PING_INTERVAL))
+	{
+		send_net_stats_ping(1);
+		last_ping_time = now;
+	}
+
+	update_net_stats();
+}
+
+const net_stats_summary_t *get_net_stats(net_stats_kind kind)
+{
+	return &samples[kind].summary;
+}
+
+double get_net_stats_jitter(void)
+{
+	return jitter;
+}
+
+int save_net_stats(const char *file_name)
+{
+	const net_stats_summary_t *summary;
+	FILE *f;
+	int i, j;
+
+	f = open_file_config(file_name, "w");
+	if (f == NULL)
+	{
+		return 0;
+	}
+
+	update_net_stats();
+
+	fprintf(f, "kind,total,count,min_us,avg_us,p50_us,p95_us,p99_us,max_us");
+	for (i = 0; i < NET_STATS_BUCKETS - 1; i++)
+		fprintf(f, ",lt_%uus", 1u << i);
+	// the last bucket has no upper bound
+	fprintf(f, ",ge_%uus", 1u << (NET_STATS_BUCKETS - 2));
+	fprintf(f, "\n");
+
+	for (i = 0; i < NET_STATS_KINDS; i++)
+	{
+		summary = get_net_stats(i);
+		fprintf(f, "%s,%llu,%u,%u,%u,%u,%u,%u,%u", get_net_stats_name(i),
+			(unsigned long long)summary->total, summary->count,
+			summary->min, summary->avg, summary->p50, summary->p95,
+			summary->p99, summary->max);
+		for (j = 0; j < NET_STATS_BUCKETS; j++)
+			fprintf(f, ",%u", summary->histogram[j]);
+		fprintf(f, "\n");
+	}
+
+	fclose(f);
+
+	return 1;
+}
+
+int save_net_stats_samples(const char *file_name)
+{
+	const net_stats_samples_t *s;
+	FILE *f;
+	Uint32 i, index;
+	int kind;
+
+	f = open_file_config(file_name, "w");
+	if (f == NULL)
+	{
+		return 0;
+	}
+
+	fprintf(f, "kind,time_ms,value_us\n");
+
+	for (kind = 0; kind < NET_STATS_KINDS; kind++)
+	{
+		s = &samples[kind];
+
+		/* oldest first */
+		for (i = 0; i < s->count; i++)
+		{
+			index = (s->next + NET_STATS_SAMPLES - s->count + i) % NET_STATS_SAMPLES;
+			fprintf(f, "%s,%u,%u\n", get_net_stats_name(kind),
+				s->times[index], s->values[index]);
+		}
+	}
+
+	fclose(f);
+
+	return 1;
+}
+
+void reset_net_stats(void)
+{
+	memset(samples, 0, sizeof(samples));
+	last_receive_time = 0;
+	have_interval = 0;
+	jitter = 0.0;
+}
@@ -0,0 +1,139 @@
+/*!
+ * \file
+ * \ingroup network_text
+ * \brief Latency statistics of the connection to the server.
+ *
+ *      The network thread stores the receive time of each message in the
+ *      message ring, the main loop passes it on when it dispatches the
+ *      message. This gives the time each message waited in the ring and the
+ *      gaps between receives, which show the server tick and its jitter.
+ *      The round trip time is measured with a PING sent every few seconds,
+ *      the PONG is matched by the echoed time stamp. The last samples of
+ *      each kind are kept, so all statistics cover a rolling window.
+ */
+#ifndef	NET_STATS_H
+#define	NET_STATS_H
+
+#include <SDL_types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NET_STATS_SAMPLES	1024	/*!< samples kept of each kind */
+#define NET_STATS_BUCKETS	24	/*!< log2 buckets of the histograms, the last is at least 2^22 us */
+#define NET_STATS_PING_INTERVAL	5000	/*!< ms between the automatic pings */
+
+/*!
+ * The kinds of samples.
+ */
+typedef enum
+{
+	NET_STATS_RTT = 0,	/*!< round trip time of a ping */
+	NET_STATS_QUEUE_WAIT,	/*!< time between receive and dispatch of a message */
+	NET_STATS_INTERVAL,	/*!< time between two receives */
+	NET_STATS_JITTER,	/*!< difference between two successive receive intervals */
+	NET_STATS_KINDS
+} net_stats_kind;
+
+/*!
+ * Summary of the samples of one kind, all times in microseconds.
+ */
+typedef struct
+{
+	Uint64 total;		/*!< samples since the last reset */
+	Uint32 count;		/*!< samples in the window */
+	Uint32 last;		/*!< the newest sample */
+	Uint32 min;
+	Uint32 avg;
+	Uint32 p50;		/*!< median */
+	Uint32 p95;
+	Uint32 p99;
+	Uint32 max;
+	Uint32 histogram[NET_STATS_BUCKETS];	/*!< bucket 0 is below one microsecond, bucket i is [2^(i-1), 2^i) */
+} net_stats_summary_t;
+
+extern int net_stats;		/*!< if set, the latency is measured */
+extern int show_net_stats;	/*!< if set, the latency is shown below the FPS and also measured */
+
+/*!
+ * \brief Gets the name of a kind of samples.
+ * \param kind	the kind
+ * \retval const char*	the name, used in the CSV files
+ */
+const char *get_net_stats_name(net_stats_kind kind);
+
+/*!
+ * \brief Adds the samples of a message, called by the main loop before it
+ *        is processed.
+ * \param receive_time	the performance counter when the network thread received the message, zero if unknown
+ */
+void net_stats_dispatch(Uint64 receive_time);
+
+/*!
+ * \brief Sends a PING to the server and remembers when.
+ *
+ *      The PING and the commands buffered before it are written at once,
+ *      not held back by the send delay.
+ * \param automatic	set for the periodic pings, their PONG is not shown
+ */
+void send_net_stats_ping(int automatic);
+
+/*!
+ * \brief Adds the round trip time of a PONG.
+ * \param stamp	the time stamp echoed by the server
+ * \retval int	one if the PONG answers an automatic ping, zero otherwise
+ */
+int net_stats_pong(Uint32 stamp);
+
+/*!
+ * \brief Sends the automatic pings and updates the summaries, called by
+ *        the main thread 500 ms timer.
+ */
+void net_stats_timer(void);
+
+/*!
+ * \brief Gets the summary of a kind of samples.
+ *
+ *      The summaries are updated by \ref net_stats_timer, or by
+ *      \ref update_net_stats.
+ * \param kind	the kind
+ * \retval const net_stats_summary_t*	the summary
+ */
+const net_stats_summary_t *get_net_stats(net_stats_kind kind);
+
+/*!
+ * \brief Updates the summaries from the current samples.
+ */
+void update_net_stats(void);
+
+/*!
+ * \brief Gets the smoothed jitter, as estimated in RFC 3550.
+ * \retval double	the jitter in microseconds
+ */
+double get_net_stats_jitter(void);
+
+/*!
+ * \brief Writes the summaries to a file, one line of each kind.
+ * \param file_name	the file, in the config directory
+ * \retval int	one on success, zero on failure
+ */
+int save_net_stats(const char *file_name);
+
+/*!
+ * \brief Writes the samples in the window to a file.
+ * \param file_name	the file, in the config directory
+ * \retval int	one on success, zero on failure
+ */
+int save_net_stats_samples(const char *file_name);
+
+/*!
+ * \brief Removes all samples.
+ */
+void reset_net_stats(void);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif	/* NET_STATS_H */
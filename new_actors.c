@@ -129,7 +129,8 @@ int add_enhanced_actor(enhanced_actor *this_actor, float x_pos, float y_pos,
 #endif	/* ANIMATION_SCALING*/
 
 	//clear the que
-	for(k=0; k<MAX_CMD_QUEUE; k++)	our_actor->que[k]=nothing;
+	our_actor->que_head=0;
+	our_actor->que_length=0;
 	for(k=0;k<MAX_EMOTE_QUEUE;k++)	{
 		our_actor->emote_que[k].emote=NULL;
 		our_actor->emote_que[k].origin=NO_EMOTE;
@@ -176,6 +177,7 @@ int add_enhanced_actor(enhanced_actor *this_actor, float x_pos, float y_pos,
 	actors_list[i]=our_actor;
 
 	if(i >= max_actors) max_actors = i+1;
+	add_actor_to_id_index(i);
 
 	//Actors list will be unlocked later
 
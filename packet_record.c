@@ -0,0 +1,265 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <SDL_timer.h>
+#include <SDL_endian.h>
+#include "packet_record.h"
+#include "asc.h"
+#include "colors.h"
+#include "errors.h"
+#include "multiplayer.h"
+#include "text.h"
+#include "translate.h"
+#include "io/elpathwrapper.h"
+#ifdef	NEW_SOUND
+#include "sound.h"
+#endif	//NEW_SOUND
+
+#define PACKET_RECORD_DIR	"packets"
+
+int record_packets = 0;
+int packet_replay_active = 0;
+
+static FILE *record_file = NULL;
+static Uint32 record_start_time = 0;
+
+static FILE *replay_file = NULL;
+static Uint32 replay_start_time = 0;
+static Uint32 replay_count = 0;
+static Uint32 replay_next_time = 0;
+static Uint32 replay_next_length = 0;
+static Uint8 replay_next_data[MESSAGE_RING_MAX_MESSAGE];
+
+int start_packet_recording(const char *file_name)
+{
+	char name[128];
+	const Uint8 header[8] = { 'E', 'L', 'P', 'R', PACKET_RECORD_VERSION, 0, 0, 0 };
+
+	stop_packet_recording();
+
+	if ((file_name == NULL) || (file_name[0] == '\0'))
+	{
+		time_t c_time;
+
+		time(&c_time);
+		mkdir_config(PACKET_RECORD_DIR);
+		strftime(name, sizeof(name), PACKET_RECORD_DIR "/%Y%m%d_%H%M%S.elpr",
+			localtime(&c_time));
+	}
+	else
+	{
+		safe_strncpy(name, file_name, sizeof(name));
+	}
+
+	record_file = open_file_config(name, "wb");
+
+	if (record_file == NULL)
+	{
+		LOG_ERROR("%s: %s \"%s\"\n", reg_error_str, cant_open_file, name);
+		return 0;
+	}
+
+	fwrite(header, sizeof(header), 1, record_file);
+	record_start_time = SDL_GetTicks();
+
+	LOG_TO_CONSOLE(c_green1, "Recording server messages to:");
+	LOG_TO_CONSOLE(c_green1, name);
+
+	return 1;
+}
+
+void stop_packet_recording(void)
+{
+	if (record_file != NULL)
+	{
+		fclose(record_file);
+		record_file = NULL;
+		LOG_TO_CONSOLE(c_green1, "Stopped recording server messages");
+	}
+}
+
+int is_recording_packets(void)
+{
+	return record_file != NULL;
+}
+
+void record_packet(const Uint8 *data, Uint32 length)
+{
+	Uint32 time;
+
+	if (record_file == NULL)
+	{
+		return;
+	}
+
+	time = SDL_SwapLE32(SDL_GetTicks() - record_start_time);
+
+	if ((fwrite(&time, sizeof(time), 1, record_file) != 1) ||
+		(fwrite(data, length, 1, record_file) != 1))
+	{
+		LOG_ERROR("Failed to write the server message recording\n");
+		fclose(record_file);
+		record_file = NULL;
+	}
+}
+
+/* reads the next message, returns zero at the end of the recording */
+static int read_replay_packet(void)
+{
+	Uint8 header[7];
+	Uint32 length;
+
+	if (fread(header, sizeof(header), 1, replay_file) != 1)
+	{
+		return 0;
+	}
+
+	replay_next_time = header[0] | (header[1] << 8) | (header[2] << 16) |
+		((Uint32)header[3] << 24);
+	length = (header[5] | (header[6] << 8)) + 2;
+
+	if (length > sizeof(replay_next_data))
+	{
+		LOG_ERROR("Replayed message too big, protocol = %d, size = %u\n",
+			header[4], length);
+		return 0;
+	}
+
+	memcpy(replay_next_data, header + 4, 3);
+
+	if ((length > 3) && (fread(replay_next_data + 3, length - 3, 1, replay_file) != 1))
+	{
+		return 0;
+	}
+
+	replay_next_length = length;
+
+	return 1;
+}
+
+/* processes the whole recording at once and logs the timings */
+static void replay_packets_fast(void)
+{
+	Uint64 start, end, total, max_time;
+	double frequency;
+	char str[256];
+#ifdef	NEW_SOUND
+	int old_no_sound;
+
+	old_no_sound = no_sound;
+	no_sound = 1;
+#endif	//NEW_SOUND
+
+	total = 0;
+	max_time = 0;
+
+	do
+	{
+		start = SDL_GetPerformanceCounter();
+		process_message_from_server(replay_next_data, replay_next_length);
+		end = SDL_GetPerformanceCounter();
+
+		total += end - start;
+		if (end - start > max_time)
+		{
+			max_time = end - start;
+		}
+		replay_count++;
+	} while (packet_replay_active && read_replay_packet());
+
+#ifdef	NEW_SOUND
+	no_sound = old_no_sound;
+#endif	//NEW_SOUND
+
+	frequency = SDL_GetPerformanceFrequency();
+	safe_snprintf(str, sizeof(str), "Replayed %u messages in %.2f ms, "
+		"avg %.2f us, max %.2f us", replay_count, 1000.0 * total / frequency,
+		1000000.0 * total / replay_count / frequency,
+		1000000.0 * max_time / frequency);
+	LOG_TO_CONSOLE(c_green1, str);
+
+	stop_packet_replay();
+}
+
+int start_packet_replay(const char *file_name, int fast)
+{
+	Uint8 header[8];
+
+	stop_packet_replay();
+
+	replay_file = open_file_config(file_name, "rb");
+
+	if (replay_file == NULL)
+	{
+		LOG_TO_CONSOLE(c_red1, cant_open_file);
+		return 0;
+	}
+
+	if ((fread(header, sizeof(header), 1, replay_file) != 1) ||
+		(memcmp(header, "ELPR", 4) != 0) ||
+		(header[4] != PACKET_RECORD_VERSION))
+	{
+		LOG_TO_CONSOLE(c_red1, "Not a server message recording");
+		fclose(replay_file);
+		replay_file = NULL;
+		return 0;
+	}
+
+	replay_count = 0;
+	packet_replay_active = 1;
+
+	if (!read_replay_packet())
+	{
+		stop_packet_replay();
+		return 1;
+	}
+
+	if (fast)
+	{
+		replay_packets_fast();
+	}
+	else
+	{
+		replay_start_time = SDL_GetTicks() - replay_next_time;
+	}
+
+	return 1;
+}
+
+void stop_packet_replay(void)
+{
+	if (replay_file != NULL)
+	{
+		fclose(replay_file);
+		replay_file = NULL;
+	}
+	packet_replay_active = 0;
+}
+
+void replay_packets(void)
+{
+	Uint32 now;
+
+	if (replay_file == NULL)
+	{
+		return;
+	}
+
+	now = SDL_GetTicks() - replay_start_time;
+
+	while (packet_replay_active && (replay_next_time <= now))
+	{
+		process_message_from_server(replay_next_data, replay_next_length);
+		replay_count++;
+
+		if (!read_replay_packet())
+		{
+			char str[64];
+
+			safe_snprintf(str, sizeof(str), "Replayed %u messages", replay_count);
+			LOG_TO_CONSOLE(c_green1, str);
+			stop_packet_replay();
+			return;
+		}
+	}
+}
@@ -0,0 +1,80 @@
+/*!
+ * \file
+ * \ingroup network_text
+ * \brief Recording and replaying of the messages received from the server.
+ *
+ *      A recording starts with the four bytes "ELPR" and a little endian
+ *      Uint32 version. Each message follows as a little endian Uint32 with
+ *      the milliseconds since the recording started, and the message as
+ *      received, starting with the protocol byte and the length field.
+ */
+#ifndef	PACKET_RECORD_H
+#define	PACKET_RECORD_H
+
+#include <SDL_types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PACKET_RECORD_VERSION	1	/*!< version of the recording format */
+
+extern int record_packets;	/*!< if set, every connection to the server gets recorded */
+extern int packet_replay_active;	/*!< set while a recording gets replayed */
+
+/*!
+ * \brief Starts recording the messages from the server.
+ * \param file_name	the file in the config directory, NULL or empty for a new file in the packets folder
+ * \retval int	one on success, zero on failure
+ */
+int start_packet_recording(const char *file_name);
+
+/*!
+ * \brief Stops recording the messages from the server.
+ */
+void stop_packet_recording(void);
+
+/*!
+ * \brief Checks if the messages from the server get recorded.
+ * \retval int	one if recording, else zero
+ */
+int is_recording_packets(void);
+
+/*!
+ * \brief Records a message, if recording.
+ *
+ *      Called by the main loop before a message gets processed.
+ * \param data		the message
+ * \param length	size of the message, including the header
+ */
+void record_packet(const Uint8 *data, Uint32 length);
+
+/*!
+ * \brief Starts replaying a recording.
+ *
+ *      Nothing is sent to the server while replaying. A \a fast replay
+ *      processes all messages at once without rendering or sounds in
+ *      between and logs the processing time to the console.
+ * \param file_name	the recording in the config directory
+ * \param fast		if zero, the messages get processed at the recorded time
+ * \retval int	one on success, zero on failure
+ */
+int start_packet_replay(const char *file_name, int fast);
+
+/*!
+ * \brief Stops replaying a recording.
+ */
+void stop_packet_replay(void);
+
+/*!
+ * \brief Processes the replayed messages that are due.
+ *
+ *      Called by the main loop once per frame.
+ */
+void replay_packets(void);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif	/* PACKET_RECORD_H */
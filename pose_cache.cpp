@@ -0,0 +1,313 @@
+#include <cmath>
+#include <cstring>
+#include <list>
+#include <map>
+#include <vector>
+#include <SDL.h>
+#include <cal3d/cal3d.h>
+#include "pose_cache.h"
+
+#define POSE_CACHE_MAX_CYCLES	4	/*!< actors blending more cycles are not cached */
+#define POSE_CACHE_MAX_ENTRIES	2048
+#define POSE_CACHE_MAX_AGE	1000	/*!< ms an unused entry is kept */
+#define POSE_CACHE_WEIGHT_STEPS	16	/*!< steps of the quantized cycle weights */
+#define POSE_CACHE_BONE_SIZE	7	/*!< floats of a bone: translation and rotation */
+
+int pose_cache_quantum = 0;
+
+namespace
+{
+
+	class PoseKey
+	{
+		public:
+			const CalCoreModel* m_core_model;
+			Sint32 m_quantum;
+			Sint32 m_time;
+			Sint32 m_duration;
+			Sint32 m_cycle_count;
+			const CalCoreAnimation* m_animations[POSE_CACHE_MAX_CYCLES];
+			Sint32 m_weights[POSE_CACHE_MAX_CYCLES];
+			Sint32 m_times[POSE_CACHE_MAX_CYCLES];
+
+			inline bool operator<(const PoseKey &key) const
+			{
+				return memcmp(this, &key, sizeof(PoseKey)) < 0;
+			}
+
+	};
+
+	class PoseEntry
+	{
+		public:
+			std::vector<float> m_bones;
+			Uint32 m_last_used;
+
+	};
+
+	typedef std::map<PoseKey, PoseEntry> PoseMap;
+
+	PoseMap pose_cache;
+	SDL_mutex* pose_cache_mutex = 0;
+	Uint32 pose_cache_time = 0;
+	SDL_atomic_t pose_cache_hits;
+	SDL_atomic_t pose_cache_misses;
+	SDL_atomic_t pose_cache_skipped;
+
+	inline Sint32 quantize(const float value, const float step)
+	{
+		return static_cast<Sint32>(std::floor(value / step));
+	}
+
+	/*
+	 * Builds the key of the pose after the animations were updated. Fails
+	 * for actions, they are not looped and are started at any time, so
+	 * their poses are rarely shared.
+	 */
+	bool build_pose_key(CalModel* model, CalMixer* mixer, PoseKey &key)
+	{
+		std::list<CalAnimationCycle*>::iterator it;
+		CalAnimationCycle* cycle;
+		float quantum;
+		Sint32 i;
+
+		if (!mixer->getAnimationActionList().empty() ||
+			(mixer->getAnimationCycle().size() > POSE_CACHE_MAX_CYCLES))
+		{
+			return false;
+		}
+
+		quantum = pose_cache_quantum / 1000.0f;
+
+		// the keys are compared as memory, so the unused cycles must be zero
+		memset(&key, 0, sizeof(key));
+
+		key.m_core_model = model->getCoreModel();
+		key.m_quantum = pose_cache_quantum;
+		key.m_time = quantize(mixer->getAnimationTime(), quantum);
+		key.m_duration = quantize(mixer->getAnimationDuration(), quantum);
+
+		i = 0;
+
+		for (it = mixer->getAnimationCycle().begin();
+			it != mixer->getAnimationCycle().end(); it++)
+		{
+			cycle = *it;
+
+			key.m_animations[i] = cycle->getCoreAnimation();
+			key.m_weights[i] = static_cast<Sint32>(cycle->getWeight() *
+				POSE_CACHE_WEIGHT_STEPS + 0.5f);
+
+			// cycles that fade out run on their own time, one more than
+			// the bucket to tell them from the synchronized ones
+			if (cycle->getState() == CalAnimation::STATE_ASYNC)
+			{
+				key.m_times[i] = quantize(cycle->getTime(), quantum) + 1;
+			}
+
+			i++;
+		}
+
+		key.m_cycle_count = i;
+
+		return true;
+	}
+
+	void save_pose(CalSkeleton* skeleton, std::vector<float> &bones)
+	{
+		const std::vector<CalBone*> &vector_bone = skeleton->getVectorBone();
+		Uint32 i;
+
+		bones.resize(vector_bone.size() * POSE_CACHE_BONE_SIZE);
+
+		for (i = 0; i < vector_bone.size(); i++)
+		{
+			const CalVector &translation = vector_bone[i]->getTranslation();
+			const CalQuaternion &rotation = vector_bone[i]->getRotation();
+
+			bones[i * POSE_CACHE_BONE_SIZE + 0] = translation.x;
+			bones[i * POSE_CACHE_BONE_SIZE + 1] = translation.y;
+			bones[i * POSE_CACHE_BONE_SIZE + 2] = translation.z;
+			bones[i * POSE_CACHE_BONE_SIZE + 3] = rotation.x;
+			bones[i * POSE_CACHE_BONE_SIZE + 4] = rotation.y;
+			bones[i * POSE_CACHE_BONE_SIZE + 5] = rotation.z;
+			bones[i * POSE_CACHE_BONE_SIZE + 6] = rotation.w;
+		}
+	}
+
+	/*
+	 * Sets the pose as the only state of each bone, so the skeleton ends
+	 * up like after CalMixer::updateSkeleton().
+	 */
+	void load_pose(CalSkeleton* skeleton, const std::vector<float> &bones)
+	{
+		const std::vector<CalBone*> &vector_bone = skeleton->getVectorBone();
+		Uint32 i;
+
+		skeleton->clearState();
+
+		for (i = 0; i < vector_bone.size(); i++)
+		{
+			const CalVector translation(bones[i * POSE_CACHE_BONE_SIZE + 0],
+				bones[i * POSE_CACHE_BONE_SIZE + 1],
+				bones[i * POSE_CACHE_BONE_SIZE + 2]);
+			const CalQuaternion rotation(bones[i * POSE_CACHE_BONE_SIZE + 3],
+				bones[i * POSE_CACHE_BONE_SIZE + 4],
+				bones[i * POSE_CACHE_BONE_SIZE + 5],
+				bones[i * POSE_CACHE_BONE_SIZE + 6]);
+
+			vector_bone[i]->blendState(1.0f, translation, rotation);
+		}
+
+		skeleton->lockState();
+		skeleton->calculateState();
+	}
+
+	/*
+	 * Returns the bones of the entry or NULL. The entries are only removed
+	 * on the main thread while no skeleton is updated, so the bones stay
+	 * valid without the lock.
+	 */
+	const std::vector<float>* find_pose(const PoseKey &key, const Uint32 bone_count)
+	{
+		PoseMap::iterator it;
+		const std::vector<float>* bones;
+
+		bones = 0;
+
+		SDL_LockMutex(pose_cache_mutex);
+
+		it = pose_cache.find(key);
+
+		if ((it != pose_cache.end()) &&
+			(it->second.m_bones.size() == bone_count * POSE_CACHE_BONE_SIZE))
+		{
+			it->second.m_last_used = pose_cache_time;
+			bones = &it->second.m_bones;
+		}
+
+		SDL_UnlockMutex(pose_cache_mutex);
+
+		return bones;
+	}
+
+	/*
+	 * Another thread may have added the same pose meanwhile, then the
+	 * older one is kept.
+	 */
+	void add_pose(const PoseKey &key, const std::vector<float> &bones)
+	{
+		SDL_LockMutex(pose_cache_mutex);
+
+		if ((pose_cache.size() < POSE_CACHE_MAX_ENTRIES) &&
+			(pose_cache.find(key) == pose_cache.end()))
+		{
+			PoseEntry &entry = pose_cache[key];
+
+			entry.m_bones = bones;
+			entry.m_last_used = pose_cache_time;
+		}
+
+		SDL_UnlockMutex(pose_cache_mutex);
+	}
+
+}
+
+extern "C" void update_actor_pose(actor* act, const float step)
+{
+	CalModel* model;
+	CalMixer* mixer;
+	CalSkeleton* skeleton;
+	const std::vector<float>* bones;
+	std::vector<float> new_bones;
+	PoseKey key;
+
+	model = act->calmodel;
+	mixer = model->getMixer();
+	skeleton = model->getSkeleton();
+
+	if ((pose_cache_quantum <= 0) || (pose_cache_mutex == 0) ||
+		(mixer == 0) || (skeleton == 0))
+	{
+		model->update(step);
+
+		return;
+	}
+
+	mixer->updateAnimation(step);
+
+	if (build_pose_key(model, mixer, key))
+	{
+		bones = find_pose(key, skeleton->getVectorBone().size());
+
+		if (bones != 0)
+		{
+			load_pose(skeleton, *bones);
+			SDL_AtomicAdd(&pose_cache_hits, 1);
+		}
+		else
+		{
+			mixer->updateSkeleton();
+			save_pose(skeleton, new_bones);
+			add_pose(key, new_bones);
+			SDL_AtomicAdd(&pose_cache_misses, 1);
+		}
+	}
+	else
+	{
+		mixer->updateSkeleton();
+		SDL_AtomicAdd(&pose_cache_skipped, 1);
+	}
+
+	// the rest of CalModel::update()
+	model->getMorphTargetMixer()->update(step);
+	model->getPhysique()->update();
+	model->getSpringSystem()->update(step);
+}
+
+extern "C" void age_pose_cache(const Uint32 time)
+{
+	PoseMap::iterator it;
+
+	if (pose_cache_mutex == 0)
+	{
+		pose_cache_mutex = SDL_CreateMutex();
+	}
+
+	pose_cache_time = time;
+
+	it = pose_cache.begin();
+
+	while (it != pose_cache.end())
+	{
+		if ((time - it->second.m_last_used) > POSE_CACHE_MAX_AGE)
+		{
+			pose_cache.erase(it++);
+		}
+		else
+		{
+			it++;
+		}
+	}
+}
+
+extern "C" void clear_pose_cache()
+{
+	pose_cache.clear();
+}
+
+extern "C" void get_pose_cache_stats(Uint32* hits, Uint32* misses,
+	Uint32* skipped, Uint32* entries)
+{
+	*hits = SDL_AtomicGet(&pose_cache_hits);
+	*misses = SDL_AtomicGet(&pose_cache_misses);
+	*skipped = SDL_AtomicGet(&pose_cache_skipped);
+	*entries = pose_cache.size();
+}
+
+extern "C" void reset_pose_cache_stats()
+{
+	SDL_AtomicSet(&pose_cache_hits, 0);
+	SDL_AtomicSet(&pose_cache_misses, 0);
+	SDL_AtomicSet(&pose_cache_skipped, 0);
+}
@@ -0,0 +1,70 @@
+/*!
+ * \file
+ * \ingroup display_actors
+ * \brief Shares the skeleton poses of actors playing the same animations.
+ *
+ *      The pose of an actor that only plays animation cycles depends on its
+ *      skeleton, the cycles, their weights and the animation time. These are
+ *      quantized to build a key, and the bone states computed for one actor
+ *      are reused for every actor with the same key until the entry gets too
+ *      old. A larger quantum gives more hits but less smooth animations.
+ */
+#ifndef	POSE_CACHE_H
+#define	POSE_CACHE_H
+
+#include <SDL_types.h>
+#include "actors.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern int pose_cache_quantum;	/*!< ms of animation time that share a pose, zero disables the cache */
+
+/*!
+ * \brief Updates the animations and the skeleton of an actor.
+ *
+ *      Does the same as CalModel_Update(), but takes the skeleton from the
+ *      pose cache if possible. Can run on several threads at once for
+ *      different actors.
+ * \param act	the actor
+ * \param step	the animation time since the last update, in seconds
+ */
+void update_actor_pose(actor *act, const float step);
+
+/*!
+ * \brief Removes the old entries from the pose cache.
+ *
+ *      Must be called on the main thread once a frame, before any skeleton
+ *      is updated.
+ * \param time	the current time in ms
+ */
+void age_pose_cache(const Uint32 time);
+
+/*!
+ * \brief Removes all entries from the pose cache.
+ *
+ *      Must be called when the actor definitions are freed.
+ */
+void clear_pose_cache(void);
+
+/*!
+ * \brief Gets the statistics of the pose cache.
+ * \param hits		the updates that used a cached pose
+ * \param misses	the updates that computed a pose for the cache
+ * \param skipped	the updates that can't use the cache, e.g. because of an action
+ * \param entries	the poses in the cache
+ */
+void get_pose_cache_stats(Uint32 *hits, Uint32 *misses, Uint32 *skipped,
+	Uint32 *entries);
+
+/*!
+ * \brief Sets the hits, misses and skipped updates of the pose cache to zero.
+ */
+void reset_pose_cache_stats(void);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif	/* POSE_CACHE_H */
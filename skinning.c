@@ -0,0 +1,372 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <SDL.h>
+#include "skinning.h"
+
+#if	defined(USE_SIMD) || defined(__SSE2__) || defined(_M_X64)
+#define	SKINNING_SSE2
+#endif
+
+#ifdef	SKINNING_SSE2
+#if	defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define	SKINNING_AVX2
+#define	TARGET_AVX2 __attribute__((target("avx2")))
+#elif	defined(_MSC_VER)
+#define	SKINNING_AVX2
+#define	TARGET_AVX2
+#endif
+#endif
+
+#ifdef	SKINNING_SSE2
+#include <emmintrin.h>
+#ifdef	SKINNING_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+skinning_data_t *skinning_data_new(const Uint32 vertex_count,
+	const Uint32 influence_count)
+{
+	skinning_data_t *data;
+	Uint32 count;
+
+	data = calloc(1, sizeof(skinning_data_t));
+
+	if (data == NULL)
+	{
+		return NULL;
+	}
+
+	count = vertex_count > 0 ? vertex_count : 1;
+
+	data->vertex_count = vertex_count;
+	data->influence_count = influence_count;
+	data->positions = calloc(count * 3, sizeof(float));
+	data->normals = calloc(count * 3, sizeof(float));
+	data->weights = calloc(count * influence_count + 1, sizeof(float));
+	data->offsets = calloc(count * influence_count + 1, sizeof(Sint32));
+	data->texture_coordinates = calloc(count * 2, sizeof(float));
+
+	if ((data->positions == NULL) || (data->normals == NULL) ||
+		(data->weights == NULL) || (data->offsets == NULL) ||
+		(data->texture_coordinates == NULL))
+	{
+		skinning_data_free(data);
+
+		return NULL;
+	}
+
+	return data;
+}
+
+void skinning_data_free(skinning_data_t *data)
+{
+	if (data == NULL)
+	{
+		return;
+	}
+
+	free(data->positions);
+	free(data->normals);
+	free(data->weights);
+	free(data->offsets);
+	free(data->texture_coordinates);
+	free(data);
+}
+
+static void skin_vertex(const skinning_data_t *data, const float *bones,
+	const Uint32 index, float *vertices, float *normals)
+{
+	float m[SKINNING_MATRIX_SIZE];
+	const float *bone;
+	float w, x, y, z, tx, ty, tz, scale;
+	Uint32 i, j, n;
+
+	n = data->vertex_count;
+
+	memset(m, 0, sizeof(m));
+
+	for (i = 0; i < data->influence_count; i++)
+	{
+		w = data->weights[i * n + index];
+		bone = bones + data->offsets[i * n + index];
+
+		for (j = 0; j < SKINNING_MATRIX_SIZE; j++)
+		{
+			m[j] += w * bone[j];
+		}
+	}
+
+	x = data->positions[index];
+	y = data->positions[n + index];
+	z = data->positions[2 * n + index];
+
+	vertices[index * 3 + 0] = m[0] * x + m[1] * y + m[2] * z + m[3];
+	vertices[index * 3 + 1] = m[4] * x + m[5] * y + m[6] * z + m[7];
+	vertices[index * 3 + 2] = m[8] * x + m[9] * y + m[10] * z + m[11];
+
+	if (normals == NULL)
+	{
+		return;
+	}
+
+	x = data->normals[index];
+	y = data->normals[n + index];
+	z = data->normals[2 * n + index];
+
+	tx = m[0] * x + m[1] * y + m[2] * z;
+	ty = m[4] * x + m[5] * y + m[6] * z;
+	tz = m[8] * x + m[9] * y + m[10] * z;
+
+	scale = 1.0f / sqrtf(tx * tx + ty * ty + tz * tz);
+
+	normals[index * 3 + 0] = tx * scale;
+	normals[index * 3 + 1] = ty * scale;
+	normals[index * 3 + 2] = tz * scale;
+}
+
+#ifdef	SKINNING_SSE2
+/* Stores x, y and z of four vertices interleaved. Each store writes one
+ * float too much, which the next one overwrites, the last one is split so
+ * nothing after the four vertices is touched. */
+#define	STORE_VERTICES_SSE2(x, y, z, dest)	\
+	do	\
+	{	\
+		__m128 sx = (x), sy = (y), sz = (z), sw = _mm_setzero_ps();	\
+		_MM_TRANSPOSE4_PS(sx, sy, sz, sw);	\
+		_mm_storeu_ps((dest) + 0, sx);	\
+		_mm_storeu_ps((dest) + 3, sy);	\
+		_mm_storeu_ps((dest) + 6, sz);	\
+		_mm_storel_pi((__m64*)((dest) + 9), sw);	\
+		_mm_store_ss((dest) + 11, _mm_movehl_ps(sw, sw));	\
+	}	\
+	while (0)
+
+static Uint32 skin_vertices_sse2(const skinning_data_t *data,
+	const float *bones, const Uint32 start, const Uint32 end,
+	float *vertices, float *normals)
+{
+	__m128 m[SKINNING_MATRIX_SIZE];
+	__m128 w, r0, r1, r2, x, y, z, tx, ty, tz, scale;
+	const float *bone;
+	Uint32 i, j, k, n, index;
+
+	n = data->vertex_count;
+
+	for (i = start; (i + 4) <= end; i += 4)
+	{
+		// blend the matrix rows of each vertex, m[j * 3 + row]
+		for (j = 0; j < 4; j++)
+		{
+			r0 = _mm_setzero_ps();
+			r1 = _mm_setzero_ps();
+			r2 = _mm_setzero_ps();
+
+			for (k = 0; k < data->influence_count; k++)
+			{
+				index = k * n + i + j;
+				w = _mm_set1_ps(data->weights[index]);
+				bone = bones + data->offsets[index];
+
+				r0 = _mm_add_ps(r0, _mm_mul_ps(w, _mm_loadu_ps(bone + 0)));
+				r1 = _mm_add_ps(r1, _mm_mul_ps(w, _mm_loadu_ps(bone + 4)));
+				r2 = _mm_add_ps(r2, _mm_mul_ps(w, _mm_loadu_ps(bone + 8)));
+			}
+
+			m[j * 3 + 0] = r0;
+			m[j * 3 + 1] = r1;
+			m[j * 3 + 2] = r2;
+		}
+
+		// transpose to one register per matrix element, m[column * 3 + row]
+		_MM_TRANSPOSE4_PS(m[0], m[3], m[6], m[9]);
+		_MM_TRANSPOSE4_PS(m[1], m[4], m[7], m[10]);
+		_MM_TRANSPOSE4_PS(m[2], m[5], m[8], m[11]);
+
+		x = _mm_loadu_ps(data->positions + i);
+		y = _mm_loadu_ps(data->positions + n + i);
+		z = _mm_loadu_ps(data->positions + 2 * n + i);
+
+		tx = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m[0], x),
+			_mm_mul_ps(m[3], y)), _mm_mul_ps(m[6], z)), m[9]);
+		ty = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m[1], x),
+			_mm_mul_ps(m[4], y)), _mm_mul_ps(m[7], z)), m[10]);
+		tz = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m[2], x),
+			_mm_mul_ps(m[5], y)), _mm_mul_ps(m[8], z)), m[11]);
+
+		STORE_VERTICES_SSE2(tx, ty, tz, vertices + i * 3);
+
+		if (normals == NULL)
+		{
+			continue;
+		}
+
+		x = _mm_loadu_ps(data->normals + i);
+		y = _mm_loadu_ps(data->normals + n + i);
+		z = _mm_loadu_ps(data->normals + 2 * n + i);
+
+		tx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[0], x),
+			_mm_mul_ps(m[3], y)), _mm_mul_ps(m[6], z));
+		ty = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[1], x),
+			_mm_mul_ps(m[4], y)), _mm_mul_ps(m[7], z));
+		tz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[2], x),
+			_mm_mul_ps(m[5], y)), _mm_mul_ps(m[8], z));
+
+		scale = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(_mm_add_ps(
+			_mm_add_ps(_mm_mul_ps(tx, tx), _mm_mul_ps(ty, ty)),
+			_mm_mul_ps(tz, tz))));
+
+		STORE_VERTICES_SSE2(_mm_mul_ps(tx, scale), _mm_mul_ps(ty, scale),
+			_mm_mul_ps(tz, scale), normals + i * 3);
+	}
+
+	return i;
+}
+#endif	/* SKINNING_SSE2 */
+
+#ifdef	SKINNING_AVX2
+/* The 4x4 transpose of _MM_TRANSPOSE4_PS, done in both halves at once */
+#define	TRANSPOSE4_AVX(r0, r1, r2, r3)	\
+	do	\
+	{	\
+		__m256 t0 = _mm256_unpacklo_ps((r0), (r1));	\
+		__m256 t1 = _mm256_unpacklo_ps((r2), (r3));	\
+		__m256 t2 = _mm256_unpackhi_ps((r0), (r1));	\
+		__m256 t3 = _mm256_unpackhi_ps((r2), (r3));	\
+		(r0) = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0));	\
+		(r1) = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2));	\
+		(r2) = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0));	\
+		(r3) = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(3, 2, 3, 2));	\
+	}	\
+	while (0)
+
+/* Loads a row of two bone matrices, one into each half */
+#define	LOAD_ROWS_AVX(low, high, row)	\
+	_mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps((low) + (row))),	\
+		_mm_loadu_ps((high) + (row)), 1)
+
+TARGET_AVX2 static Uint32 skin_vertices_avx2(const skinning_data_t *data,
+	const float *bones, const Uint32 start, const Uint32 end,
+	float *vertices, float *normals)
+{
+	__m256 m[SKINNING_MATRIX_SIZE];
+	__m256 w, r0, r1, r2, x, y, z, tx, ty, tz, scale;
+	const float *low, *high;
+	Uint32 i, j, k, n, index;
+
+	n = data->vertex_count;
+
+	for (i = start; (i + 8) <= end; i += 8)
+	{
+		// blend the matrix rows of vertex j in the low and of vertex
+		// j + 4 in the high half, m[j * 3 + row]
+		for (j = 0; j < 4; j++)
+		{
+			r0 = _mm256_setzero_ps();
+			r1 = _mm256_setzero_ps();
+			r2 = _mm256_setzero_ps();
+
+			for (k = 0; k < data->influence_count; k++)
+			{
+				index = k * n + i + j;
+				w = _mm256_insertf128_ps(_mm256_castps128_ps256(
+					_mm_set1_ps(data->weights[index])),
+					_mm_set1_ps(data->weights[index + 4]), 1);
+				low = bones + data->offsets[index];
+				high = bones + data->offsets[index + 4];
+
+				r0 = _mm256_add_ps(r0, _mm256_mul_ps(w, LOAD_ROWS_AVX(low, high, 0)));
+				r1 = _mm256_add_ps(r1, _mm256_mul_ps(w, LOAD_ROWS_AVX(low, high, 4)));
+				r2 = _mm256_add_ps(r2, _mm256_mul_ps(w, LOAD_ROWS_AVX(low, high, 8)));
+			}
+
+			m[j * 3 + 0] = r0;
+			m[j * 3 + 1] = r1;
+			m[j * 3 + 2] = r2;
+		}
+
+		// transpose to one register per matrix element, m[column * 3 + row]
+		TRANSPOSE4_AVX(m[0], m[3], m[6], m[9]);
+		TRANSPOSE4_AVX(m[1], m[4], m[7], m[10]);
+		TRANSPOSE4_AVX(m[2], m[5], m[8], m[11]);
+
+		x = _mm256_loadu_ps(data->positions + i);
+		y = _mm256_loadu_ps(data->positions + n + i);
+		z = _mm256_loadu_ps(data->positions + 2 * n + i);
+
+		tx = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m[0], x),
+			_mm256_mul_ps(m[3], y)), _mm256_mul_ps(m[6], z)), m[9]);
+		ty = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m[1], x),
+			_mm256_mul_ps(m[4], y)), _mm256_mul_ps(m[7], z)), m[10]);
+		tz = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m[2], x),
+			_mm256_mul_ps(m[5], y)), _mm256_mul_ps(m[8], z)), m[11]);
+
+		STORE_VERTICES_SSE2(_mm256_castps256_ps128(tx),
+			_mm256_castps256_ps128(ty), _mm256_castps256_ps128(tz),
+			vertices + i * 3);
+		STORE_VERTICES_SSE2(_mm256_extractf128_ps(tx, 1),
+			_mm256_extractf128_ps(ty, 1), _mm256_extractf128_ps(tz, 1),
+			vertices + i * 3 + 12);
+
+		if (normals == NULL)
+		{
+			continue;
+		}
+
+		x = _mm256_loadu_ps(data->normals + i);
+		y = _mm256_loadu_ps(data->normals + n + i);
+		z = _mm256_loadu_ps(data->normals + 2 * n + i);
+
+		tx = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m[0], x),
+			_mm256_mul_ps(m[3], y)), _mm256_mul_ps(m[6], z));
+		ty = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m[1], x),
+			_mm256_mul_ps(m[4], y)), _mm256_mul_ps(m[7], z));
+		tz = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m[2], x),
+			_mm256_mul_ps(m[5], y)), _mm256_mul_ps(m[8], z));
+
+		scale = _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sqrt_ps(
+			_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(tx, tx),
+			_mm256_mul_ps(ty, ty)), _mm256_mul_ps(tz, tz))));
+
+		tx = _mm256_mul_ps(tx, scale);
+		ty = _mm256_mul_ps(ty, scale);
+		tz = _mm256_mul_ps(tz, scale);
+
+		STORE_VERTICES_SSE2(_mm256_castps256_ps128(tx),
+			_mm256_castps256_ps128(ty), _mm256_castps256_ps128(tz),
+			normals + i * 3);
+		STORE_VERTICES_SSE2(_mm256_extractf128_ps(tx, 1),
+			_mm256_extractf128_ps(ty, 1), _mm256_extractf128_ps(tz, 1),
+			normals + i * 3 + 12);
+	}
+
+	return i;
+}
+#endif	/* SKINNING_AVX2 */
+
+void skin_vertices(const skinning_data_t *data, const float *bones,
+	const Uint32 start, const Uint32 end, float *vertices, float *normals)
+{
+	Uint32 i;
+
+	i = start;
+
+#ifdef	SKINNING_AVX2
+	if (SDL_HasAVX2())
+	{
+		i = skin_vertices_avx2(data, bones, i, end, vertices, normals);
+	}
+#endif	/* SKINNING_AVX2 */
+#ifdef	SKINNING_SSE2
+	if (SDL_HasSSE2())
+	{
+		i = skin_vertices_sse2(data, bones, i, end, vertices, normals);
+	}
+#endif	/* SKINNING_SSE2 */
+
+	for (; i < end; i++)
+	{
+		skin_vertex(data, bones, i, vertices, normals);
+	}
+}
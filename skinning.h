@@ -0,0 +1,75 @@
+/*!
+ * \file
+ * \ingroup display_actors
+ * \brief Software skinning of actor meshes.
+ *
+ *      Used for the actors when the animation program is not available. The
+ *      vertex data of a submesh is kept as structure of arrays, so several
+ *      vertices are blended at once with SSE2 or AVX2. The bone matrices of
+ *      each influence are weighted and summed, then the blended matrix
+ *      transforms the vertex. This is the same as blending the vertices
+ *      transformed by each bone, like cal3d does, up to rounding.
+ */
+#ifndef	SKINNING_H
+#define	SKINNING_H
+
+#include <SDL_types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SKINNING_MATRIX_SIZE	12	/*!< floats of a bone matrix: three rows of rotation and translation */
+
+/*!
+ * The skinning data of a submesh. The arrays with one value per vertex and
+ * influence hold all values of the first influence, then all of the second
+ * one and so on. Missing influences have the weight zero.
+ */
+typedef struct
+{
+	Uint32 vertex_count;	/*!< number of vertices */
+	Uint32 influence_count;	/*!< max. number of influences of a vertex */
+	Uint32 bone_count;	/*!< one more than the highest bone id used */
+	float *positions;	/*!< x of all vertices, then y, then z */
+	float *normals;		/*!< the normals, like the positions */
+	float *weights;		/*!< the weight of each vertex and influence */
+	Sint32 *offsets;	/*!< where the bone matrix of each vertex and influence starts, in floats */
+	float *texture_coordinates;	/*!< u and v of each vertex */
+} skinning_data_t;
+
+/*!
+ * \brief Allocates the skinning data of a submesh.
+ * \param vertex_count		number of vertices
+ * \param influence_count	max. number of influences of a vertex
+ * \retval skinning_data_t*	the data, all zero, or NULL on failure
+ */
+skinning_data_t *skinning_data_new(const Uint32 vertex_count,
+	const Uint32 influence_count);
+
+/*!
+ * \brief Frees the skinning data of a submesh.
+ * \param data	the data
+ */
+void skinning_data_free(skinning_data_t *data);
+
+/*!
+ * \brief Skins a range of vertices.
+ *
+ *      Only reads its arguments, so it can run on several threads at once for
+ *      different ranges.
+ * \param data		the skinning data of the submesh
+ * \param bones		the bone matrices, the first one must be the identity for vertices without influences
+ * \param start		the first vertex
+ * \param end		the vertex after the last one
+ * \param vertices	the transformed positions, x, y and z of each vertex
+ * \param normals	the transformed and normalized normals, like the positions, or NULL
+ */
+void skin_vertices(const skinning_data_t *data, const float *bones,
+	const Uint32 start, const Uint32 end, float *vertices, float *normals);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif	/* SKINNING_H */
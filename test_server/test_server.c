@@ -0,0 +1,1042 @@
+/*
+ * Stand-in game server for load and soak testing of the client.
+ *
+ * Accepts one client at a time over TCP, answers the login with the usual
+ * login sequence and a map change, then generates the load described in a
+ * scenario file: moving actors, chat, combat and inventory updates. The
+ * round trip time of PING_REQUEST messages is measured, so the whole
+ * client pipeline from the socket to the main loop and back is covered.
+ * PING is answered with PONG, so the client can measure its latency.
+ *
+ * Usage: el_test_server [-p port] [scenario file]
+ *
+ * To connect the client, add a server to servers.lst, e.g.
+ *
+ *	local		local		127.0.0.1		2000	Local test server
+ *
+ * and start the client with its ID as the last argument, e.g.
+ * "el.linux.bin local". Any user name and password are accepted.
+ *
+ * The scenario file is a list of "setting value" lines, # starts a comment.
+ * Settings before the first "phase" line apply to the whole run, each
+ * "phase <seconds> [name]" line starts a phase that keeps the load settings
+ * of the phase before it unless they are changed. See crowd.scn.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <SDL.h>
+#include <SDL_net.h>
+#include "../client_serv.h"
+
+#define MAX_MESSAGE		8192	/* max. size of one message, including the header */
+#define OUT_BUFFER_SIZE		(256 * 1024)
+#define MAX_PHASES		64
+#define MAX_BOTS		999	/* the client holds at most 1000 actors, one is the player */
+#define PLAYER_ID		1
+#define FIRST_BOT_ID		1000
+#define STATS_SHORTS		115	/* size of HERE_YOUR_STATS */
+#define ITEM_SLOTS		36
+#define BOT_HEALTH		100
+
+/* the actor kinds of actors.h */
+#define HUMAN			1
+#define COMPUTER_CONTROLLED_HUMAN	3
+
+typedef struct
+{
+	char name[32];
+	Uint32 duration;	/* ms */
+	int actors;		/* number of other actors */
+	int creatures;		/* percent of the actors that are creatures */
+	int walking;		/* percent of the actors that walk around */
+	int step_time;		/* ms between the steps of a walking actor */
+	int chat_rate;		/* chat lines per second */
+	int chat_length;	/* max. characters of a chat line */
+	int combat_rate;	/* hits per second */
+	int item_rate;		/* inventory updates per second */
+	int ping_rate;		/* round trip measurements per second */
+} phase_t;
+
+typedef struct
+{
+	int port;
+	char map[256];
+	int x, y;		/* where the player starts */
+	int radius;		/* actors stay within this many tiles of the player */
+	Uint32 seed;
+	int tick;		/* ms between sends */
+	int repeat;		/* restart with the first phase after the last one */
+	int phase_count;
+	phase_t phases[MAX_PHASES];
+} scenario_t;
+
+typedef struct
+{
+	int active;
+	int creature;
+	int walking;
+	int x, y;
+	int dir;		/* 0 - 7, north clockwise */
+	int health;
+	Uint32 next_step;
+} bot_t;
+
+typedef struct
+{
+	Uint32 start;
+	Uint32 messages;
+	Uint64 bytes;
+	Uint32 sends;
+	Uint32 steps;
+	Uint32 chat;
+	Uint32 hits;
+	Uint32 items;
+	Uint32 received;	/* messages from the client */
+	Uint32 pings;
+	Uint32 pongs;
+	Uint32 min_rtt, max_rtt;
+	Uint64 total_rtt;
+} phase_stats_t;
+
+static scenario_t scenario;
+
+static TCPsocket client = NULL;
+static SDLNet_SocketSet socket_set = NULL;
+static int connected = 0;
+
+static Uint8 out_buffer[OUT_BUFFER_SIZE];
+static int out_length = 0;
+static Uint8 in_buffer[MAX_MESSAGE * 2];
+static int in_length = 0;
+
+static bot_t bots[MAX_BOTS];
+static int bot_count = 0;
+static int logged_in = 0;
+static int phase = 0;
+static Uint32 phase_start = 0;
+static Uint32 last_tick = 0;
+static Uint32 next_minute = 0;
+static int game_minute = 0;
+static phase_stats_t stats;
+
+/* remainders of the rates, in thousandths of an event */
+static Uint32 chat_credit = 0;
+static Uint32 combat_credit = 0;
+static Uint32 item_credit = 0;
+static Uint32 ping_credit = 0;
+
+static Uint32 random_state = 1;
+
+static const char *chat_words[] =
+{
+	"hello", "anyone", "selling", "buying", "iron", "bars", "ore", "sword",
+	"cape", "potion", "of", "the", "gc", "pm", "me", "for", "price", "at",
+	"storage", "wolf", "beaver", "fur", "need", "help", "quest", "lol",
+	"isla", "prima", "portland", "trade", "wts", "wtb", "cheap", "now"
+};
+
+static const int creature_types[] =
+{
+	rat, beaver, deer, wolf, white_rabbit, brown_rabbit, fox, bear
+};
+
+static const int dir_x[8] = { 0, 1, 1, 1, 0, -1, -1, -1 };
+static const int dir_y[8] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+
+static Uint32 get_random(Uint32 range)
+{
+	/* xorshift, so a scenario always generates the same messages */
+	random_state ^= random_state << 13;
+	random_state ^= random_state >> 17;
+	random_state ^= random_state << 5;
+
+	return range > 0 ? random_state % range : 0;
+}
+
+static void put_16(Uint8 *buffer, Uint16 value)
+{
+	buffer[0] = value & 0xFF;
+	buffer[1] = value >> 8;
+}
+
+static void put_32(Uint8 *buffer, Uint32 value)
+{
+	put_16(buffer, value & 0xFFFF);
+	put_16(buffer + 2, value >> 16);
+}
+
+static Uint16 get_16(const Uint8 *buffer)
+{
+	return buffer[0] | (buffer[1] << 8);
+}
+
+static Uint32 get_32(const Uint8 *buffer)
+{
+	return get_16(buffer) | ((Uint32)get_16(buffer + 2) << 16);
+}
+
+static void disconnect_client(const char *reason)
+{
+	if (client != NULL)
+	{
+		SDLNet_TCP_DelSocket(socket_set, client);
+		SDLNet_TCP_Close(client);
+		client = NULL;
+	}
+	if (connected)
+	{
+		printf("Client disconnected: %s\n", reason);
+	}
+	connected = 0;
+}
+
+static void flush_messages(void)
+{
+	if (connected && (out_length > 0))
+	{
+		if (SDLNet_TCP_Send(client, out_buffer, out_length) < out_length)
+		{
+			disconnect_client(SDLNet_GetError());
+		}
+		stats.sends++;
+		stats.bytes += out_length;
+	}
+	out_length = 0;
+}
+
+static void add_message(Uint8 type, const Uint8 *data, int size)
+{
+	if (out_length + size + 3 > OUT_BUFFER_SIZE)
+	{
+		flush_messages();
+	}
+
+	out_buffer[out_length] = type;
+	put_16(out_buffer + out_length + 1, size + 1);
+	if (size > 0)
+	{
+		memcpy(out_buffer + out_length + 3, data, size);
+	}
+	out_length += size + 3;
+	stats.messages++;
+}
+
+static void send_raw_text(Uint8 channel, const char *text)
+{
+	Uint8 data[MAX_MESSAGE];
+	int length;
+
+	length = strlen(text);
+	if (length > MAX_MESSAGE - 4)
+	{
+		length = MAX_MESSAGE - 4;
+	}
+
+	data[0] = channel;
+	memcpy(data + 1, text, length);
+	add_message(RAW_TEXT, data, length + 1);
+}
+
+static void send_actor_command(int id, Uint8 command)
+{
+	Uint8 data[3];
+
+	put_16(data, id);
+	data[2] = command;
+	add_message(ADD_ACTOR_COMMAND, data, sizeof(data));
+}
+
+static void send_actor_health(Uint8 type, int id, int amount)
+{
+	Uint8 data[4];
+
+	put_16(data, id);
+	put_16(data + 2, amount);
+	add_message(type, data, sizeof(data));
+}
+
+static void send_enhanced_actor(int id, int x, int y, int type, int kind,
+	int health, const char *name)
+{
+	Uint8 data[128];
+	int length;
+
+	memset(data, 0, sizeof(data));
+	put_16(data, id);
+	put_16(data + 2, x & 0x7FF);
+	put_16(data + 4, y & 0x7FF);
+	put_16(data + 8, get_random(8) * 45);
+	data[10] = type;
+	data[12] = SKIN_BROWN + get_random(4);
+	data[13] = HAIR_BLACK + get_random(4);
+	data[14] = SHIRT_BLACK + get_random(4);
+	data[15] = PANTS_BLACK + get_random(4);
+	data[16] = BOOTS_BLACK + get_random(4);
+	data[17] = HEAD_1;
+	data[18] = SHIELD_NONE;
+	data[19] = WEAPON_NONE;
+	data[20] = CAPE_NONE;
+	data[21] = HELMET_NONE;
+	data[22] = frame_idle;
+	put_16(data + 23, health);
+	put_16(data + 25, health);
+	data[27] = kind;
+	length = 28 + SDL_strlcpy((char *)data + 28, name, 32) + 1;
+	put_16(data + length, ACTOR_SCALE_BASE);
+	data[length + 2] = 255;		/* no attachment */
+	data[length + 3] = 0;		/* eyes */
+	data[length + 4] = NECK_NONE;
+	add_message(ADD_NEW_ENHANCED_ACTOR, data, length + 5);
+}
+
+static void send_creature(int id, int x, int y, int type, int health,
+	const char *name)
+{
+	Uint8 data[64];
+	int length;
+
+	memset(data, 0, sizeof(data));
+	put_16(data, id);
+	put_16(data + 2, x & 0x7FF);
+	put_16(data + 4, y & 0x7FF);
+	put_16(data + 8, get_random(8) * 45);
+	data[10] = type;
+	data[11] = frame_idle;
+	put_16(data + 12, health);
+	put_16(data + 14, health);
+	data[16] = COMPUTER_CONTROLLED_HUMAN;
+	length = 17 + SDL_strlcpy((char *)data + 17, name, 32) + 1;
+	put_16(data + length, ACTOR_SCALE_BASE);
+	data[length + 2] = 255;		/* no attachment */
+	add_message(ADD_NEW_ACTOR, data, length + 3);
+}
+
+static void add_bot(int index, Uint32 now)
+{
+	const phase_t *p = &scenario.phases[phase];
+	bot_t *bot = &bots[index];
+	char name[32];
+
+	bot->active = 1;
+	bot->creature = get_random(100) < (Uint32)p->creatures;
+	bot->walking = get_random(100) < (Uint32)p->walking;
+	bot->x = scenario.x + get_random(2 * scenario.radius + 1) - scenario.radius;
+	bot->y = scenario.y + get_random(2 * scenario.radius + 1) - scenario.radius;
+	bot->dir = get_random(8);
+	bot->health = BOT_HEALTH;
+	bot->next_step = now + get_random(p->step_time + 1);
+
+	if (bot->creature)
+	{
+		snprintf(name, sizeof(name), "Creature%d", index);
+		send_creature(FIRST_BOT_ID + index, bot->x, bot->y,
+			creature_types[get_random(sizeof(creature_types) / sizeof(creature_types[0]))],
+			BOT_HEALTH, name);
+	}
+	else
+	{
+		snprintf(name, sizeof(name), "Bot%d", index);
+		send_enhanced_actor(FIRST_BOT_ID + index, bot->x, bot->y,
+			human_female + get_random(6), HUMAN, BOT_HEALTH, name);
+	}
+}
+
+static void remove_bot(int index)
+{
+	Uint8 data[2];
+
+	bots[index].active = 0;
+	put_16(data, FIRST_BOT_ID + index);
+	add_message(REMOVE_ACTOR, data, sizeof(data));
+}
+
+/* adds or removes actors to match the current phase */
+static void update_bot_count(Uint32 now)
+{
+	int count;
+
+	count = scenario.phases[phase].actors;
+
+	while (bot_count < count)
+	{
+		add_bot(bot_count++, now);
+	}
+	while (bot_count > count)
+	{
+		remove_bot(--bot_count);
+	}
+}
+
+static void send_new_minute(void)
+{
+	Uint8 data[2];
+
+	put_16(data, game_minute);
+	add_message(NEW_MINUTE, data, sizeof(data));
+	game_minute = (game_minute + 1) % 360;
+}
+
+static void send_login_sequence(Uint32 now)
+{
+	Uint8 data[STATS_SHORTS * 2];
+	int i;
+
+	add_message(LOG_IN_OK, NULL, 0);
+
+	memset(data, 0, sizeof(data));
+	for (i = 0; i < 12; i++)
+	{
+		/* the base attributes and nexus */
+		put_16(data + i * 2, 10);
+	}
+	add_message(HERE_YOUR_STATS, data, sizeof(data));
+
+	data[0] = 0;
+	add_message(HERE_YOUR_INVENTORY, data, 1);
+
+	put_16(data, PLAYER_ID);
+	add_message(YOU_ARE, data, 2);
+
+	add_message(CHANGE_MAP, (const Uint8 *)scenario.map, strlen(scenario.map) + 1);
+
+	send_new_minute();
+	next_minute = now + 60000;
+
+	put_32(data, now);
+	add_message(SYNC_CLOCK, data, 4);
+
+	send_enhanced_actor(PLAYER_ID, scenario.x, scenario.y, human_male, HUMAN,
+		BOT_HEALTH, "Tester");
+
+	send_raw_text(CHAT_SERVER, "Welcome to the test server");
+}
+
+static void start_phase(int index, Uint32 now)
+{
+	memset(&stats, 0, sizeof(stats));
+	stats.start = now;
+	stats.min_rtt = 0xFFFFFFFF;
+	phase = index;
+	phase_start = now;
+
+	printf("Phase %d %s: %d actors, %d chat/s, %d hits/s, %d items/s\n",
+		phase + 1, scenario.phases[phase].name, scenario.phases[phase].actors,
+		scenario.phases[phase].chat_rate, scenario.phases[phase].combat_rate,
+		scenario.phases[phase].item_rate);
+
+	update_bot_count(now);
+}
+
+static void print_phase_stats(Uint32 now)
+{
+	double seconds;
+
+	seconds = (now - stats.start) / 1000.0;
+	if (seconds <= 0.0)
+	{
+		seconds = 1.0;
+	}
+
+	printf("  %.1f s, %u messages (%.0f/s), %.1f KB/s in %u sends\n", seconds,
+		stats.messages, stats.messages / seconds, stats.bytes / 1024.0 / seconds,
+		stats.sends);
+	printf("  %u steps, %u chat lines, %u hits, %u items, %u messages received\n",
+		stats.steps, stats.chat, stats.hits, stats.items, stats.received);
+	if (stats.pongs > 0)
+	{
+		printf("  round trip: %u of %u pings, min %u ms, avg %.1f ms, max %u ms\n",
+			stats.pongs, stats.pings, stats.min_rtt,
+			(double)stats.total_rtt / stats.pongs, stats.max_rtt);
+	}
+}
+
+/* the number of events due at a rate per second in elapsed ms */
+static Uint32 get_due_events(Uint32 *credit, int rate, Uint32 elapsed)
+{
+	Uint32 count;
+
+	*credit += rate * elapsed;
+	count = *credit / 1000;
+	*credit %= 1000;
+
+	return count;
+}
+
+static void walk_bots(Uint32 now)
+{
+	const phase_t *p = &scenario.phases[phase];
+	bot_t *bot;
+	int i, x, y;
+
+	for (i = 0; i < bot_count; i++)
+	{
+		bot = &bots[i];
+		if (!bot->walking || ((Sint32)(now - bot->next_step) < 0))
+		{
+			continue;
+		}
+
+		/* mostly keep going, turn around at the edge of the area */
+		if (get_random(4) == 0)
+		{
+			bot->dir = (bot->dir + 7 + get_random(3)) % 8;
+		}
+		x = bot->x + dir_x[bot->dir];
+		y = bot->y + dir_y[bot->dir];
+		if ((abs(x - scenario.x) > scenario.radius) ||
+			(abs(y - scenario.y) > scenario.radius))
+		{
+			bot->dir = (bot->dir + 4) % 8;
+			x = bot->x + dir_x[bot->dir];
+			y = bot->y + dir_y[bot->dir];
+		}
+		bot->x = x;
+		bot->y = y;
+		bot->next_step += p->step_time;
+		if ((Sint32)(now - bot->next_step) > p->step_time)
+		{
+			bot->next_step = now + p->step_time;
+		}
+
+		send_actor_command(FIRST_BOT_ID + i, move_n + bot->dir);
+		stats.steps++;
+	}
+}
+
+static void send_chat(int count)
+{
+	const phase_t *p = &scenario.phases[phase];
+	char text[MAX_MESSAGE / 2];
+	int length, max_length, word;
+
+	while (count-- > 0)
+	{
+		length = snprintf(text, sizeof(text), "Bot%u:", get_random(bot_count > 0 ? bot_count : 1));
+		max_length = 8 + get_random(p->chat_length > 8 ? p->chat_length - 8 : 1);
+		if (max_length >= (int)sizeof(text))
+		{
+			max_length = sizeof(text) - 1;
+		}
+		while (length < max_length)
+		{
+			word = get_random(sizeof(chat_words) / sizeof(chat_words[0]));
+			length += snprintf(text + length, sizeof(text) - length, " %s", chat_words[word]);
+		}
+		text[max_length] = '\0';
+		send_raw_text(get_random(4) == 0 ? CHAT_CHANNEL1 : CHAT_LOCAL, text);
+		stats.chat++;
+	}
+}
+
+static void send_combat(int count)
+{
+	bot_t *bot;
+	int index, damage;
+
+	while ((count-- > 0) && (bot_count > 0))
+	{
+		index = get_random(bot_count);
+		bot = &bots[index];
+		damage = 1 + get_random(20);
+
+		send_actor_command(FIRST_BOT_ID + index, get_random(2) ? attack_up_1 : pain1);
+		send_actor_health(GET_ACTOR_DAMAGE, FIRST_BOT_ID + index, damage);
+		bot->health -= damage;
+		if (bot->health < BOT_HEALTH / 4)
+		{
+			send_actor_health(GET_ACTOR_HEAL, FIRST_BOT_ID + index, BOT_HEALTH - bot->health);
+			bot->health = BOT_HEALTH;
+		}
+		stats.hits++;
+	}
+}
+
+static void send_items(int count)
+{
+	Uint8 data[8];
+
+	while (count-- > 0)
+	{
+		put_16(data, get_random(256));
+		put_32(data + 2, 1 + get_random(1000));
+		data[6] = get_random(ITEM_SLOTS);
+		data[7] = 0;
+		add_message(GET_NEW_INVENTORY_ITEM, data, sizeof(data));
+		stats.items++;
+	}
+}
+
+static void send_pings(int count, Uint32 now)
+{
+	Uint8 data[4];
+
+	while (count-- > 0)
+	{
+		put_32(data, now);
+		add_message(PING_REQUEST, data, sizeof(data));
+		stats.pings++;
+	}
+}
+
+static void generate_load(Uint32 now)
+{
+	const phase_t *p = &scenario.phases[phase];
+	Uint32 elapsed;
+
+	elapsed = now - last_tick;
+	last_tick = now;
+
+	walk_bots(now);
+	send_chat(get_due_events(&chat_credit, p->chat_rate, elapsed));
+	send_combat(get_due_events(&combat_credit, p->combat_rate, elapsed));
+	send_items(get_due_events(&item_credit, p->item_rate, elapsed));
+	send_pings(get_due_events(&ping_credit, p->ping_rate, elapsed), now);
+
+	if ((Sint32)(now - next_minute) >= 0)
+	{
+		send_new_minute();
+		next_minute += 60000;
+	}
+}
+
+/* returns zero when the scenario has ended */
+static int update_phase(Uint32 now)
+{
+	if (now - phase_start < scenario.phases[phase].duration)
+	{
+		return 1;
+	}
+
+	print_phase_stats(now);
+
+	if (phase + 1 < scenario.phase_count)
+	{
+		start_phase(phase + 1, now);
+	}
+	else if (scenario.repeat)
+	{
+		start_phase(0, now);
+	}
+	else
+	{
+		return 0;
+	}
+
+	return 1;
+}
+
+static void process_client_message(const Uint8 *data, int length, Uint32 now)
+{
+	Uint32 rtt;
+	int name_length;
+
+	stats.received++;
+
+	switch (data[0])
+	{
+		case SEND_OPENING_SCREEN:
+			send_raw_text(CHAT_SERVER, "Eternal Lands test server, log in with any name");
+			break;
+		case LOG_IN:
+			if (!logged_in)
+			{
+				for (name_length = 0; (name_length < length - 3) &&
+					(data[3 + name_length] != ' '); name_length++);
+				printf("Login: %.*s\n", name_length, (const char *)data + 3);
+				logged_in = 1;
+				send_login_sequence(now);
+				last_tick = now;
+				start_phase(0, now);
+			}
+			break;
+		case PING:
+			/* echo the time stamp, the client measures its round trip time */
+			if (length >= 7)
+			{
+				add_message(PONG, data + 3, 4);
+			}
+			break;
+		case PING_RESPONSE:
+			if (length >= 7)
+			{
+				rtt = now - get_32(data + 3);
+				stats.pongs++;
+				stats.total_rtt += rtt;
+				if (rtt < stats.min_rtt)
+				{
+					stats.min_rtt = rtt;
+				}
+				if (rtt > stats.max_rtt)
+				{
+					stats.max_rtt = rtt;
+				}
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+static void receive_messages(Uint32 now)
+{
+	int received, offset, length;
+
+	received = SDLNet_TCP_Recv(client, in_buffer + in_length, sizeof(in_buffer) - in_length);
+	if (received <= 0)
+	{
+		disconnect_client("connection closed");
+		return;
+	}
+	in_length += received;
+
+	offset = 0;
+	while (in_length - offset >= 3)
+	{
+		length = get_16(in_buffer + offset + 1) + 2;
+		if ((length < 3) || (length > MAX_MESSAGE))
+		{
+			disconnect_client("invalid message");
+			return;
+		}
+		if (in_length - offset < length)
+		{
+			break;
+		}
+		process_client_message(in_buffer + offset, length, now);
+		offset += length;
+	}
+
+	in_length -= offset;
+	memmove(in_buffer, in_buffer + offset, in_length);
+}
+
+static void run_session(void)
+{
+	Uint32 now, next_tick;
+	Sint32 wait;
+
+	connected = 1;
+	logged_in = 0;
+	in_length = 0;
+	out_length = 0;
+	bot_count = 0;
+	game_minute = 0;
+	chat_credit = combat_credit = item_credit = ping_credit = 0;
+	random_state = scenario.seed;
+	memset(&stats, 0, sizeof(stats));
+	next_tick = SDL_GetTicks();
+
+	while (connected)
+	{
+		now = SDL_GetTicks();
+		wait = (Sint32)(next_tick - now);
+		if (wait < 0)
+		{
+			wait = 0;
+		}
+
+		if (SDLNet_CheckSockets(socket_set, wait) > 0)
+		{
+			now = SDL_GetTicks();
+			receive_messages(now);
+		}
+
+		now = SDL_GetTicks();
+		if (connected && logged_in && ((Sint32)(now - next_tick) >= 0))
+		{
+			if (!update_phase(now))
+			{
+				/* the last phase is already reported */
+				logged_in = 0;
+				flush_messages();
+				disconnect_client("scenario finished");
+				break;
+			}
+			generate_load(now);
+			next_tick += scenario.tick;
+			if ((Sint32)(now - next_tick) > scenario.tick)
+			{
+				next_tick = now + scenario.tick;
+			}
+		}
+		else if (!logged_in)
+		{
+			next_tick = now + scenario.tick;
+		}
+
+		flush_messages();
+	}
+
+	if (logged_in)
+	{
+		print_phase_stats(SDL_GetTicks());
+	}
+}
+
+static void set_defaults(void)
+{
+	phase_t *p = &scenario.phases[0];
+
+	memset(&scenario, 0, sizeof(scenario));
+	scenario.port = 2000;
+	SDL_strlcpy(scenario.map, "./maps/startmap.elm", sizeof(scenario.map));
+	scenario.x = 64;
+	scenario.y = 64;
+	scenario.radius = 12;
+	scenario.seed = 1;
+	scenario.tick = 50;
+
+	SDL_strlcpy(p->name, "default", sizeof(p->name));
+	p->duration = 0xFFFFFFFF;
+	p->actors = 100;
+	p->creatures = 25;
+	p->walking = 50;
+	p->step_time = 400;
+	p->chat_rate = 2;
+	p->chat_length = 80;
+	p->combat_rate = 5;
+	p->item_rate = 1;
+	p->ping_rate = 1;
+}
+
+/* returns zero on an unknown setting */
+static int set_phase_value(phase_t *p, const char *name, int value)
+{
+	if (value < 0)
+	{
+		value = 0;
+	}
+
+	if (!strcmp(name, "actors"))
+	{
+		p->actors = value > MAX_BOTS ? MAX_BOTS : value;
+	}
+	else if (!strcmp(name, "creatures"))
+	{
+		p->creatures = value;
+	}
+	else if (!strcmp(name, "walking"))
+	{
+		p->walking = value;
+	}
+	else if (!strcmp(name, "step_time"))
+	{
+		p->step_time = value < 1 ? 1 : value;
+	}
+	else if (!strcmp(name, "chat_rate"))
+	{
+		p->chat_rate = value;
+	}
+	else if (!strcmp(name, "chat_length"))
+	{
+		p->chat_length = value;
+	}
+	else if (!strcmp(name, "combat_rate"))
+	{
+		p->combat_rate = value;
+	}
+	else if (!strcmp(name, "item_rate"))
+	{
+		p->item_rate = value;
+	}
+	else if (!strcmp(name, "ping_rate"))
+	{
+		p->ping_rate = value;
+	}
+	else
+	{
+		return 0;
+	}
+
+	return 1;
+}
+
+static int load_scenario(const char *file_name)
+{
+	FILE *file;
+	char line[512], name[64], value[256];
+	char *comment;
+	phase_t *p;
+	int line_number, fields;
+
+	file = fopen(file_name, "r");
+	if (file == NULL)
+	{
+		fprintf(stderr, "Can't open scenario %s\n", file_name);
+		return 0;
+	}
+
+	/* the defaults are the base of the first phase */
+	p = &scenario.phases[0];
+	line_number = 0;
+
+	while (fgets(line, sizeof(line), file) != NULL)
+	{
+		line_number++;
+		comment = strchr(line, '#');
+		if (comment != NULL)
+		{
+			*comment = '\0';
+		}
+
+		value[0] = '\0';
+		fields = sscanf(line, "%63s %255[^\r\n]", name, value);
+		if (fields < 1)
+		{
+			continue;
+		}
+
+		if (!strcmp(name, "phase"))
+		{
+			if (scenario.phase_count >= MAX_PHASES)
+			{
+				fprintf(stderr, "%s:%d: too many phases\n", file_name, line_number);
+				break;
+			}
+			if (scenario.phase_count > 0)
+			{
+				scenario.phases[scenario.phase_count] = *p;
+			}
+			p = &scenario.phases[scenario.phase_count++];
+			p->name[0] = '\0';
+			p->duration = 1000 * atoi(value);
+			if (sscanf(value, "%*d %31s", p->name) != 1)
+			{
+				snprintf(p->name, sizeof(p->name), "%d", scenario.phase_count);
+			}
+		}
+		else if (!strcmp(name, "port"))
+		{
+			scenario.port = atoi(value);
+		}
+		else if (!strcmp(name, "map"))
+		{
+			SDL_strlcpy(scenario.map, value, sizeof(scenario.map));
+		}
+		else if (!strcmp(name, "position"))
+		{
+			sscanf(value, "%d %d", &scenario.x, &scenario.y);
+		}
+		else if (!strcmp(name, "radius"))
+		{
+			scenario.radius = atoi(value);
+		}
+		else if (!strcmp(name, "seed"))
+		{
+			scenario.seed = strtoul(value, NULL, 0);
+		}
+		else if (!strcmp(name, "tick"))
+		{
+			scenario.tick = atoi(value);
+		}
+		else if (!strcmp(name, "repeat"))
+		{
+			scenario.repeat = atoi(value);
+		}
+		else if (!set_phase_value(p, name, atoi(value)))
+		{
+			fprintf(stderr, "%s:%d: unknown setting %s\n", file_name, line_number, name);
+		}
+	}
+
+	fclose(file);
+
+	if (scenario.phase_count == 0)
+	{
+		/* no phases, run the settings until the client disconnects */
+		scenario.phase_count = 1;
+	}
+	if (scenario.seed == 0)
+	{
+		scenario.seed = 1;
+	}
+	if (scenario.tick < 1)
+	{
+		scenario.tick = 1;
+	}
+	if (scenario.radius < 1)
+	{
+		scenario.radius = 1;
+	}
+
+	return 1;
+}
+
+int main(int argc, char *argv[])
+{
+	IPaddress ip;
+	TCPsocket server;
+	int i, port;
+
+	set_defaults();
+	port = 0;
+	/* the reports are read while the server runs, also from a log file */
+	setvbuf(stdout, NULL, _IOLBF, BUFSIZ);
+
+	for (i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-p") && (i + 1 < argc))
+		{
+			port = atoi(argv[++i]);
+		}
+		else if (argv[i][0] == '-')
+		{
+			fprintf(stderr, "Usage: %s [-p port] [scenario file]\n", argv[0]);
+			return 1;
+		}
+		else if (!load_scenario(argv[i]))
+		{
+			return 1;
+		}
+	}
+	if (port > 0)
+	{
+		scenario.port = port;
+	}
+	if (scenario.phase_count == 0)
+	{
+		scenario.phase_count = 1;
+	}
+
+#ifdef	SIGPIPE
+	/* a client that goes away must not kill the server in a send */
+	signal(SIGPIPE, SIG_IGN);
+#endif	//SIGPIPE
+
+	if ((SDL_Init(SDL_INIT_TIMER) < 0) || (SDLNet_Init() < 0))
+	{
+		fprintf(stderr, "Failed to initialise SDL: %s\n", SDL_GetError());
+		return 1;
+	}
+
+	if ((SDLNet_ResolveHost(&ip, NULL, scenario.port) < 0) ||
+		((server = SDLNet_TCP_Open(&ip)) == NULL))
+	{
+		fprintf(stderr, "Can't listen on port %d: %s\n", scenario.port, SDLNet_GetError());
+		SDLNet_Quit();
+		SDL_Quit();
+		return 1;
+	}
+	socket_set = SDLNet_AllocSocketSet(1);
+
+	printf("Listening on port %d, %d phase(s)\n", scenario.port, scenario.phase_count);
+
+	for (;;)
+	{
+		client = SDLNet_TCP_Accept(server);
+		if (client == NULL)
+		{
+			SDL_Delay(100);
+			continue;
+		}
+
+		printf("Client connected\n");
+		SDLNet_TCP_AddSocket(socket_set, client);
+		run_session();
+	}
+
+	/* not reached, the server runs until it is killed */
+	return 0;
+}
@@ -0,0 +1,17 @@
+/*
+ * The block decoder of dds.c before the in place row decoder, see
+ * dds_reference.c.
+ */
+#ifndef	DDS_REFERENCE_H
+#define	DDS_REFERENCE_H
+
+#include "dds.h"
+
+void reference_unpack_dxt1(DXTColorBlock *block, Uint8 *values);
+void reference_unpack_dxt3(DXTExplicitAlphaBlock *alpha_block, DXTColorBlock *color_block, Uint8 *values);
+void reference_unpack_dxt5(DXTInterpolatedAlphaBlock *alpha_block, DXTColorBlock *color_block, Uint8 *values);
+void reference_unpack_ati1(DXTInterpolatedAlphaBlock *block, Uint8 *values);
+void reference_unpack_ati2(DXTInterpolatedAlphaBlock *first_block, DXTInterpolatedAlphaBlock *second_block,
+	Uint8 *values);
+
+#endif	/* DDS_REFERENCE_H */
@@ -0,0 +1,227 @@
+/*
+ * Checks that the DXT/ATI row decoder of dds.c is bit-exact with the block
+ * decoder it replaced (dds_reference.c).
+ *
+ * Every format is decoded from random blocks, half of them with equal end
+ * points, then from random levels with sizes that are not a multiple of
+ * four, both in one call and one block row at a time.
+ *
+ * Usage: dds_test [blocks per format]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dds_reference.h"
+
+#define MAX_LEVEL_SIZE	67
+
+static const Uint32 formats[] =
+{
+	DDSFMT_DXT1, DDSFMT_DXT2, DDSFMT_DXT3, DDSFMT_DXT4, DDSFMT_DXT5,
+	DDSFMT_ATI1, DDSFMT_ATI2
+};
+
+static const char *format_names[] =
+{
+	"DXT1", "DXT2", "DXT3", "DXT4", "DXT5", "ATI1", "ATI2"
+};
+
+static Uint32 random_state = 1;
+
+static Uint32 get_random(void)
+{
+	random_state = random_state * 1103515245 + 12345;
+
+	return random_state >> 8;
+}
+
+static void fill_block(const Uint32 format, Uint8 *block, const Uint32 size,
+	const Uint32 equal)
+{
+	Uint32 i;
+
+	for (i = 0; i < size; i++)
+	{
+		block[i] = get_random();
+	}
+
+	if (!equal)
+	{
+		return;
+	}
+
+	/* equal end points select the three color and the six alpha palettes */
+	switch (format)
+	{
+		case DDSFMT_DXT1:
+			memcpy(block + 2, block, 2);
+			break;
+		case DDSFMT_DXT2:
+		case DDSFMT_DXT3:
+			memcpy(block + 10, block + 8, 2);
+			break;
+		case DDSFMT_DXT4:
+		case DDSFMT_DXT5:
+			block[1] = block[0];
+			memcpy(block + 10, block + 8, 2);
+			break;
+		case DDSFMT_ATI1:
+			block[1] = block[0];
+			break;
+		case DDSFMT_ATI2:
+			block[1] = block[0];
+			block[9] = block[8];
+			break;
+	}
+}
+
+static void reference_unpack(const Uint32 format, Uint8 *block, Uint8 *values)
+{
+	switch (format)
+	{
+		case DDSFMT_DXT1:
+			reference_unpack_dxt1((DXTColorBlock *)block, values);
+			break;
+		case DDSFMT_DXT2:
+		case DDSFMT_DXT3:
+			reference_unpack_dxt3((DXTExplicitAlphaBlock *)block,
+				(DXTColorBlock *)(block + 8), values);
+			break;
+		case DDSFMT_DXT4:
+		case DDSFMT_DXT5:
+			reference_unpack_dxt5((DXTInterpolatedAlphaBlock *)block,
+				(DXTColorBlock *)(block + 8), values);
+			break;
+		case DDSFMT_ATI1:
+			reference_unpack_ati1((DXTInterpolatedAlphaBlock *)block,
+				values);
+			break;
+		case DDSFMT_ATI2:
+			reference_unpack_ati2((DXTInterpolatedAlphaBlock *)block,
+				(DXTInterpolatedAlphaBlock *)(block + 8), values);
+			break;
+	}
+}
+
+static Uint32 check_blocks(const Uint32 index, const Uint32 count)
+{
+	Uint8 block[16], values[64], expected[64];
+	Uint32 i, block_size, errors;
+
+	block_size = get_dxt_block_size(formats[index]);
+	errors = 0;
+
+	for (i = 0; i < count; i++)
+	{
+		fill_block(formats[index], block, block_size, i & 1);
+
+		memset(values, 0x55, sizeof(values));
+		memset(expected, 0xAA, sizeof(expected));
+
+		decompress_dxt_rows(formats[index], block, 4, 4, 0, 1, values);
+		reference_unpack(formats[index], block, expected);
+
+		if (memcmp(values, expected, sizeof(values)) != 0)
+		{
+			errors++;
+		}
+	}
+
+	return errors;
+}
+
+static Uint32 check_level(const Uint32 index, const Uint32 width,
+	const Uint32 height)
+{
+	static Uint8 blocks[((MAX_LEVEL_SIZE + 3) / 4) * ((MAX_LEVEL_SIZE + 3) / 4) * 16];
+	static Uint8 image[MAX_LEVEL_SIZE * MAX_LEVEL_SIZE * 4];
+	static Uint8 rows[MAX_LEVEL_SIZE * MAX_LEVEL_SIZE * 4];
+	static Uint8 expected[MAX_LEVEL_SIZE * MAX_LEVEL_SIZE * 4];
+	Uint8 values[64];
+	Uint32 block_size, blocks_x, blocks_y, x, y, i, j, errors;
+
+	block_size = get_dxt_block_size(formats[index]);
+	blocks_x = (width + 3) / 4;
+	blocks_y = (height + 3) / 4;
+
+	for (i = 0; i < (blocks_x * blocks_y); i++)
+	{
+		fill_block(formats[index], blocks + i * block_size,
+			block_size, i & 1);
+	}
+
+	/* the reference decodes whole blocks, clipped at the level border */
+	for (y = 0; y < blocks_y; y++)
+	{
+		for (x = 0; x < blocks_x; x++)
+		{
+			reference_unpack(formats[index], blocks +
+				(y * blocks_x + x) * block_size, values);
+
+			for (j = 0; j < 4; j++)
+			{
+				for (i = 0; i < 4; i++)
+				{
+					if (((x * 4 + i) < width) && ((y * 4 + j) < height))
+					{
+						memcpy(expected + ((y * 4 + j) * width + x * 4 + i) * 4,
+							values + (j * 4 + i) * 4, 4);
+					}
+				}
+			}
+		}
+	}
+
+	decompress_dxt_rows(formats[index], blocks, width, height, 0, blocks_y, image);
+
+	for (y = 0; y < blocks_y; y++)
+	{
+		decompress_dxt_rows(formats[index], blocks, width, height, y, 1, rows);
+	}
+
+	errors = 0;
+
+	if (memcmp(image, expected, width * height * 4) != 0)
+	{
+		errors++;
+	}
+
+	if (memcmp(rows, expected, width * height * 4) != 0)
+	{
+		errors++;
+	}
+
+	return errors;
+}
+
+int main(int argc, char *argv[])
+{
+	Uint32 count, index, width, height, errors, total;
+
+	count = 200000;
+
+	if (argc > 1)
+	{
+		count = atoi(argv[1]);
+	}
+
+	total = 0;
+
+	for (index = 0; index < (sizeof(formats) / sizeof(formats[0])); index++)
+	{
+		errors = check_blocks(index, count);
+
+		for (height = 1; height <= MAX_LEVEL_SIZE; height += 11)
+		{
+			for (width = 1; width <= MAX_LEVEL_SIZE; width += 7)
+			{
+				errors += check_level(index, width, height);
+			}
+		}
+
+		printf("%s: %u errors\n", format_names[index], errors);
+		total += errors;
+	}
+
+	return total != 0;
+}
@@ -0,0 +1,119 @@
+/*
+ * Times lookups in the hash table of hash.c and mem_hash() against the
+ * chained table and the byte wise hash they replaced, see
+ * hash_reference.c.
+ *
+ * Usage: hash_bench [entries [calls]]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "hash.h"
+#include "hash_reference.h"
+
+static double get_ns(const Uint64 ticks, const Uint32 count)
+{
+	return 1e9 * ticks / SDL_GetPerformanceFrequency() / count;
+}
+
+int main(int argc, char *argv[])
+{
+	hash_table *table;
+	reference_hash_table *reference;
+	Uint8 buffer[4096];
+	Uint64 start, ticks;
+	Uint32 i, j, entries, calls, sum;
+
+	entries = 20000;
+	calls = 10;
+	sum = 0;
+
+	if (argc > 1)
+	{
+		entries = atoi(argv[1]);
+	}
+
+	if (argc > 2)
+	{
+		calls = atoi(argv[2]);
+	}
+
+	/* 64 buckets, as most tables of the client are created */
+	table = create_hash_table(64, hash_fn_int, cmp_fn_int, 0);
+	reference = reference_create_hash_table(64, reference_hash_fn_int,
+		cmp_fn_int, 0);
+
+	for (i = 0; i < entries; i++)
+	{
+		hash_add(table, (void*)(uintptr_t)(i * 7919),
+			(void*)(uintptr_t)i);
+		reference_hash_add(reference, (void*)(uintptr_t)(i * 7919),
+			(void*)(uintptr_t)i);
+	}
+
+	printf("%u entries, %u calls\n", entries, calls);
+
+	start = SDL_GetPerformanceCounter();
+
+	for (j = 0; j < calls; j++)
+	{
+		for (i = 0; i < entries; i++)
+		{
+			sum += hash_get(table, (void*)(uintptr_t)(i * 7919)) != 0;
+		}
+	}
+
+	ticks = SDL_GetPerformanceCounter() - start;
+
+	printf("hash_get            %9.1f ns\n", get_ns(ticks, entries * calls));
+
+	start = SDL_GetPerformanceCounter();
+
+	for (j = 0; j < calls; j++)
+	{
+		for (i = 0; i < entries; i++)
+		{
+			sum += reference_hash_get(reference,
+				(void*)(uintptr_t)(i * 7919)) != 0;
+		}
+	}
+
+	ticks = SDL_GetPerformanceCounter() - start;
+
+	printf("reference_hash_get  %9.1f ns\n", get_ns(ticks, entries * calls));
+
+	destroy_hash_table(table);
+	reference_destroy_hash_table(reference);
+
+	for (i = 0; i < sizeof(buffer); i++)
+	{
+		buffer[i] = i * 31;
+	}
+
+	start = SDL_GetPerformanceCounter();
+
+	for (i = 0; i < 20000; i++)
+	{
+		sum += mem_hash(buffer, sizeof(buffer));
+	}
+
+	ticks = SDL_GetPerformanceCounter() - start;
+
+	printf("mem_hash            %9.2f GB/s\n",
+		sizeof(buffer) / get_ns(ticks, 20000));
+
+	start = SDL_GetPerformanceCounter();
+
+	for (i = 0; i < 20000; i++)
+	{
+		sum += reference_mem_hash(buffer, sizeof(buffer));
+	}
+
+	ticks = SDL_GetPerformanceCounter() - start;
+
+	printf("reference_mem_hash  %9.2f GB/s\n",
+		sizeof(buffer) / get_ns(ticks, 20000));
+
+	/* keep the calls */
+	return sum == 42;
+}
@@ -0,0 +1,186 @@
+/****************************************************************************
+ *            hash_reference.c
+ *
+ * The chained hash table of hash.c as it was before open addressing,
+ * kept unchanged as the reference of hash_test. The key compare
+ * functions are the ones of hash.c.
+ ****************************************************************************/
+
+#include "hash_reference.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+reference_hash_table *reference_create_hash_table(int size, 
+			     unsigned long int (*hashfn)(void *), 
+			     int (*keyfn)(void *, void*),
+			     void (*freefn)(void *)){
+	reference_hash_table *new_table;
+	
+	new_table=(reference_hash_table*)calloc(1,sizeof(reference_hash_table));
+	if(!new_table) return NULL;
+
+	new_table->store=(reference_hash_entry**)calloc(size,sizeof(reference_hash_entry*));
+	if(!new_table->store) { free(new_table); return NULL;}
+	
+	new_table->size=size;
+	new_table->items=0;
+	new_table->hash_fun=hashfn;
+	new_table->key_cmp=keyfn;
+	new_table->free_fun=freefn;
+
+	return new_table;
+}
+
+int reference_destroy_hash_table(reference_hash_table *table){
+	int i;
+	reference_hash_entry *he=NULL, *ht=NULL;
+
+	if(table){
+		if(table->store) {
+			if (table->free_fun)
+				for(i=0;i<table->size;i++){
+					he=table->store[i];
+					while(he){
+						ht=he->next;
+						table->free_fun(he->item);
+						free(he);
+						he=ht;
+					}
+				}
+			free(table->store);
+		}
+		free(table);
+		return 1;
+	}
+	return 0;
+}
+
+reference_hash_entry *reference_hash_get(reference_hash_table *table, void* key){
+	unsigned int pos;
+	reference_hash_entry *he=NULL;
+
+	if(!table||!table->hash_fun||!table->key_cmp) return NULL;
+	
+	pos=(table->hash_fun(key))%table->size;
+
+	he=table->store[pos];
+	while(he){
+		if(table->key_cmp(key,he->key)!=0) break;
+		he=he->next;
+	}
+	return he;
+}
+
+int reference_hash_add(reference_hash_table *table, void* key, void *item){
+	unsigned int pos;
+	reference_hash_entry *he=NULL;
+
+	if(!table||!table->hash_fun) return 0;
+	
+	pos=table->hash_fun(key)%table->size;
+	
+	he=(reference_hash_entry*)calloc(1,sizeof(reference_hash_entry));
+	if(!he) return 0;
+	he->key=key;
+	he->item=item;
+	he->next=table->store[pos];
+	table->store[pos]=he;
+	table->items++;
+	return 1;
+}
+
+int reference_hash_delete(reference_hash_table *table, void *key){
+
+	reference_hash_entry *he,*ht,*hp;
+	int del=0,pos;
+
+	if(!table||!table->hash_fun||!table->key_cmp) return del;
+	
+	pos=table->hash_fun(key)%table->size;
+	he=table->store[pos];
+	ht=NULL;
+	while(he){
+		hp=he->next;
+		if(table->key_cmp(key,he->key)!=0) {
+			if (ht) ht->next=he->next;
+			else table->store[pos]=he->next;
+			if (table->free_fun) 
+				table->free_fun(he->item);			
+			free(he);
+			del++;
+			table->items--;	
+		} else ht=he;
+		he=hp;
+	}
+	return del;
+}
+
+
+void reference_hash_start_iterator(reference_hash_table *table){ 
+	if(!table) return;
+	table->cur=table->store[0];
+	table->where=-1;
+}
+
+reference_hash_entry *reference_hash_get_next(reference_hash_table *table){
+
+	if(!table||table->where>=table->size) {
+		return NULL;
+	}
+
+	if(table->where==-1&&table->cur&&table->cur==table->store[0]) {
+		table->where++;
+		return table->store[0];
+	}
+
+	if(table->cur&&table->cur->next){
+			return (table->cur = table->cur->next);
+			}
+
+	table->cur=NULL;
+	table->where++;
+	while(table->where<table->size){
+		if(table->store[table->where]){
+			table->cur=table->store[table->where];
+			break;
+		}
+		table->where++;	  
+	}
+	return table->cur;
+}
+
+
+//HASH FNs
+unsigned long int reference_hash_fn_int(void *key){
+	return (unsigned long int)(uintptr_t) key;
+}
+unsigned long int reference_hash_fn_str(void *key)
+{
+	unsigned long int hash = 5381;
+	char c;
+	char *k=(char*)key;
+
+	while ( (c=*k++) )
+		hash = ((hash << 5) + hash) + c; /* hash * 33 + c */
+	hash--;
+
+	return hash;
+}
+
+Uint32 reference_mem_hash(const void* str, const Uint32 len)
+{
+	Uint32 hash, i;
+
+	hash = 2166136261u;
+
+	for (i = 0; i < len; i++)
+	{
+		hash = hash * 1607;
+		hash = hash ^ ((Uint8*)str)[i];
+	}
+
+	return hash;
+}
+
@@ -0,0 +1,48 @@
+/*
+ * The chained hash table of hash.c before open addressing, see
+ * hash_reference.c.
+ */
+#ifndef	HASH_REFERENCE_H
+#define	HASH_REFERENCE_H
+
+#include <SDL_types.h>
+
+typedef struct _reference_hash_entry{
+	void *key;
+	void *item;
+	struct _reference_hash_entry *next;
+} reference_hash_entry;
+
+typedef struct _reference_hash_table{
+	int size;
+	int items;
+	reference_hash_entry **store;
+
+	reference_hash_entry *cur;
+	int where;
+
+	unsigned long int (*hash_fun)(void *);
+	int (*key_cmp)(void *, void *);
+	void (*free_fun)(void *);
+} reference_hash_table;
+
+reference_hash_table *reference_create_hash_table(int size,
+			     unsigned long int (*hashfn)(void *),
+			     int (*keyfn)(void *, void*),
+			     void (*freefn)(void *)
+);
+
+int reference_destroy_hash_table(reference_hash_table *table);
+
+reference_hash_entry *reference_hash_get(reference_hash_table *table, void* key);
+int reference_hash_add(reference_hash_table *table, void* key, void *item);
+int reference_hash_delete(reference_hash_table *table, void *key);
+void reference_hash_start_iterator(reference_hash_table *table);
+reference_hash_entry *reference_hash_get_next(reference_hash_table *table);
+
+unsigned long int reference_hash_fn_int(void *key);
+unsigned long int reference_hash_fn_str(void *key);
+
+Uint32 reference_mem_hash(const void* str, const Uint32 len);
+
+#endif	/* HASH_REFERENCE_H */
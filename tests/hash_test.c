@@ -0,0 +1,280 @@
+/*
+ * Checks the open addressing hash table of hash.c against the chained
+ * table it replaced.
+ *
+ * Both tables get the same random sequences of hash_add(), hash_get(),
+ * hash_delete() and iterations, with few distinct keys, so most keys are
+ * added many times. Lookups must return the same entries, deletes the
+ * same counts, iterations the same sets of entries and both tables must
+ * free the same items.
+ *
+ * Usage: hash_test [rounds [seed]]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "hash.h"
+#include "hash_reference.h"
+
+#define MAX_ITEMS	65536
+#define STRING_KEYS	4096
+
+static Uint32 random_state = 1;
+static Uint64 freed_sum, reference_freed_sum;
+static char string_keys[STRING_KEYS][2][16];
+static Uint64 items[MAX_ITEMS], reference_items[MAX_ITEMS];
+
+static Uint32 get_random(void)
+{
+	random_state = random_state * 1103515245 + 12345;
+
+	return random_state >> 8;
+}
+
+static void free_item(void *item)
+{
+	freed_sum += (uintptr_t)item;
+}
+
+static void reference_free_item(void *item)
+{
+	reference_freed_sum += (uintptr_t)item;
+}
+
+static int compare_items(const void *a, const void *b)
+{
+	Uint64 x, y;
+
+	x = *((const Uint64*)a);
+	y = *((const Uint64*)b);
+
+	return (x > y) - (x < y);
+}
+
+/* the key is the same for both tables, only its address may differ */
+static Uint64 get_key_id(void *key, const Uint32 strings)
+{
+	if (strings != 0)
+	{
+		return strtoul(key, 0, 10);
+	}
+
+	return (uintptr_t)key;
+}
+
+static Uint32 check_iterator(hash_table *table,
+	reference_hash_table *reference, const Uint32 strings)
+{
+	hash_entry *entry;
+	reference_hash_entry *reference_entry;
+	Uint32 count, reference_count;
+
+	count = 0;
+	reference_count = 0;
+
+	hash_start_iterator(table);
+
+	while ((entry = hash_get_next(table)) != 0)
+	{
+		if (count < MAX_ITEMS)
+		{
+			items[count] = ((Uint64)(uintptr_t)entry->item << 32) |
+				get_key_id(entry->key, strings);
+		}
+
+		count++;
+	}
+
+	reference_hash_start_iterator(reference);
+
+	while ((reference_entry = reference_hash_get_next(reference)) != 0)
+	{
+		if (reference_count < MAX_ITEMS)
+		{
+			reference_items[reference_count] =
+				((Uint64)(uintptr_t)reference_entry->item << 32) |
+				get_key_id(reference_entry->key, strings);
+		}
+
+		reference_count++;
+	}
+
+	if ((count != reference_count) || (count != table->items) ||
+		(count > MAX_ITEMS))
+	{
+		printf("iterator: %u entries, expected %u\n", count,
+			reference_count);
+
+		return 1;
+	}
+
+	qsort(items, count, sizeof(Uint64), compare_items);
+	qsort(reference_items, count, sizeof(Uint64), compare_items);
+
+	if (memcmp(items, reference_items, count * sizeof(Uint64)) != 0)
+	{
+		printf("iterator: different entries\n");
+
+		return 1;
+	}
+
+	return 0;
+}
+
+static Uint32 check_round(const Uint32 round, const Uint32 strings)
+{
+	hash_table *table;
+	reference_hash_table *reference;
+	hash_entry *entry;
+	reference_hash_entry *reference_entry;
+	void *key, *reference_key;
+	Uint32 i, size, range, operations, operation, index, item, deleted;
+	Uint32 reference_deleted, errors;
+
+	size = 1 + get_random() % 64;
+	range = 1 + get_random() % (((get_random() & 1) != 0) ? 50 : 5000);
+	operations = get_random() % 20000;
+	item = 1;
+	errors = 0;
+
+	if (strings != 0)
+	{
+		range = 1 + range % STRING_KEYS;
+		table = create_hash_table(size, hash_fn_str, cmp_fn_str,
+			free_item);
+		reference = reference_create_hash_table(size,
+			reference_hash_fn_str, cmp_fn_str, reference_free_item);
+	}
+	else
+	{
+		table = create_hash_table(size, hash_fn_int, cmp_fn_int,
+			free_item);
+		reference = reference_create_hash_table(size,
+			reference_hash_fn_int, cmp_fn_int, reference_free_item);
+	}
+
+	freed_sum = 0;
+	reference_freed_sum = 0;
+
+	for (i = 0; (i < operations) && (errors == 0); i++)
+	{
+		operation = get_random() % 100;
+		index = get_random() % range;
+
+		/* equal strings at different addresses */
+		if (strings != 0)
+		{
+			key = string_keys[index][0];
+			reference_key = string_keys[index][1];
+		}
+		else
+		{
+			key = (void*)(uintptr_t)index;
+			reference_key = key;
+		}
+
+		if (operation < 45)
+		{
+			hash_add(table, key, (void*)(uintptr_t)item);
+			reference_hash_add(reference, reference_key,
+				(void*)(uintptr_t)item);
+			item++;
+		}
+		else if (operation < 65)
+		{
+			deleted = hash_delete(table, key);
+			reference_deleted = reference_hash_delete(reference,
+				reference_key);
+
+			if (deleted != reference_deleted)
+			{
+				printf("delete: %u entries, expected %u\n",
+					deleted, reference_deleted);
+				errors++;
+			}
+		}
+		else
+		{
+			entry = hash_get(table, key);
+			reference_entry = reference_hash_get(reference,
+				reference_key);
+
+			if ((entry == 0) != (reference_entry == 0))
+			{
+				printf("get: found %u, expected %u\n",
+					entry != 0, reference_entry != 0);
+				errors++;
+			}
+			else if ((entry != 0) && ((entry->item !=
+				reference_entry->item) ||
+				(get_key_id(entry->key, strings) !=
+				get_key_id(reference_entry->key, strings))))
+			{
+				printf("get: a different entry\n");
+				errors++;
+			}
+		}
+
+		if ((get_random() % 997) == 0)
+		{
+			errors += check_iterator(table, reference, strings);
+		}
+	}
+
+	if (errors == 0)
+	{
+		errors += check_iterator(table, reference, strings);
+	}
+
+	destroy_hash_table(table);
+	reference_destroy_hash_table(reference);
+
+	if (freed_sum != reference_freed_sum)
+	{
+		printf("destroy: freed different items\n");
+		errors++;
+	}
+
+	if (errors != 0)
+	{
+		printf("round %u (%s keys) failed\n", round,
+			(strings != 0) ? "string" : "int");
+	}
+
+	return errors;
+}
+
+int main(int argc, char *argv[])
+{
+	Uint32 i, rounds, errors;
+
+	rounds = 200;
+
+	if (argc > 1)
+	{
+		rounds = atoi(argv[1]);
+	}
+
+	if (argc > 2)
+	{
+		random_state = atoi(argv[2]);
+	}
+
+	for (i = 0; i < STRING_KEYS; i++)
+	{
+		snprintf(string_keys[i][0], sizeof(string_keys[i][0]), "%u", i);
+		snprintf(string_keys[i][1], sizeof(string_keys[i][1]), "%u", i);
+	}
+
+	errors = 0;
+
+	for (i = 0; i < rounds; i++)
+	{
+		errors += check_round(i, i & 1);
+	}
+
+	printf("%u rounds, %u errors\n", rounds, errors);
+
+	return errors != 0;
+}
@@ -0,0 +1,174 @@
+/*
+ * Times the image kernels of image.c with the scalar, SSE2 and AVX2 paths.
+ *
+ * image.c is included with SDL_HasSSE2() and SDL_HasAVX2() replaced, so
+ * each path can be forced, see image_test.c.
+ *
+ * Usage: image_bench [pixels [calls]]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SDL_HasSSE2 bench_has_sse2
+#define SDL_HasAVX2 bench_has_avx2
+#include "image.c"
+#include "el_memory.h"
+#undef SDL_HasSSE2
+#undef SDL_HasAVX2
+
+typedef enum
+{
+	level_scalar = 0,
+	level_sse2,
+	level_avx2,
+	level_count
+} simd_level;
+
+static const char *level_names[] =
+{
+	"scalar", "sse2", "avx2"
+};
+
+static simd_level level = level_avx2;
+
+/* the logging of the client is not linked */
+void log_debug_verbose(const char* file, const Uint32 line,
+	const char* message, ...)
+{
+}
+
+SDL_bool bench_has_sse2(void)
+{
+	return (level >= level_sse2) && __builtin_cpu_supports("sse2");
+}
+
+SDL_bool bench_has_avx2(void)
+{
+	return (level >= level_avx2) && __builtin_cpu_supports("avx2");
+}
+
+typedef enum
+{
+	kernel_rgba8 = 0,
+	kernel_r5g6b5,
+	kernel_rgba4,
+	kernel_blend,
+	kernel_replace_a8,
+	kernel_count
+} bench_kernel;
+
+static const char *kernel_names[] =
+{
+	"rgba8", "r5g6b5", "rgba4", "blend", "replace_a8"
+};
+
+static void run_kernel(const bench_kernel kernel, const Uint32 size,
+	const Uint8 *source, const Uint8 *source1, const Uint8 *alpha,
+	Uint8 *dest)
+{
+	switch (kernel)
+	{
+		case kernel_rgba8:
+			fast_unpack(source, size, 0x00FF0000, 0x0000FF00,
+				0x000000FF, 0xFF000000, dest);
+			break;
+		case kernel_r5g6b5:
+			fast_unpack(source, size, 0x0000F800, 0x000007E0,
+				0x0000001F, 0x00000000, dest);
+			break;
+		case kernel_rgba4:
+			fast_unpack(source, size, 0x00000F00, 0x000000F0,
+				0x0000000F, 0x0000F000, dest);
+			break;
+		case kernel_blend:
+			fast_blend(alpha, size, source, source1, dest);
+			break;
+		case kernel_replace_a8:
+			fast_replace_a8_rgba8(alpha, size, dest);
+			break;
+		default:
+			break;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	Uint8 *source, *source1, *alpha, *dest;
+	Uint64 start, ticks;
+	Uint32 i, size, calls;
+	int kernel;
+	double ms;
+
+	size = 512 * 512;
+	calls = 200;
+
+	if (argc > 1)
+	{
+		size = (atoi(argv[1]) + 15) & ~15;
+	}
+
+	if (argc > 2)
+	{
+		calls = atoi(argv[2]);
+	}
+
+	source = malloc_aligned(size * 4, 16);
+	source1 = malloc_aligned(size * 4, 16);
+	alpha = malloc_aligned(size, 16);
+	dest = malloc_aligned(size * 4, 16);
+
+	for (i = 0; i < (size * 4); i++)
+	{
+		source[i] = rand();
+		source1[i] = rand();
+	}
+
+	for (i = 0; i < size; i++)
+	{
+		alpha[i] = rand();
+	}
+
+	printf("%u pixels, %u calls\n", size, calls);
+
+	for (kernel = 0; kernel < kernel_count; kernel++)
+	{
+		printf("%-11s", kernel_names[kernel]);
+
+		for (level = level_scalar; level < level_count; level++)
+		{
+			/* unpack() can't handle formats without a channel */
+			if (((level == level_scalar) && (kernel == kernel_r5g6b5)) ||
+				((level == level_avx2) &&
+				!__builtin_cpu_supports("avx2")))
+			{
+				printf(" %8s %9s", level_names[level], "-");
+				continue;
+			}
+
+			run_kernel(kernel, size, source, source1, alpha, dest);
+
+			start = SDL_GetPerformanceCounter();
+
+			for (i = 0; i < calls; i++)
+			{
+				run_kernel(kernel, size, source, source1,
+					alpha, dest);
+			}
+
+			ticks = SDL_GetPerformanceCounter() - start;
+			ms = 1000.0 * ticks / SDL_GetPerformanceFrequency() / calls;
+
+			printf(" %8s %6.3f ms", level_names[level], ms);
+		}
+
+		printf("\n");
+	}
+
+	free_aligned(source);
+	free_aligned(source1);
+	free_aligned(alpha);
+	free_aligned(dest);
+
+	return 0;
+}
@@ -0,0 +1,370 @@
+/*
+ * Checks the SSE2 and AVX2 image kernels of image.c against a scalar
+ * reference.
+ *
+ * image.c is included with SDL_HasSSE2() and SDL_HasAVX2() replaced, so
+ * each path can be forced on any CPU that has it. The AVX2 kernels must
+ * give the same bytes as the SSE2 ones, both may differ from the exact
+ * scalar results by one, as the SSE2 kernels always did.
+ *
+ * Usage: image_test [pixels]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SDL_HasSSE2 test_has_sse2
+#define SDL_HasAVX2 test_has_avx2
+#include "image.c"
+#include "el_memory.h"
+#undef SDL_HasSSE2
+#undef SDL_HasAVX2
+
+typedef enum
+{
+	level_scalar = 0,
+	level_sse2,
+	level_avx2,
+	level_count
+} simd_level;
+
+static const char *level_names[] =
+{
+	"scalar", "sse2", "avx2"
+};
+
+typedef struct
+{
+	const char *name;
+	Uint32 masks[4];
+	Uint32 bpp;
+} pixel_format;
+
+static const pixel_format formats[] =
+{
+	{ "l8", { 0x000000FF, 0x000000FF, 0x000000FF, 0x00000000 }, 1 },
+	{ "a8", { 0x00000000, 0x00000000, 0x00000000, 0x000000FF }, 1 },
+	{ "la8", { 0x000000FF, 0x000000FF, 0x000000FF, 0x0000FF00 }, 2 },
+	{ "rgba8", { 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000 }, 4 },
+	{ "r5g6b5", { 0x0000F800, 0x000007E0, 0x0000001F, 0x00000000 }, 2 },
+	{ "rgb5a1", { 0x00007C00, 0x000003E0, 0x0000001F, 0x00008000 }, 2 },
+	{ "rgba4", { 0x00000F00, 0x000000F0, 0x0000000F, 0x0000F000 }, 2 }
+};
+
+static simd_level level = level_avx2;
+
+/* the logging of the client is not linked */
+void log_debug_verbose(const char* file, const Uint32 line,
+	const char* message, ...)
+{
+}
+
+SDL_bool test_has_sse2(void)
+{
+	return (level >= level_sse2) && __builtin_cpu_supports("sse2");
+}
+
+SDL_bool test_has_avx2(void)
+{
+	return (level >= level_avx2) && __builtin_cpu_supports("avx2");
+}
+
+static Uint32 random_state = 1;
+
+static Uint32 get_random(void)
+{
+	random_state = random_state * 1103515245 + 12345;
+
+	return random_state >> 8;
+}
+
+static Uint8 expand(const Uint32 pixel, const Uint32 mask, const Uint8 none)
+{
+	Uint32 shift;
+
+	if (mask == 0)
+	{
+		return none;
+	}
+
+	shift = 0;
+
+	while ((mask & (1 << shift)) == 0)
+	{
+		shift++;
+	}
+
+	return ((pixel & mask) >> shift) * 255 / (mask >> shift);
+}
+
+static void reference_unpack(const pixel_format *format, const Uint8 *source,
+	const Uint32 size, Uint8 *dest)
+{
+	Uint32 i, pixel;
+
+	for (i = 0; i < size; i++)
+	{
+		pixel = 0;
+		memcpy(&pixel, source + i * format->bpp, format->bpp);
+
+		dest[i * 4 + 0] = expand(pixel, format->masks[0], 0);
+		dest[i * 4 + 1] = expand(pixel, format->masks[1], 0);
+		dest[i * 4 + 2] = expand(pixel, format->masks[2], 0);
+		dest[i * 4 + 3] = expand(pixel, format->masks[3], 255);
+	}
+}
+
+static void reference_blend(const Uint8 *alpha, const Uint32 size,
+	const Uint8 *source0, const Uint8 *source1, Uint8 *dest)
+{
+	Uint32 i, j;
+
+	for (i = 0; i < size * 4; i++)
+	{
+		j = i / 4;
+		dest[i] = (source1[i] * alpha[j] + source0[i] * (255 - alpha[j])) / 255;
+	}
+}
+
+/* the kernels that are checked, the unpacks first */
+#define KERNEL_BLEND		(sizeof(formats) / sizeof(formats[0]))
+#define KERNEL_REPLACE_A8	(KERNEL_BLEND + 1)
+#define KERNEL_REPLACE_ALPHA	(KERNEL_BLEND + 2)
+#define KERNEL_COUNT		(KERNEL_BLEND + 3)
+#define REPLACE_ALPHA		0x5A
+
+typedef struct
+{
+	Uint8 *source;
+	Uint8 *source1;
+	Uint8 *alpha;
+	Uint8 *expected;
+	Uint8 *dest;
+	Uint8 *sse2;
+} test_buffers;
+
+static const char *get_kernel_name(const Uint32 kernel)
+{
+	switch (kernel)
+	{
+		case KERNEL_BLEND:
+			return "blend";
+		case KERNEL_REPLACE_A8:
+			return "replace_a8";
+		case KERNEL_REPLACE_ALPHA:
+			return "replace_alpha";
+		default:
+			return formats[kernel].name;
+	}
+}
+
+static void run_reference(const Uint32 kernel, const test_buffers *buffers,
+	const Uint32 offset, const Uint32 size)
+{
+	Uint32 i;
+
+	switch (kernel)
+	{
+		case KERNEL_BLEND:
+			reference_blend(buffers->alpha + offset, size,
+				buffers->source + offset,
+				buffers->source1 + offset, buffers->expected);
+			break;
+		case KERNEL_REPLACE_A8:
+		case KERNEL_REPLACE_ALPHA:
+			memcpy(buffers->expected, buffers->source + offset,
+				size * 4);
+			for (i = 0; i < size; i++)
+			{
+				buffers->expected[i * 4 + 3] =
+					(kernel == KERNEL_REPLACE_A8) ?
+					buffers->alpha[offset + i] : REPLACE_ALPHA;
+			}
+			break;
+		default:
+			reference_unpack(&formats[kernel],
+				buffers->source + offset, size,
+				buffers->expected);
+			break;
+	}
+}
+
+static void run_kernel(const Uint32 kernel, const test_buffers *buffers,
+	const Uint32 offset, const Uint32 size)
+{
+	Uint8 *dest;
+
+	dest = buffers->dest + offset;
+
+	switch (kernel)
+	{
+		case KERNEL_BLEND:
+			fast_blend(buffers->alpha + offset, size,
+				buffers->source + offset,
+				buffers->source1 + offset, dest);
+			break;
+		case KERNEL_REPLACE_A8:
+			memcpy(dest, buffers->source + offset, size * 4);
+			fast_replace_a8_rgba8(buffers->alpha + offset, size,
+				dest);
+			break;
+		case KERNEL_REPLACE_ALPHA:
+			memcpy(dest, buffers->source + offset, size * 4);
+			fast_replace_alpha_rgba8(REPLACE_ALPHA, size, dest);
+			break;
+		default:
+			fast_unpack(buffers->source + offset, size,
+				formats[kernel].masks[0],
+				formats[kernel].masks[1],
+				formats[kernel].masks[2],
+				formats[kernel].masks[3], dest);
+			break;
+	}
+}
+
+/* if the level runs its own kernel, the fallback of each level is the
+ * one below */
+static Uint32 has_kernel(const Uint32 kernel, const simd_level test_level,
+	const Uint32 offset, const Uint32 size)
+{
+	switch (test_level)
+	{
+		case level_avx2:
+			return __builtin_cpu_supports("avx2") &&
+				((size & 0x07) == 0);
+		case level_sse2:
+			if (kernel >= KERNEL_BLEND)
+			{
+				return (offset == 0) && ((size & 0x03) == 0);
+			}
+			return (offset == 0) && ((size & 0x0F) == 0);
+		default:
+			/* unpack() can't handle formats without a channel */
+			return kernel >= KERNEL_BLEND;
+	}
+}
+
+static Uint32 check(const test_buffers *buffers, const Uint32 offset,
+	const Uint32 size)
+{
+	Uint32 kernel, i, difference, largest, errors, have_sse2;
+
+	errors = 0;
+
+	for (kernel = 0; kernel < KERNEL_COUNT; kernel++)
+	{
+		run_reference(kernel, buffers, offset, size);
+
+		printf("%-14s offset %u, %6u pixels:", get_kernel_name(kernel),
+			offset, size);
+
+		have_sse2 = 0;
+
+		for (level = level_scalar; level < level_count; level++)
+		{
+			if (!has_kernel(kernel, level, offset, size))
+			{
+				printf(" %s -", level_names[level]);
+				continue;
+			}
+
+			memset(buffers->dest + offset, 0, size * 4);
+			run_kernel(kernel, buffers, offset, size);
+
+			largest = 0;
+
+			for (i = 0; i < (size * 4); i++)
+			{
+				difference = abs(buffers->dest[offset + i] -
+					buffers->expected[i]);
+				if (difference > largest)
+				{
+					largest = difference;
+				}
+			}
+
+			printf(" %s %u", level_names[level], largest);
+
+			/* only the unpacks and the blend round */
+			if ((largest > 1) || ((largest > 0) &&
+				(kernel >= KERNEL_REPLACE_A8)))
+			{
+				errors++;
+			}
+
+			if (level == level_sse2)
+			{
+				memcpy(buffers->sse2, buffers->dest + offset,
+					size * 4);
+				have_sse2 = 1;
+			}
+
+			if ((level == level_avx2) && have_sse2 &&
+				(memcmp(buffers->sse2, buffers->dest + offset,
+					size * 4) != 0))
+			{
+				printf(" (differs from sse2)");
+				errors++;
+			}
+		}
+
+		printf("\n");
+	}
+
+	return errors;
+}
+
+int main(int argc, char *argv[])
+{
+	test_buffers buffers;
+	Uint32 i, size, errors;
+
+	size = 1 << 16;
+
+	if (argc > 1)
+	{
+		size = (atoi(argv[1]) + 15) & ~15;
+	}
+
+	if (!__builtin_cpu_supports("avx2"))
+	{
+		printf("The CPU has no AVX2, only the SSE2 kernels are checked.\n");
+	}
+
+	/* the unaligned runs start one byte later */
+	buffers.source = malloc_aligned(size * 4 + 1, 16);
+	buffers.source1 = malloc_aligned(size * 4 + 1, 16);
+	buffers.alpha = malloc_aligned(size + 1, 16);
+	buffers.expected = malloc_aligned(size * 4, 16);
+	buffers.dest = malloc_aligned(size * 4 + 1, 16);
+	buffers.sse2 = malloc_aligned(size * 4, 16);
+
+	for (i = 0; i < (size * 4 + 1); i++)
+	{
+		buffers.source[i] = get_random();
+		buffers.source1[i] = get_random();
+	}
+
+	for (i = 0; i < (size + 1); i++)
+	{
+		buffers.alpha[i] = get_random();
+	}
+
+	/* both vector paths, the AVX2 path alone, the unaligned AVX2 path
+	 * and the scalar path */
+	errors = check(&buffers, 0, size);
+	errors += check(&buffers, 0, size - 8);
+	errors += check(&buffers, 1, size);
+	errors += check(&buffers, 0, size - 13);
+
+	free_aligned(buffers.source);
+	free_aligned(buffers.source1);
+	free_aligned(buffers.alpha);
+	free_aligned(buffers.expected);
+	free_aligned(buffers.dest);
+	free_aligned(buffers.sse2);
+
+	printf("%u errors\n", errors);
+
+	return errors != 0;
+}
@@ -0,0 +1,268 @@
+/*
+ * Stress test of the message ring of message_ring.c.
+ *
+ * A producer thread receives a stream of framed messages into a small
+ * ring, in random chunks like the network thread, and the main thread
+ * checks every message in order. The messages are mostly small, but some
+ * are close to the maximum size, so the ring wraps and overflows often.
+ * Both sides stall now and then, so the ring fills up and the overflow
+ * queue is used, then drains and the ring is used again.
+ * If the consumer makes no progress for a few seconds, the test fails.
+ *
+ * Usage: ring_test [messages [ring size]]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL_thread.h>
+#include <SDL_timer.h>
+#include "message_ring.h"
+
+static message_ring_t *ring;
+static Uint32 message_count = 500000;
+static SDL_atomic_t checked;
+static SDL_atomic_t done;
+
+/* the logging of the client is not linked */
+void log_error(const char* file, const Uint32 line, const char* message, ...)
+{
+}
+
+static Uint32 get_random(Uint32 *state)
+{
+	*state = *state * 1103515245 + 12345;
+
+	return *state >> 8;
+}
+
+/* the size of a message, including the three header bytes */
+static Uint32 get_message_size(const Uint32 index)
+{
+	Uint32 value;
+
+	value = index * 2654435761u;
+	value ^= value >> 13;
+
+	if ((value % 97) == 0)
+	{
+		return 3 + (value >> 3) % (MESSAGE_RING_MAX_MESSAGE - 3);
+	}
+
+	return 3 + (value >> 3) % 60;
+}
+
+static Uint8 get_message_byte(const Uint32 index, const Uint32 offset)
+{
+	return index * 31 + offset * 7;
+}
+
+static int producer_thread(void *data)
+{
+	static Uint8 message[MESSAGE_RING_MAX_MESSAGE];
+	Uint8 *buffer;
+	Uint32 index, offset, size, space, count, pending, length, i;
+	Uint32 random_state;
+
+	index = 0;
+	offset = 0;
+	size = 0;
+	random_state = 1;
+
+	while (SDL_AtomicGet(&done) == 0)
+	{
+		if (offset == size)
+		{
+			if (index == message_count)
+			{
+				break;
+			}
+
+			size = get_message_size(index);
+			message[0] = index;
+			message[1] = (size - 2) & 0xFF;
+			message[2] = (size - 2) >> 8;
+
+			for (i = 3; i < size; i++)
+			{
+				message[i] = get_message_byte(index, i);
+			}
+
+			offset = 0;
+			index++;
+		}
+
+		/* let the consumer catch up, so the ring is used again */
+		if ((get_random(&random_state) % 500) == 0)
+		{
+			SDL_Delay(1);
+		}
+
+		buffer = message_ring_get_space(ring, &space);
+
+		if (space == 0)
+		{
+			continue;
+		}
+
+		/* receives never line up with the messages */
+		count = 1 + get_random(&random_state) % 3000;
+
+		if (count > (size - offset))
+		{
+			count = size - offset;
+		}
+
+		if (count > space)
+		{
+			count = space;
+		}
+
+		memcpy(buffer, message + offset, count);
+		offset += count;
+
+		message_ring_received(ring, count);
+
+		while (((buffer = message_ring_get_pending(ring, &pending)) != 0) &&
+			(pending >= 3))
+		{
+			length = (buffer[1] | (buffer[2] << 8)) + 2;
+
+			if (length > pending)
+			{
+				break;
+			}
+
+			message_ring_commit(ring, length);
+		}
+	}
+
+	return 0;
+}
+
+static int watchdog_thread(void *data)
+{
+	Sint32 last;
+	Uint32 i;
+
+	last = -1;
+
+	while (SDL_AtomicGet(&done) == 0)
+	{
+		for (i = 0; (i < 30) && (SDL_AtomicGet(&done) == 0); i++)
+		{
+			SDL_Delay(100);
+		}
+
+		if ((SDL_AtomicGet(&done) == 0) &&
+			(SDL_AtomicGet(&checked) == last))
+		{
+			printf("no progress after %d messages\n", last);
+			fflush(stdout);
+
+			exit(2);
+		}
+
+		last = SDL_AtomicGet(&checked);
+	}
+
+	return 0;
+}
+
+static Uint32 check_message(const Uint32 index, const Uint8 *message,
+	const Uint32 length)
+{
+	Uint32 i;
+
+	if ((length != get_message_size(index)) ||
+		(message[0] != (Uint8)index))
+	{
+		printf("message %u: length %u, expected %u\n", index, length,
+			get_message_size(index));
+
+		return 1;
+	}
+
+	for (i = 3; i < length; i++)
+	{
+		if (message[i] != get_message_byte(index, i))
+		{
+			printf("message %u: wrong byte %u\n", index, i);
+
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	const Uint8 *messages[MESSAGE_RING_MAX_BATCH];
+	Uint32 lengths[MESSAGE_RING_MAX_BATCH];
+	message_ring_stats_t stats;
+	SDL_Thread *producer, *watchdog;
+	Uint32 index, count, i, size, random_state, errors;
+
+	size = 64 * 1024;
+	random_state = 7;
+	errors = 0;
+
+	if (argc > 1)
+	{
+		message_count = atoi(argv[1]);
+	}
+
+	if (argc > 2)
+	{
+		size = atoi(argv[2]);
+	}
+
+	if (message_ring_initialise(&ring, size) == 0)
+	{
+		return 1;
+	}
+
+	SDL_AtomicSet(&checked, 0);
+	SDL_AtomicSet(&done, 0);
+
+	producer = SDL_CreateThread(producer_thread, "producer", 0);
+	watchdog = SDL_CreateThread(watchdog_thread, "watchdog", 0);
+
+	index = 0;
+
+	while ((index < message_count) && (errors == 0))
+	{
+		count = message_ring_peek_batch(ring, messages, lengths,
+			MESSAGE_RING_MAX_BATCH);
+
+		for (i = 0; (i < count) && (errors == 0); i++)
+		{
+			errors += check_message(index, messages[i], lengths[i]);
+			index++;
+		}
+
+		/* let the ring fill up, so it overflows */
+		if ((get_random(&random_state) % 20000) == 0)
+		{
+			SDL_Delay(5);
+		}
+
+		message_ring_pop_batch(ring);
+
+		SDL_AtomicSet(&checked, index);
+	}
+
+	SDL_AtomicSet(&done, 1);
+	SDL_WaitThread(producer, 0);
+	SDL_WaitThread(watchdog, 0);
+
+	message_ring_get_stats(ring, &stats);
+
+	printf("%u messages, %u wraps, %u full, %u overflows, %u errors\n",
+		index, (Uint32)stats.wraps, (Uint32)stats.full,
+		(Uint32)stats.overflows, errors);
+
+	message_ring_destroy(ring);
+
+	return errors != 0;
+}
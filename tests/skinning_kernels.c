@@ -0,0 +1,23 @@
+/*
+ * skinning.c with SDL_HasSSE2() and SDL_HasAVX2() replaced, so
+ * skinning_test can force each path on any CPU that has it, see
+ * image_test.c.
+ */
+#define SDL_HasSSE2 test_has_sse2
+#define SDL_HasAVX2 test_has_avx2
+#include "skinning.c"
+#undef SDL_HasSSE2
+#undef SDL_HasAVX2
+
+/* 0 for the scalar code, 1 for SSE2, 2 for AVX2 */
+int skinning_level = 2;
+
+SDL_bool test_has_sse2(void)
+{
+	return (skinning_level >= 1) && __builtin_cpu_supports("sse2");
+}
+
+SDL_bool test_has_avx2(void)
+{
+	return (skinning_level >= 2) && __builtin_cpu_supports("avx2");
+}
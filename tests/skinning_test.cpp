@@ -0,0 +1,383 @@
+/*
+ * Checks the scalar, SSE2 and AVX2 skinning of skinning.c against
+ * CalPhysique.
+ *
+ * The fixture model is built in memory: a tree of bones and one submesh
+ * with vertices of zero to four influences, a vertex count that leaves a
+ * tail for the scalar code. For each random pose the bone matrices are
+ * taken from the skeleton like skin_model() in actor_init.cpp does, and
+ * the skinned vertices and normals must match calculateVertices() and
+ * calculateNormals() up to rounding. Skinning a part of the submesh must
+ * not touch the vertices outside of it.
+ *
+ * Needs cal3d, so it is only built if cal3d is found.
+ *
+ * Usage: skinning_test [poses]
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <SDL.h>
+#include <cal3d/cal3d.h>
+#include "skinning.h"
+
+#define BONE_COUNT	24
+#define VERTEX_COUNT	1021
+#define MAX_INFLUENCES	4
+#define TOLERANCE	1e-4f
+#define UNTOUCHED	12345.0f
+
+extern "C" int skinning_level;
+
+static const char* level_names[] =
+{
+	"scalar", "sse2", "avx2"
+};
+
+static Uint32 random_state = 1;
+
+static Uint32 get_random()
+{
+	random_state = random_state * 1103515245 + 12345;
+
+	return random_state >> 8;
+}
+
+/* a value in [-1, 1] */
+static float get_random_float()
+{
+	return (get_random() % 65536) / 32768.0f - 1.0f;
+}
+
+static CalQuaternion get_random_rotation()
+{
+	float x, y, z, w, scale;
+
+	do
+	{
+		x = get_random_float();
+		y = get_random_float();
+		z = get_random_float();
+		w = get_random_float();
+	}
+	while ((x * x + y * y + z * z + w * w) < 0.01f);
+
+	scale = 1.0f / std::sqrt(x * x + y * y + z * z + w * w);
+
+	return CalQuaternion(x * scale, y * scale, z * scale, w * scale);
+}
+
+static CalVector get_random_vector()
+{
+	return CalVector(get_random_float(), get_random_float(),
+		get_random_float());
+}
+
+static CalVector get_random_normal()
+{
+	CalVector normal;
+
+	do
+	{
+		normal = get_random_vector();
+	}
+	while (normal.length() < 0.1f);
+
+	normal.normalize();
+
+	return normal;
+}
+
+static CalCoreSkeleton* build_core_skeleton()
+{
+	CalCoreSkeleton* core_skeleton;
+	CalCoreBone* core_bone;
+	Uint32 i;
+	int parent_id;
+
+	core_skeleton = new CalCoreSkeleton();
+
+	// a binary tree, the parents come before their children
+	for (i = 0; i < BONE_COUNT; i++)
+	{
+		core_bone = new CalCoreBone("bone");
+		parent_id = (i > 0) ? (i - 1) / 2 : -1;
+
+		core_bone->setCoreSkeleton(core_skeleton);
+		core_bone->setParentId(parent_id);
+		core_bone->setTranslation(get_random_vector());
+		core_bone->setRotation(get_random_rotation());
+		core_bone->setTranslationBoneSpace(get_random_vector());
+		core_bone->setRotationBoneSpace(get_random_rotation());
+
+		core_skeleton->addCoreBone(core_bone);
+
+		if (parent_id >= 0)
+		{
+			core_skeleton->getCoreBone(parent_id)->addChildId(i);
+		}
+	}
+
+	core_skeleton->calculateState();
+
+	return core_skeleton;
+}
+
+static CalCoreMesh* build_core_mesh()
+{
+	CalCoreMesh* core_mesh;
+	CalCoreSubmesh* core_submesh;
+	CalCoreSubmesh::Vertex vertex;
+	CalCoreSubmesh::Influence influence;
+	float sum;
+	Uint32 i, j, count;
+
+	core_submesh = new CalCoreSubmesh();
+	core_submesh->reserve(VERTEX_COUNT, 0, 0, 0);
+
+	for (i = 0; i < VERTEX_COUNT; i++)
+	{
+		vertex.position = get_random_vector() * 2.0f;
+		vertex.normal = get_random_normal();
+		vertex.collapseId = -1;
+		vertex.faceCollapseCount = 0;
+		vertex.vectorInfluence.clear();
+
+		count = get_random() % (MAX_INFLUENCES + 1);
+		sum = 0.0f;
+
+		for (j = 0; j < count; j++)
+		{
+			influence.boneId = get_random() % BONE_COUNT;
+			influence.weight = 0.05f + (get_random() % 1000) / 1000.0f;
+			sum += influence.weight;
+
+			vertex.vectorInfluence.push_back(influence);
+		}
+
+		for (j = 0; j < count; j++)
+		{
+			vertex.vectorInfluence[j].weight /= sum;
+		}
+
+		core_submesh->setVertex(i, vertex);
+	}
+
+	core_mesh = new CalCoreMesh();
+	core_mesh->addCoreSubmesh(core_submesh);
+
+	return core_mesh;
+}
+
+/* like build_skinning_data() in actor_init.cpp */
+static skinning_data_t* build_skinning_data(CalCoreSubmesh* core_submesh)
+{
+	skinning_data_t* data;
+	Uint32 i, j, count;
+
+	const std::vector<CalCoreSubmesh::Vertex> &vertices =
+		core_submesh->getVectorVertex();
+
+	count = vertices.size();
+
+	data = skinning_data_new(count, MAX_INFLUENCES);
+
+	for (i = 0; i < count; i++)
+	{
+		const CalCoreSubmesh::Vertex &vertex = vertices[i];
+
+		data->positions[i] = vertex.position.x;
+		data->positions[count + i] = vertex.position.y;
+		data->positions[2 * count + i] = vertex.position.z;
+		data->normals[i] = vertex.normal.x;
+		data->normals[count + i] = vertex.normal.y;
+		data->normals[2 * count + i] = vertex.normal.z;
+
+		if (vertex.vectorInfluence.size() == 0)
+		{
+			data->weights[i] = 1.0f;
+			data->offsets[i] = 0;
+			continue;
+		}
+
+		for (j = 0; j < vertex.vectorInfluence.size(); j++)
+		{
+			data->weights[j * count + i] =
+				vertex.vectorInfluence[j].weight;
+			data->offsets[j * count + i] =
+				(vertex.vectorInfluence[j].boneId + 1) *
+				SKINNING_MATRIX_SIZE;
+		}
+	}
+
+	return data;
+}
+
+static void set_random_pose(CalSkeleton* skeleton)
+{
+	const std::vector<CalBone*> &vector_bone = skeleton->getVectorBone();
+	Uint32 i;
+
+	skeleton->clearState();
+
+	for (i = 0; i < vector_bone.size(); i++)
+	{
+		vector_bone[i]->blendState(1.0f, get_random_vector(),
+			get_random_rotation());
+	}
+
+	skeleton->lockState();
+	skeleton->calculateState();
+}
+
+/* like skin_model() in actor_init.cpp */
+static void get_bones(CalSkeleton* skeleton, std::vector<float> &bones)
+{
+	const std::vector<CalBone*> &vector_bone = skeleton->getVectorBone();
+	float* matrix;
+	Uint32 i;
+
+	bones.assign((vector_bone.size() + 1) * SKINNING_MATRIX_SIZE, 0.0f);
+	bones[0] = 1.0f;
+	bones[5] = 1.0f;
+	bones[10] = 1.0f;
+
+	for (i = 0; i < vector_bone.size(); i++)
+	{
+		const CalMatrix &rotation = vector_bone[i]->getTransformMatrix();
+		const CalVector &translation = vector_bone[i]->getTranslationBoneSpace();
+
+		matrix = &bones[(i + 1) * SKINNING_MATRIX_SIZE];
+
+		matrix[0] = rotation.dxdx;
+		matrix[1] = rotation.dxdy;
+		matrix[2] = rotation.dxdz;
+		matrix[3] = translation.x;
+		matrix[4] = rotation.dydx;
+		matrix[5] = rotation.dydy;
+		matrix[6] = rotation.dydz;
+		matrix[7] = translation.y;
+		matrix[8] = rotation.dzdx;
+		matrix[9] = rotation.dzdy;
+		matrix[10] = rotation.dzdz;
+		matrix[11] = translation.z;
+	}
+}
+
+static Uint32 check_range(const skinning_data_t* data,
+	const std::vector<float> &bones, const Uint32 start, const Uint32 end,
+	const std::vector<float> &expected_vertices,
+	const std::vector<float> &expected_normals, float* max_error)
+{
+	std::vector<float> vertices, normals;
+	float error;
+	Uint32 i, errors;
+
+	vertices.assign(VERTEX_COUNT * 3, UNTOUCHED);
+	normals.assign(VERTEX_COUNT * 3, UNTOUCHED);
+
+	skin_vertices(data, &bones[0], start, end, &vertices[0], &normals[0]);
+
+	errors = 0;
+
+	for (i = 0; i < VERTEX_COUNT * 3; i++)
+	{
+		if ((i < (start * 3)) || (i >= (end * 3)))
+		{
+			if ((vertices[i] != UNTOUCHED) || (normals[i] != UNTOUCHED))
+			{
+				errors++;
+			}
+
+			continue;
+		}
+
+		error = std::max(std::fabs(vertices[i] - expected_vertices[i]),
+			std::fabs(normals[i] - expected_normals[i]));
+
+		*max_error = std::max(*max_error, error);
+
+		if (!(error <= TOLERANCE))
+		{
+			errors++;
+		}
+	}
+
+	return errors;
+}
+
+int main(int argc, char* argv[])
+{
+	CalCoreModel* core_model;
+	CalModel* model;
+	CalSubmesh* submesh;
+	skinning_data_t* data;
+	std::vector<float> bones, vertices, normals;
+	float max_error;
+	Uint32 i, poses, errors, start, end;
+	int mesh_id;
+
+	poses = 100;
+
+	if (argc > 1)
+	{
+		poses = atoi(argv[1]);
+	}
+
+	core_model = new CalCoreModel("skinning_test");
+	core_model->setCoreSkeleton(build_core_skeleton());
+	mesh_id = core_model->addCoreMesh(build_core_mesh());
+
+	model = new CalModel(core_model);
+	model->attachMesh(mesh_id);
+
+	submesh = model->getMesh(mesh_id)->getSubmesh(0);
+	data = build_skinning_data(core_model->getCoreMesh(mesh_id)->getCoreSubmesh(0));
+
+	vertices.resize(VERTEX_COUNT * 3);
+	normals.resize(VERTEX_COUNT * 3);
+
+	if (!__builtin_cpu_supports("avx2"))
+	{
+		printf("The CPU has no AVX2, only the SSE2 and scalar code is checked.\n");
+	}
+
+	errors = 0;
+
+	for (skinning_level = 0; skinning_level < 3; skinning_level++)
+	{
+		max_error = 0.0f;
+		random_state = 7;
+
+		for (i = 0; i < poses; i++)
+		{
+			set_random_pose(model->getSkeleton());
+			get_bones(model->getSkeleton(), bones);
+
+			model->getPhysique()->calculateVertices(submesh, &vertices[0]);
+			model->getPhysique()->calculateNormals(submesh, &normals[0]);
+
+			errors += check_range(data, bones, 0, VERTEX_COUNT, vertices,
+				normals, &max_error);
+
+			start = get_random() % VERTEX_COUNT;
+			end = start + get_random() % (VERTEX_COUNT - start + 1);
+
+			errors += check_range(data, bones, start, end, vertices,
+				normals, &max_error);
+		}
+
+		printf("%s: max. difference %g\n", level_names[skinning_level],
+			max_error);
+	}
+
+	skinning_data_free(data);
+	delete model;
+	delete core_model;
+
+	printf("%u errors\n", errors);
+
+	return errors != 0;
+}
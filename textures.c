@@ -15,6 +15,10 @@
 #include "el_memory.h"
 #include <assert.h>
 #include "hash.h"
+#include "io/elpathwrapper.h"
+#include "io/elfilewrapper.h"
+#include "xz/7zCrc.h"
+#include <SDL_cpuinfo.h>
 
 #define TEXTURE_SIZE_X 512
 #define TEXTURE_SIZE_Y 512
@@ -22,17 +26,85 @@
 
 #ifdef	ELC
 #define ACTOR_TEXTURE_CACHE_MAX 256
-#define ACTOR_TEXTURE_THREAD_COUNT 2
+#define ACTOR_TEXTURE_THREAD_COUNT 8
+#define ACTOR_IMAGE_CACHE_MAX 32
+#define ACTOR_IMAGE_CACHE_MAGIC 0x54434145	// "EACT"
+#define ACTOR_IMAGE_CACHE_VERSION 2
+
+/*!
+ * cache of composed actor images, shared by all actor texture threads.
+ */
+typedef struct
+{
+	enhanced_actor_images_t files;	/*!< the files used for the image */
+	image_t image;			/*!< the composed image */
+	Uint32 hash;			/*!< hash value of the files */
+	Uint32 options;			/*!< the options used to compose the image */
+	Uint32 access_time;		/*!< last time used */
+} actor_image_cache_t;
+
+/*!
+ * header of the composed actor images in the disk cache.
+ */
+typedef struct
+{
+	Uint32 magic;
+	Uint32 version;
+	Uint32 options;
+	Uint32 width;
+	Uint32 height;
+	Uint32 format;
+	Uint32 alpha;
+	Uint32 size;
+	Uint32 sources;		/*!< checksum of the source images */
+} actor_image_file_header_t;
+
+/*!
+ * checksum of a source image of the actor images, computed once per file.
+ */
+typedef struct
+{
+	char name[128];		/*!< the file name found by check_image_name() */
+	Uint32 crc;		/*!< checksum of the file, zero if it can't be opened */
+} actor_image_source_t;
+
+/* get_actor_image_sources() reads the members as an array of file names */
+typedef char actor_images_are_file_names[
+	(sizeof(enhanced_actor_images_t) % MAX_FILE_PATH) == 0 ? 1 : -1];
 
 actor_texture_cache_t* actor_texture_handles = NULL;
 SDL_Thread* actor_texture_threads[ACTOR_TEXTURE_THREAD_COUNT];
+Uint32 actor_texture_thread_count = 0;
 Uint32 max_actor_texture_handles = 32;
 queue_t* actor_texture_queue = NULL;
 Uint32 actor_texture_threads_done = 0;
+int actor_texture_disk_cache = 0;
+
+static actor_image_cache_t actor_image_cache[ACTOR_IMAGE_CACHE_MAX];
+static SDL_mutex* actor_image_cache_mutex = NULL;
+static Uint32 actor_image_cache_time = 0;
+static hash_table* actor_image_sources = NULL;
 #endif	/* ELC */
 
 #define TEXTURE_CACHE_MAX 8192
 
+#ifdef	ELC
+#define TEXTURE_DECODE_THREAD_COUNT 2
+#define TEXTURE_STREAM_FIRST_LEVEL 3
+
+int threaded_texture_loading = 1;
+int texture_upload_budget = 4096;
+int texture_streaming = 0;
+
+static SDL_Thread* texture_decode_threads[TEXTURE_DECODE_THREAD_COUNT];
+static Uint32 texture_decode_threads_done = 0;
+static queue_t* texture_decode_queue = NULL;
+static queue_t* texture_upload_queue = NULL;
+static SDL_mutex* texture_decode_mutex = NULL;
+static texture_loading_stats_t texture_loading_stats;
+static GLuint texture_placeholder_id = 0;
+#endif	/* ELC */
+
 static texture_cache_t* texture_handles = NULL;
 static cache_struct* texture_cache = NULL;
 static Uint32 texture_handles_used = 0;
@@ -40,6 +112,15 @@ static Uint32 texture_handles_used = 0;
 static Uint32 texture_cache_sorted[TEXTURE_CACHE_MAX];
 #endif
 
+int texture_memory_budget = 0;
+int texture_cpu_only = 0;
+
+static texture_residency_stats_t texture_residency_stats;
+static GLuint texture_cpu_only_id = 0;
+#ifdef	ELC
+static Uint32 texture_residency_check_time = 0;
+#endif	/* ELC */
+
 Uint32 compact_texture(texture_cache_t* texture)
 {
 	Uint32 size;
@@ -54,12 +135,33 @@ Uint32 compact_texture(texture_cache_t* texture)
 		return 0;
 	}
 
-	glDeleteTextures(1, &texture->id);
+	if (texture_cpu_only == 0)
+	{
+		glDeleteTextures(1, &texture->id);
+	}
 
 	size = texture->size;
 
+	texture_residency_stats.resident_bytes -= texture->size;
+	texture_residency_stats.decoded_bytes -= texture->decoded_size;
+	texture_residency_stats.resident--;
+
 	texture->id = 0;
 	texture->size = 0;
+	texture->decoded_size = 0;
+#ifdef	ELC
+	CHECK_AND_LOCK_MUTEX(texture_decode_mutex);
+
+	// a more detailed image waiting for upload is not needed anymore
+	if (texture->state == tst_image_loaded)
+	{
+		free_image(&texture->image);
+	}
+
+	texture->state = tst_unloaded;
+
+	CHECK_AND_UNLOCK_MUTEX(texture_decode_mutex);
+#endif	/* ELC */
 
 	return size;
 }
@@ -69,13 +171,66 @@ void bind_texture_id(const GLuint id)
 	if (last_texture != id)
 	{
 		last_texture = id;
+
+		if (texture_cpu_only != 0)
+		{
+			return;
+		}
+
 		glBindTexture(GL_TEXTURE_2D, id);
 	}
 }
 
+static Uint32 get_texture_memory_size(const GLenum internal_format,
+	const Uint32 width, const Uint32 height)
+{
+	switch (internal_format)
+	{
+		case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+		case GL_COMPRESSED_LUMINANCE_LATC1_EXT:
+			return ((width + 3) / 4) * ((height + 3) / 4) * 8;
+		case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+		case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+		case GL_COMPRESSED_LUMINANCE_ALPHA_3DC_ATI:
+		case GL_COMPRESSED_LUMINANCE_ALPHA_LATC2_EXT:
+			return ((width + 3) / 4) * ((height + 3) / 4) * 16;
+		case GL_ALPHA8:
+		case GL_LUMINANCE8:
+			return width * height;
+		case GL_RGBA4:
+		case GL_RGB5:
+		case GL_RGB5_A1:
+		case GL_LUMINANCE8_ALPHA8:
+			return width * height * 2;
+		default:
+			// drivers store RGB8 padded to four bytes
+			return width * height * 4;
+	}
+}
+
+static Uint32 get_image_memory_size(const GLenum internal_format,
+	const image_t* image)
+{
+	Uint32 width, height, size, i;
+
+	width = image->width;
+	height = image->height;
+	size = 0;
+
+	for (i = 0; i < image->mipmaps; i++)
+	{
+		size += get_texture_memory_size(internal_format, width, height);
+
+		width = max2u(width / 2, 1);
+		height = max2u(height / 2, 1);
+	}
+
+	return size;
+}
+
 static GLuint build_texture(image_t* image, const Uint32 wrap_mode_repeat,
 	const GLenum min_filter, const Uint32 af,
-	const texture_format_type format)
+	const texture_format_type format, Uint32* memory_size)
 {
 	void* ptr;
 	GLuint id;
@@ -299,6 +454,19 @@ static GLuint build_texture(image_t* image, const Uint32 wrap_mode_repeat,
 		return 0;
 	}
 
+	if (memory_size != 0)
+	{
+		*memory_size = get_image_memory_size(internal_format, image);
+	}
+
+	// the CPU only mode stops before the first GL call
+	if (texture_cpu_only != 0)
+	{
+		texture_cpu_only_id++;
+
+		return texture_cpu_only_id;
+	}
+
 	glGenTextures(1, &id);
 	glBindTexture(GL_TEXTURE_2D, id);	//failsafe
 	bind_texture_id(id);
@@ -529,90 +697,383 @@ static Uint32 get_supported_compression_formats()
 	return result;
 }
 
-static Uint32 load_texture(texture_cache_t* texture_handle)
+typedef struct
 {
-	image_t image;
-	GLuint id;
-	Uint32 strip_mipmaps, base_level, wrap_mode_repeat, af, i, compression;
+	Uint32 strip_mipmaps;
+	Uint32 base_level;
+	Uint32 wrap_mode_repeat;
+	Uint32 af;
+	Uint32 compression;
 	GLenum min_filter;
 	texture_format_type format;
+} texture_load_options_t;
 
-	memset(&image, 0, sizeof(image_t));
-
-	wrap_mode_repeat = 0;
-	strip_mipmaps = 0;
-	base_level = 0;
-	af = 0;
-	min_filter = GL_LINEAR;
-	format = tft_auto;
+static void get_texture_load_options(const texture_type type,
+	texture_load_options_t* options)
+{
+	options->wrap_mode_repeat = 0;
+	options->strip_mipmaps = 0;
+	options->base_level = 0;
+	options->af = 0;
+	options->min_filter = GL_LINEAR;
+	options->format = tft_auto;
 
-	compression = get_supported_compression_formats();
+	options->compression = get_supported_compression_formats();
 
-	switch (texture_handle->type)
+	switch (type)
 	{
 		case tt_gui:
-			wrap_mode_repeat = 1;
-			strip_mipmaps = 1;
+			options->wrap_mode_repeat = 1;
+			options->strip_mipmaps = 1;
 			break;
 		case tt_image:
-			strip_mipmaps = 1;
-			if ((compression & tct_s3tc) == tct_s3tc)
+			options->strip_mipmaps = 1;
+			if ((options->compression & tct_s3tc) == tct_s3tc)
 			{
-				format = tft_dxt1;
+				options->format = tft_dxt1;
 			}
 
 			break;
 		case tt_font:
 			break;
 		case tt_mesh:
-			wrap_mode_repeat = 1;
+			options->wrap_mode_repeat = 1;
 			if (poor_man != 0)
 			{
-				min_filter = GL_LINEAR_MIPMAP_NEAREST;
-				base_level = 1;
+				options->min_filter = GL_LINEAR_MIPMAP_NEAREST;
+				options->base_level = 1;
 			}
 			else
 			{
-				min_filter = GL_LINEAR_MIPMAP_LINEAR;
-				af = 1;
+				options->min_filter = GL_LINEAR_MIPMAP_LINEAR;
+				options->af = 1;
 			}
 			break;
 		case tt_atlas:
-			wrap_mode_repeat = 0;
+			options->wrap_mode_repeat = 0;
 			break;
 	}
+}
 
-	if (load_image_data(texture_handle->file_name, compression, 0,
-		strip_mipmaps, base_level, &image) == 0)
-	{
-		texture_handle->load_err = 1;
+static Uint32 decode_texture(const char* file_name, const texture_type type,
+	const Uint32 stream_level, image_t* image)
+{
+	texture_load_options_t options;
+
+	memset(image, 0, sizeof(image_t));
 
-		LOG_ERROR("Error loading image '%s'",
-			texture_handle->file_name);
+	get_texture_load_options(type, &options);
+
+	if (load_image_data(file_name, options.compression, 0,
+		options.strip_mipmaps, max2u(options.base_level, stream_level),
+		image) == 0)
+	{
+		LOG_ERROR("Error loading image '%s'", file_name);
 
 		return 0;
 	}
 
-	id = build_texture(&image, wrap_mode_repeat, min_filter, af, format);
+	return 1;
+}
+
+static void upload_texture(texture_cache_t* texture_handle, image_t* image)
+{
+	texture_load_options_t options;
+	GLuint id;
+	Uint32 i;
+
+	get_texture_load_options(texture_handle->type, &options);
+
+	id = build_texture(image, options.wrap_mode_repeat, options.min_filter,
+		options.af, options.format, &texture_handle->size);
 
 	assert(id != 0);
 
 	texture_handle->id = id;
-	texture_handle->alpha = image.alpha;
-	texture_handle->size = 0;
+	texture_handle->alpha = image->alpha;
+	texture_handle->decoded_size = 0;
+	texture_handle->full_size = max2u(image->width, image->height) <<
+		image->base_level;
 
-	for (i = 0; i < image.mipmaps; i++)
+	// the file may have less mipmaps than requested, only a level above
+	// the one we always load can get more detail
+	if (image->base_level > options.base_level)
 	{
-		texture_handle->size += image.sizes[i];
+		texture_handle->stream_level = image->base_level;
+	}
+	else
+	{
+		texture_handle->stream_level = 0;
 	}
 
-	free_image(&image);
+	for (i = 0; i < image->mipmaps; i++)
+	{
+		texture_handle->decoded_size += image->sizes[i];
+	}
+
+	texture_residency_stats.resident_bytes += texture_handle->size;
+	texture_residency_stats.decoded_bytes += texture_handle->decoded_size;
+	texture_residency_stats.resident++;
+
+	if (texture_residency_stats.peak_resident_bytes <
+		texture_residency_stats.resident_bytes)
+	{
+		texture_residency_stats.peak_resident_bytes =
+			texture_residency_stats.resident_bytes;
+	}
+
+	free_image(image);
+}
+
+static Uint32 load_texture(texture_cache_t* texture_handle)
+{
+	image_t image;
+
+	if (decode_texture(texture_handle->file_name, texture_handle->type, 0,
+		&image) == 0)
+	{
+		texture_handle->load_err = 1;
+
+		return 0;
+	}
+
+	upload_texture(texture_handle, &image);
+
+	return 1;
+}
+
+#ifdef	ELC
+static void request_texture_decode(texture_cache_t* texture_handle,
+	const Uint32 stream_level)
+{
+	CHECK_AND_LOCK_MUTEX(texture_decode_mutex);
+
+	// unloaded textures or streamed textures that need more detail
+	if ((texture_handle->state == tst_unloaded) ||
+		((texture_handle->state == tst_texture_loaded) &&
+		(texture_handle->id != 0)))
+	{
+		texture_handle->state = tst_image_loading;
+		texture_handle->stream_request = stream_level;
+		texture_loading_stats.pending++;
+
+		queue_push_signal(texture_decode_queue, texture_handle);
+	}
+
+	CHECK_AND_UNLOCK_MUTEX(texture_decode_mutex);
+}
+
+static int texture_decode_thread(void* done)
+{
+	texture_cache_t* texture_handle;
+	char file_name[128];
+	texture_type type;
+	image_t image;
+	Uint32 result, stream_level;
+
+	init_thread_log("texture_decode");
+
+	while (*((Uint32*)done) == 0)
+	{
+		texture_handle = queue_pop_blocking(texture_decode_queue);
+
+		if (texture_handle == 0)
+		{
+			continue;
+		}
+
+		CHECK_AND_LOCK_MUTEX(texture_decode_mutex);
+
+		texture_loading_stats.pending--;
+
+		if (texture_handle->state != tst_image_loading)
+		{
+			// unloaded or loaded otherwise while waiting
+			CHECK_AND_UNLOCK_MUTEX(texture_decode_mutex);
+
+			continue;
+		}
+
+		safe_strncpy(file_name, texture_handle->file_name,
+			sizeof(file_name));
+		type = texture_handle->type;
+		stream_level = texture_handle->stream_request;
+		texture_loading_stats.decoding++;
+
+		CHECK_AND_UNLOCK_MUTEX(texture_decode_mutex);
+
+		result = decode_texture(file_name, type, stream_level, &image);
+
+		CHECK_AND_LOCK_MUTEX(texture_decode_mutex);
+
+		texture_loading_stats.decoding--;
+
+		if (texture_handle->state != tst_image_loading)
+		{
+			free_image(&image);
+		}
+		else if ((result == 0) && (texture_handle->id != 0))
+		{
+			// keep the streamed texture we have
+			texture_handle->state = tst_texture_loaded;
+			texture_handle->stream_level = 0;
+		}
+		else if (result == 0)
+		{
+			texture_handle->load_err = 1;
+			texture_handle->state = tst_unloaded;
+		}
+		else
+		{
+			memcpy(&texture_handle->image, &image, sizeof(image));
+			texture_handle->state = tst_image_loaded;
+
+			queue_push(texture_upload_queue, texture_handle);
+		}
+
+		CHECK_AND_UNLOCK_MUTEX(texture_decode_mutex);
+	}
 
 	return 1;
 }
 
-static Uint32 load_texture_handle(const Uint32 handle)
+static GLuint get_texture_placeholder_id()
+{
+	static const Uint8 white[4] = { 0xFF, 0xFF, 0xFF, 0xFF };
+
+	if (texture_cpu_only != 0)
+	{
+		return 0;
+	}
+
+	if (texture_placeholder_id == 0)
+	{
+		glGenTextures(1, &texture_placeholder_id);
+		glBindTexture(GL_TEXTURE_2D, texture_placeholder_id);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA,
+			GL_UNSIGNED_BYTE, white);
+		glBindTexture(GL_TEXTURE_2D, last_texture);
+
+		CHECK_GL_ERRORS();
+	}
+
+	return texture_placeholder_id;
+}
+
+void upload_decoded_textures()
+{
+	texture_cache_t* texture_handle;
+	image_t image;
+	Uint32 budget, uploaded, i, size;
+
+	budget = max2i(texture_upload_budget, 0) * 1024;
+	uploaded = 0;
+
+	// always upload at least one texture per frame
+	while ((uploaded == 0) || (uploaded < budget))
+	{
+		texture_handle = queue_pop(texture_upload_queue);
+
+		if (texture_handle == 0)
+		{
+			break;
+		}
+
+		CHECK_AND_LOCK_MUTEX(texture_decode_mutex);
+
+		if (texture_handle->state != tst_image_loaded)
+		{
+			CHECK_AND_UNLOCK_MUTEX(texture_decode_mutex);
+
+			continue;
+		}
+
+		memcpy(&image, &texture_handle->image, sizeof(image));
+		memset(&texture_handle->image, 0, sizeof(image));
+
+		CHECK_AND_UNLOCK_MUTEX(texture_decode_mutex);
+
+		for (i = 0; i < image.mipmaps; i++)
+		{
+			uploaded += image.sizes[i];
+		}
+
+		// replace the less detailed streamed texture
+		if (texture_handle->id != 0)
+		{
+			size = compact_texture(texture_handle);
+
+			cache_adj_size(texture_cache, -size, texture_handle);
+		}
+
+		texture_handle->state = tst_texture_loaded;
+
+		upload_texture(texture_handle, &image);
+
+		cache_adj_size(texture_cache, texture_handle->size,
+			texture_handle);
+
+		texture_loading_stats.uploaded++;
+		texture_loading_stats.uploaded_bytes += texture_handle->size;
+	}
+}
+
+void request_texture_screen_size(const Uint32 handle, const float size)
+{
+	texture_cache_t* texture_handle;
+	Uint32 level;
+
+	if (handle >= texture_handles_used)
+	{
+		return;
+	}
+
+	texture_handle = &texture_handles[handle];
+
+	if ((texture_handle->id == 0) || (texture_handle->stream_level == 0) ||
+		(texture_handle->state != tst_texture_loaded))
+	{
+		return;
+	}
+
+	level = 0;
+
+	// stream in all mipmaps, if streaming was disabled
+	if (texture_streaming != 0)
+	{
+		while ((level < texture_handle->stream_level) &&
+			((texture_handle->full_size >> (level + 1)) >= size))
+		{
+			level++;
+		}
+	}
+
+	if (level < texture_handle->stream_level)
+	{
+		request_texture_decode(texture_handle, level);
+	}
+}
+
+void get_texture_loading_stats(texture_loading_stats_t* stats)
 {
+	CHECK_AND_LOCK_MUTEX(texture_decode_mutex);
+
+	memcpy(stats, &texture_loading_stats, sizeof(texture_loading_stats_t));
+	stats->ready = texture_upload_queue->nodes;
+
+	CHECK_AND_UNLOCK_MUTEX(texture_decode_mutex);
+}
+#endif	/* ELC */
+
+static Uint32 load_texture_handle(const Uint32 handle, const Uint32 wait)
+{
+#ifdef	ELC
+	image_t image;
+	Uint32 decoded;
+#endif	/* ELC */
+
 	if (handle >= texture_handles_used)
 	{
 		LOG_ERROR("handle: %i, max_handle: %i\n", handle,
@@ -631,16 +1092,104 @@ static Uint32 load_texture_handle(const Uint32 handle)
 		return 0;
 	}
 
-	if (load_texture(&texture_handles[handle]) != 0)
-	{
-		cache_adj_size(texture_cache,
-			texture_handles[handle].size,
-			&texture_handles[handle]);
+#ifdef	ELC
+	if ((threaded_texture_loading != 0) && (wait == 0) &&
+		(texture_handles[handle].type == tt_mesh))
+	{
+		// streamed textures start with the small mipmaps only
+		request_texture_decode(&texture_handles[handle],
+			(texture_streaming != 0) ? TEXTURE_STREAM_FIRST_LEVEL : 0);
+
+		return 0;
+	}
+
+	// use the decoded image, if a decode thread was faster
+	CHECK_AND_LOCK_MUTEX(texture_decode_mutex);
+
+	decoded = texture_handles[handle].state == tst_image_loaded;
+
+	if (decoded != 0)
+	{
+		memcpy(&image, &texture_handles[handle].image, sizeof(image));
+		memset(&texture_handles[handle].image, 0, sizeof(image));
+	}
+
+	texture_handles[handle].state = tst_texture_loaded;
+
+	CHECK_AND_UNLOCK_MUTEX(texture_decode_mutex);
+
+	if (decoded != 0)
+	{
+		upload_texture(&texture_handles[handle], &image);
+	}
+	else if (load_texture(&texture_handles[handle]) == 0)
+	{
+		texture_handles[handle].state = tst_unloaded;
+
+		return 0;
+	}
+
+	cache_adj_size(texture_cache, texture_handles[handle].size,
+		&texture_handles[handle]);
+
+	return 1;
+#else	/* ELC */
+	if (load_texture(&texture_handles[handle]) != 0)
+	{
+		cache_adj_size(texture_cache,
+			texture_handles[handle].size,
+			&texture_handles[handle]);
+
+		return 1;
+	}
+
+	return 0;
+#endif	/* ELC */
+}
+
+#ifdef	ELC
+void check_texture_memory_budget()
+{
+	Uint64 budget, target, excess;
+	Uint32 evictions, size, last_check_time;
+
+	last_check_time = texture_residency_check_time;
+	texture_residency_check_time = cur_time;
+
+	if (texture_memory_budget <= 0)
+	{
+		return;
+	}
+
+	budget = ((Uint64)texture_memory_budget) * 1024 * 1024;
+
+	if (texture_residency_stats.resident_bytes <= budget)
+	{
+		return;
+	}
+
+	// evict a bit more than needed, so we don't evict every frame
+	target = budget - budget / 8;
 
-		return 1;
-	}
+	// the LRU list of the cache is ordered by the last bind, textures
+	// bound since the last check are in use
+	excess = texture_residency_stats.resident_bytes - target;
+	evictions = texture_cache->evictions;
+	size = cache_release_lru(texture_cache,
+		(excess < 0xFFFFFFFF) ? excess : 0xFFFFFFFF, last_check_time);
 
-	return 0;
+	texture_residency_stats.evictions += texture_cache->evictions -
+		evictions;
+	texture_residency_stats.evicted_bytes += size;
+}
+#endif	/* ELC */
+
+void get_texture_residency_stats(texture_residency_stats_t* stats)
+{
+	memcpy(stats, &texture_residency_stats,
+		sizeof(texture_residency_stats_t));
+	stats->budget = ((Uint64)max2i(texture_memory_budget, 0)) * 1024 *
+		1024;
 }
 
 static GLuint get_texture_id(const Uint32 handle)
@@ -653,8 +1202,22 @@ static GLuint get_texture_id(const Uint32 handle)
 		return 0;
 	}
 
-	if (load_texture_handle(handle) == 0)
+	texture_residency_stats.binds++;
+
+	if (texture_handles[handle].id != 0)
+	{
+		texture_residency_stats.hits++;
+	}
+
+	if (load_texture_handle(handle, 0) == 0)
 	{
+#ifdef	ELC
+		if (texture_handles[handle].state == tst_image_loading ||
+			texture_handles[handle].state == tst_image_loaded)
+		{
+			return get_texture_placeholder_id();
+		}
+#endif	/* ELC */
 		return 0;
 	}
 
@@ -676,7 +1239,7 @@ Uint32 get_texture_alpha(const Uint32 handle)
 		return 0;
 	}
 
-	if (load_texture_handle(handle) == 0)
+	if (load_texture_handle(handle, 1) == 0)
 	{
 		return 0;
 	}
@@ -1872,7 +2435,7 @@ Uint32 bind_actor_texture(const Uint32 handle, char* alpha)
 		}
 
 		id = build_texture(&actor_texture_handles[handle].image,
-			0, min_filter, af, format);
+			0, min_filter, af, format, 0);
 
 		CHECK_GL_ERRORS();
 
@@ -2121,6 +2684,373 @@ void change_enhanced_actor(const Uint32 handle, enhanced_actor* actor)
 	queue_push_signal(actor_texture_queue, &actor_texture_handles[handle]);
 }
 
+static Uint32 get_actor_image_options()
+{
+	Uint32 result;
+
+	result = 0;
+
+	if (poor_man != 0)
+	{
+		result |= 0x01;
+	}
+
+	if (have_extension(ext_texture_compression_s3tc))
+	{
+		result |= 0x02;
+	}
+
+	return result;
+}
+
+static void copy_actor_image(const image_t* source, image_t* dest)
+{
+	memcpy(dest, source, sizeof(image_t));
+
+	dest->image = malloc_aligned(source->sizes[0], 16);
+	memcpy(dest->image, source->image, source->sizes[0]);
+}
+
+/*!
+ * the size of a composed actor image, zero for formats it never has.
+ */
+static Uint32 get_actor_image_size(const Uint32 width, const Uint32 height,
+	const Uint32 format)
+{
+	switch (format)
+	{
+		case ift_dxt1:
+			return width * height / 2;
+		case ift_dxt3:
+		case ift_dxt5:
+			return width * height;
+		case ift_rgba8:
+			return width * height * 4;
+		default:
+			return 0;
+	}
+}
+
+/*!
+ * checksum of a source image, each file is read only once per session.
+ */
+static Uint32 get_actor_image_source_crc(const char* file_name)
+{
+	actor_image_source_t* source;
+	hash_entry* entry;
+	el_file_ptr file;
+	Uint32 crc;
+
+	CHECK_AND_LOCK_MUTEX(actor_image_cache_mutex);
+
+	entry = hash_get(actor_image_sources, (void*)file_name);
+	crc = entry != 0 ? ((actor_image_source_t*)entry->item)->crc : 0;
+
+	CHECK_AND_UNLOCK_MUTEX(actor_image_cache_mutex);
+
+	if (entry != 0)
+	{
+		return crc;
+	}
+
+	// read without the lock, two threads may read the same file at worst
+	file = el_open_custom(file_name);
+
+	if (file != 0)
+	{
+#ifdef FASTER_MAP_LOAD
+		crc = el_crc32(file);
+#else // FASTER_MAP_LOAD
+		crc = CrcCalc(el_get_pointer(file), el_get_size(file));
+#endif // FASTER_MAP_LOAD
+		el_close(file);
+	}
+
+	CHECK_AND_LOCK_MUTEX(actor_image_cache_mutex);
+
+	if (hash_get(actor_image_sources, (void*)file_name) == 0)
+	{
+		source = calloc(1, sizeof(actor_image_source_t));
+		safe_strncpy(source->name, file_name, sizeof(source->name));
+		source->crc = crc;
+		hash_add(actor_image_sources, source->name, source);
+	}
+
+	CHECK_AND_UNLOCK_MUTEX(actor_image_cache_mutex);
+
+	return crc;
+}
+
+/*!
+ * checksum of the source images, so a cached image of an updated skin is
+ * not used.
+ */
+static Uint32 get_actor_image_sources(const enhanced_actor_images_t* files)
+{
+	const char* file_name;
+	char buffer[128];
+	Uint32 i, crc, result;
+
+	result = CRC_INIT_VAL;
+
+	// all members are file names
+	for (i = 0; i < (sizeof(enhanced_actor_images_t) / MAX_FILE_PATH); i++)
+	{
+		file_name = ((const char*)files) + i * MAX_FILE_PATH;
+
+		if ((file_name[0] == 0) ||
+			(check_image_name(file_name, sizeof(buffer), buffer) == 0))
+		{
+			continue;
+		}
+
+		crc = get_actor_image_source_crc(buffer);
+
+		if (crc == 0)
+		{
+			continue;
+		}
+
+		result = CrcUpdate(result, &i, sizeof(i));
+		result = CrcUpdate(result, &crc, sizeof(crc));
+	}
+
+	return CRC_GET_DIGEST(result);
+}
+
+// the names are on disk, so they can't use mem_hash(), that may change
+static void get_actor_image_file_name(const enhanced_actor_images_t* files,
+	const Uint32 options, char* file_name, const Uint32 size)
+{
+	safe_snprintf(file_name, size, "actor_textures/%08x_%u.dat",
+		CrcCalc(files, sizeof(enhanced_actor_images_t)), options);
+}
+
+static Uint32 load_actor_image_file(const enhanced_actor_images_t* files,
+	const Uint32 options, const Uint32 sources, image_t* image)
+{
+	enhanced_actor_images_t file_files;
+	actor_image_file_header_t header;
+	char file_name[128];
+	FILE* file;
+
+	get_actor_image_file_name(files, options, file_name, sizeof(file_name));
+
+	file = open_file_config_no_local(file_name, "rb");
+
+	if (file == 0)
+	{
+		return 0;
+	}
+
+	memset(image, 0, sizeof(image_t));
+
+	if ((fread(&header, sizeof(header), 1, file) != 1) ||
+		(header.magic != ACTOR_IMAGE_CACHE_MAGIC) ||
+		(header.version != ACTOR_IMAGE_CACHE_VERSION) ||
+		(header.options != options) ||
+		(header.sources != sources) ||
+		(fread(&file_files, sizeof(file_files), 1, file) != 1) ||
+		(memcmp(&file_files, files, sizeof(file_files)) != 0) ||
+		(header.width != header.height) ||
+		(header.width < 128) || (header.width > 1024) ||
+		(popcount(header.width) != 1) ||
+		(header.alpha > 1) || (header.size == 0) ||
+		(header.size != get_actor_image_size(header.width,
+			header.height, header.format)))
+	{
+		fclose(file);
+
+		return 0;
+	}
+
+	image->sizes[0] = header.size;
+	image->width = header.width;
+	image->height = header.height;
+	image->mipmaps = 1;
+	image->format = header.format;
+	image->alpha = header.alpha;
+	image->image = malloc_aligned(header.size, 16);
+
+	if (fread(image->image, header.size, 1, file) != 1)
+	{
+		free_image(image);
+		fclose(file);
+
+		return 0;
+	}
+
+	fclose(file);
+
+	return 1;
+}
+
+static void save_actor_image_file(const enhanced_actor_images_t* files,
+	const Uint32 options, const Uint32 sources, const image_t* image)
+{
+	actor_image_file_header_t header;
+	char file_name[128];
+	FILE* file;
+
+	get_actor_image_file_name(files, options, file_name, sizeof(file_name));
+
+	file = open_file_config_no_local(file_name, "wb");
+
+	if (file == 0)
+	{
+		LOG_ERROR("Can't write actor texture cache file '%s'",
+			file_name);
+
+		return;
+	}
+
+	header.magic = ACTOR_IMAGE_CACHE_MAGIC;
+	header.version = ACTOR_IMAGE_CACHE_VERSION;
+	header.options = options;
+	header.width = image->width;
+	header.height = image->height;
+	header.format = image->format;
+	header.alpha = image->alpha;
+	header.size = image->sizes[0];
+	header.sources = sources;
+
+	if ((fwrite(&header, sizeof(header), 1, file) != 1) ||
+		(fwrite(files, sizeof(enhanced_actor_images_t), 1, file) != 1) ||
+		(fwrite(image->image, image->sizes[0], 1, file) != 1))
+	{
+		LOG_ERROR("Can't write actor texture cache file '%s'",
+			file_name);
+	}
+
+	fclose(file);
+}
+
+static void add_actor_image_cache(const enhanced_actor_images_t* files,
+	const Uint32 hash, const Uint32 options, const image_t* image)
+{
+	Uint32 i, index;
+
+	CHECK_AND_LOCK_MUTEX(actor_image_cache_mutex);
+
+	index = 0;
+
+	for (i = 0; i < ACTOR_IMAGE_CACHE_MAX; i++)
+	{
+		if (actor_image_cache[i].image.image == 0)
+		{
+			index = i;
+
+			break;
+		}
+
+		if (actor_image_cache[i].access_time <
+			actor_image_cache[index].access_time)
+		{
+			index = i;
+		}
+	}
+
+	if (actor_image_cache[index].image.image != 0)
+	{
+		free_image(&actor_image_cache[index].image);
+	}
+
+	memcpy(&actor_image_cache[index].files, files,
+		sizeof(enhanced_actor_images_t));
+	copy_actor_image(image, &actor_image_cache[index].image);
+	actor_image_cache[index].hash = hash;
+	actor_image_cache[index].options = options;
+	actor_image_cache[index].access_time = ++actor_image_cache_time;
+
+	CHECK_AND_UNLOCK_MUTEX(actor_image_cache_mutex);
+}
+
+static Uint32 find_actor_image_cache(const enhanced_actor_images_t* files,
+	const Uint32 hash, const Uint32 options, image_t* image)
+{
+	Uint32 i;
+
+	CHECK_AND_LOCK_MUTEX(actor_image_cache_mutex);
+
+	for (i = 0; i < ACTOR_IMAGE_CACHE_MAX; i++)
+	{
+		if ((actor_image_cache[i].image.image != 0) &&
+			(actor_image_cache[i].hash == hash) &&
+			(actor_image_cache[i].options == options) &&
+			(memcmp(&actor_image_cache[i].files, files,
+				sizeof(enhanced_actor_images_t)) == 0))
+		{
+			copy_actor_image(&actor_image_cache[i].image, image);
+			actor_image_cache[i].access_time =
+				++actor_image_cache_time;
+
+			CHECK_AND_UNLOCK_MUTEX(actor_image_cache_mutex);
+
+			return 1;
+		}
+	}
+
+	CHECK_AND_UNLOCK_MUTEX(actor_image_cache_mutex);
+
+	return 0;
+}
+
+static void clear_actor_image_cache()
+{
+	Uint32 i;
+
+	CHECK_AND_LOCK_MUTEX(actor_image_cache_mutex);
+
+	for (i = 0; i < ACTOR_IMAGE_CACHE_MAX; i++)
+	{
+		if (actor_image_cache[i].image.image != 0)
+		{
+			free_image(&actor_image_cache[i].image);
+		}
+	}
+
+	memset(actor_image_cache, 0, sizeof(actor_image_cache));
+
+	CHECK_AND_UNLOCK_MUTEX(actor_image_cache_mutex);
+}
+
+static void compose_enhanced_actor(const enhanced_actor_images_t* files,
+	const Uint32 hash, image_t* image, Uint8* buffer)
+{
+	Uint32 options, sources;
+
+	options = get_actor_image_options();
+
+	// identical outfits are composed only once
+	if (find_actor_image_cache(files, hash, options, image) != 0)
+	{
+		return;
+	}
+
+	sources = 0;
+
+	if (actor_texture_disk_cache != 0)
+	{
+		sources = get_actor_image_sources(files);
+
+		if (load_actor_image_file(files, options, sources, image) != 0)
+		{
+			add_actor_image_cache(files, hash, options, image);
+
+			return;
+		}
+	}
+
+	load_enhanced_actor_threaded(files, image, buffer);
+
+	add_actor_image_cache(files, hash, options, image);
+
+	if (actor_texture_disk_cache != 0)
+	{
+		save_actor_image_file(files, options, sources, image);
+	}
+}
+
 int load_enhanced_actor_thread(void* done)
 {
 	enhanced_actor_images_t files;
@@ -2152,7 +3082,7 @@ int load_enhanced_actor_thread(void* done)
 
 			CHECK_AND_UNLOCK_MUTEX(actor->mutex);
 
-			load_enhanced_actor_threaded(&files, &image, buffer);
+			compose_enhanced_actor(&files, hash, &image, buffer);
 
 			CHECK_AND_LOCK_MUTEX(actor->mutex);
 
@@ -2238,11 +3168,34 @@ void init_texture_cache()
 		actor_texture_handles[i].state = tst_unloaded;
 	}
 
-	for (i = 0; i < ACTOR_TEXTURE_THREAD_COUNT; i++)
+	actor_image_cache_mutex = SDL_CreateMutex();
+	actor_image_sources = create_hash_table(256, hash_fn_str, cmp_fn_str,
+		free);
+
+	// composing is CPU bound, so use the spare cores
+	actor_texture_thread_count = min2u(max2i(SDL_GetCPUCount() - 1, 2),
+		ACTOR_TEXTURE_THREAD_COUNT);
+
+	for (i = 0; i < actor_texture_thread_count; i++)
 	{
 		actor_texture_threads[i] = SDL_CreateThread(
 			load_enhanced_actor_thread, "TextureThread", &actor_texture_threads_done);
 	}
+
+	memset(&texture_loading_stats, 0, sizeof(texture_loading_stats));
+
+	texture_decode_mutex = SDL_CreateMutex();
+	texture_decode_threads_done = 0;
+
+	queue_initialise(&texture_decode_queue);
+	queue_initialise(&texture_upload_queue);
+
+	for (i = 0; i < TEXTURE_DECODE_THREAD_COUNT; i++)
+	{
+		texture_decode_threads[i] = SDL_CreateThread(
+			texture_decode_thread, "TextureDecodeThread",
+			&texture_decode_threads_done);
+	}
 #endif	/* ELC */
 }
 
@@ -2256,7 +3209,7 @@ void free_texture_cache()
 
 	while (queue_pop(actor_texture_queue) != 0);
 
-	for (i = 0; i < ACTOR_TEXTURE_THREAD_COUNT; i++)
+	for (i = 0; i < actor_texture_thread_count; i++)
 	{
 		SDL_CondBroadcast(actor_texture_queue->condition);
 		SDL_WaitThread(actor_texture_threads[i], &result);
@@ -2264,6 +3217,43 @@ void free_texture_cache()
 
 	queue_destroy(actor_texture_queue);
 
+	clear_actor_image_cache();
+	destroy_hash_table(actor_image_sources);
+	actor_image_sources = NULL;
+	SDL_DestroyMutex(actor_image_cache_mutex);
+	actor_image_cache_mutex = NULL;
+
+	texture_decode_threads_done = 1;
+
+	while (queue_pop(texture_decode_queue) != 0);
+
+	for (i = 0; i < TEXTURE_DECODE_THREAD_COUNT; i++)
+	{
+		SDL_CondBroadcast(texture_decode_queue->condition);
+		SDL_WaitThread(texture_decode_threads[i], &result);
+	}
+
+	while (queue_pop(texture_upload_queue) != 0);
+
+	queue_destroy(texture_decode_queue);
+	queue_destroy(texture_upload_queue);
+	SDL_DestroyMutex(texture_decode_mutex);
+
+	texture_decode_queue = NULL;
+	texture_upload_queue = NULL;
+	texture_decode_mutex = NULL;
+
+	for (i = 0; i < texture_handles_used; i++)
+	{
+		free_image(&texture_handles[i].image);
+	}
+
+	if (texture_placeholder_id != 0)
+	{
+		glDeleteTextures(1, &texture_placeholder_id);
+		texture_placeholder_id = 0;
+	}
+
 	for (i = 0; i < ACTOR_TEXTURE_CACHE_MAX; i++)
 	{
 		free_actor_texture_resources(&actor_texture_handles[i]);
@@ -2279,7 +3269,7 @@ void free_texture_cache()
 
 	for (i = 0; i < texture_handles_used; i++)
 	{
-		if (texture_handles[i].id != 0)
+		if ((texture_handles[i].id != 0) && (texture_cpu_only == 0))
 		{
 			glDeleteTextures(1, &texture_handles[i].id);
 		}
@@ -2289,25 +3279,61 @@ void free_texture_cache()
 
 	cache_delete(texture_cache);
 	texture_cache = NULL;
+
+	memset(&texture_residency_stats, 0, sizeof(texture_residency_stats));
 }
 
 void unload_texture_cache()
 {
 	Uint32 i;
 
+#ifdef	ELC
+	while (queue_pop(texture_upload_queue) != 0);
+
+	CHECK_AND_LOCK_MUTEX(texture_decode_mutex);
+
+	for (i = 0; i < texture_handles_used; i++)
+	{
+		if (texture_handles[i].state == tst_image_loaded)
+		{
+			free_image(&texture_handles[i].image);
+		}
+
+		texture_handles[i].state = tst_unloaded;
+	}
+
+	CHECK_AND_UNLOCK_MUTEX(texture_decode_mutex);
+
+	if (texture_placeholder_id != 0)
+	{
+		glDeleteTextures(1, &texture_placeholder_id);
+		texture_placeholder_id = 0;
+	}
+#endif	/* ELC */
+
 	for (i = 0; i < texture_handles_used; i++)
 	{
 		if (texture_handles[i].id != 0)
 		{
-			glDeleteTextures(1, &texture_handles[i].id);
+			if (texture_cpu_only == 0)
+			{
+				glDeleteTextures(1, &texture_handles[i].id);
+			}
 
 			texture_handles[i].id = 0;
 
 			cache_adj_size(texture_cache, -texture_handles[i].size,
 				&texture_handles[i]);
+
+			texture_handles[i].size = 0;
+			texture_handles[i].decoded_size = 0;
 		}
 	}
 
+	texture_residency_stats.resident = 0;
+	texture_residency_stats.resident_bytes = 0;
+	texture_residency_stats.decoded_bytes = 0;
+
 #ifdef	ELC
 	unload_actor_texture_cache();
 #endif	/* ELC */
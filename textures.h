@@ -47,6 +47,15 @@ typedef enum
 	tft_ati2
 } texture_format_type;
 
+typedef enum
+{
+	tst_unloaded = 0,
+	tst_image_loading,
+	tst_image_loaded,
+	tst_texture_loading,
+	tst_texture_loaded
+} texture_state_type;
+
 /*!
  * we use a separate cache structure to cache textures.
  */
@@ -56,12 +65,57 @@ typedef struct
 	cache_item_struct *cache_ptr;	/*!< a pointer to the cached item */
 	GLuint id;			/*!< the id of the texture */
 	Uint32 hash;			/*!< hash value of the name */
-	Uint32 size;			/*!< size of the texture */
+	Uint32 size;			/*!< size of the texture in video memory */
+	Uint32 decoded_size;		/*!< size of the decoded image */
 	texture_type type;		/*!< the texture type, needed for loading and unloading */
 	Uint8 load_err;			/*!< if true, we tried to load this texture before and failed */
 	Uint8 alpha;			/*!< the texture has an alpha channel */
+	Uint8 stream_level;		/*!< the first mipmap level loaded */
+	Uint8 stream_request;		/*!< the first mipmap level to load */
+	Uint32 full_size;		/*!< width or height of the full image, whichever is larger */
+#ifdef	ELC
+	image_t image;			/*!< the decoded image, waiting for upload */
+	texture_state_type state;	/*!< the texture states e.g. loading */
+#endif	/* ELC */
 } texture_cache_t;
 
+/*!
+ * statistics of the texture residency.
+ */
+typedef struct
+{
+	Uint64 binds;			/*!< number of texture binds */
+	Uint64 hits;			/*!< binds of already resident textures */
+	Uint64 evictions;		/*!< textures evicted because of the budget */
+	Uint64 evicted_bytes;		/*!< video memory freed by evictions */
+	Uint64 resident_bytes;		/*!< video memory used by resident textures */
+	Uint64 peak_resident_bytes;	/*!< maximum of resident_bytes */
+	Uint64 decoded_bytes;		/*!< decoded size of the resident textures */
+	Uint64 budget;			/*!< the budget in bytes, zero if unlimited */
+	Uint32 resident;		/*!< number of resident textures */
+} texture_residency_stats_t;
+
+extern int texture_memory_budget;	/*!< texture memory budget in megabytes, zero for no limit */
+extern int texture_cpu_only;	/*!< if set, textures are decoded and their video memory estimated, but never given to GL */
+
+#ifdef	ELC
+/*!
+ * statistics of the threaded texture loading.
+ */
+typedef struct
+{
+	Uint32 pending;			/*!< textures waiting for a decode thread */
+	Uint32 decoding;		/*!< textures decoded at the moment */
+	Uint32 ready;			/*!< decoded textures waiting for upload */
+	Uint32 uploaded;		/*!< textures uploaded by upload_decoded_textures */
+	Uint64 uploaded_bytes;		/*!< bytes uploaded by upload_decoded_textures */
+} texture_loading_stats_t;
+
+extern int threaded_texture_loading;	/*!< decode mesh textures in background threads */
+extern int texture_upload_budget;	/*!< kilobytes of decoded textures uploaded per frame */
+extern int texture_streaming;		/*!< load the small mipmaps of mesh textures first */
+#endif	/* ELC */
+
 /*!
  * \ingroup 	textures
  * \brief 	Loads a texture for non-gui use.
@@ -152,8 +206,69 @@ void bind_texture_unbuffered(const Uint32 handle);
  */
 Uint32 get_texture_alpha(const Uint32 handle);
 
+/*!
+ * \ingroup 	textures
+ * \brief 	Gets the texture residency statistics
+ *
+ *      	Fills in the statistics of the texture residency.
+ *
+ * \param	stats Pointer to the statistics to fill in.
+ * \callgraph
+ */
+void get_texture_residency_stats(texture_residency_stats_t* stats);
+
 #ifdef	ELC
 
+/*!
+ * \ingroup 	textures
+ * \brief 	Enforces the texture memory budget
+ *
+ *      	Evicts the least recently bound textures, from the end of the
+ *		LRU list of the texture cache, until the resident textures fit
+ *		into texture_memory_budget again. Textures bound since the last
+ *		call are never evicted.
+ *
+ * \callgraph
+ */
+void check_texture_memory_budget();
+
+/*!
+ * \ingroup 	textures
+ * \brief 	Uploads decoded textures
+ *
+ *      	Uploads the textures decoded by the background threads, at
+ *		most texture_upload_budget kilobytes (but at least one texture)
+ *		per call. Must be called from the thread owning the GL context.
+ *
+ * \callgraph
+ */
+void upload_decoded_textures();
+
+/*!
+ * \ingroup 	textures
+ * \brief 	Requests texture detail for a screen size
+ *
+ *      	Streamed textures are loaded without their largest mipmaps.
+ *		Loads the mipmaps needed to draw the texture with the given
+ *		size in pixels in background, if they are not loaded yet.
+ *
+ * \param	handle The texture handle.
+ * \param	size The size of the textured object on screen in pixels.
+ * \callgraph
+ */
+void request_texture_screen_size(const Uint32 handle, const float size);
+
+/*!
+ * \ingroup 	textures
+ * \brief 	Gets the texture loading statistics
+ *
+ *      	Fills in the statistics of the threaded texture loading.
+ *
+ * \param	stats Pointer to the statistics to fill in.
+ * \callgraph
+ */
+void get_texture_loading_stats(texture_loading_stats_t* stats);
+
 /*!
  * we use a separate cache structure to cache textures.
  */
@@ -191,17 +306,10 @@ typedef struct
 	char hands_tex_save[MAX_FILE_PATH];
 } enhanced_actor_images_t;
 
-typedef enum
-{
-	tst_unloaded = 0,
-	tst_image_loading,
-	tst_image_loaded,
-	tst_texture_loading,
-	tst_texture_loaded
-} texture_state_type;
-
 #define MAX_ACTOR_NAME 24
 
+extern int actor_texture_disk_cache;	/*!< keep composed actor textures in the config dir */
+
 /*!
  * we use a separate cache structure to cache textures.
  */
@@ -0,0 +1,181 @@
+#include <SDL.h>
+#include <SDL_thread.h>
+#include <SDL_atomic.h>
+#include "worker_pool.h"
+#include "errors.h"
+#include "misc.h"
+
+static SDL_Thread *worker_threads[WORKER_POOL_MAX_THREADS];
+static Uint32 worker_count = 0;
+static SDL_sem *worker_start_sem = NULL;
+static SDL_sem *worker_done_sem = NULL;
+static SDL_atomic_t worker_pool_done;
+
+/* the current job, set before the workers are woken up */
+static worker_pool_job_t worker_job = NULL;
+static void *worker_data = NULL;
+static Uint32 worker_job_count = 0;
+static Uint32 worker_job_batch = 1;
+static SDL_atomic_t worker_next_index;
+
+static void run_batches(void)
+{
+	Uint32 start, end, i;
+
+	while (1)
+	{
+		start = SDL_AtomicAdd(&worker_next_index, worker_job_batch);
+
+		if (start >= worker_job_count)
+		{
+			return;
+		}
+
+		end = min2u(start + worker_job_batch, worker_job_count);
+
+		for (i = start; i < end; i++)
+		{
+			worker_job(worker_data, i);
+		}
+	}
+}
+
+static int worker_thread(void *data)
+{
+	while (1)
+	{
+		SDL_SemWait(worker_start_sem);
+
+		if (SDL_AtomicGet(&worker_pool_done) != 0)
+		{
+			return 0;
+		}
+
+		run_batches();
+
+		SDL_SemPost(worker_done_sem);
+	}
+}
+
+void init_worker_pool(void)
+{
+	Uint32 i;
+
+	SDL_AtomicSet(&worker_pool_done, 0);
+	SDL_AtomicSet(&worker_next_index, 0);
+
+	worker_count = min2u(max2i(SDL_GetCPUCount() - 1, 0),
+		WORKER_POOL_MAX_THREADS);
+
+	if (worker_count == 0)
+	{
+		return;
+	}
+
+	worker_start_sem = SDL_CreateSemaphore(0);
+	worker_done_sem = SDL_CreateSemaphore(0);
+
+	if ((worker_start_sem == NULL) || (worker_done_sem == NULL))
+	{
+		LOG_ERROR("Can't create worker pool semaphores: %s",
+			SDL_GetError());
+		worker_count = 0;
+		return;
+	}
+
+	for (i = 0; i < worker_count; i++)
+	{
+		worker_threads[i] = SDL_CreateThread(worker_thread,
+			"WorkerThread", NULL);
+
+		if (worker_threads[i] == NULL)
+		{
+			LOG_ERROR("Can't create worker thread: %s",
+				SDL_GetError());
+			break;
+		}
+	}
+
+	worker_count = i;
+
+	LOG_INFO("Started %u worker threads", worker_count);
+}
+
+void free_worker_pool(void)
+{
+	Uint32 i;
+
+	SDL_AtomicSet(&worker_pool_done, 1);
+
+	for (i = 0; i < worker_count; i++)
+	{
+		SDL_SemPost(worker_start_sem);
+	}
+
+	for (i = 0; i < worker_count; i++)
+	{
+		SDL_WaitThread(worker_threads[i], NULL);
+		worker_threads[i] = NULL;
+	}
+
+	worker_count = 0;
+
+	if (worker_start_sem != NULL)
+	{
+		SDL_DestroySemaphore(worker_start_sem);
+		worker_start_sem = NULL;
+	}
+
+	if (worker_done_sem != NULL)
+	{
+		SDL_DestroySemaphore(worker_done_sem);
+		worker_done_sem = NULL;
+	}
+}
+
+Uint32 get_worker_pool_size(void)
+{
+	return worker_count;
+}
+
+void worker_pool_run(worker_pool_job_t job, void *data, Uint32 count,
+	Uint32 batch)
+{
+	Uint32 wake, i;
+
+	batch = max2u(batch, 1);
+
+	if ((worker_count == 0) || (count <= batch))
+	{
+		for (i = 0; i < count; i++)
+		{
+			job(data, i);
+		}
+
+		return;
+	}
+
+	// the calling thread takes one batch itself
+	wake = min2u((count + batch - 1) / batch - 1, worker_count);
+
+	worker_job = job;
+	worker_data = data;
+	worker_job_count = count;
+	worker_job_batch = batch;
+	SDL_AtomicSet(&worker_next_index, 0);
+
+	for (i = 0; i < wake; i++)
+	{
+		SDL_SemPost(worker_start_sem);
+	}
+
+	run_batches();
+
+	for (i = 0; i < wake; i++)
+	{
+		SDL_SemWait(worker_done_sem);
+	}
+
+	worker_job = NULL;
+	worker_data = NULL;
+}
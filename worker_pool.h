@@ -0,0 +1,62 @@
+/*!
+ * \file
+ * \ingroup misc
+ * \brief Pool of worker threads for splitting per-frame work across the cores.
+ *
+ *      The pool runs a job for each index of a range. The indices are claimed
+ *      in batches by the workers and the calling thread, so the call returns
+ *      when the whole range is done. The job must not depend on the order in
+ *      which the indices are run, then the result is the same as running the
+ *      indices one after the other.
+ *
+ *      Only the main thread may run jobs, the pool is not reentrant.
+ */
+#ifndef	WORKER_POOL_H
+#define	WORKER_POOL_H
+
+#include <SDL_types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WORKER_POOL_MAX_THREADS	16	/*!< max. number of worker threads */
+
+/*!
+ * A job of the pool.
+ * \param data	the data passed to \ref worker_pool_run
+ * \param index	the index to work on
+ */
+typedef void (*worker_pool_job_t)(void *data, Uint32 index);
+
+/*!
+ * \brief Starts the worker threads, one less than there are cores.
+ */
+void init_worker_pool(void);
+
+/*!
+ * \brief Stops the worker threads.
+ */
+void free_worker_pool(void);
+
+/*!
+ * \brief Gets the number of worker threads.
+ * \retval Uint32	the number of workers, zero if all jobs run on the calling thread
+ */
+Uint32 get_worker_pool_size(void);
+
+/*!
+ * \brief Runs a job for the indices 0 to \a count - 1 and waits until all are done.
+ * \param job	the job
+ * \param data	passed to the job
+ * \param count	the number of indices
+ * \param batch	the number of indices a thread claims at once, at least one
+ */
+void worker_pool_run(worker_pool_job_t job, void *data, Uint32 count,
+	Uint32 batch);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif	/* WORKER_POOL_H */